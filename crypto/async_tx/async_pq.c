@@ -123,6 +123,7 @@ static void
 do_sync_gen_syndrome(struct page **blocks, unsigned int offset, int disks,
 		     size_t len, struct async_submit_ctl *submit)
 {
+	const struct raid6_calls *call;
 	void **srcs;
 	int i;
 	int start = -1, stop = disks - 3;
@@ -145,12 +146,13 @@ do_sync_gen_syndrome(struct page **blocks, unsigned int offset, int disks,
 			}
 		}
 	}
+	call = raid6_call_for(disks);
 	if (submit->flags & ASYNC_TX_PQ_XOR_DST) {
-		BUG_ON(!raid6_call.xor_syndrome);
+		BUG_ON(!call->xor_syndrome);
 		if (start >= 0)
-			raid6_call.xor_syndrome(disks, start, stop, len, srcs);
+			call->xor_syndrome(disks, start, stop, len, srcs);
 	} else
-		raid6_call.gen_syndrome(disks, len, srcs);
+		call->gen_syndrome(disks, len, srcs);
 	async_tx_sync_epilog(submit);
 }
 
@@ -10,8 +10,10 @@
 
 #include <linux/cpu.h>
 #include <linux/cpuidle.h>
+#include <linux/interrupt.h>
 #include <linux/mutex.h>
 #include <linux/pm_qos.h>
+#include <linux/sched/clock.h>
 
 #include "cpuidle.h"
 
@@ -108,3 +110,29 @@ int cpuidle_governor_latency_req(unsigned int cpu)
 
 	return device_req < global_req ? device_req : global_req;
 }
+
+#ifdef CONFIG_CPU_IDLE_IRQ_TIMINGS
+/**
+ * cpuidle_predict_irq_us - Predict the time until the next device interrupt
+ *
+ * Must be called with interrupts disabled. Returns the predicted time in
+ * microseconds, UINT_MAX if no interrupt is expected.
+ */
+unsigned int cpuidle_predict_irq_us(void)
+{
+	u64 now = local_clock();
+	u64 next = irq_timings_next_event(now);
+
+	if (next == U64_MAX)
+		return UINT_MAX;
+
+	return min_t(u64, div_u64(next - now, NSEC_PER_USEC), UINT_MAX);
+}
+
+static int __init cpuidle_irq_timings_init(void)
+{
+	irq_timings_enable();
+	return 0;
+}
+core_initcall(cpuidle_irq_timings_init);
+#endif
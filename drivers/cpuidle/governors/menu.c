@@ -322,6 +322,8 @@ static int menu_select(struct cpuidle_driver *drv, struct cpuidle_device *dev,
 
 	expected_interval = get_typical_interval(data);
 	expected_interval = min(expected_interval, data->next_timer_us);
+	/* A device interrupt expected before the timer ends the sleep too */
+	expected_interval = min(expected_interval, cpuidle_predict_irq_us());
 
 	first_idx = 0;
 	if (drv->states[0].flags & CPUIDLE_FLAG_POLLING) {
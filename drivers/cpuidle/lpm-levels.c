@@ -87,6 +87,10 @@ module_param_named(lpm_prediction, lpm_prediction, bool, 0664);
 static bool lpm_ipi_prediction = true;
 module_param_named(lpm_ipi_prediction, lpm_ipi_prediction, bool, 0664);
 
+/* Only effective with CONFIG_CPU_IDLE_IRQ_TIMINGS */
+static bool lpm_irq_prediction = true;
+module_param_named(lpm_irq_prediction, lpm_irq_prediction, bool, 0664);
+
 struct lpm_history {
 	uint32_t resi[MAXSAMPLES];
 	int mode[MAXSAMPLES];
@@ -620,6 +624,19 @@ static uint64_t lpm_cpuidle_predict(struct cpuidle_device *dev,
 	return 0;
 }
 
+/*
+ * Predicted time to the next device interrupt, from the arrival history
+ * kept by the irq core. The history timer started for a prediction is
+ * only cancelled with lpm_prediction, so this needs it as well.
+ */
+static uint32_t lpm_irq_predict(struct lpm_cpu *cpu)
+{
+	if (!lpm_irq_prediction || !lpm_prediction || !cpu->lpm_prediction)
+		return UINT_MAX;
+
+	return cpuidle_predict_irq_us();
+}
+
 static inline void invalidate_predict_history(struct cpuidle_device *dev)
 {
 	struct lpm_history *history = &per_cpu(hist, dev->cpu);
@@ -716,6 +733,7 @@ static int cpu_power_select(struct cpuidle_device *dev,
 	uint32_t lvl_latency_us = 0;
 	uint64_t predicted = 0;
 	uint32_t htime = 0, idx_restrict_time = 0, ipi_predicted = 0;
+	uint32_t irq_predicted = 0, irq_us;
 	uint32_t next_wakeup_us = (uint32_t)sleep_us;
 	uint32_t min_residency, max_residency;
 	struct power_params *pwr_params;
@@ -751,6 +769,12 @@ static int cpu_power_select(struct cpuidle_device *dev,
 				predicted = lpm_cpuidle_predict(dev, cpu,
 					&idx_restrict, &idx_restrict_time,
 					&ipi_predicted);
+				irq_us = lpm_irq_predict(cpu);
+				if (irq_us < next_wakeup_us &&
+				    (!predicted || irq_us < predicted)) {
+					predicted = max_t(uint32_t, irq_us, 1);
+					irq_predicted = 1;
+				}
 				if (predicted && (predicted < min_residency))
 					predicted = min_residency;
 			} else
@@ -803,7 +827,8 @@ done_select:
 	trace_cpu_power_select(best_level, sleep_us, latency_us, next_event_us);
 
 	trace_cpu_pred_select(idx_restrict_time ? 2 : (ipi_predicted ?
-				3 : (predicted ? 1 : 0)), predicted, htime);
+				3 : (irq_predicted ? 4 : (predicted ? 1 : 0))),
+				predicted, htime);
 
 	return best_level;
 }
@@ -1515,6 +1540,8 @@ exit:
 	cluster_unprepare(cpu->parent, cpumask, idx, true, end_time, success);
 	cpu_unprepare(cpu, idx, true);
 	dev->last_residency = ktime_us_delta(ktime_get(), start);
+	if (success && dev->last_residency < cpu->levels[idx].pwr.min_residency)
+		lpm_stats_cpu_premature(idx);
 	update_history(dev, idx);
 	trace_cpu_idle_exit(idx, success);
 	sec_debug_cpu_lpm_log(dev->cpu, idx, success, 0);
@@ -17,6 +17,7 @@
 #include <linux/shrinker.h>
 #include <linux/module.h>
 #include <linux/rbtree.h>
+#include <linux/hash.h>
 #include <linux/stacktrace.h>
 
 #define DM_MSG_PREFIX "bufio"
@@ -56,6 +57,13 @@
  */
 #define DM_BUFIO_WRITE_ALIGN		4096
 
+/*
+ * The buffer index is split into this many shards, selected by a hash of
+ * the block number.
+ */
+#define DM_BUFIO_SHARD_BITS		4
+#define DM_BUFIO_SHARDS			(1 << DM_BUFIO_SHARD_BITS)
+
 /*
  * dm_buffer->list_mode
  */
@@ -65,7 +73,13 @@
 
 /*
  * Linking of buffers:
- *	All buffers are linked to cache_hash with their hash_list field.
+ *	All buffers are linked to the red/black tree of their shard with
+ *	their node field.  A shard's tree is only modified with c->lock held
+ *	and the shard lock held for writing, so it may be searched either
+ *	with c->lock or with the shard lock held for reading.  Cache hits
+ *	take a hold on the buffer with just the shard lock, so the hold
+ *	count of an unheld buffer may only be trusted with the shard lock
+ *	held for writing.
  *
  *	Clean buffers that are not being written (B_WRITING not set)
  *	are linked to lru[LIST_CLEAN] with their lru_list field.
@@ -77,7 +91,16 @@
  *	context), so some clean-not-writing buffers can be held on
  *	dirty_lru too.  They are later added to lru in the process
  *	context.
+ *
+ *	Cache hits that bypass c->lock don't move the buffer in the LRU
+ *	queue; they only set its accessed flag, and the buffer gets a
+ *	second chance when it is found at the tail of the queue.
  */
+struct dm_bufio_shard {
+	rwlock_t lock;
+	struct rb_root tree;
+} ____cacheline_aligned_in_smp;
+
 struct dm_bufio_client {
 	struct mutex lock;
 
@@ -99,8 +122,8 @@ struct dm_bufio_client {
 
 	unsigned minimum_buffers;
 
-	struct rb_root buffer_tree;
 	wait_queue_head_t free_buffer_wait;
+	unsigned free_buffer_waiters;
 
 	sector_t start;
 
@@ -108,6 +131,8 @@ struct dm_bufio_client {
 
 	struct list_head client_list;
 	struct shrinker shrinker;
+
+	struct dm_bufio_shard shards[DM_BUFIO_SHARDS];
 };
 
 /*
@@ -136,9 +161,10 @@ struct dm_buffer {
 	void *data;
 	unsigned char data_mode;		/* DATA_MODE_* */
 	unsigned char list_mode;		/* LIST_* */
+	unsigned char accessed;
 	blk_status_t read_error;
 	blk_status_t write_error;
-	unsigned hold_count;
+	atomic_t hold_count;
 	unsigned long state;
 	unsigned long last_accessed;
 	unsigned dirty_start;
@@ -241,11 +267,17 @@ static void buffer_record_stack(struct dm_buffer *b)
 #endif
 
 /*----------------------------------------------------------------
- * A red/black tree acts as an index for all the buffers.
+ * Sharded red/black trees act as an index for all the buffers.
  *--------------------------------------------------------------*/
-static struct dm_buffer *__find(struct dm_bufio_client *c, sector_t block)
+static struct dm_bufio_shard *dm_bufio_shard(struct dm_bufio_client *c,
+					     sector_t block)
 {
-	struct rb_node *n = c->buffer_tree.rb_node;
+	return &c->shards[hash_64(block, DM_BUFIO_SHARD_BITS)];
+}
+
+static struct dm_buffer *__shard_find(struct dm_bufio_shard *s, sector_t block)
+{
+	struct rb_node *n = s->tree.rb_node;
 	struct dm_buffer *b;
 
 	while (n) {
@@ -260,17 +292,25 @@ static struct dm_buffer *__find(struct dm_bufio_client *c, sector_t block)
 	return NULL;
 }
 
+static struct dm_buffer *__find(struct dm_bufio_client *c, sector_t block)
+{
+	return __shard_find(dm_bufio_shard(c, block), block);
+}
+
 static void __insert(struct dm_bufio_client *c, struct dm_buffer *b)
 {
-	struct rb_node **new = &c->buffer_tree.rb_node, *parent = NULL;
+	struct dm_bufio_shard *s = dm_bufio_shard(c, b->block);
+	struct rb_node **new = &s->tree.rb_node, *parent = NULL;
 	struct dm_buffer *found;
 
+	write_lock(&s->lock);
+
 	while (*new) {
 		found = container_of(*new, struct dm_buffer, node);
 
 		if (found->block == b->block) {
 			BUG_ON(found != b);
-			return;
+			goto out;
 		}
 
 		parent = *new;
@@ -279,12 +319,18 @@ static void __insert(struct dm_bufio_client *c, struct dm_buffer *b)
 	}
 
 	rb_link_node(&b->node, parent, new);
-	rb_insert_color(&b->node, &c->buffer_tree);
+	rb_insert_color(&b->node, &s->tree);
+out:
+	write_unlock(&s->lock);
 }
 
 static void __remove(struct dm_bufio_client *c, struct dm_buffer *b)
 {
-	rb_erase(&b->node, &c->buffer_tree);
+	struct dm_bufio_shard *s = dm_bufio_shard(c, b->block);
+
+	write_lock(&s->lock);
+	rb_erase(&b->node, &s->tree);
+	write_unlock(&s->lock);
 }
 
 /*----------------------------------------------------------------*/
@@ -472,17 +518,30 @@ static void __link_buffer(struct dm_buffer *b, sector_t block, int dirty)
 }
 
 /*
- * Unlink buffer from the hash list and dirty or clean queue.
+ * Unlink buffer from the index and dirty or clean queue if it is held by
+ * exactly "holders" users.  The hold count is checked with the shard lock
+ * held for writing, so that a concurrent cache hit can't take a hold on a
+ * buffer being unlinked.
  */
-static void __unlink_buffer(struct dm_buffer *b)
+static bool __try_unlink_buffer(struct dm_buffer *b, int holders)
 {
 	struct dm_bufio_client *c = b->c;
+	struct dm_bufio_shard *s = dm_bufio_shard(c, b->block);
+
+	write_lock(&s->lock);
+	if (atomic_read(&b->hold_count) != holders) {
+		write_unlock(&s->lock);
+		return false;
+	}
+	rb_erase(&b->node, &s->tree);
+	write_unlock(&s->lock);
 
 	BUG_ON(!c->n_buffers[b->list_mode]);
 
 	c->n_buffers[b->list_mode]--;
-	__remove(b->c, b);
 	list_del(&b->lru_list);
+
+	return true;
 }
 
 /*
@@ -501,6 +560,21 @@ static void __relink_lru(struct dm_buffer *b, int dirty)
 	b->last_accessed = jiffies;
 }
 
+/*
+ * If the buffer was hit without c->lock since it was last looked at here,
+ * move it to the head of its LRU queue instead of reclaiming it.
+ */
+static bool __lru_second_chance(struct dm_buffer *b)
+{
+	if (likely(!READ_ONCE(b->accessed)))
+		return false;
+
+	WRITE_ONCE(b->accessed, 0);
+	list_move(&b->lru_list, &b->c->lru[b->list_mode]);
+
+	return true;
+}
+
 /*----------------------------------------------------------------
  * Submit I/O on the buffer.
  *
@@ -722,11 +796,12 @@ static void __flush_write_list(struct list_head *write_list)
  * Wait until any activity on the buffer finishes.  Possibly write the
  * buffer if it is dirty.  When this function finishes, there is no I/O
  * running on the buffer and the buffer is not dirty.
+ *
+ * The caller found the buffer unheld, but a cache hit may take a hold on
+ * it meanwhile; the caller must unlink it with __try_unlink_buffer().
  */
 static void __make_buffer_clean(struct dm_buffer *b)
 {
-	BUG_ON(b->hold_count);
-
 	if (!b->state)	/* fast case */
 		return;
 
@@ -741,27 +816,27 @@ static void __make_buffer_clean(struct dm_buffer *b)
  */
 static struct dm_buffer *__get_unclaimed_buffer(struct dm_bufio_client *c)
 {
-	struct dm_buffer *b;
+	struct dm_buffer *b, *tmp;
 
-	list_for_each_entry_reverse(b, &c->lru[LIST_CLEAN], lru_list) {
+	list_for_each_entry_safe_reverse(b, tmp, &c->lru[LIST_CLEAN], lru_list) {
 		BUG_ON(test_bit(B_WRITING, &b->state));
 		BUG_ON(test_bit(B_DIRTY, &b->state));
 
-		if (!b->hold_count) {
+		if (!atomic_read(&b->hold_count) && !__lru_second_chance(b)) {
 			__make_buffer_clean(b);
-			__unlink_buffer(b);
-			return b;
+			if (__try_unlink_buffer(b, 0))
+				return b;
 		}
 		cond_resched();
 	}
 
-	list_for_each_entry_reverse(b, &c->lru[LIST_DIRTY], lru_list) {
+	list_for_each_entry_safe_reverse(b, tmp, &c->lru[LIST_DIRTY], lru_list) {
 		BUG_ON(test_bit(B_READING, &b->state));
 
-		if (!b->hold_count) {
+		if (!atomic_read(&b->hold_count) && !__lru_second_chance(b)) {
 			__make_buffer_clean(b);
-			__unlink_buffer(b);
-			return b;
+			if (__try_unlink_buffer(b, 0))
+				return b;
 		}
 		cond_resched();
 	}
@@ -769,6 +844,23 @@ static struct dm_buffer *__get_unclaimed_buffer(struct dm_bufio_client *c)
 	return NULL;
 }
 
+/*
+ * The last hold on a buffer is dropped without c->lock, and the lock is
+ * only taken to wake up waiters if free_buffer_waiters is non-zero.  A
+ * thread that may wait for a hold to be dropped must register itself
+ * before it looks at the hold counts.
+ */
+static void __register_free_buffer_waiter(struct dm_bufio_client *c)
+{
+	c->free_buffer_waiters++;
+	smp_mb();
+}
+
+static void __unregister_free_buffer_waiter(struct dm_bufio_client *c)
+{
+	c->free_buffer_waiters--;
+}
+
 /*
  * Wait until some other threads free some buffer or release hold count on
  * some buffer.
@@ -850,11 +942,13 @@ static struct dm_buffer *__alloc_buffer_wait_no_callback(struct dm_bufio_client
 			return b;
 		}
 
+		__register_free_buffer_waiter(c);
 		b = __get_unclaimed_buffer(c);
+		if (!b)
+			__wait_for_free_buffer(c);
+		__unregister_free_buffer_waiter(c);
 		if (b)
 			return b;
-
-		__wait_for_free_buffer(c);
 	}
 }
 
@@ -1003,18 +1097,21 @@ static struct dm_buffer *__bufio_new(struct dm_bufio_client *c, sector_t block,
 
 	__check_watermark(c, write_list);
 
+	/*
+	 * The buffer must be fully set up before __link_buffer makes it
+	 * visible to cache hits that don't take c->lock.
+	 */
 	b = new_b;
-	b->hold_count = 1;
+	atomic_set(&b->hold_count, 1);
 	b->read_error = 0;
 	b->write_error = 0;
+	b->accessed = 0;
+	b->state = nf == NF_FRESH ? 0 : 1 << B_READING;
 	__link_buffer(b, block, LIST_CLEAN);
 
-	if (nf == NF_FRESH) {
-		b->state = 0;
+	if (nf == NF_FRESH)
 		return b;
-	}
 
-	b->state = 1 << B_READING;
 	*need_submit = 1;
 
 	return b;
@@ -1032,7 +1129,7 @@ found_buffer:
 	if (nf == NF_GET && unlikely(test_bit(B_READING, &b->state)))
 		return NULL;
 
-	b->hold_count++;
+	atomic_inc(&b->hold_count);
 	__relink_lru(b, test_bit(B_DIRTY, &b->state) ||
 		     test_bit(B_WRITING, &b->state));
 	return b;
@@ -1055,6 +1152,41 @@ static void read_endio(struct dm_buffer *b, blk_status_t status)
 	wake_up_bit(&b->state, B_READING);
 }
 
+/*
+ * Take a hold on a cached buffer without taking c->lock.  The buffer is
+ * not moved in the LRU queue, it is only marked as accessed.
+ */
+static struct dm_buffer *__bufio_get_cached(struct dm_bufio_client *c,
+					    sector_t block, enum new_flag nf)
+{
+	struct dm_bufio_shard *s = dm_bufio_shard(c, block);
+	struct dm_buffer *b;
+	int holders = 0;
+
+	read_lock(&s->lock);
+	b = __shard_find(s, block);
+	if (b) {
+		if (nf == NF_GET && unlikely(test_bit(B_READING, &b->state)))
+			b = NULL;
+		else
+			holders = atomic_inc_return(&b->hold_count);
+	}
+	read_unlock(&s->lock);
+
+	if (b) {
+#ifdef CONFIG_DM_DEBUG_BLOCK_STACK_TRACING
+		if (holders == 1)
+			buffer_record_stack(b);
+#endif
+		if (!READ_ONCE(b->accessed))
+			WRITE_ONCE(b->accessed, 1);
+		if (READ_ONCE(b->last_accessed) != jiffies)
+			WRITE_ONCE(b->last_accessed, jiffies);
+	}
+
+	return b;
+}
+
 /*
  * A common routine for dm_bufio_new and dm_bufio_read.  Operation of these
  * functions is similar except that dm_bufio_new doesn't read the
@@ -1069,10 +1201,14 @@ static void *new_read(struct dm_bufio_client *c, sector_t block,
 
 	LIST_HEAD(write_list);
 
+	b = __bufio_get_cached(c, block, nf);
+	if (likely(b))
+		goto found;
+
 	dm_bufio_lock(c);
 	b = __bufio_new(c, block, nf, &need_submit, &write_list);
 #ifdef CONFIG_DM_DEBUG_BLOCK_STACK_TRACING
-	if (b && b->hold_count == 1)
+	if (b && atomic_read(&b->hold_count) == 1)
 		buffer_record_stack(b);
 #endif
 	dm_bufio_unlock(c);
@@ -1085,6 +1221,7 @@ static void *new_read(struct dm_bufio_client *c, sector_t block,
 	if (need_submit)
 		submit_io(b, REQ_OP_READ, read_endio);
 
+found:
 	wait_on_bit_io(&b->state, B_READING, TASK_UNINTERRUPTIBLE);
 
 	if (b->read_error) {
@@ -1175,12 +1312,27 @@ void dm_bufio_release(struct dm_buffer *b)
 {
 	struct dm_bufio_client *c = b->c;
 
-	dm_bufio_lock(c);
+	BUG_ON(!atomic_read(&b->hold_count));
 
-	BUG_ON(!b->hold_count);
+	if (likely(!b->read_error && !b->write_error)) {
+		/*
+		 * The buffer may be reclaimed as soon as the hold is dropped,
+		 * so don't touch it afterwards.  The barrier implied by
+		 * atomic_dec_and_test pairs with the one in
+		 * __register_free_buffer_waiter.
+		 */
+		if (atomic_dec_and_test(&b->hold_count) &&
+		    unlikely(READ_ONCE(c->free_buffer_waiters))) {
+			dm_bufio_lock(c);
+			wake_up(&c->free_buffer_wait);
+			dm_bufio_unlock(c);
+		}
+		return;
+	}
+
+	dm_bufio_lock(c);
 
-	b->hold_count--;
-	if (!b->hold_count) {
+	if (atomic_dec_and_test(&b->hold_count)) {
 		wake_up(&c->free_buffer_wait);
 
 		/*
@@ -1188,13 +1340,11 @@ void dm_bufio_release(struct dm_buffer *b)
 		 * to be written, free the buffer. There is no point in caching
 		 * invalid buffer.
 		 */
-		if ((b->read_error || b->write_error) &&
-		    !test_bit(B_READING, &b->state) &&
+		if (!test_bit(B_READING, &b->state) &&
 		    !test_bit(B_WRITING, &b->state) &&
-		    !test_bit(B_DIRTY, &b->state)) {
-			__unlink_buffer(b);
+		    !test_bit(B_DIRTY, &b->state) &&
+		    __try_unlink_buffer(b, 0))
 			__free_buffer_wake(b);
-		}
 	}
 
 	dm_bufio_unlock(c);
@@ -1280,12 +1430,12 @@ again:
 		if (test_bit(B_WRITING, &b->state)) {
 			if (buffers_processed < c->n_buffers[LIST_DIRTY]) {
 				dropped_lock = 1;
-				b->hold_count++;
+				atomic_inc(&b->hold_count);
 				dm_bufio_unlock(c);
 				wait_on_bit_io(&b->state, B_WRITING,
 					       TASK_UNINTERRUPTIBLE);
 				dm_bufio_lock(c);
-				b->hold_count--;
+				atomic_dec(&b->hold_count);
 			} else
 				wait_on_bit_io(&b->state, B_WRITING,
 					       TASK_UNINTERRUPTIBLE);
@@ -1371,10 +1521,11 @@ void dm_bufio_release_move(struct dm_buffer *b, sector_t new_block)
 
 	dm_bufio_lock(c);
 
+	__register_free_buffer_waiter(c);
 retry:
 	new = __find(c, new_block);
 	if (new) {
-		if (new->hold_count) {
+		if (atomic_read(&new->hold_count)) {
 			__wait_for_free_buffer(c);
 			goto retry;
 		}
@@ -1384,41 +1535,43 @@ retry:
 		 * to be overwritten in a bit?
 		 */
 		__make_buffer_clean(new);
-		__unlink_buffer(new);
+		if (!__try_unlink_buffer(new, 0))
+			goto retry;
 		__free_buffer_wake(new);
 	}
+	__unregister_free_buffer_waiter(c);
 
-	BUG_ON(!b->hold_count);
+	BUG_ON(!atomic_read(&b->hold_count));
 	BUG_ON(test_bit(B_READING, &b->state));
 
 	__write_dirty_buffer(b, NULL);
-	if (b->hold_count == 1) {
+	if (__try_unlink_buffer(b, 1)) {
 		wait_on_bit_io(&b->state, B_WRITING,
 			       TASK_UNINTERRUPTIBLE);
 		set_bit(B_DIRTY, &b->state);
 		b->dirty_start = 0;
 		b->dirty_end = c->block_size;
-		__unlink_buffer(b);
 		__link_buffer(b, new_block, LIST_DIRTY);
 	} else {
 		sector_t old_block;
 		wait_on_bit_lock_io(&b->state, B_WRITING,
 				    TASK_UNINTERRUPTIBLE);
 		/*
-		 * Relink buffer to "new_block" so that write_callback
-		 * sees "new_block" as a block number.
-		 * After the write, link the buffer back to old_block.
-		 * All this must be done in bufio lock, so that block number
+		 * Change the block number to "new_block" so that
+		 * write_callback sees "new_block" as a block number.
+		 * After the write, change it back to old_block.
+		 * All this must be done in bufio lock, and the buffer is
+		 * kept out of the index meanwhile, so that block number
 		 * change isn't visible to other threads.
 		 */
 		old_block = b->block;
-		__unlink_buffer(b);
-		__link_buffer(b, new_block, b->list_mode);
+		__remove(c, b);
+		b->block = new_block;
 		submit_io(b, REQ_OP_WRITE, write_endio);
 		wait_on_bit_io(&b->state, B_WRITING,
 			       TASK_UNINTERRUPTIBLE);
-		__unlink_buffer(b);
-		__link_buffer(b, old_block, b->list_mode);
+		b->block = old_block;
+		__insert(c, b);
 	}
 
 	dm_bufio_unlock(c);
@@ -1439,10 +1592,9 @@ void dm_bufio_forget(struct dm_bufio_client *c, sector_t block)
 	dm_bufio_lock(c);
 
 	b = __find(c, block);
-	if (b && likely(!b->hold_count) && likely(!b->state)) {
-		__unlink_buffer(b);
+	if (b && likely(!atomic_read(&b->hold_count)) && likely(!b->state) &&
+	    __try_unlink_buffer(b, 0))
 		__free_buffer_wake(b);
-	}
 
 	dm_bufio_unlock(c);
 }
@@ -1518,10 +1670,12 @@ static void drop_buffers(struct dm_bufio_client *c)
 			WARN_ON(!warned);
 			warned = true;
 			DMERR("leaked buffer %llx, hold count %u, list %d",
-			      (unsigned long long)b->block, b->hold_count, i);
+			      (unsigned long long)b->block,
+			      atomic_read(&b->hold_count), i);
 #ifdef CONFIG_DM_DEBUG_BLOCK_STACK_TRACING
 			print_stack_trace(&b->stack_trace, 1);
-			b->hold_count = 0; /* mark unclaimed to avoid BUG_ON below */
+			/* mark unclaimed to avoid BUG_ON below */
+			atomic_set(&b->hold_count, 0);
 #endif
 		}
 
@@ -1553,11 +1707,12 @@ static bool __try_evict_buffer(struct dm_buffer *b, gfp_t gfp)
 			return false;
 	}
 
-	if (b->hold_count)
+	if (atomic_read(&b->hold_count) || __lru_second_chance(b))
 		return false;
 
 	__make_buffer_clean(b);
-	__unlink_buffer(b);
+	if (!__try_unlink_buffer(b, 0))
+		return false;
 	__free_buffer_wake(b);
 
 	return true;
@@ -1647,7 +1802,10 @@ struct dm_bufio_client *dm_bufio_client_create(struct block_device *bdev, unsign
 		r = -ENOMEM;
 		goto bad_client;
 	}
-	c->buffer_tree = RB_ROOT;
+	for (i = 0; i < DM_BUFIO_SHARDS; i++) {
+		rwlock_init(&c->shards[i].lock);
+		c->shards[i].tree = RB_ROOT;
+	}
 
 	c->bdev = bdev;
 	c->block_size = block_size;
@@ -1765,7 +1923,8 @@ void dm_bufio_client_destroy(struct dm_bufio_client *c)
 
 	mutex_unlock(&dm_bufio_clients_lock);
 
-	BUG_ON(!RB_EMPTY_ROOT(&c->buffer_tree));
+	for (i = 0; i < DM_BUFIO_SHARDS; i++)
+		BUG_ON(!RB_EMPTY_ROOT(&c->shards[i].tree));
 	BUG_ON(c->need_reserved_buffers);
 
 	while (!list_empty(&c->reserved_buffers)) {
@@ -7043,6 +7043,9 @@ static struct r5conf *setup_conf(struct mddev *mddev)
 	conf->level = mddev->new_level;
 	if (conf->level == 6) {
 		conf->max_degraded = 2;
+		raid6_select_algo_disks(conf->raid_disks);
+		if (conf->previous_raid_disks != conf->raid_disks)
+			raid6_select_algo_disks(conf->previous_raid_disks);
 		if (raid6_call.xor_syndrome)
 			conf->rmw_level = PARITY_ENABLE_RMW;
 		else
@@ -7892,6 +7895,9 @@ static int raid5_start_reshape(struct mddev *mddev)
 		return -EINVAL;
 	}
 
+	if (conf->level == 6)
+		raid6_select_algo_disks(conf->raid_disks + mddev->delta_disks);
+
 	atomic_set(&conf->reshape_stripes, 0);
 	spin_lock_irq(&conf->device_lock);
 	write_seqcount_begin(&conf->gen_lock);
@@ -84,6 +84,7 @@ static int rmnet_unregister_real_device(struct net_device *real_dev,
 
 	rmnet_map_cmd_exit(port);
 	rmnet_map_tx_aggregate_exit(port);
+	rmnet_map_deag_exit(port);
 
 	rmnet_descriptor_deinit(port);
 
@@ -131,6 +132,10 @@ static int rmnet_register_real_device(struct net_device *real_dev)
 	rmnet_map_tx_aggregate_init(port);
 	rmnet_map_cmd_init(port);
 
+	/* Steering is optional, the RX path falls back to inline processing */
+	if (rmnet_map_deag_init(port))
+		netdev_warn(real_dev, "DL deaggregation steering unavailable\n");
+
 	netdev_dbg(real_dev, "registered with rmnet\n");
 	return 0;
 }
@@ -23,6 +23,8 @@ struct rmnet_endpoint {
 struct rmnet_agg_stats {
 	u64 ul_agg_reuse;
 	u64 ul_agg_alloc;
+	u64 ul_agg_bytes_copied;
+	u64 ul_agg_bytes_referenced;
 };
 
 struct rmnet_port_priv_stats {
@@ -41,6 +43,16 @@ struct rmnet_port_priv_stats {
 	struct rmnet_agg_stats agg;
 };
 
+/* Per-CPU queue of deaggregated MAP packets steered by flow hash */
+struct rmnet_deag_queue {
+	struct sk_buff_head skbs;
+	struct work_struct work;
+	struct rmnet_port *port;
+	u64 queued;
+	u64 dropped;
+	u64 processed;
+};
+
 struct rmnet_egress_agg_params {
 	u16 agg_size;
 	u8 agg_count;
@@ -80,13 +92,18 @@ struct rmnet_port {
 	u8 agg_size_order;
 	struct list_head agg_list;
 	struct rmnet_agg_page *agg_head;
+	struct sk_buff *agg_tail;
+	struct sk_buff *agg_copy;
 
 	void *qmi_info;
 
 	/* dl marker elements */
 	struct list_head dl_list;
 	struct rmnet_port_priv_stats stats;
-	int dl_marker_flush;
+	atomic_t dl_marker_flush;
+
+	/* DL deaggregation steering */
+	struct rmnet_deag_queue __percpu *deag_queues;
 
 	/* Descriptor pool */
 	spinlock_t desc_pool_lock;
@@ -11,6 +11,7 @@
 #include <linux/ip.h>
 #include <linux/ipv6.h>
 #include <net/sock.h>
+#include <net/flow_dissector.h>
 #include <linux/tracepoint.h>
 #include "rmnet_private.h"
 #include "rmnet_config.h"
@@ -132,11 +133,11 @@ rmnet_deliver_skb(struct sk_buff *skb, struct rmnet_port *port)
 
 	if (port->data_format & RMNET_INGRESS_FORMAT_DL_MARKER) {
 		if (!rmnet_check_skb_can_gro(skb) &&
-		    port->dl_marker_flush >= 0) {
+		    atomic_read(&port->dl_marker_flush) >= 0) {
 			struct napi_struct *napi = get_current_napi_context();
 
 			napi_gro_receive(napi, skb);
-			port->dl_marker_flush++;
+			atomic_inc(&port->dl_marker_flush);
 		} else {
 			netif_receive_skb(skb);
 		}
@@ -182,11 +183,11 @@ rmnet_deliver_skb_wq(struct sk_buff *skb, struct rmnet_port *port,
 	if (ctx == RMNET_NET_RX_CTX) {
 		if (port->data_format & RMNET_INGRESS_FORMAT_DL_MARKER) {
 			if (!rmnet_check_skb_can_gro(skb) &&
-			    port->dl_marker_flush >= 0) {
+			    atomic_read(&port->dl_marker_flush) >= 0) {
 				struct napi_struct *napi =
 					get_current_napi_context();
 				napi_gro_receive(napi, skb);
-				port->dl_marker_flush++;
+				atomic_inc(&port->dl_marker_flush);
 			} else {
 				netif_receive_skb(skb);
 			}
@@ -198,8 +199,8 @@ rmnet_deliver_skb_wq(struct sk_buff *skb, struct rmnet_port *port,
 		}
 	} else {
 		if ((port->data_format & RMNET_INGRESS_FORMAT_DL_MARKER) &&
-		    port->dl_marker_flush >= 0)
-			port->dl_marker_flush++;
+		    atomic_read(&port->dl_marker_flush) >= 0)
+			atomic_inc(&port->dl_marker_flush);
 		gro_cells_receive(&priv->gro_cells, skb);
 	}
 }
@@ -207,13 +208,17 @@ EXPORT_SYMBOL(rmnet_deliver_skb_wq);
 
 /* Deliver a list of skbs after undoing coalescing */
 static void rmnet_deliver_skb_list(struct sk_buff_head *head,
-				   struct rmnet_port *port)
+				   struct rmnet_port *port,
+				   enum rmnet_packet_context ctx)
 {
 	struct sk_buff *skb;
 
 	while ((skb = __skb_dequeue(head))) {
 		rmnet_set_skb_proto(skb);
-		rmnet_deliver_skb(skb, port);
+		if (ctx == RMNET_NET_RX_CTX)
+			rmnet_deliver_skb(skb, port);
+		else
+			rmnet_deliver_skb_wq(skb, port, ctx);
 	}
 }
 
@@ -221,7 +226,8 @@ static void rmnet_deliver_skb_list(struct sk_buff_head *head,
 
 static void
 __rmnet_map_ingress_handler(struct sk_buff *skb,
-			    struct rmnet_port *port)
+			    struct rmnet_port *port,
+			    enum rmnet_packet_context ctx)
 {
 	struct rmnet_map_header *qmap;
 	struct rmnet_endpoint *ep;
@@ -287,13 +293,177 @@ __rmnet_map_ingress_handler(struct sk_buff *skb,
 		qmi_rmnet_work_maybe_restart(port);
 #endif
 
-	rmnet_deliver_skb_list(&list, port);
+	rmnet_deliver_skb_list(&list, port, ctx);
 	return;
 
 free_skb:
 	kfree_skb(skb);
 }
 
+/* DL deaggregation steering
+ *
+ * Checksum validation, undoing of coalescing and delivery of the packets in
+ * a MAP frame are moved off the CPU taking the real device RX. Each packet
+ * is placed on the queue of the CPU selected by its flow hash so that the
+ * order within a flow is kept.
+ */
+
+static u32 rmnet_map_flow_hash(struct sk_buff *skb, struct rmnet_port *port)
+{
+	struct rmnet_map_header *maph;
+	unsigned char *data;
+	struct flow_keys keys;
+	__be16 proto;
+	int nhoff;
+
+	data = rmnet_map_data_ptr(skb);
+	maph = (struct rmnet_map_header *)data;
+	nhoff = sizeof(*maph);
+
+	if (maph->next_hdr &&
+	    (port->data_format & (RMNET_FLAGS_INGRESS_COALESCE |
+				  RMNET_FLAGS_INGRESS_MAP_CKSUMV5))) {
+		if (rmnet_map_get_next_hdr_type(skb) ==
+		    RMNET_MAP_HEADER_TYPE_COALESCING)
+			nhoff += sizeof(struct rmnet_map_v5_coal_header);
+		else
+			nhoff += sizeof(struct rmnet_map_v5_csum_header);
+	}
+
+	if (nhoff >= skb->len)
+		return 0;
+
+	switch (data[nhoff] & 0xF0) {
+	case RMNET_IP_VERSION_4:
+		proto = htons(ETH_P_IP);
+		break;
+	case RMNET_IP_VERSION_6:
+		proto = htons(ETH_P_IPV6);
+		break;
+	default:
+		return 0;
+	}
+
+	memset(&keys, 0, sizeof(keys));
+	if (!__skb_flow_dissect(NULL, &flow_keys_dissector, &keys, data,
+				proto, nhoff, skb->len, 0))
+		return 0;
+
+	return flow_hash_from_keys(&keys);
+}
+
+/* The flow to queue mapping is taken over the possible CPUs so that it does
+ * not move when CPUs are hotplugged. Work queued for an offline CPU is still
+ * run by the workqueue, and a queue is only ever drained by its own work
+ * item, so the order within a flow is kept either way.
+ */
+static int rmnet_map_deag_cpu(u32 hash)
+{
+	int cpu, idx;
+
+	idx = reciprocal_scale(hash, num_possible_cpus());
+	for_each_possible_cpu(cpu) {
+		if (!idx--)
+			return cpu;
+	}
+
+	return smp_processor_id();
+}
+
+/* Returns true if the packet was consumed by a steering queue */
+static bool rmnet_map_deag_steer(struct sk_buff *skb, struct rmnet_port *port)
+{
+	struct rmnet_deag_queue *q;
+	int cpu;
+
+	if (!(port->data_format & RMNET_INGRESS_FORMAT_DEAG_STEER) ||
+	    !port->deag_queues)
+		return false;
+
+	/* Commands are handled in order with the rest of the RX path */
+	if (((struct rmnet_map_header *)rmnet_map_data_ptr(skb))->cd_bit)
+		return false;
+
+	cpu = rmnet_map_deag_cpu(rmnet_map_flow_hash(skb, port));
+	q = per_cpu_ptr(port->deag_queues, cpu);
+
+	spin_lock(&q->skbs.lock);
+	if (skb_queue_len(&q->skbs) >= netdev_max_backlog) {
+		q->dropped++;
+		spin_unlock(&q->skbs.lock);
+		kfree_skb(skb);
+		return true;
+	}
+
+	__skb_queue_tail(&q->skbs, skb);
+	q->queued++;
+	spin_unlock(&q->skbs.lock);
+
+	queue_work_on(cpu, system_highpri_wq, &q->work);
+	return true;
+}
+
+static void rmnet_map_deag_work(struct work_struct *work)
+{
+	struct rmnet_deag_queue *q;
+	struct sk_buff_head list;
+	struct sk_buff *skb;
+
+	q = container_of(work, struct rmnet_deag_queue, work);
+	__skb_queue_head_init(&list);
+
+	spin_lock_bh(&q->skbs.lock);
+	skb_queue_splice_tail_init(&q->skbs, &list);
+	spin_unlock_bh(&q->skbs.lock);
+
+	local_bh_disable();
+	rcu_read_lock();
+	while ((skb = __skb_dequeue(&list))) {
+		q->processed++;
+		__rmnet_map_ingress_handler(skb, q->port, RMNET_WQ_CTX);
+	}
+	rcu_read_unlock();
+	local_bh_enable();
+}
+
+int rmnet_map_deag_init(struct rmnet_port *port)
+{
+	struct rmnet_deag_queue *q;
+	int cpu;
+
+	port->deag_queues = alloc_percpu(struct rmnet_deag_queue);
+	if (!port->deag_queues)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		q = per_cpu_ptr(port->deag_queues, cpu);
+		skb_queue_head_init(&q->skbs);
+		INIT_WORK(&q->work, rmnet_map_deag_work);
+		q->port = port;
+	}
+
+	return 0;
+}
+
+/* Must be called after the RX handler has been unregistered */
+void rmnet_map_deag_exit(struct rmnet_port *port)
+{
+	struct rmnet_deag_queue *q;
+	int cpu;
+
+	if (!port->deag_queues)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		q = per_cpu_ptr(port->deag_queues, cpu);
+		cancel_work_sync(&q->work);
+		skb_queue_purge(&q->skbs);
+	}
+
+	free_percpu(port->deag_queues);
+	port->deag_queues = NULL;
+}
+
 int (*rmnet_perf_deag_entry)(struct sk_buff *skb,
 			     struct rmnet_port *port) __rcu __read_mostly;
 EXPORT_SYMBOL(rmnet_perf_deag_entry);
@@ -325,7 +495,7 @@ rmnet_map_ingress_handler(struct sk_buff *skb,
 
 	/* No aggregation. Pass the frame on as is */
 	if (!(port->data_format & RMNET_FLAGS_INGRESS_DEAGGREGATION)) {
-		__rmnet_map_ingress_handler(skb, port);
+		__rmnet_map_ingress_handler(skb, port, RMNET_NET_RX_CTX);
 		return;
 	}
 
@@ -347,7 +517,9 @@ rmnet_map_ingress_handler(struct sk_buff *skb,
 
 		skb_shinfo(skb)->frag_list = NULL;
 		while ((skbn = rmnet_map_deaggregate(skb, port)) != NULL) {
-			__rmnet_map_ingress_handler(skbn, port);
+			if (!rmnet_map_deag_steer(skbn, port))
+				__rmnet_map_ingress_handler(skbn, port,
+							    RMNET_NET_RX_CTX);
 
 			if (skbn == skb)
 				goto next_skb;
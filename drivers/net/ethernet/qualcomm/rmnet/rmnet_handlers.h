@@ -24,5 +24,7 @@ bool rmnet_slow_start_on(u32 hash_key);
 rx_handler_result_t _rmnet_map_ingress_handler(struct sk_buff *skb,
 					       struct rmnet_port *port);
 rx_handler_result_t rmnet_rx_handler(struct sk_buff **pskb);
+int rmnet_map_deag_init(struct rmnet_port *port);
+void rmnet_map_deag_exit(struct rmnet_port *port);
 
 #endif /* _RMNET_HANDLERS_H_ */
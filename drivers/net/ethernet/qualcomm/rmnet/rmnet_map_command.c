@@ -94,7 +94,7 @@ rmnet_map_dl_hdr_notify_v2(struct rmnet_port *port,
 {
 	struct rmnet_map_dl_ind *tmp;
 
-	port->dl_marker_flush = 0;
+	atomic_set(&port->dl_marker_flush, 0);
 
 	list_for_each_entry(tmp, &port->dl_list, list)
 		tmp->dl_hdr_handler_v2(dlhdr, qcmd);
@@ -106,7 +106,7 @@ rmnet_map_dl_hdr_notify(struct rmnet_port *port,
 {
 	struct rmnet_map_dl_ind *tmp;
 
-	port->dl_marker_flush = 0;
+	atomic_set(&port->dl_marker_flush, 0);
 
 	list_for_each_entry(tmp, &port->dl_list, list)
 		tmp->dl_hdr_handler(dlhdr);
@@ -123,12 +123,12 @@ rmnet_map_dl_trl_notify_v2(struct rmnet_port *port,
 	list_for_each_entry(tmp, &port->dl_list, list)
 		tmp->dl_trl_handler_v2(dltrl, qcmd);
 
-	if (port->dl_marker_flush) {
+	if (atomic_read(&port->dl_marker_flush)) {
 		napi = get_current_napi_context();
 		napi_gro_flush(napi, false);
 	}
 
-	port->dl_marker_flush = -1;
+	atomic_set(&port->dl_marker_flush, -1);
 }
 
 void
@@ -141,12 +141,12 @@ rmnet_map_dl_trl_notify(struct rmnet_port *port,
 	list_for_each_entry(tmp, &port->dl_list, list)
 		tmp->dl_trl_handler(dltrl);
 
-	if (port->dl_marker_flush) {
+	if (atomic_read(&port->dl_marker_flush)) {
 		napi = get_current_napi_context();
 		napi_gro_flush(napi, false);
 	}
 
-	port->dl_marker_flush = -1;
+	atomic_set(&port->dl_marker_flush, -1);
 }
 
 static void rmnet_map_process_flow_start(struct sk_buff *skb,
@@ -315,7 +315,7 @@ void rmnet_map_cmd_init(struct rmnet_port *port)
 {
 	INIT_LIST_HEAD(&port->dl_list);
 
-	port->dl_marker_flush = -1;
+	atomic_set(&port->dl_marker_flush, -1);
 }
 
 int rmnet_map_dl_ind_register(struct rmnet_port *port,
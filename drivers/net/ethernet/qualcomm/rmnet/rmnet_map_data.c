@@ -1195,6 +1195,8 @@ int rmnet_map_process_next_hdr_packet(struct sk_buff *skb,
 
 long rmnet_agg_time_limit __read_mostly = 1000000L;
 long rmnet_agg_bypass_time __read_mostly = 10000000L;
+/* Packets up to this size are copied in fragment based aggregation */
+unsigned int rmnet_agg_copy_thresh __read_mostly = 256;
 
 int rmnet_map_tx_agg_skip(struct sk_buff *skb, int offset)
 {
@@ -1385,6 +1387,13 @@ static struct sk_buff *rmnet_map_build_skb(struct rmnet_port *port)
 	struct page *page;
 	void *vaddr;
 
+	if (port->egress_agg_params.agg_features & RMNET_FRAG_AGGREGATION) {
+		skb = alloc_skb(RMNET_AGG_COPY_SIZE, GFP_ATOMIC);
+		port->agg_copy = skb;
+		port->agg_tail = NULL;
+		return skb;
+	}
+
 	page = rmnet_get_agg_pages(port);
 	if (!page)
 		return NULL;
@@ -1401,6 +1410,76 @@ static struct sk_buff *rmnet_map_build_skb(struct rmnet_port *port)
 	return skb;
 }
 
+/* Chains skb to the frag_list of the aggregate being built */
+static void rmnet_map_agg_chain(struct rmnet_port *port, struct sk_buff *skb)
+{
+	struct sk_buff *agg_skb = port->agg_skb;
+
+	skb->next = NULL;
+	if (port->agg_tail)
+		port->agg_tail->next = skb;
+	else
+		skb_shinfo(agg_skb)->frag_list = skb;
+	port->agg_tail = skb;
+
+	agg_skb->len += skb->len;
+	agg_skb->data_len += skb->len;
+	agg_skb->truesize += skb->truesize;
+}
+
+/* Copies skb into the linear buffer at the end of the aggregate, starting
+ * a new one if the current buffer has been followed by a chained packet
+ * or does not have enough room left.
+ */
+static int rmnet_map_agg_copy(struct rmnet_port *port, struct sk_buff *skb)
+{
+	struct sk_buff *dst = port->agg_copy;
+
+	if (!dst || skb_tailroom(dst) < skb->len) {
+		dst = alloc_skb(max_t(unsigned int, skb->len,
+				      RMNET_AGG_COPY_SIZE), GFP_ATOMIC);
+		if (!dst)
+			return -ENOMEM;
+
+		rmnet_map_agg_chain(port, dst);
+		port->agg_copy = dst;
+	}
+
+	rmnet_map_linearize_copy(dst, skb);
+	if (dst != port->agg_skb) {
+		port->agg_skb->len += skb->len;
+		port->agg_skb->data_len += skb->len;
+	}
+
+	port->stats.agg.ul_agg_bytes_copied += skb->len;
+	dev_kfree_skb_any(skb);
+	return 0;
+}
+
+/* Adds skb to the aggregate and consumes it. In fragment based aggregation
+ * the packet is referenced through the frag_list of the aggregate instead
+ * of being copied, unless it is small enough that the copy is cheaper than
+ * the per buffer overhead on the real device.
+ */
+static int rmnet_map_agg_append(struct rmnet_port *port, struct sk_buff *skb)
+{
+	if (!(port->egress_agg_params.agg_features & RMNET_FRAG_AGGREGATION)) {
+		rmnet_map_linearize_copy(port->agg_skb, skb);
+		port->stats.agg.ul_agg_bytes_copied += skb->len;
+		dev_kfree_skb_any(skb);
+		return 0;
+	}
+
+	/* Nested frag_lists are not allowed */
+	if (skb->len <= rmnet_agg_copy_thresh || skb_has_frag_list(skb))
+		return rmnet_map_agg_copy(port, skb);
+
+	rmnet_map_agg_chain(port, skb);
+	port->agg_copy = NULL;
+	port->stats.agg.ul_agg_bytes_referenced += skb->len;
+	return 0;
+}
+
 static void rmnet_map_send_agg_skb(struct rmnet_port *port, unsigned long flags)
 {
 	struct sk_buff *agg_skb;
@@ -1467,12 +1546,18 @@ new_packet:
 			dev_queue_xmit(skb);
 			return;
 		}
-		rmnet_map_linearize_copy(port->agg_skb, skb);
 		port->agg_skb->dev = skb->dev;
 		port->agg_skb->protocol = htons(ETH_P_MAP);
+		if (rmnet_map_agg_append(port, skb)) {
+			kfree_skb(port->agg_skb);
+			port->agg_skb = NULL;
+			spin_unlock_irqrestore(&port->agg_lock, flags);
+			skb->protocol = htons(ETH_P_MAP);
+			dev_queue_xmit(skb);
+			return;
+		}
 		port->agg_count = 1;
 		getnstimeofday(&port->agg_time);
-		dev_kfree_skb_any(skb);
 		goto schedule;
 	}
 	diff = timespec_sub(port->agg_last, port->agg_time);
@@ -1485,9 +1570,13 @@ new_packet:
 		goto new_packet;
 	}
 
-	rmnet_map_linearize_copy(port->agg_skb, skb);
+	if (rmnet_map_agg_append(port, skb)) {
+		rmnet_map_send_agg_skb(port, flags);
+		skb->protocol = htons(ETH_P_MAP);
+		dev_queue_xmit(skb);
+		return;
+	}
 	port->agg_count++;
-	dev_kfree_skb_any(skb);
 
 schedule:
 	if (port->agg_state != -EINPROGRESS) {
@@ -1502,9 +1591,24 @@ schedule:
 void rmnet_map_update_ul_agg_config(struct rmnet_port *port, u16 size,
 				    u8 count, u8 features, u32 time)
 {
+	struct sk_buff *agg_skb = NULL;
 	unsigned long irq_flags;
 
 	spin_lock_irqsave(&port->agg_lock, irq_flags);
+
+	/* The aggregate being built belongs to the old mode and buffers:
+	 * ship it before they change under it.
+	 */
+	if (port->agg_skb) {
+		agg_skb = port->agg_skb;
+		port->agg_skb = NULL;
+		port->agg_count = 0;
+		memset(&port->agg_time, 0, sizeof(struct timespec));
+	}
+	port->agg_state = 0;
+	port->agg_copy = NULL;
+	port->agg_tail = NULL;
+
 	port->egress_agg_params.agg_count = count;
 	port->egress_agg_params.agg_time = time;
 	port->egress_agg_params.agg_size = size;
@@ -1524,11 +1628,15 @@ void rmnet_map_update_ul_agg_config(struct rmnet_port *port, u16 size,
 	size -= SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
 	port->egress_agg_params.agg_size = size;
 
+	/* Fragment based aggregation does not use the page pool */
 	if (port->egress_agg_params.agg_features == RMNET_PAGE_RECYCLE)
 		rmnet_alloc_agg_pages(port);
 
 done:
 	spin_unlock_irqrestore(&port->agg_lock, irq_flags);
+
+	if (agg_skb)
+		dev_queue_xmit(agg_skb);
 }
 
 void rmnet_map_tx_aggregate_init(struct rmnet_port *port)
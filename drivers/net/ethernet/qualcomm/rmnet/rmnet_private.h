@@ -25,8 +25,15 @@ RMNET_INGRESS_FORMAT_DL_MARKER_V2)
 #define RMNET_INGRESS_FORMAT_PS                 BIT(27)
 #define RMNET_FORMAT_PS_NOTIF                   BIT(26)
 
+/* DL deaggregation steering to per-CPU queues */
+#define RMNET_INGRESS_FORMAT_DEAG_STEER         BIT(25)
+
 /* UL Aggregation parameters */
 #define RMNET_PAGE_RECYCLE                      BIT(0)
+#define RMNET_FRAG_AGGREGATION                  BIT(1)
+
+/* Linear buffer used to hold small packets in fragment based aggregation */
+#define RMNET_AGG_COPY_SIZE                     1024
 
 /* Replace skb->dev to a virtual rmnet device and pass up the stack */
 #define RMNET_EPMODE_VND (1)
@@ -245,17 +245,38 @@ static const char rmnet_port_gstrings_stats[][ETH_GSTRING_LEN] = {
 	"DL trailer pkts received",
 	"UL agg reuse",
 	"UL agg alloc",
+	"UL agg bytes copied",
+	"UL agg bytes referenced",
+};
+
+static const char rmnet_deag_gstrings_stats[][ETH_GSTRING_LEN] = {
+	"queued",
+	"dropped",
+	"processed",
 };
 
 static void rmnet_get_strings(struct net_device *dev, u32 stringset, u8 *buf)
 {
+	int cpu, i;
+
 	switch (stringset) {
 	case ETH_SS_STATS:
 		memcpy(buf, &rmnet_gstrings_stats,
 		       sizeof(rmnet_gstrings_stats));
-		memcpy(buf + sizeof(rmnet_gstrings_stats),
-		       &rmnet_port_gstrings_stats,
+		buf += sizeof(rmnet_gstrings_stats);
+		memcpy(buf, &rmnet_port_gstrings_stats,
 		       sizeof(rmnet_port_gstrings_stats));
+		buf += sizeof(rmnet_port_gstrings_stats);
+
+		for_each_possible_cpu(cpu) {
+			for (i = 0; i < ARRAY_SIZE(rmnet_deag_gstrings_stats);
+			     i++) {
+				snprintf(buf, ETH_GSTRING_LEN,
+					 "DL deag cpu%d %s", cpu,
+					 rmnet_deag_gstrings_stats[i]);
+				buf += ETH_GSTRING_LEN;
+			}
+		}
 		break;
 	}
 }
@@ -265,7 +286,9 @@ static int rmnet_get_sset_count(struct net_device *dev, int sset)
 	switch (sset) {
 	case ETH_SS_STATS:
 		return ARRAY_SIZE(rmnet_gstrings_stats) +
-		       ARRAY_SIZE(rmnet_port_gstrings_stats);
+		       ARRAY_SIZE(rmnet_port_gstrings_stats) +
+		       ARRAY_SIZE(rmnet_deag_gstrings_stats) *
+		       num_possible_cpus();
 	default:
 		return -EOPNOTSUPP;
 	}
@@ -277,7 +300,9 @@ static void rmnet_get_ethtool_stats(struct net_device *dev,
 	struct rmnet_priv *priv = netdev_priv(dev);
 	struct rmnet_priv_stats *st = &priv->stats;
 	struct rmnet_port_priv_stats *stp;
+	struct rmnet_deag_queue *q;
 	struct rmnet_port *port;
+	int cpu;
 
 	port = rmnet_get_port(priv->real_dev);
 
@@ -287,16 +312,32 @@ static void rmnet_get_ethtool_stats(struct net_device *dev,
 	stp = &port->stats;
 
 	memcpy(data, st, ARRAY_SIZE(rmnet_gstrings_stats) * sizeof(u64));
-	memcpy(data + ARRAY_SIZE(rmnet_gstrings_stats), stp,
-	       ARRAY_SIZE(rmnet_port_gstrings_stats) * sizeof(u64));
+	data += ARRAY_SIZE(rmnet_gstrings_stats);
+	memcpy(data, stp, ARRAY_SIZE(rmnet_port_gstrings_stats) * sizeof(u64));
+	data += ARRAY_SIZE(rmnet_port_gstrings_stats);
+
+	for_each_possible_cpu(cpu) {
+		if (port->deag_queues) {
+			q = per_cpu_ptr(port->deag_queues, cpu);
+			data[0] = q->queued;
+			data[1] = q->dropped;
+			data[2] = q->processed;
+		} else {
+			memset(data, 0, ARRAY_SIZE(rmnet_deag_gstrings_stats) *
+			       sizeof(u64));
+		}
+		data += ARRAY_SIZE(rmnet_deag_gstrings_stats);
+	}
 }
 
 static int rmnet_stats_reset(struct net_device *dev)
 {
 	struct rmnet_priv *priv = netdev_priv(dev);
 	struct rmnet_port_priv_stats *stp;
+	struct rmnet_deag_queue *q;
 	struct rmnet_priv_stats *st;
 	struct rmnet_port *port;
+	int cpu;
 
 	port = rmnet_get_port(priv->real_dev);
 	if (!port)
@@ -306,6 +347,15 @@ static int rmnet_stats_reset(struct net_device *dev)
 
 	memset(stp, 0, sizeof(*stp));
 
+	if (port->deag_queues) {
+		for_each_possible_cpu(cpu) {
+			q = per_cpu_ptr(port->deag_queues, cpu);
+			q->queued = 0;
+			q->dropped = 0;
+			q->processed = 0;
+		}
+	}
+
 	st = &priv->stats;
 
 	memset(st, 0, sizeof(*st));
@@ -256,7 +256,7 @@ struct tun_struct {
 	struct net_device	*dev;
 	netdev_features_t	set_features;
 #define TUN_USER_FEATURES (NETIF_F_HW_CSUM|NETIF_F_TSO_ECN|NETIF_F_TSO| \
-			  NETIF_F_TSO6)
+			  NETIF_F_TSO6|NETIF_F_GSO_UDP_L4)
 
 	int			align;
 	int			vnet_hdr_sz;
@@ -2318,6 +2318,161 @@ static ssize_t tun_chr_read_iter(struct kiocb *iocb, struct iov_iter *to)
 	return ret;
 }
 
+/* Deliver what a batch that ended early left queued for more to follow */
+static void tun_rx_flush(struct tun_struct *tun, struct tun_file *tfile)
+{
+	struct sk_buff_head *queue = &tfile->sk.sk_write_queue;
+	struct sk_buff_head process_queue;
+	struct sk_buff *skb;
+
+	if (skb_queue_empty(queue))
+		return;
+
+	if (tfile->napi_enabled) {
+		local_bh_disable();
+		napi_schedule(&tfile->napi);
+		local_bh_enable();
+		return;
+	}
+
+	__skb_queue_head_init(&process_queue);
+	spin_lock_bh(&queue->lock);
+	skb_queue_splice_tail_init(queue, &process_queue);
+	spin_unlock_bh(&queue->lock);
+
+	local_bh_disable();
+	while ((skb = __skb_dequeue(&process_queue))) {
+		skb_record_rx_queue(skb, tfile->queue_index);
+		netif_receive_skb(skb);
+	}
+	local_bh_enable();
+}
+
+/* Write a batch of packets. All but the last are flagged as having more
+ * to follow, so they are handed to the stack together.
+ */
+static long tun_send_mmsg(struct file *file, struct tun_struct *tun,
+			  struct tun_file *tfile, struct tun_mmsg *mmsg)
+{
+	struct tun_packet __user *upkts = u64_to_user_ptr(mmsg->packets);
+	int noblock = (file->f_flags & O_NONBLOCK) ||
+		      (mmsg->flags & TUN_MMSG_DONTWAIT);
+	struct tun_packet pkt;
+	struct iov_iter from;
+	struct iovec iov;
+	ssize_t ret = 0;
+	u32 i;
+
+	for (i = 0; i < mmsg->count; i++) {
+		if (i && signal_pending(current))
+			break;
+		cond_resched();
+
+		if (copy_from_user(&pkt, &upkts[i], sizeof(pkt))) {
+			ret = -EFAULT;
+			break;
+		}
+		if (pkt.reserved) {
+			ret = -EINVAL;
+			break;
+		}
+
+		ret = import_single_range(WRITE, u64_to_user_ptr(pkt.buf),
+					  pkt.len, &iov, &from);
+		if (ret)
+			break;
+
+		ret = tun_get_user(tun, tfile, NULL, &from, noblock,
+				   i + 1 < mmsg->count);
+		if (ret < 0)
+			break;
+	}
+
+	if (i < mmsg->count)
+		tun_rx_flush(tun, tfile);
+
+	return i ? i : ret;
+}
+
+/* Read up to a batch of packets. Only the first one may block; the call
+ * returns as soon as the queue is empty after that.
+ */
+static long tun_recv_mmsg(struct file *file, struct tun_struct *tun,
+			  struct tun_file *tfile, struct tun_mmsg *mmsg)
+{
+	struct tun_packet __user *upkts = u64_to_user_ptr(mmsg->packets);
+	int noblock = (file->f_flags & O_NONBLOCK) ||
+		      (mmsg->flags & TUN_MMSG_DONTWAIT);
+	struct tun_packet pkt;
+	struct iov_iter to;
+	struct iovec iov;
+	ssize_t ret = 0;
+	u32 i;
+
+	for (i = 0; i < mmsg->count; i++) {
+		if (i && signal_pending(current))
+			break;
+		cond_resched();
+
+		if (copy_from_user(&pkt, &upkts[i], sizeof(pkt))) {
+			ret = -EFAULT;
+			break;
+		}
+		if (pkt.reserved) {
+			ret = -EINVAL;
+			break;
+		}
+
+		ret = import_single_range(READ, u64_to_user_ptr(pkt.buf),
+					  pkt.len, &iov, &to);
+		if (ret)
+			break;
+
+		ret = tun_do_read(tun, tfile, &to, noblock || i, NULL);
+		if (ret < 0)
+			break;
+
+		ret = min_t(ssize_t, ret, pkt.len);
+		if (put_user(ret, &upkts[i].len)) {
+			ret = -EFAULT;
+			break;
+		}
+	}
+
+	/* Running out of packets after the first one is not an error */
+	return i ? i : ret;
+}
+
+static long tun_chr_mmsg(struct file *file, unsigned int cmd,
+			 void __user *argp)
+{
+	struct tun_file *tfile = file->private_data;
+	struct tun_struct *tun;
+	struct tun_mmsg mmsg;
+	long ret;
+
+	if (copy_from_user(&mmsg, argp, sizeof(mmsg)))
+		return -EFAULT;
+
+	if (mmsg.flags & ~TUN_MMSG_DONTWAIT)
+		return -EINVAL;
+	/* Bound the work done in one call, as sendmmsg() does */
+	if (mmsg.count > UIO_MAXIOV)
+		mmsg.count = UIO_MAXIOV;
+
+	tun = tun_get(tfile);
+	if (!tun)
+		return -EBADFD;
+
+	if (cmd == TUNSENDMMSG)
+		ret = tun_send_mmsg(file, tun, tfile, &mmsg);
+	else
+		ret = tun_recv_mmsg(file, tun, tfile, &mmsg);
+
+	tun_put(tun);
+	return ret;
+}
+
 static void tun_prog_free(struct rcu_head *rcu)
 {
 	struct tun_prog *prog = container_of(rcu, struct tun_prog, rcu);
@@ -2841,6 +2996,15 @@ static int set_offload(struct tun_struct *tun, unsigned long arg)
 			arg &= ~(TUN_F_TSO4|TUN_F_TSO6);
 		}
 
+		/* The stack has one feature for UDP segmentation of both
+		 * IPv4 and IPv6, so user space must handle both.
+		 */
+		if ((arg & (TUN_F_USO4|TUN_F_USO6)) ==
+		    (TUN_F_USO4|TUN_F_USO6)) {
+			features |= NETIF_F_GSO_UDP_L4;
+			arg &= ~(TUN_F_USO4|TUN_F_USO6);
+		}
+
 		arg &= ~TUN_F_UFO;
 	}
 
@@ -2983,7 +3147,9 @@ static long __tun_chr_ioctl(struct file *file, unsigned int cmd,
 	// ------------- END of KNOX_VPN -------------------//
 
 #ifdef CONFIG_ANDROID_PARANOID_NETWORK
-	if (cmd != TUNGETIFF && !capable(CAP_NET_ADMIN)) {
+	/* The batched I/O ioctls are read() and write() of an open fd */
+	if (cmd != TUNGETIFF && cmd != TUNSENDMMSG && cmd != TUNRECVMMSG &&
+	    !capable(CAP_NET_ADMIN)) {
 		return -EPERM;
 	}
 #endif
@@ -3007,6 +3173,9 @@ static long __tun_chr_ioctl(struct file *file, unsigned int cmd,
 		// ------------- END of KNOX_VPN -------------------//
 	} else if (cmd == TUNSETQUEUE) {
 		return tun_set_queue(file, &ifr);
+	} else if (cmd == TUNSENDMMSG || cmd == TUNRECVMMSG) {
+		/* Data path, keep it out of rtnl_lock */
+		return tun_chr_mmsg(file, cmd, argp);
 	} else if (cmd == SIOCGSKNS) {
 		if (!ns_capable(net->user_ns, CAP_NET_ADMIN))
 			return -EPERM;
@@ -3332,6 +3501,8 @@ static long tun_chr_compat_ioctl(struct file *file,
 	case TUNSETTXFILTER:
 	case TUNGETSNDBUF:
 	case TUNSETSNDBUF:
+	case TUNSENDMMSG:
+	case TUNRECVMMSG:
 	case SIOCGIFHWADDR:
 	case SIOCSIFHWADDR:
 		arg = (unsigned long)compat_ptr(arg);
@@ -38,6 +38,7 @@ struct level_stats {
 	int64_t max_time[CONFIG_MSM_IDLE_STATS_BUCKET_COUNT];
 	int success_count;
 	int failed_count;
+	int premature_count;	/* left before the level's min residency */
 	uint64_t total_time;
 	uint64_t enter_time;
 };
@@ -119,6 +120,10 @@ static void level_stats_print(struct seq_file *m, struct level_stats *stats)
 	if (stats->failed_count)
 		seq_printf(m, "  failed count: %7d\n", stats->failed_count);
 
+	if (stats->premature_count)
+		seq_printf(m, "  premature count: %7d\n",
+			stats->premature_count);
+
 	bucket_time = stats->first_bucket_time;
 	for (i = 0;
 		i < CONFIG_MSM_IDLE_STATS_BUCKET_COUNT - 1;
@@ -176,6 +181,7 @@ static void level_stats_reset(struct level_stats *stats)
 	memset(stats->max_time, 0, sizeof(stats->max_time));
 	stats->success_count = 0;
 	stats->failed_count = 0;
+	stats->premature_count = 0;
 	stats->total_time = 0;
 }
 
@@ -788,6 +794,26 @@ void lpm_stats_cpu_exit(uint32_t index, uint64_t time, bool success)
 }
 EXPORT_SYMBOL(lpm_stats_cpu_exit);
 
+/**
+ * lpm_stats_cpu_premature() - API to count a premature cpu lpm exit.
+ *
+ * @index:	cpu's lpm level index.
+ *
+ * Function to communicate that the cpu woke up from the low power mode
+ * before its minimum residency, i.e. a shallower level would have been
+ * cheaper.
+ */
+void lpm_stats_cpu_premature(uint32_t index)
+{
+	struct lpm_stats *stats = &(*this_cpu_ptr(&(cpu_stats)));
+
+	if (!stats->time_stats)
+		return;
+
+	stats->time_stats[index].premature_count++;
+}
+EXPORT_SYMBOL(lpm_stats_cpu_premature);
+
 /**
  * lpm_stats_suspend_enter() - API to communicate system entering suspend.
  *
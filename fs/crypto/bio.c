@@ -23,29 +23,68 @@
 #include <linux/pagemap.h>
 #include <linux/module.h>
 #include <linux/bio.h>
+#include <linux/blkdev.h>
 #include <linux/namei.h>
 #include "fscrypt_private.h"
 
+/* Number of blocks handed to the crypto API at once when decrypting a bio */
+#define FSCRYPT_DECRYPT_BATCH	16
+
+static void fscrypt_decrypt_bio_blocks(const struct inode *inode,
+				       struct fscrypt_block *blocks,
+				       unsigned int nr_blocks, bool done)
+{
+	unsigned int i;
+
+	fscrypt_do_blocks_crypto(inode, FS_DECRYPT, blocks, nr_blocks,
+				 GFP_NOFS);
+
+	for (i = 0; i < nr_blocks; i++) {
+		struct page *page = blocks[i].dest_page;
+
+		if (blocks[i].err)
+			SetPageError(page);
+		else if (done)
+			SetPageUptodate(page);
+		if (done)
+			unlock_page(page);
+	}
+}
+
 static void __fscrypt_decrypt_bio(struct bio *bio, bool done)
 {
+	struct fscrypt_block blocks[FSCRYPT_DECRYPT_BATCH];
+	const struct inode *batch_inode = NULL;
+	unsigned int nr_blocks = 0;
 	struct bio_vec *bv;
 	int i;
 
 	bio_for_each_segment_all(bv, bio, i) {
 		struct page *page = bv->bv_page;
-		if (fscrypt_using_hardware_encryption(page->mapping->host)) {
+		struct inode *inode = page->mapping->host;
+
+		if (fscrypt_using_hardware_encryption(inode)) {
 			SetPageUptodate(page);
-		} else {
-			int ret = fscrypt_decrypt_page(page->mapping->host,
-				page, PAGE_SIZE, 0, page->index);
-			if (ret)
-				SetPageError(page);
-			else if (done)
-				SetPageUptodate(page);
+			if (done)
+				unlock_page(page);
+			continue;
 		}
-		if (done)
-			unlock_page(page);
+
+		if (nr_blocks && (inode != batch_inode ||
+				  nr_blocks == FSCRYPT_DECRYPT_BATCH)) {
+			fscrypt_decrypt_bio_blocks(batch_inode, blocks,
+						   nr_blocks, done);
+			nr_blocks = 0;
+		}
+		batch_inode = inode;
+		blocks[nr_blocks].src_page = page;
+		blocks[nr_blocks].dest_page = page;
+		blocks[nr_blocks].lblk_num = page->index;
+		nr_blocks++;
 	}
+
+	if (nr_blocks)
+		fscrypt_decrypt_bio_blocks(batch_inode, blocks, nr_blocks, done);
 }
 
 void fscrypt_decrypt_bio(struct bio *bio)
@@ -94,63 +133,157 @@ void fscrypt_pullback_bio_page(struct page **page, bool restore)
 }
 EXPORT_SYMBOL(fscrypt_pullback_bio_page);
 
+/*
+ * fscrypt_zeroout_range() writes the range through up to
+ * FSCRYPT_ZEROOUT_MAX_BIOS bios in flight, each of up to
+ * FSCRYPT_ZEROOUT_BIO_PAGES bounce pages, so that the next batch can be
+ * encrypted while the previous one is being written.
+ */
+#define FSCRYPT_ZEROOUT_BIO_PAGES	8
+#define FSCRYPT_ZEROOUT_MAX_BIOS	2
+
+struct fscrypt_zeroout_slot {
+	struct fscrypt_ctx **ctxs;
+	struct completion done;
+	struct bio *bio;
+};
+
+static void fscrypt_zeroout_end_io(struct bio *bio)
+{
+	struct fscrypt_zeroout_slot *slot = bio->bi_private;
+
+	complete(&slot->done);
+}
+
+static int fscrypt_zeroout_wait(struct fscrypt_zeroout_slot *slot)
+{
+	int err;
+
+	wait_for_completion_io(&slot->done);
+	err = blk_status_to_errno(slot->bio->bi_status);
+	bio_put(slot->bio);
+	slot->bio = NULL;
+	return err;
+}
+
 int fscrypt_zeroout_range(const struct inode *inode, pgoff_t lblk,
 				sector_t pblk, unsigned int len)
 {
-	struct fscrypt_ctx *ctx;
-	struct page *ciphertext_page = NULL;
-	struct bio *bio;
-	int ret, err = 0;
+	struct fscrypt_ctx *ctxs[FSCRYPT_ZEROOUT_BIO_PAGES *
+				 FSCRYPT_ZEROOUT_MAX_BIOS];
+	struct fscrypt_zeroout_slot slots[FSCRYPT_ZEROOUT_MAX_BIOS];
+	struct fscrypt_block blocks[FSCRYPT_ZEROOUT_BIO_PAGES];
+	unsigned int nr_pages, nr_slots, pages_per_bio;
+	unsigned int i, j;
+	int err = 0;
 
 	BUG_ON(inode->i_sb->s_blocksize != PAGE_SIZE);
 
-	ctx = fscrypt_get_ctx(GFP_NOFS);
-	if (IS_ERR(ctx))
-		return PTR_ERR(ctx);
+	if (len == 0)
+		return 0;
+
+	/*
+	 * Take bounce pages through the regular fscrypt_ctx pools.  Only the
+	 * first one may wait, the others are opportunistic so that zeroing
+	 * out can't starve writeback of bounce pages.
+	 */
+	nr_pages = min_t(unsigned int, len, ARRAY_SIZE(ctxs));
+	for (i = 0; i < nr_pages; i++) {
+		struct fscrypt_ctx *ctx;
+		struct page *page;
+
+		ctx = fscrypt_get_ctx(i ? GFP_NOWAIT : GFP_NOFS);
+		if (IS_ERR(ctx)) {
+			err = PTR_ERR(ctx);
+			break;
+		}
+		page = fscrypt_alloc_bounce_page(ctx,
+						 i ? GFP_NOWAIT : GFP_NOFS);
+		if (IS_ERR(page)) {
+			fscrypt_release_ctx(ctx);
+			err = PTR_ERR(page);
+			break;
+		}
+		ctxs[i] = ctx;
+	}
+	if (i == 0)
+		return err;
+	err = 0;
 
-	ciphertext_page = fscrypt_alloc_bounce_page(ctx, GFP_NOWAIT);
-	if (IS_ERR(ciphertext_page)) {
-		err = PTR_ERR(ciphertext_page);
-		goto errout;
+	/* Spread the pages we got evenly over the bios. */
+	nr_pages = i;
+	nr_slots = min_t(unsigned int, nr_pages, FSCRYPT_ZEROOUT_MAX_BIOS);
+	pages_per_bio = min_t(unsigned int, nr_pages / nr_slots,
+			      FSCRYPT_ZEROOUT_BIO_PAGES);
+	for (i = 0; i < nr_slots; i++) {
+		slots[i].ctxs = &ctxs[i * pages_per_bio];
+		init_completion(&slots[i].done);
+		slots[i].bio = NULL;
 	}
 
-	while (len--) {
-		err = fscrypt_do_page_crypto(inode, FS_ENCRYPT, lblk,
-					     ZERO_PAGE(0), ciphertext_page,
-					     PAGE_SIZE, 0, GFP_NOFS);
-		if (err)
-			goto errout;
+	for (i = 0; len; i = (i + 1) % nr_slots) {
+		struct fscrypt_zeroout_slot *slot = &slots[i];
+		unsigned int nr = min(len, pages_per_bio);
+		struct bio *bio;
+
+		if (slot->bio) {
+			err = fscrypt_zeroout_wait(slot);
+			if (err)
+				break;
+		}
 
-		bio = bio_alloc(GFP_NOWAIT, 1);
-		if (!bio) {
-			err = -ENOMEM;
-			goto errout;
+		for (j = 0; j < nr; j++) {
+			blocks[j].src_page = ZERO_PAGE(0);
+			blocks[j].dest_page = slot->ctxs[j]->w.bounce_page;
+			blocks[j].lblk_num = lblk + j;
 		}
+		err = fscrypt_do_blocks_crypto(inode, FS_ENCRYPT, blocks, nr,
+					       GFP_NOFS);
+		if (err)
+			break;
+
+		bio = bio_alloc(GFP_NOFS, nr);
 		bio_set_dev(bio, inode->i_sb->s_bdev);
 		bio->bi_iter.bi_sector =
 			pblk << (inode->i_sb->s_blocksize_bits - 9);
-		bio_set_op_attrs(bio, REQ_OP_WRITE, REQ_NOENCRYPT);
-		ret = bio_add_page(bio, ciphertext_page,
-					inode->i_sb->s_blocksize, 0);
-		if (ret != inode->i_sb->s_blocksize) {
-			/* should never happen! */
-			WARN_ON(1);
+		bio_set_op_attrs(bio, REQ_OP_WRITE, REQ_NOENCRYPT | REQ_SYNC);
+		for (j = 0; j < nr; j++) {
+			int ret = bio_add_page(bio, blocks[j].dest_page,
+					       inode->i_sb->s_blocksize, 0);
+
+			if (ret != inode->i_sb->s_blocksize) {
+				/* should never happen! */
+				WARN_ON(1);
+				err = -EIO;
+				break;
+			}
+		}
+		if (err) {
 			bio_put(bio);
-			err = -EIO;
-			goto errout;
+			break;
 		}
-		err = submit_bio_wait(bio);
-		if (err == 0 && bio->bi_status)
-			err = -EIO;
-		bio_put(bio);
-		if (err)
-			goto errout;
-		lblk++;
-		pblk++;
+		bio->bi_private = slot;
+		bio->bi_end_io = fscrypt_zeroout_end_io;
+		reinit_completion(&slot->done);
+		slot->bio = bio;
+		submit_bio(bio);
+
+		lblk += nr;
+		pblk += nr;
+		len -= nr;
 	}
-	err = 0;
-errout:
-	fscrypt_release_ctx(ctx);
+
+	for (i = 0; i < nr_slots; i++) {
+		if (slots[i].bio) {
+			int ret = fscrypt_zeroout_wait(&slots[i]);
+
+			if (!err)
+				err = ret;
+		}
+	}
+
+	for (i = 0; i < nr_pages; i++)
+		fscrypt_release_ctx(ctxs[i]);
 	return err;
 }
 EXPORT_SYMBOL(fscrypt_zeroout_range);
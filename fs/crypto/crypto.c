@@ -144,6 +144,40 @@ void fscrypt_generate_iv(union fscrypt_iv *iv, u64 lblk_num,
 		crypto_cipher_encrypt_one(ci->ci_essiv_tfm, iv->raw, iv->raw);
 }
 
+#ifdef CONFIG_FSCRYPT_SDP
+/* Record audit log in case of a failure during en/decryption of a sensitive file */
+static void fscrypt_sdp_audit_crypt_failure(const struct inode *inode,
+					    fscrypt_direction_t rw, int res)
+{
+	struct fscrypt_info *ci = inode->i_crypt_info;
+	sdp_fs_command_t *cmd = NULL;
+
+	if (ci->ci_sdp_info) {
+		if (ci->ci_sdp_info->sdp_flags & SDP_DEK_IS_SENSITIVE) {
+			printk("Record audit log in case of a failure during en/decryption of sensitive file\n");
+			if (rw == FS_DECRYPT) {
+				cmd = sdp_fs_command_alloc(FSOP_AUDIT_FAIL_DECRYPT,
+				current->tgid, ci->ci_sdp_info->engine_id, -1, inode->i_ino, res,
+						GFP_KERNEL);
+			} else {
+				cmd = sdp_fs_command_alloc(FSOP_AUDIT_FAIL_ENCRYPT,
+				current->tgid, ci->ci_sdp_info->engine_id, -1, inode->i_ino, res,
+						GFP_KERNEL);
+			}
+			if (cmd) {
+				sdp_fs_request(cmd, NULL);
+				sdp_fs_command_free(cmd);
+			}
+		}
+	}
+}
+#else
+static inline void fscrypt_sdp_audit_crypt_failure(const struct inode *inode,
+						   fscrypt_direction_t rw, int res)
+{
+}
+#endif
+
 int fscrypt_do_page_crypto(const struct inode *inode, fscrypt_direction_t rw,
 			   u64 lblk_num, struct page *src_page,
 			   struct page *dest_page, unsigned int len,
@@ -156,9 +190,6 @@ int fscrypt_do_page_crypto(const struct inode *inode, fscrypt_direction_t rw,
 	struct fscrypt_info *ci = inode->i_crypt_info;
 	struct crypto_skcipher *tfm = ci->ci_ctfm;
 	int res = 0;
-#ifdef CONFIG_FSCRYPT_SDP
-	sdp_fs_command_t *cmd = NULL;
-#endif
 
 	if (WARN_ON_ONCE(len <= 0))
 		return -EINVAL;
@@ -190,31 +221,142 @@ int fscrypt_do_page_crypto(const struct inode *inode, fscrypt_direction_t rw,
 			    "%scryption failed for inode %lu, block %llu: %d",
 			    (rw == FS_DECRYPT ? "de" : "en"),
 			    inode->i_ino, lblk_num, res);
-#ifdef CONFIG_FSCRYPT_SDP
-		if (ci->ci_sdp_info) {
-			if (ci->ci_sdp_info->sdp_flags & SDP_DEK_IS_SENSITIVE) {
-				printk("Record audit log in case of a failure during en/decryption of sensitive file\n");
-				if (rw == FS_DECRYPT) {
-					cmd = sdp_fs_command_alloc(FSOP_AUDIT_FAIL_DECRYPT,
-					current->tgid, ci->ci_sdp_info->engine_id, -1, inode->i_ino, res,
-							GFP_KERNEL);
-				} else {
-					cmd = sdp_fs_command_alloc(FSOP_AUDIT_FAIL_ENCRYPT,
-					current->tgid, ci->ci_sdp_info->engine_id, -1, inode->i_ino, res,
-							GFP_KERNEL);
-				}
-				if (cmd) {
-					sdp_fs_request(cmd, NULL);
-					sdp_fs_command_free(cmd);
-				}
-			}
-		}
-#endif
+		fscrypt_sdp_audit_crypt_failure(inode, rw, res);
 		return res;
 	}
 	return 0;
 }
 
+/*
+ * Each block needs its own IV, so an skcipher request can never span more than
+ * one block.  Instead, a batch of blocks is set up in one allocation, all of
+ * the requests are submitted back to back and the caller waits only once, so
+ * that asynchronous implementations can work on them in parallel.
+ */
+struct fscrypt_block_req {
+	struct fscrypt_block *block;
+	atomic_t *pending;
+	struct completion *done;
+	union fscrypt_iv iv;
+	struct scatterlist src, dst;
+	/* must be last, it is followed by the tfm's request context */
+	struct skcipher_request req;
+};
+
+static void fscrypt_block_req_done(struct crypto_async_request *areq, int err)
+{
+	struct fscrypt_block_req *breq = areq->data;
+
+	if (err == -EINPROGRESS)
+		return;
+
+	breq->block->err = err;
+	if (atomic_dec_and_test(breq->pending))
+		complete(breq->done);
+}
+
+/**
+ * fscrypt_do_blocks_crypto() - En/decrypts a batch of page-sized blocks
+ * @inode:     The inode all of the blocks belong to
+ * @rw:        FS_DECRYPT or FS_ENCRYPT
+ * @blocks:    The blocks to process; ->err is set for each of them
+ * @nr_blocks: Number of entries in @blocks
+ * @gfp_flags: The gfp flag for memory allocation
+ *
+ * Falls back to one fscrypt_do_page_crypto() call per block if the batch of
+ * requests can't be allocated.
+ *
+ * Return: Zero if all blocks were processed, else the first error.
+ */
+int fscrypt_do_blocks_crypto(const struct inode *inode, fscrypt_direction_t rw,
+			     struct fscrypt_block *blocks,
+			     unsigned int nr_blocks, gfp_t gfp_flags)
+{
+	struct fscrypt_info *ci = inode->i_crypt_info;
+	struct crypto_skcipher *tfm = ci->ci_ctfm;
+	DECLARE_COMPLETION_ONSTACK(done);
+	atomic_t pending;
+	size_t stride;
+	u8 *reqs;
+	unsigned int i;
+	int res = 0;
+
+	stride = ALIGN(sizeof(struct fscrypt_block_req) +
+		       crypto_skcipher_reqsize(tfm), CRYPTO_MINALIGN);
+	reqs = kmalloc_array(nr_blocks, stride, gfp_flags);
+	if (!reqs) {
+		for (i = 0; i < nr_blocks; i++) {
+			struct fscrypt_block *block = &blocks[i];
+
+			block->err = fscrypt_do_page_crypto(inode, rw,
+					block->lblk_num, block->src_page,
+					block->dest_page, PAGE_SIZE, 0,
+					gfp_flags);
+			if (block->err && !res)
+				res = block->err;
+		}
+		return res;
+	}
+
+	/* Biased by one so that the batch can't complete while submitting. */
+	atomic_set(&pending, nr_blocks + 1);
+
+	for (i = 0; i < nr_blocks; i++) {
+		struct fscrypt_block_req *breq = (void *)(reqs + i * stride);
+		struct fscrypt_block *block = &blocks[i];
+		int err;
+
+		breq->block = block;
+		breq->pending = &pending;
+		breq->done = &done;
+		block->err = 0;
+
+		fscrypt_generate_iv(&breq->iv, block->lblk_num, ci);
+
+		sg_init_table(&breq->src, 1);
+		sg_set_page(&breq->src, block->src_page, PAGE_SIZE, 0);
+		sg_init_table(&breq->dst, 1);
+		sg_set_page(&breq->dst, block->dest_page, PAGE_SIZE, 0);
+
+		skcipher_request_set_tfm(&breq->req, tfm);
+		skcipher_request_set_callback(&breq->req,
+			CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
+			fscrypt_block_req_done, breq);
+		skcipher_request_set_crypt(&breq->req, &breq->src, &breq->dst,
+					   PAGE_SIZE, &breq->iv);
+		if (rw == FS_DECRYPT)
+			err = crypto_skcipher_decrypt(&breq->req);
+		else
+			err = crypto_skcipher_encrypt(&breq->req);
+
+		/* Completed synchronously, the callback won't be called. */
+		if (err != -EINPROGRESS && err != -EBUSY) {
+			block->err = err;
+			atomic_dec(&pending);
+		}
+	}
+
+	if (!atomic_dec_and_test(&pending))
+		wait_for_completion(&done);
+
+	for (i = 0; i < nr_blocks; i++) {
+		struct fscrypt_block *block = &blocks[i];
+
+		if (!block->err)
+			continue;
+		fscrypt_err(inode->i_sb,
+			    "%scryption failed for inode %lu, block %llu: %d",
+			    (rw == FS_DECRYPT ? "de" : "en"),
+			    inode->i_ino, block->lblk_num, block->err);
+		fscrypt_sdp_audit_crypt_failure(inode, rw, block->err);
+		if (!res)
+			res = block->err;
+	}
+
+	kzfree(reqs);
+	return res;
+}
+
 struct page *fscrypt_alloc_bounce_page(struct fscrypt_ctx *ctx,
 				       gfp_t gfp_flags)
 {
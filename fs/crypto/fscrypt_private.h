@@ -155,6 +155,19 @@ extern int fscrypt_do_page_crypto(const struct inode *inode,
 				  struct page *dest_page,
 				  unsigned int len, unsigned int offs,
 				  gfp_t gfp_flags);
+
+/* A page-sized block for fscrypt_do_blocks_crypto() */
+struct fscrypt_block {
+	struct page *src_page;
+	struct page *dest_page;
+	u64 lblk_num;
+	int err;
+};
+
+extern int fscrypt_do_blocks_crypto(const struct inode *inode,
+				    fscrypt_direction_t rw,
+				    struct fscrypt_block *blocks,
+				    unsigned int nr_blocks, gfp_t gfp_flags);
 extern struct page *fscrypt_alloc_bounce_page(struct fscrypt_ctx *ctx,
 					      gfp_t gfp_flags);
 extern const struct dentry_operations fscrypt_d_ops;
@@ -1205,7 +1205,7 @@ static void ext4_destroy_inode(struct inode *inode)
 				true);
 		dump_stack();
 	}
-	call_rcu(&inode->i_rcu, ext4_i_callback);
+	call_rcu_lazy(&inode->i_rcu, ext4_i_callback);
 }
 
 static void init_once(void *foo)
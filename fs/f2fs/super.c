@@ -1141,7 +1141,7 @@ static void f2fs_i_callback(struct rcu_head *head)
 
 static void f2fs_destroy_inode(struct inode *inode)
 {
-	call_rcu(&inode->i_rcu, f2fs_i_callback);
+	call_rcu_lazy(&inode->i_rcu, f2fs_i_callback);
 }
 
 static void destroy_percpu_info(struct f2fs_sb_info *sbi)
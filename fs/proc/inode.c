@@ -83,7 +83,7 @@ static void proc_i_callback(struct rcu_head *head)
 
 static void proc_destroy_inode(struct inode *inode)
 {
-	call_rcu(&inode->i_rcu, proc_i_callback);
+	call_rcu_lazy(&inode->i_rcu, proc_i_callback);
 }
 
 static void init_once(void *foo)
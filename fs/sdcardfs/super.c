@@ -239,7 +239,7 @@ static void i_callback(struct rcu_head *head)
 
 static void sdcardfs_destroy_inode(struct inode *inode)
 {
-	call_rcu(&inode->i_rcu, i_callback);
+	call_rcu_lazy(&inode->i_rcu, i_callback);
 }
 
 /* sdcardfs inode cache constructor */
@@ -265,6 +265,13 @@ static inline int cpuidle_register_governor(struct cpuidle_governor *gov)
 {return 0;}
 #endif
 
+#ifdef CONFIG_CPU_IDLE_IRQ_TIMINGS
+extern unsigned int cpuidle_predict_irq_us(void);
+#else
+static inline unsigned int cpuidle_predict_irq_us(void)
+{return UINT_MAX;}
+#endif
+
 #define __CPU_PM_CPU_IDLE_ENTER(low_level_idle_enter, idx, is_retention) \
 ({									\
 	int __ret = 0;							\
@@ -130,12 +130,32 @@ extern const struct raid6_calls raid6_neonx1;
 extern const struct raid6_calls raid6_neonx2;
 extern const struct raid6_calls raid6_neonx4;
 extern const struct raid6_calls raid6_neonx8;
+extern const struct raid6_calls raid6_neonx4b;
+extern const struct raid6_calls raid6_neonx8b;
 
 /* Algorithm list */
 extern const struct raid6_calls * const raid6_algos[];
 extern const struct raid6_recov_calls *const raid6_recov_algos[];
 int raid6_select_algo(void);
 
+#ifdef __KERNEL__
+/* Per array width algorithm selection, see raid6_select_algo_disks() */
+#define RAID6_MAX_TUNED_DISKS	64
+
+extern const struct raid6_calls *raid6_width_call[RAID6_MAX_TUNED_DISKS + 1];
+void raid6_select_algo_disks(int disks);
+
+static inline const struct raid6_calls *raid6_call_for(int disks)
+{
+	const struct raid6_calls *call = NULL;
+
+	if (disks <= RAID6_MAX_TUNED_DISKS)
+		call = READ_ONCE(raid6_width_call[disks]);
+
+	return call ? call : &raid6_call;
+}
+#endif
+
 /* Return values from chk_syndrome */
 #define RAID6_OK	0
 #define RAID6_P_BAD	1
@@ -49,6 +49,14 @@ void synchronize_sched_expedited(void);
 void synchronize_rcu_expedited(void);
 
 void kfree_call_rcu(struct rcu_head *head, rcu_callback_t func);
+#ifdef CONFIG_RCU_LAZY
+void call_rcu_lazy(struct rcu_head *head, rcu_callback_t func);
+#else /* #ifdef CONFIG_RCU_LAZY */
+static inline void call_rcu_lazy(struct rcu_head *head, rcu_callback_t func)
+{
+	call_rcu(head, func);
+}
+#endif /* #else #ifdef CONFIG_RCU_LAZY */
 
 /**
  * synchronize_rcu_bh_expedited - Brute-force RCU-bh grace period
@@ -38,6 +38,11 @@ struct rw_semaphore {
 	 * if the owner is running on the cpu.
 	 */
 	struct task_struct *owner;
+	/*
+	 * Set when a waiter has been starved for too long: lock stealing
+	 * by optimistic spinners stops until a waiter gets the lock.
+	 */
+	bool handoff;
 #endif
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 	struct lockdep_map	dep_map;
@@ -82,7 +87,8 @@ static inline int rwsem_is_locked(struct rw_semaphore *sem)
 #endif
 
 #ifdef CONFIG_RWSEM_SPIN_ON_OWNER
-#define __RWSEM_OPT_INIT(lockname) , .osq = OSQ_LOCK_UNLOCKED, .owner = NULL
+#define __RWSEM_OPT_INIT(lockname) , .osq = OSQ_LOCK_UNLOCKED, .owner = NULL, \
+				   .handoff = false
 #else
 #define __RWSEM_OPT_INIT(lockname)
 #endif
@@ -753,6 +753,15 @@ struct wake_q_node {
 	struct wake_q_node *next;
 };
 
+/* Lock wait in progress, see kernel/locking/lock_contention.c */
+struct lock_contention_wait {
+	void				*lock;
+	unsigned long			ip;
+	u64				start;
+	unsigned int			flags;
+	unsigned int			gen;
+};
+
 struct task_struct {
 #ifdef CONFIG_THREAD_INFO_IN_TASK
 	/*
@@ -1107,6 +1116,10 @@ struct task_struct {
 	struct mutex_waiter		*blocked_on;
 #endif
 
+#ifdef CONFIG_LOCK_CONTENTION_HIST
+	struct lock_contention_wait	lock_wait;
+#endif
+
 #ifdef CONFIG_TRACE_IRQFLAGS
 	unsigned int			irq_events;
 	unsigned long			hardirq_enable_ip;
@@ -305,7 +305,10 @@ struct tcp_sock {
 	u32	lost_out;	/* Lost packets			*/
 	u32	sacked_out;	/* SACK'd packets			*/
 
-	struct hrtimer	pacing_timer;
+	u64	tcp_wstamp_ns;	/* earliest departure time of next packet */
+	u64	pacing_slot;	/* pacing wheel slot we wait for */
+	u32	pacing_cpu;	/* cpu of the pacing wheel we are on */
+	struct hlist_node pacing_node; /* on a pacing wheel while throttled */
 	struct hrtimer	compressed_ack_timer;
 
 	/* from STCP, retrans queue hinting */
@@ -410,6 +413,7 @@ enum tsq_enum {
 	TCP_MTU_REDUCED_DEFERRED,  /* tcp_v{4|6}_err() could not call
 				    * tcp_v{4|6}_mtu_reduced()
 				    */
+	TSQ_PACED,		   /* queued on a pacing wheel */
 };
 
 enum tsq_flags {
@@ -419,6 +423,7 @@ enum tsq_flags {
 	TCPF_WRITE_TIMER_DEFERRED	= (1UL << TCP_WRITE_TIMER_DEFERRED),
 	TCPF_DELACK_TIMER_DEFERRED	= (1UL << TCP_DELACK_TIMER_DEFERRED),
 	TCPF_MTU_REDUCED_DEFERRED	= (1UL << TCP_MTU_REDUCED_DEFERRED),
+	TSQF_PACED			= (1UL << TSQ_PACED),
 };
 
 static inline struct tcp_sock *tcp_sk(const struct sock *sk)
@@ -8,10 +8,14 @@
 #include <linux/refcount.h>
 #include <net/sock.h>
 
+struct scm_fp_list;
+
 void unix_inflight(struct user_struct *user, struct file *fp);
 void unix_notinflight(struct user_struct *user, struct file *fp);
 void unix_gc(void);
-void wait_for_unix_gc(void);
+void wait_for_unix_gc(struct scm_fp_list *fpl);
+void unix_gc_track(struct sock *sk);
+void unix_gc_track_receiver(struct sock *sk, struct scm_fp_list *fpl);
 struct sock *unix_get_socket(struct file *filp);
 struct sock *unix_peer_get(struct sock *);
 
@@ -62,8 +66,10 @@ struct unix_sock {
 	unsigned long		gc_flags;
 #define UNIX_GC_CANDIDATE	0
 #define UNIX_GC_MAYBE_CYCLE	1
+#define UNIX_GC_TRACKED		2
 	struct socket_wq	peer_wq;
 	wait_queue_entry_t		peer_wake;
+	struct sk_buff_head	recycle;
 };
 
 static inline struct unix_sock *unix_sk(const struct sock *sk)
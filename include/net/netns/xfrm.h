@@ -9,6 +9,7 @@
 #include <net/dst_ops.h>
 
 struct ctl_table_header;
+struct xfrm_input_cache;
 
 struct xfrm_policy_hash {
 	struct hlist_head	__rcu *table;
@@ -44,6 +45,11 @@ struct netns_xfrm {
 	unsigned int		state_hmask;
 	unsigned int		state_num;
 	struct work_struct	state_hash_work;
+	/* Per-CPU cache of SAs found by SPI on input, valid for as long as
+	 * input_cache_genid is unchanged.
+	 */
+	struct xfrm_input_cache	__percpu *input_cache;
+	atomic_t		input_cache_genid;
 
 	struct list_head	policy_all;
 	struct hlist_head	*policy_byidx;
@@ -62,6 +68,7 @@ struct netns_xfrm {
 	u32			sysctl_aevent_rseqth;
 	int			sysctl_larval_drop;
 	u32			sysctl_acq_expires;
+	int			sysctl_pcrypt;
 #ifdef CONFIG_SYSCTL
 	struct ctl_table_header	*sysctl_hdr;
 #endif
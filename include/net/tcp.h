@@ -603,6 +603,7 @@ void tcp_send_loss_probe(struct sock *sk);
 bool tcp_schedule_loss_probe(struct sock *sk, bool advancing_rto);
 void tcp_skb_collapse_tstamp(struct sk_buff *skb,
 			     const struct sk_buff *next_skb);
+void tcp_pacing_cancel(struct sock *sk);
 
 /* tcp_input.c */
 void tcp_rearm_rto(struct sock *sk);
@@ -615,8 +616,7 @@ void tcp_fin(struct sock *sk);
 void tcp_init_xmit_timers(struct sock *);
 static inline void tcp_clear_xmit_timers(struct sock *sk)
 {
-	if (hrtimer_try_to_cancel(&tcp_sk(sk)->pacing_timer) == 1)
-		__sock_put(sk);
+	tcp_pacing_cancel(sk);
 
 	if (hrtimer_try_to_cancel(&tcp_sk(sk)->compressed_ack_timer) == 1)
 		__sock_put(sk);
@@ -2065,8 +2065,6 @@ static inline void tcp_listendrop(const struct sock *sk)
 	__NET_INC_STATS(sock_net(sk), LINUX_MIB_LISTENDROPS);
 }
 
-enum hrtimer_restart tcp_pace_kick(struct hrtimer *timer);
-
 /*
  * Interface for adding Upper Level Protocols over TCP
  */
@@ -56,6 +56,8 @@
 #define TLS_RECORD_TYPE_DATA		0x17
 
 #define TLS_AAD_SPACE_SIZE		13
+#define TLS_1_3_AAD_SPACE_SIZE		TLS_HEADER_SIZE
+#define TLS_1_3_TAIL_SIZE		1
 #define TLS_DEVICE_NAME_MAX		32
 
 /*
@@ -98,10 +100,12 @@ struct tls_sw_context_tx {
 	struct crypto_wait async_wait;
 
 	char aad_space[TLS_AAD_SPACE_SIZE];
+	char content_type;
 
 	unsigned int sg_plaintext_size;
 	int sg_plaintext_num_elem;
-	struct scatterlist sg_plaintext_data[MAX_SKB_FRAGS];
+	/* One spare entry for the TLS 1.3 inner content type */
+	struct scatterlist sg_plaintext_data[MAX_SKB_FRAGS + 1];
 
 	unsigned int sg_encrypted_size;
 	int sg_encrypted_num_elem;
@@ -124,6 +128,9 @@ struct tls_sw_context_rx {
 	struct sk_buff *recv_pkt;
 	u8 control;
 	bool decrypted;
+	bool async_capable;
+	/* Records in async decryption, plus one held by the reader */
+	atomic_t decrypt_pending;
 };
 
 struct tls_record_info {
@@ -170,6 +177,9 @@ struct cipher_context {
 	u16 tag_size;
 	u16 overhead_size;
 	u16 iv_size;
+	u16 salt_size;
+	u16 aad_size;
+	u16 tail_size;
 	char *iv;
 	u16 rec_seq_size;
 	char *rec_seq;
@@ -178,6 +188,8 @@ struct cipher_context {
 union tls_crypto_context {
 	struct tls_crypto_info info;
 	struct tls12_crypto_info_aes_gcm_128 aes_gcm_128;
+	struct tls12_crypto_info_aes_gcm_256 aes_gcm_256;
+	struct tls12_crypto_info_chacha20_poly1305 chacha20_poly1305;
 };
 
 struct tls_context {
@@ -349,13 +361,36 @@ static inline bool tls_bigint_increment(unsigned char *seq, int len)
 	return (i == -1);
 }
 
+/* Size of the explicit nonce carried after the record header */
+static inline u16 tls_nonce_size(const struct cipher_context *ctx)
+{
+	return ctx->prepend_size - TLS_HEADER_SIZE;
+}
+
 static inline void tls_advance_record_sn(struct sock *sk,
 					 struct cipher_context *ctx)
 {
 	if (tls_bigint_increment(ctx->rec_seq, ctx->rec_seq_size))
 		tls_err_abort(sk, EBADMSG);
-	tls_bigint_increment(ctx->iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
-			     ctx->iv_size);
+
+	/* Implicit nonces are derived from the record sequence number */
+	if (tls_nonce_size(ctx))
+		tls_bigint_increment(ctx->iv + ctx->salt_size, ctx->iv_size);
+}
+
+/* Build the per-record nonce for ciphers without an explicit nonce
+ * (TLS 1.3 and ChaCha20-Poly1305): the static IV XORed with the record
+ * sequence number, left padded to the IV length.
+ */
+static inline void tls_xor_iv_with_seq(const struct cipher_context *ctx,
+				       char *iv)
+{
+	int iv_len = ctx->salt_size + ctx->iv_size;
+	int i;
+
+	memcpy(iv, ctx->iv, iv_len);
+	for (i = 0; i < ctx->rec_seq_size; i++)
+		iv[iv_len - ctx->rec_seq_size + i] ^= ctx->rec_seq[i];
 }
 
 static inline void tls_fill_prepend(struct tls_context *ctx,
@@ -363,21 +398,32 @@ static inline void tls_fill_prepend(struct tls_context *ctx,
 			     size_t plaintext_len,
 			     unsigned char record_type)
 {
-	size_t pkt_len, iv_size = ctx->tx.iv_size;
+	size_t pkt_len, nonce_size = tls_nonce_size(&ctx->tx);
 
-	pkt_len = plaintext_len + iv_size + ctx->tx.tag_size;
+	pkt_len = plaintext_len + nonce_size + ctx->tx.tag_size +
+		  ctx->tx.tail_size;
 
 	/* we cover nonce explicit here as well, so buf should be of
 	 * size KTLS_DTLS_HEADER_SIZE + KTLS_DTLS_NONCE_EXPLICIT_SIZE
 	 */
-	buf[0] = record_type;
-	buf[1] = TLS_VERSION_MINOR(ctx->crypto_send.info.version);
-	buf[2] = TLS_VERSION_MAJOR(ctx->crypto_send.info.version);
+	if (ctx->crypto_send.info.version == TLS_1_3_VERSION) {
+		/* The real record type is encrypted with the payload and
+		 * the legacy record version is always TLS 1.2
+		 */
+		buf[0] = TLS_RECORD_TYPE_DATA;
+		buf[1] = TLS_1_2_VERSION_MAJOR;
+		buf[2] = TLS_1_2_VERSION_MINOR;
+	} else {
+		buf[0] = record_type;
+		buf[1] = TLS_VERSION_MINOR(ctx->crypto_send.info.version);
+		buf[2] = TLS_VERSION_MAJOR(ctx->crypto_send.info.version);
+	}
 	/* we can use IV for nonce explicit according to spec */
 	buf[3] = pkt_len >> 8;
 	buf[4] = pkt_len & 0xFF;
-	memcpy(buf + TLS_NONCE_OFFSET,
-	       ctx->tx.iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE, iv_size);
+	if (nonce_size)
+		memcpy(buf + TLS_NONCE_OFFSET,
+		       ctx->tx.iv + ctx->tx.salt_size, nonce_size);
 }
 
 static inline void tls_make_aad(char *buf,
@@ -395,6 +441,18 @@ static inline void tls_make_aad(char *buf,
 	buf[12] = size & 0xFF;
 }
 
+/* TLS 1.3 authenticates the record header, whose length covers the
+ * encrypted inner content type and the tag.
+ */
+static inline void tls13_make_aad(char *buf, size_t size)
+{
+	buf[0] = TLS_RECORD_TYPE_DATA;
+	buf[1] = TLS_1_2_VERSION_MAJOR;
+	buf[2] = TLS_1_2_VERSION_MINOR;
+	buf[3] = size >> 8;
+	buf[4] = size & 0xFF;
+}
+
 static inline struct tls_context *tls_get_ctx(const struct sock *sk)
 {
 	struct inet_connection_sock *icsk = inet_csk(sk);
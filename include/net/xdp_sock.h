@@ -21,6 +21,13 @@ struct xdp_umem_props {
 	u64 size;
 };
 
+/* Flags for the umem flags field */
+#define XDP_UMEM_USES_NEED_WAKEUP (1 << 0)
+
+/* Rings for which the umem has set XDP_RING_NEED_WAKEUP */
+#define XDP_WAKEUP_RX (1 << 0)
+#define XDP_WAKEUP_TX (1 << 1)
+
 struct xdp_umem_page {
 	void *addr;
 	dma_addr_t dma;
@@ -41,9 +48,23 @@ struct xdp_umem {
 	u32 npgs;
 	struct net_device *dev;
 	u16 queue_id;
+	u8 flags;
+	u8 need_wakeup;
 	bool zc;
 	spinlock_t xsk_list_lock;
 	struct list_head xsk_list;
+	/* The fill and completion queues are shared by all sockets bound
+	 * to the umem. In copy mode fq_lock serializes receive and cq_lock
+	 * serializes completion queue reservations against the SKB
+	 * destructor callback.
+	 */
+	spinlock_t fq_lock;
+	spinlock_t cq_lock;
+	/* Number of sendmsg() batches in progress, under cq_lock. Their
+	 * completions are published to user space once, when the last
+	 * batch ends.
+	 */
+	u32 cq_batches;
 };
 
 struct xdp_sock {
@@ -59,10 +80,6 @@ struct xdp_sock {
 	bool zc;
 	/* Protects multiple processes in the control path */
 	struct mutex mutex;
-	/* Mutual exclusion of NAPI TX thread and sendmsg error paths
-	 * in the SKB destructor callback.
-	 */
-	spinlock_t tx_completion_lock;
 	u64 rx_dropped;
 };
 
@@ -78,6 +95,15 @@ void xsk_umem_discard_addr(struct xdp_umem *umem);
 void xsk_umem_complete_tx(struct xdp_umem *umem, u32 nb_entries);
 bool xsk_umem_consume_tx(struct xdp_umem *umem, dma_addr_t *dma, u32 *len);
 void xsk_umem_consume_tx_done(struct xdp_umem *umem);
+void xsk_set_rx_need_wakeup(struct xdp_umem *umem);
+void xsk_set_tx_need_wakeup(struct xdp_umem *umem);
+void xsk_clear_rx_need_wakeup(struct xdp_umem *umem);
+void xsk_clear_tx_need_wakeup(struct xdp_umem *umem);
+
+static inline bool xsk_umem_uses_need_wakeup(struct xdp_umem *umem)
+{
+	return umem->flags & XDP_UMEM_USES_NEED_WAKEUP;
+}
 #else
 static inline int xsk_generic_rcv(struct xdp_sock *xs, struct xdp_buff *xdp)
 {
@@ -97,6 +123,27 @@ static inline bool xsk_is_setup_for_bpf_map(struct xdp_sock *xs)
 {
 	return false;
 }
+
+static inline void xsk_set_rx_need_wakeup(struct xdp_umem *umem)
+{
+}
+
+static inline void xsk_set_tx_need_wakeup(struct xdp_umem *umem)
+{
+}
+
+static inline void xsk_clear_rx_need_wakeup(struct xdp_umem *umem)
+{
+}
+
+static inline void xsk_clear_tx_need_wakeup(struct xdp_umem *umem)
+{
+}
+
+static inline bool xsk_umem_uses_need_wakeup(struct xdp_umem *umem)
+{
+	return false;
+}
 #endif /* CONFIG_XDP_SOCKETS */
 
 #endif /* _LINUX_XDP_SOCK_H */
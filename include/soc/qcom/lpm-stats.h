@@ -41,6 +41,7 @@ void lpm_stats_cluster_exit(struct lpm_stats *stats, uint32_t index,
 				bool success);
 void lpm_stats_cpu_enter(uint32_t index, uint64_t time);
 void lpm_stats_cpu_exit(uint32_t index, uint64_t time, bool success);
+void lpm_stats_cpu_premature(uint32_t index);
 void lpm_stats_suspend_enter(void);
 void lpm_stats_suspend_exit(void);
 #else
@@ -66,6 +67,9 @@ static inline void lpm_stats_cpu_exit(uint32_t index, bool success,
 							uint64_t time)
 { }
 
+static inline void lpm_stats_cpu_premature(uint32_t index)
+{ }
+
 static inline void lpm_stats_suspend_enter(void)
 { }
 
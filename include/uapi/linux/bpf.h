@@ -103,6 +103,11 @@ enum bpf_cmd {
 	BPF_BTF_LOAD,
 	BPF_BTF_GET_FD_BY_ID,
 	BPF_TASK_FD_QUERY,
+	/* 21..23 are taken by mainline commands this tree does not have */
+	BPF_MAP_LOOKUP_BATCH = 24,
+	BPF_MAP_LOOKUP_AND_DELETE_BATCH,
+	BPF_MAP_UPDATE_BATCH,
+	BPF_MAP_DELETE_BATCH,
 };
 
 enum bpf_map_type {
@@ -127,6 +132,8 @@ enum bpf_map_type {
 	BPF_MAP_TYPE_SOCKHASH,
 	BPF_MAP_TYPE_CGROUP_STORAGE,
 	BPF_MAP_TYPE_REUSEPORT_SOCKARRAY,
+	/* 21..26 are taken by mainline map types this tree does not have */
+	BPF_MAP_TYPE_RINGBUF = 27,
 };
 
 enum bpf_prog_type {
@@ -314,6 +321,23 @@ union bpf_attr {
 		__u64		flags;
 	};
 
+	struct { /* struct used by BPF_MAP_*_BATCH commands */
+		__aligned_u64	in_batch;	/* start batch,
+						 * NULL to start from beginning
+						 */
+		__aligned_u64	out_batch;	/* output: next start batch */
+		__aligned_u64	keys;
+		__aligned_u64	values;
+		__u32		count;		/* input/output:
+						 * input: # of key/value
+						 * elements
+						 * output: # of filled elements
+						 */
+		__u32		map_fd;
+		__u64		elem_flags;
+		__u64		flags;
+	} batch;
+
 	struct { /* anonymous struct used by BPF_PROG_LOAD command */
 		__u32		prog_type;	/* one of enum bpf_prog_type */
 		__u32		insn_cnt;
@@ -2143,8 +2167,43 @@ union bpf_attr {
  *		request in the skb.
  *	Return
  *		0 on success, or a negative error in case of failure.
+ *
+ * int bpf_ringbuf_output(void *ringbuf, void *data, u64 size, u64 flags)
+ *	Description
+ *		Copy *size* bytes from *data* into a record of the ring buffer
+ *		*ringbuf*, a map of type **BPF_MAP_TYPE_RINGBUF**, and make it
+ *		visible to the consumer.  Unlike the per-CPU buffers of
+ *		**bpf_perf_event_output**\ (), a ring buffer is shared by all
+ *		CPUs and keeps the records in commit order.
+ *
+ *		If **BPF_RB_NO_WAKEUP** is specified in *flags*, no notification
+ *		of new data availability is sent.
+ *		If **BPF_RB_FORCE_WAKEUP** is specified in *flags*, notification
+ *		of new data availability is sent unconditionally.
+ *		Otherwise the consumer is only woken up if it has consumed
+ *		everything up to this record, so it may be sleeping.
+ *	Return
+ *		0 on success, **-EAGAIN** if the ring buffer has no room left,
+ *		or another negative error in case of failure.
+ *
+ * u64 bpf_ringbuf_query(void *ringbuf, u64 flags)
+ *	Description
+ *		Query various characteristics of provided ring buffer. What
+ *		exactly is queried is determined by *flags*:
+ *
+ *		* **BPF_RB_AVAIL_DATA**: Amount of data not yet consumed.
+ *		* **BPF_RB_RING_SIZE**: The size of ring buffer.
+ *		* **BPF_RB_CONS_POS**: Consumer position (can wrap around).
+ *		* **BPF_RB_PROD_POS**: Producer(s) position (can wrap around).
+ *
+ *		Data returned is just a momentary snapshot of actual values
+ *		and could be inaccurate, so this facility should be used to
+ *		power heuristics and for reporting, not to make 100% correct
+ *		calculation.
+ *	Return
+ *		Requested value, or 0, if *flags* are not recognized.
  */
-#define __BPF_FUNC_MAPPER(FN)		\
+#define __BPF_FUNC_MAPPER_BASE(FN)	\
 	FN(unspec),			\
 	FN(map_lookup_elem),		\
 	FN(map_update_elem),		\
@@ -2230,12 +2289,22 @@ union bpf_attr {
 	FN(sk_select_reuseport),	\
 	FN(skb_ancestor_cgroup_id),
 
+/* The ring buffer helpers keep the IDs they have in mainline, see below */
+#define __BPF_FUNC_MAPPER(FN)		\
+	__BPF_FUNC_MAPPER_BASE(FN)	\
+	FN(ringbuf_output),		\
+	FN(ringbuf_query),
+
 /* integer value in 'imm' field of BPF_CALL instruction selects which helper
  * function eBPF program intends to call
  */
 #define __BPF_ENUM_FN(x) BPF_FUNC_ ## x
 enum bpf_func_id {
-	__BPF_FUNC_MAPPER(__BPF_ENUM_FN)
+	__BPF_FUNC_MAPPER_BASE(__BPF_ENUM_FN)
+	/* 84..129 are taken by mainline helpers this tree does not have */
+	BPF_FUNC_ringbuf_output = 130,
+	/* 131..133 are mainline's ringbuf_reserve, _submit and _discard */
+	BPF_FUNC_ringbuf_query = 134,
 	__BPF_FUNC_MAX_ID,
 };
 #undef __BPF_ENUM_FN
@@ -2284,6 +2353,22 @@ enum bpf_func_id {
 /* BPF_FUNC_perf_event_output for sk_buff input context. */
 #define BPF_F_CTXLEN_MASK		(0xfffffULL << 32)
 
+/* BPF_FUNC_ringbuf_output flags. */
+#define BPF_RB_NO_WAKEUP		(1ULL << 0)
+#define BPF_RB_FORCE_WAKEUP		(1ULL << 1)
+
+/* BPF_FUNC_ringbuf_query flags. */
+enum {
+	BPF_RB_AVAIL_DATA = 0,
+	BPF_RB_RING_SIZE = 1,
+	BPF_RB_CONS_POS = 2,
+	BPF_RB_PROD_POS = 3,
+};
+
+/* BPF ring buffer record header, see kernel/bpf/ringbuf.c. */
+#define BPF_RINGBUF_BUSY_BIT		(1U << 31)
+#define BPF_RINGBUF_HDR_SZ		8
+
 /* Mode for BPF_FUNC_skb_adjust_room helper. */
 enum bpf_adj_room_mode {
 	BPF_ADJ_ROOM_NET,
@@ -21,6 +21,8 @@
 #define FUTEX_WAKE_BITSET	10
 #define FUTEX_WAIT_REQUEUE_PI	11
 #define FUTEX_CMP_REQUEUE_PI	12
+/* The op number of the out-of-tree wait multiple ABI, clear of mainline */
+#define FUTEX_WAIT_MULTIPLE	31
 
 #define FUTEX_PRIVATE_FLAG	128
 #define FUTEX_CLOCK_REALTIME	256
@@ -40,6 +42,27 @@
 					 FUTEX_PRIVATE_FLAG)
 #define FUTEX_CMP_REQUEUE_PI_PRIVATE	(FUTEX_CMP_REQUEUE_PI | \
 					 FUTEX_PRIVATE_FLAG)
+#define FUTEX_WAIT_MULTIPLE_PRIVATE	(FUTEX_WAIT_MULTIPLE | \
+					 FUTEX_PRIVATE_FLAG)
+
+/*
+ * FUTEX_WAIT_MULTIPLE: uaddr points to an array of 'val' of these, at most
+ * FUTEX_MULTIPLE_MAX_COUNT.  The caller sleeps until any of the futexes is
+ * woken, or returns -EWOULDBLOCK right away if any of them does not contain
+ * its expected value.  On wakeup the index of the woken futex is returned.
+ * The timeout is relative, as for FUTEX_WAIT.
+ *
+ * Each futex is waited on with its bitset as for FUTEX_WAIT_BITSET, so
+ * FUTEX_BITSET_MATCH_ANY is woken by every wake; a zero bitset is invalid.
+ * Whether the futexes are private is set by FUTEX_PRIVATE_FLAG in the op.
+ */
+struct futex_wait_block {
+	__u64 uaddr;
+	__u32 val;
+	__u32 bitset;
+};
+
+#define FUTEX_MULTIPLE_MAX_COUNT	128
 
 /*
  * Support for robust futexes: the kernel cleans up held futexes at
@@ -59,6 +59,9 @@
 #define TUNGETVNETBE _IOR('T', 223, int)
 #define TUNSETSTEERINGEBPF _IOR('T', 224, int)
 #define TUNSETFILTEREBPF _IOR('T', 225, int)
+/* Batched packet I/O, see struct tun_mmsg */
+#define TUNSENDMMSG _IOW('T', 240, struct tun_mmsg)
+#define TUNRECVMMSG _IOW('T', 241, struct tun_mmsg)
 
 /* TUNSETIFF ifr flags */
 #define IFF_TUN		0x0001
@@ -86,6 +89,8 @@
 #define TUN_F_TSO6	0x04	/* I can handle TSO for IPv6 packets */
 #define TUN_F_TSO_ECN	0x08	/* I can handle TSO with ECN bits. */
 #define TUN_F_UFO	0x10	/* I can handle UFO packets */
+#define TUN_F_USO4	0x20	/* I can handle USO for IPv4 packets */
+#define TUN_F_USO6	0x40	/* I can handle USO for IPv6 packets */
 
 // ------------- START of KNOX_VPN ------------------//
 #define TUN_META_HDR	0x0020
@@ -96,6 +101,24 @@
 #define DEFAULT_IHL 5
 // ------------- END of KNOX_VPN -------------------//
 
+/* One packet of a TUNSENDMMSG/TUNRECVMMSG batch. Each buffer holds a
+ * single packet in the format of a write()/read() on the device. On
+ * return len is the number of bytes transferred for it. reserved must be
+ * zero. At most UIO_MAXIOV packets are handled per call.
+ */
+struct tun_packet {
+	__u64	buf;
+	__u32	len;
+	__u32	reserved;
+};
+
+#define TUN_MMSG_DONTWAIT	0x0001	/* Don't block for the first packet */
+struct tun_mmsg {
+	__u64	packets;	/* struct tun_packet array */
+	__u32	count;
+	__u32	flags;		/* TUN_MMSG_* */
+};
+
 /* Protocol info prepended to the packets (when IFF_NO_PI is not set) */
 #define TUN_PKT_STRIP	0x0001
 struct tun_pi {
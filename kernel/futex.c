@@ -2778,6 +2778,239 @@ static long futex_wait_restart(struct restart_block *restart)
 				restart->futex.val, tp, restart->futex.bitset);
 }
 
+/*
+ * One entry of a FUTEX_WAIT_MULTIPLE wait: the user's futex_wait_block and
+ * the futex_q that is queued for it.
+ */
+struct futex_vector {
+	struct futex_wait_block w;
+	unsigned int flags;
+	struct futex_q q;
+};
+
+/**
+ * futex_unqueue_multiple() - Remove several futexes from their hash buckets
+ * @vs:		the futexes to unqueue
+ * @count:	number of futexes in @vs
+ *
+ * Must be called with all of @vs queued, and drops their q.key references.
+ *
+ * Return:
+ *  - >=0 - index of the first futex that was already woken
+ *  -  -1 - none of the futexes had been woken
+ */
+static int futex_unqueue_multiple(struct futex_vector *vs, int count)
+{
+	int ret = -1, i;
+
+	for (i = 0; i < count; i++) {
+		if (!unqueue_me(&vs[i].q) && ret < 0)
+			ret = i;
+	}
+	return ret;
+}
+
+/**
+ * futex_wait_multiple_setup() - Prepare to wait on several futexes
+ * @vs:		the futexes to wait on
+ * @count:	number of futexes in @vs
+ * @woken:	index of a futex that was woken while the others were queued
+ *
+ * Queue the task on every futex of @vs, checking the value of each one with
+ * its hash bucket locked as futex_wait_setup() does.  The task state is set
+ * to TASK_INTERRUPTIBLE before the first futex is queued, so that a wakeup
+ * of an early futex while later ones are being queued is not lost.  Only
+ * one hash bucket lock is held at a time.
+ *
+ * Return:
+ *  -  0 - all futexes are queued and the task state is TASK_INTERRUPTIBLE;
+ *  -  1 - a futex was woken during the setup, its index is in @woken and
+ *	   nothing is queued;
+ *  - <0 - -EFAULT or -EWOULDBLOCK (a futex does not contain its value) and
+ *	   nothing is queued
+ */
+static int futex_wait_multiple_setup(struct futex_vector *vs, int count,
+				     int *woken)
+{
+	struct futex_hash_bucket *hb;
+	u32 __user *uaddr;
+	int ret, i, j;
+	u32 uval;
+
+retry:
+	for (i = 0; i < count; i++) {
+		uaddr = u64_to_user_ptr(vs[i].w.uaddr);
+		ret = get_futex_key(uaddr, vs[i].flags & FLAGS_SHARED,
+				    &vs[i].q.key, VERIFY_READ);
+		if (unlikely(ret)) {
+			while (--i >= 0)
+				put_futex_key(&vs[i].q.key);
+			return ret;
+		}
+	}
+
+	set_current_state(TASK_INTERRUPTIBLE);
+
+	for (i = 0; i < count; i++) {
+		uaddr = u64_to_user_ptr(vs[i].w.uaddr);
+
+		hb = queue_lock(&vs[i].q);
+		ret = get_futex_value_locked(&uval, uaddr);
+		if (!ret && uval == vs[i].w.val) {
+			queue_me(&vs[i].q, hb);
+			continue;
+		}
+		queue_unlock(hb);
+		__set_current_state(TASK_RUNNING);
+
+		/*
+		 * Back out: the futexes queued so far may already have been
+		 * woken, in which case report that instead of the mismatch.
+		 */
+		*woken = futex_unqueue_multiple(vs, i);
+		for (j = i; j < count; j++)
+			put_futex_key(&vs[j].q.key);
+		if (*woken >= 0)
+			return 1;
+
+		if (ret) {
+			if (get_user(uval, uaddr))
+				return -EFAULT;
+			goto retry;
+		}
+		return -EWOULDBLOCK;
+	}
+
+	return 0;
+}
+
+static long futex_wait_multiple_restart(struct restart_block *restart);
+
+/**
+ * futex_wait_multiple() - Wait until any of several futexes is woken
+ * @uaddr:	user address of the futex_wait_block array
+ * @flags:	futex flags (FLAGS_SHARED, etc.)
+ * @count:	number of entries in the array
+ * @abs_time:	absolute CLOCK_MONOTONIC timeout, or NULL
+ *
+ * Return: the index of the woken futex, or a negative error code.
+ */
+static int futex_wait_multiple(u32 __user *uaddr, unsigned int flags,
+			       u32 count, ktime_t *abs_time)
+{
+	struct hrtimer_sleeper timeout, *to = NULL;
+	struct restart_block *restart;
+	struct futex_vector *vs;
+	int ret, woken, i;
+
+	if (!count || count > FUTEX_MULTIPLE_MAX_COUNT)
+		return -EINVAL;
+
+	vs = kmalloc_array(count, sizeof(*vs), GFP_KERNEL);
+	if (!vs)
+		return -ENOMEM;
+
+	for (i = 0; i < count; i++) {
+		if (copy_from_user(&vs[i].w, (void __user *)uaddr +
+				   i * sizeof(struct futex_wait_block),
+				   sizeof(struct futex_wait_block))) {
+			ret = -EFAULT;
+			goto out_free;
+		}
+		if (!vs[i].w.bitset) {
+			ret = -EINVAL;
+			goto out_free;
+		}
+
+		vs[i].flags = flags;
+		vs[i].q = futex_q_init;
+		vs[i].q.bitset = vs[i].w.bitset;
+	}
+
+	if (abs_time) {
+		to = &timeout;
+
+		hrtimer_init_on_stack(&to->timer, CLOCK_MONOTONIC,
+				      HRTIMER_MODE_ABS);
+		hrtimer_init_sleeper(to, current);
+		hrtimer_set_expires_range_ns(&to->timer, *abs_time,
+					     current->timer_slack_ns);
+	}
+
+retry:
+	ret = futex_wait_multiple_setup(vs, count, &woken);
+	if (ret) {
+		if (ret > 0)
+			ret = woken;
+		goto out;
+	}
+
+	if (to)
+		hrtimer_start_expires(&to->timer, HRTIMER_MODE_ABS);
+
+	/*
+	 * A wakeup of any of the futexes sets the task running again, so
+	 * there is no need to check the futex_q's before scheduling.  As in
+	 * futex_wait_queue_me(), don't bother if the timer already expired.
+	 */
+	if (!to || to->task)
+		freezable_schedule();
+	__set_current_state(TASK_RUNNING);
+
+	/* futex_unqueue_multiple() drops the q.key refs */
+	ret = futex_unqueue_multiple(vs, count);
+	if (ret >= 0)
+		goto out;
+
+	ret = -ETIMEDOUT;
+	if (to && !to->task)
+		goto out;
+
+	/*
+	 * We expect signal_pending(current), but we might be the
+	 * victim of a spurious wakeup as well.
+	 */
+	if (!signal_pending(current))
+		goto retry;
+
+	ret = -ERESTARTSYS;
+	if (!abs_time)
+		goto out;
+
+	restart = &current->restart_block;
+	restart->fn = futex_wait_multiple_restart;
+	restart->futex.uaddr = uaddr;
+	restart->futex.val = count;
+	restart->futex.time = *abs_time;
+	restart->futex.flags = flags | FLAGS_HAS_TIMEOUT;
+
+	ret = -ERESTART_RESTARTBLOCK;
+
+out:
+	if (to) {
+		hrtimer_cancel(&to->timer);
+		destroy_hrtimer_on_stack(&to->timer);
+	}
+out_free:
+	kfree(vs);
+	return ret;
+}
+
+static long futex_wait_multiple_restart(struct restart_block *restart)
+{
+	u32 __user *uaddr = restart->futex.uaddr;
+	ktime_t t, *tp = NULL;
+
+	if (restart->futex.flags & FLAGS_HAS_TIMEOUT) {
+		t = restart->futex.time;
+		tp = &t;
+	}
+	restart->fn = do_no_restart_syscall;
+
+	return (long)futex_wait_multiple(uaddr, restart->futex.flags,
+					 restart->futex.val, tp);
+}
+
 
 /*
  * Userspace tried a 0 -> TID atomic transition of the futex value
@@ -3713,6 +3946,8 @@ long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 					     uaddr2);
 	case FUTEX_CMP_REQUEUE_PI:
 		return futex_requeue(uaddr, flags, uaddr2, val, val2, &val3, 1);
+	case FUTEX_WAIT_MULTIPLE:
+		return futex_wait_multiple(uaddr, flags, val, timeout);
 	}
 	return -ENOSYS;
 }
@@ -3729,7 +3964,8 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 
 	if (utime && (cmd == FUTEX_WAIT || cmd == FUTEX_LOCK_PI ||
 		      cmd == FUTEX_WAIT_BITSET ||
-		      cmd == FUTEX_WAIT_REQUEUE_PI)) {
+		      cmd == FUTEX_WAIT_REQUEUE_PI ||
+		      cmd == FUTEX_WAIT_MULTIPLE)) {
 		if (unlikely(should_fail_futex(!(op & FUTEX_PRIVATE_FLAG))))
 			return -EFAULT;
 		if (copy_from_user(&ts, utime, sizeof(ts)) != 0)
@@ -3738,7 +3974,7 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 			return -EINVAL;
 
 		t = timespec_to_ktime(ts);
-		if (cmd == FUTEX_WAIT)
+		if (cmd == FUTEX_WAIT || cmd == FUTEX_WAIT_MULTIPLE)
 			t = ktime_add_safe(ktime_get(), t);
 		tp = &t;
 	}
@@ -3921,14 +4157,15 @@ COMPAT_SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 
 	if (utime && (cmd == FUTEX_WAIT || cmd == FUTEX_LOCK_PI ||
 		      cmd == FUTEX_WAIT_BITSET ||
-		      cmd == FUTEX_WAIT_REQUEUE_PI)) {
+		      cmd == FUTEX_WAIT_REQUEUE_PI ||
+		      cmd == FUTEX_WAIT_MULTIPLE)) {
 		if (compat_get_timespec(&ts, utime))
 			return -EFAULT;
 		if (!timespec_valid(&ts))
 			return -EINVAL;
 
 		t = timespec_to_ktime(ts);
-		if (cmd == FUTEX_WAIT)
+		if (cmd == FUTEX_WAIT || cmd == FUTEX_WAIT_MULTIPLE)
 			t = ktime_add_safe(ktime_get(), t);
 		tp = &t;
 	}
@@ -0,0 +1,378 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Per call site lock contention histograms.
+ *
+ * Aggregates the contention_begin/contention_end tracepoints into a table
+ * keyed by the caller of the lock function, so contended locks can be found
+ * on production kernels that do not run LOCKDEP or LOCK_STAT.
+ *
+ * Collection is off by default and enabled through debugfs:
+ *
+ *	echo 1 > /sys/kernel/debug/lock_contention/enable
+ *	cat /sys/kernel/debug/lock_contention/sites
+ *	echo > /sys/kernel/debug/lock_contention/sites		(reset)
+ *
+ * The probes run inside the lock slowpaths, including the qspinlock one,
+ * so they must not take locks or allocate: the site table is allocated up
+ * front and claimed with cmpxchg, and all counters are atomic.
+ */
+
+#define pr_fmt(fmt) "lock_contention: " fmt
+
+#include <linux/atomic.h>
+#include <linux/debugfs.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/log2.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/sched/clock.h>
+#include <linux/sched/debug.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/stacktrace.h>
+#include <linux/tracepoint.h>
+#include <linux/vmalloc.h>
+
+#include <trace/events/lock.h>
+
+#define LC_SITES_BITS		10
+#define LC_SITES		(1 << LC_SITES_BITS)
+#define LC_PROBE_MAX		16		/* linear probe limit */
+#define LC_BUCKETS		32		/* log2(ns) buckets, last is open */
+#define LC_STACK_DEPTH		16
+
+struct lc_site {
+	unsigned long		ip;		/* 0 while the slot is free */
+	unsigned int		flags;		/* LCB_F_* seen at this site */
+	atomic64_t		count;
+	atomic64_t		total_ns;
+	atomic64_t		max_ns;
+	atomic64_t		hist[LC_BUCKETS];
+};
+
+static struct lc_site *lc_sites;
+static atomic64_t lc_dropped;
+
+/*
+ * Bumped on every enable so that waits begun before the previous disable
+ * are not accounted against the new table.
+ */
+static unsigned int lc_gen;
+
+/* Waits from interrupt context: [0] softirq, [1] hardirq */
+static DEFINE_PER_CPU(struct lock_contention_wait, lc_irq_wait[2]);
+
+static DEFINE_MUTEX(lc_mutex);
+static bool lc_enabled;
+
+static struct lock_contention_wait *lc_wait_slot(void)
+{
+	if (in_nmi())
+		return NULL;
+	if (in_irq())
+		return this_cpu_ptr(&lc_irq_wait[1]);
+	if (in_serving_softirq())
+		return this_cpu_ptr(&lc_irq_wait[0]);
+	return &current->lock_wait;
+}
+
+/*
+ * Return the first return address outside the locking and scheduler text,
+ * i.e. the code that called mutex_lock(), down_read(), spin_lock()...
+ */
+static unsigned long lc_caller(void)
+{
+	unsigned long entries[LC_STACK_DEPTH];
+	struct stack_trace trace = {
+		.entries	= entries,
+		.max_entries	= LC_STACK_DEPTH,
+	};
+	bool seen = false;
+	unsigned int i;
+
+	save_stack_trace(&trace);
+
+	for (i = 0; i < trace.nr_entries; i++) {
+		if (entries[i] == ULONG_MAX)
+			break;
+		if (in_sched_functions(entries[i]))
+			seen = true;
+		else if (seen)
+			return entries[i];
+	}
+
+	/* Inlined lock functions leave no marker; fall back to the probe */
+	return _RET_IP_;
+}
+
+static struct lc_site *lc_site_get(unsigned long ip)
+{
+	unsigned int i, h = hash_long(ip, LC_SITES_BITS);
+	struct lc_site *site;
+	unsigned long old;
+
+	for (i = 0; i < LC_PROBE_MAX; i++) {
+		site = &lc_sites[(h + i) & (LC_SITES - 1)];
+		old = READ_ONCE(site->ip);
+		if (old == ip)
+			return site;
+		if (!old) {
+			old = cmpxchg(&site->ip, 0, ip);
+			if (!old || old == ip)
+				return site;
+		}
+	}
+	return NULL;
+}
+
+static void lc_account(struct lock_contention_wait *w, u64 ns)
+{
+	struct lc_site *site = lc_site_get(w->ip);
+	unsigned int b;
+	s64 max;
+
+	if (!site) {
+		atomic64_inc(&lc_dropped);
+		return;
+	}
+
+	if ((READ_ONCE(site->flags) & w->flags) != w->flags)
+		WRITE_ONCE(site->flags, site->flags | w->flags);
+
+	atomic64_inc(&site->count);
+	atomic64_add(ns, &site->total_ns);
+
+	max = atomic64_read(&site->max_ns);
+	while ((s64)ns > max) {
+		s64 old = atomic64_cmpxchg(&site->max_ns, max, ns);
+
+		if (old == max)
+			break;
+		max = old;
+	}
+
+	b = ns ? min_t(unsigned int, ilog2(ns), LC_BUCKETS - 1) : 0;
+	atomic64_inc(&site->hist[b]);
+}
+
+static void lc_probe_begin(void *data, void *lock, unsigned int flags)
+{
+	struct lock_contention_wait *w;
+	unsigned long irqflags;
+	unsigned int gen = READ_ONCE(lc_gen);
+
+	local_irq_save(irqflags);
+	w = lc_wait_slot();
+	if (!w)
+		goto out;
+
+	if (w->gen == gen && w->lock) {
+		/* Spinning gave up and the lock function is about to sleep */
+		if (w->lock == lock)
+			w->flags |= flags;
+		/* Otherwise nested inside a wait, e.g. the wait_lock: ignore */
+		goto out;
+	}
+
+	w->gen = gen;
+	w->lock = lock;
+	w->flags = flags;
+	w->ip = lc_caller();
+	w->start = local_clock();
+out:
+	local_irq_restore(irqflags);
+}
+
+static void lc_probe_end(void *data, void *lock, int ret)
+{
+	struct lock_contention_wait *w;
+	unsigned long irqflags;
+	u64 now = local_clock();
+
+	local_irq_save(irqflags);
+	w = lc_wait_slot();
+	if (w && w->lock == lock) {
+		if (w->gen == READ_ONCE(lc_gen))
+			lc_account(w, now > w->start ? now - w->start : 0);
+		w->lock = NULL;
+	}
+	local_irq_restore(irqflags);
+}
+
+static int lc_register(void)
+{
+	int ret;
+
+	WRITE_ONCE(lc_gen, lc_gen + 1);
+
+	ret = register_trace_contention_begin(lc_probe_begin, NULL);
+	if (ret)
+		return ret;
+	ret = register_trace_contention_end(lc_probe_end, NULL);
+	if (ret)
+		unregister_trace_contention_begin(lc_probe_begin, NULL);
+	return ret;
+}
+
+static void lc_unregister(void)
+{
+	unregister_trace_contention_end(lc_probe_end, NULL);
+	unregister_trace_contention_begin(lc_probe_begin, NULL);
+	tracepoint_synchronize_unregister();
+}
+
+static int lc_set_enabled(bool enable)
+{
+	int ret = 0;
+
+	mutex_lock(&lc_mutex);
+	if (enable && !lc_enabled)
+		ret = lc_register();
+	else if (!enable && lc_enabled)
+		lc_unregister();
+	if (!ret)
+		lc_enabled = enable;
+	mutex_unlock(&lc_mutex);
+
+	return ret;
+}
+
+static void lc_reset(void)
+{
+	mutex_lock(&lc_mutex);
+	if (lc_enabled)
+		lc_unregister();
+	memset(lc_sites, 0, LC_SITES * sizeof(*lc_sites));
+	atomic64_set(&lc_dropped, 0);
+	if (lc_enabled && lc_register())
+		lc_enabled = false;
+	mutex_unlock(&lc_mutex);
+}
+
+static int lc_enable_get(void *data, u64 *val)
+{
+	*val = READ_ONCE(lc_enabled);
+	return 0;
+}
+
+static int lc_enable_set(void *data, u64 val)
+{
+	return lc_set_enabled(!!val);
+}
+
+DEFINE_DEBUGFS_ATTRIBUTE(lc_enable_fops, lc_enable_get, lc_enable_set,
+			 "%llu\n");
+
+static void lc_show_flags(struct seq_file *m, unsigned int flags)
+{
+	const char *type;
+
+	if (flags & LCB_F_MUTEX)
+		type = "mutex";
+	else if (flags & LCB_F_RT)
+		type = "rtmutex";
+	else if (flags & LCB_F_READ)
+		type = "rwsem:R";
+	else if (flags & LCB_F_WRITE)
+		type = "rwsem:W";
+	else
+		type = "spinlock";
+
+	seq_printf(m, " %-9s%s", type,
+		   (flags & LCB_F_SPIN) && (flags & ~LCB_F_SPIN) ? "+spin" : "");
+}
+
+static void *lc_seq_start(struct seq_file *m, loff_t *pos)
+{
+	if (!*pos)
+		seq_printf(m, "# dropped %lld\n",
+			   (long long)atomic64_read(&lc_dropped));
+	return *pos < LC_SITES ? &lc_sites[*pos] : NULL;
+}
+
+static void *lc_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	++*pos;
+	return *pos < LC_SITES ? &lc_sites[*pos] : NULL;
+}
+
+static void lc_seq_stop(struct seq_file *m, void *v)
+{
+}
+
+static int lc_seq_show(struct seq_file *m, void *v)
+{
+	struct lc_site *site = v;
+	unsigned long ip = READ_ONCE(site->ip);
+	u64 count = atomic64_read(&site->count);
+	u64 total = atomic64_read(&site->total_ns);
+	unsigned int b;
+
+	if (!ip || !count)
+		return 0;
+
+	seq_printf(m, "%pS", (void *)ip);
+	lc_show_flags(m, READ_ONCE(site->flags));
+	seq_printf(m, " count %llu total_ns %llu avg_ns %llu max_ns %llu\n",
+		   count, total, div64_u64(total, count),
+		   (u64)atomic64_read(&site->max_ns));
+
+	for (b = 0; b < LC_BUCKETS; b++) {
+		u64 n = atomic64_read(&site->hist[b]);
+
+		if (n)
+			seq_printf(m, "  %12llu ns: %llu\n",
+				   b ? 1ULL << b : 0ULL, n);
+	}
+	return 0;
+}
+
+static const struct seq_operations lc_seq_ops = {
+	.start	= lc_seq_start,
+	.next	= lc_seq_next,
+	.stop	= lc_seq_stop,
+	.show	= lc_seq_show,
+};
+
+static int lc_sites_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &lc_seq_ops);
+}
+
+static ssize_t lc_sites_write(struct file *file, const char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	lc_reset();
+	return count;
+}
+
+static const struct file_operations lc_sites_fops = {
+	.open		= lc_sites_open,
+	.read		= seq_read,
+	.write		= lc_sites_write,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static int __init lock_contention_init(void)
+{
+	struct dentry *dir;
+
+	lc_sites = vzalloc(LC_SITES * sizeof(*lc_sites));
+	if (!lc_sites)
+		return -ENOMEM;
+
+	dir = debugfs_create_dir("lock_contention", NULL);
+	if (!dir) {
+		vfree(lc_sites);
+		return -ENOMEM;
+	}
+
+	debugfs_create_file("enable", 0600, dir, NULL, &lc_enable_fops);
+	debugfs_create_file("sites", 0600, dir, NULL, &lc_sites_fops);
+
+	return 0;
+}
+late_initcall(lock_contention_init);
@@ -40,6 +40,7 @@
 #include <linux/atomic.h>
 #include <linux/moduleparam.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
 #include <linux/slab.h>
 #include <linux/percpu-rwsem.h>
 #include <linux/torture.h>
@@ -78,6 +79,8 @@ static bool lock_is_read_held;
 struct lock_stress_stats {
 	long n_lock_fail;
 	long n_lock_acquired;
+	u64 wait_ns;		/* total time spent acquiring the lock */
+	u64 max_wait_ns;	/* longest single acquisition */
 };
 
 /* Forward reference. */
@@ -583,6 +586,50 @@ static struct lock_torture_ops rwsem_lock_ops = {
 	.name		= "rwsem_lock"
 };
 
+/*
+ * rwsem with short critical sections, as seen on a contended mmap_sem, so
+ * that the optimistic spinning and handoff paths are exercised rather than
+ * every waiter going to sleep.  Watch the wait times in the statistics.
+ */
+static void torture_rwsem_stress_write_delay(struct torture_random_state *trsp)
+{
+	const unsigned long shortdelay_us = 10;
+	const unsigned long longdelay_ms = 10;
+
+	if (!(torture_random(trsp) %
+	      (cxt.nrealwriters_stress * 20000 * longdelay_ms)))
+		mdelay(longdelay_ms);
+	else
+		udelay(shortdelay_us);
+	if (!(torture_random(trsp) % (cxt.nrealwriters_stress * 20000)))
+		torture_preempt_schedule();  /* Allow test to be preempted. */
+}
+
+static void torture_rwsem_stress_read_delay(struct torture_random_state *trsp)
+{
+	const unsigned long shortdelay_us = 2;
+	const unsigned long longdelay_ms = 10;
+
+	if (!(torture_random(trsp) %
+	      (cxt.nrealreaders_stress * 20000 * longdelay_ms)))
+		mdelay(longdelay_ms);
+	else
+		udelay(shortdelay_us);
+	if (!(torture_random(trsp) % (cxt.nrealreaders_stress * 20000)))
+		torture_preempt_schedule();  /* Allow test to be preempted. */
+}
+
+static struct lock_torture_ops rwsem_stress_lock_ops = {
+	.writelock	= torture_rwsem_down_write,
+	.write_delay	= torture_rwsem_stress_write_delay,
+	.task_boost     = torture_boost_dummy,
+	.writeunlock	= torture_rwsem_up_write,
+	.readlock       = torture_rwsem_down_read,
+	.read_delay     = torture_rwsem_stress_read_delay,
+	.readunlock     = torture_rwsem_up_read,
+	.name		= "rwsem_stress_lock"
+};
+
 #include <linux/percpu-rwsem.h>
 static struct percpu_rw_semaphore pcpu_rwsem;
 
@@ -625,6 +672,19 @@ static struct lock_torture_ops percpu_rwsem_lock_ops = {
 	.name		= "percpu_rwsem_lock"
 };
 
+/*
+ * Account the time it took to acquire the lock since @start.
+ */
+static void lock_torture_account_wait(struct lock_stress_stats *lsp,
+				      ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	lsp->wait_ns += ns;
+	if (ns > lsp->max_wait_ns)
+		lsp->max_wait_ns = ns;
+}
+
 /*
  * Lock torture writer kthread.  Repeatedly acquires and releases
  * the lock, checking for duplicate acquisitions.
@@ -633,6 +693,7 @@ static int lock_torture_writer(void *arg)
 {
 	struct lock_stress_stats *lwsp = arg;
 	static DEFINE_TORTURE_RANDOM(rand);
+	ktime_t start;
 
 	VERBOSE_TOROUT_STRING("lock_torture_writer task started");
 	set_user_nice(current, MAX_NICE);
@@ -642,7 +703,9 @@ static int lock_torture_writer(void *arg)
 			schedule_timeout_uninterruptible(1);
 
 		cxt.cur_ops->task_boost(&rand);
+		start = ktime_get();
 		cxt.cur_ops->writelock();
+		lock_torture_account_wait(lwsp, start);
 		if (WARN_ON_ONCE(lock_is_write_held))
 			lwsp->n_lock_fail++;
 		lock_is_write_held = 1;
@@ -670,6 +733,7 @@ static int lock_torture_reader(void *arg)
 {
 	struct lock_stress_stats *lrsp = arg;
 	static DEFINE_TORTURE_RANDOM(rand);
+	ktime_t start;
 
 	VERBOSE_TOROUT_STRING("lock_torture_reader task started");
 	set_user_nice(current, MAX_NICE);
@@ -678,7 +742,9 @@ static int lock_torture_reader(void *arg)
 		if ((torture_random(&rand) & 0xfffff) == 0)
 			schedule_timeout_uninterruptible(1);
 
+		start = ktime_get();
 		cxt.cur_ops->readlock();
+		lock_torture_account_wait(lrsp, start);
 		lock_is_read_held = 1;
 		if (WARN_ON_ONCE(lock_is_write_held))
 			lrsp->n_lock_fail++; /* rare, but... */
@@ -704,6 +770,7 @@ static void __torture_print_stats(char *page,
 	int i, n_stress;
 	long max = 0, min = statp ? statp[0].n_lock_acquired : 0;
 	long long sum = 0;
+	u64 wait_ns = 0, max_wait_ns = 0;
 
 	n_stress = write ? cxt.nrealwriters_stress : cxt.nrealreaders_stress;
 	for (i = 0; i < n_stress; i++) {
@@ -714,12 +781,17 @@ static void __torture_print_stats(char *page,
 			max = statp[i].n_lock_fail;
 		if (min > statp[i].n_lock_fail)
 			min = statp[i].n_lock_fail;
+		wait_ns += statp[i].wait_ns;
+		if (max_wait_ns < statp[i].max_wait_ns)
+			max_wait_ns = statp[i].max_wait_ns;
 	}
 	page += sprintf(page,
-			"%s:  Total: %lld  Max/Min: %ld/%ld %s  Fail: %d %s\n",
+			"%s:  Total: %lld  Max/Min: %ld/%ld %s  Fail: %d %s  Wait avg/max: %llu/%llu us\n",
 			write ? "Writes" : "Reads ",
 			sum, max, min, max / 2 > min ? "???" : "",
-			fail, fail ? "!!!" : "");
+			fail, fail ? "!!!" : "",
+			div_u64(div64_u64(wait_ns, sum ? : 1), NSEC_PER_USEC),
+			div_u64(max_wait_ns, NSEC_PER_USEC));
 	if (fail)
 		atomic_inc(&cxt.n_lock_torture_errors);
 }
@@ -862,6 +934,7 @@ static int __init lock_torture_init(void)
 		&rtmutex_lock_ops,
 #endif
 		&rwsem_lock_ops,
+		&rwsem_stress_lock_ops,
 		&percpu_rwsem_lock_ops,
 	};
 
@@ -928,6 +1001,8 @@ static int __init lock_torture_init(void)
 		for (i = 0; i < cxt.nrealwriters_stress; i++) {
 			cxt.lwsa[i].n_lock_fail = 0;
 			cxt.lwsa[i].n_lock_acquired = 0;
+			cxt.lwsa[i].wait_ns = 0;
+			cxt.lwsa[i].max_wait_ns = 0;
 		}
 	}
 
@@ -961,6 +1036,8 @@ static int __init lock_torture_init(void)
 			for (i = 0; i < cxt.nrealreaders_stress; i++) {
 				cxt.lrsa[i].n_lock_fail = 0;
 				cxt.lrsa[i].n_lock_acquired = 0;
+				cxt.lrsa[i].wait_ns = 0;
+				cxt.lrsa[i].max_wait_ns = 0;
 			}
 		}
 	}
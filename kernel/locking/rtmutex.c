@@ -19,6 +19,8 @@
 #include <linux/sched/debug.h>
 #include <linux/timer.h>
 
+#include <trace/events/lock.h>
+
 #include "rtmutex_common.h"
 
 /*
@@ -1255,6 +1257,7 @@ rt_mutex_slowlock(struct rt_mutex *lock, int state,
 	}
 
 	set_current_state(state);
+	trace_contention_begin(lock, LCB_F_RT);
 
 	/* Setup the timer, when timeout != NULL */
 	if (unlikely(timeout))
@@ -1279,6 +1282,7 @@ rt_mutex_slowlock(struct rt_mutex *lock, int state,
 	fixup_rt_mutex_waiters(lock);
 
 	raw_spin_unlock_irqrestore(&lock->wait_lock, flags);
+	trace_contention_end(lock, ret);
 
 	/* Remove pending timer: */
 	if (unlikely(timeout))
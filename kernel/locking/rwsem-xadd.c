@@ -17,8 +17,11 @@
 #include <linux/sched/rt.h>
 #include <linux/sched/wake_q.h>
 #include <linux/sched/debug.h>
+#include <linux/sched/clock.h>
 #include <linux/osq_lock.h>
 
+#include <trace/events/lock.h>
+
 #include "rwsem.h"
 
 /*
@@ -88,6 +91,7 @@ void __init_rwsem(struct rw_semaphore *sem, const char *name,
 	INIT_LIST_HEAD(&sem->wait_list);
 #ifdef CONFIG_RWSEM_SPIN_ON_OWNER
 	sem->owner = NULL;
+	sem->handoff = false;
 	osq_lock_init(&sem->osq);
 #endif
 #ifdef CONFIG_RWSEM_PRIO_AWARE
@@ -97,6 +101,12 @@ void __init_rwsem(struct rw_semaphore *sem, const char *name,
 
 EXPORT_SYMBOL(__init_rwsem);
 
+static inline struct rwsem_waiter *
+rwsem_first_waiter(struct rw_semaphore *sem)
+{
+	return list_first_entry(&sem->wait_list, struct rwsem_waiter, list);
+}
+
 enum rwsem_wake_type {
 	RWSEM_WAKE_ANY,		/* Wake whatever's at head of wait list */
 	RWSEM_WAKE_READERS,	/* Wake readers only */
@@ -162,8 +172,16 @@ static void __rwsem_mark_wake(struct rw_semaphore *sem,
 			 * reader grant.
 			 */
 			if (atomic_long_add_return(-adjustment, &sem->count) <
-			    RWSEM_WAITING_BIAS)
+			    RWSEM_WAITING_BIAS) {
+				/*
+				 * Once the readers at the head of the queue
+				 * have waited long enough, stop the writers
+				 * from stealing the lock from them.
+				 */
+				if (time_after(jiffies, waiter->timeout))
+					rwsem_set_handoff(sem);
 				return;
+			}
 
 			/* Last active locker left. Retry waking readers. */
 			goto try_reader_grant;
@@ -200,6 +218,7 @@ static void __rwsem_mark_wake(struct rw_semaphore *sem,
 		woken++;
 	}
 	list_cut_before(&wlist, &sem->wait_list, &waiter->list);
+	rwsem_clear_handoff(sem);
 
 	adjustment = woken * RWSEM_ACTIVE_READ_BIAS - adjustment;
 	if (list_empty(&sem->wait_list)) {
@@ -234,6 +253,8 @@ static void __rwsem_mark_wake(struct rw_semaphore *sem,
 	}
 }
 
+static bool rwsem_reader_spin(struct rw_semaphore *sem);
+
 /*
  * Wait for the read lock to be granted
  */
@@ -245,8 +266,17 @@ __rwsem_down_read_failed_common(struct rw_semaphore *sem, int state)
 	DEFINE_WAKE_Q(wake_q);
 	bool is_first_waiter = false;
 
+	trace_contention_begin(sem, LCB_F_READ | LCB_F_SPIN);
+
+	/* spin while a running writer holds the lock, keeping our bias */
+	if (rwsem_reader_spin(sem)) {
+		trace_contention_end(sem, 0);
+		return sem;
+	}
+
 	waiter.task = current;
 	waiter.type = RWSEM_WAITING_FOR_READ;
+	waiter.timeout = jiffies + RWSEM_WAIT_TIMEOUT;
 
 	raw_spin_lock_irq(&sem->wait_lock);
 	if (list_empty(&sem->wait_list))
@@ -273,6 +303,8 @@ __rwsem_down_read_failed_common(struct rw_semaphore *sem, int state)
 	raw_spin_unlock_irq(&sem->wait_lock);
 	wake_up_q(&wake_q);
 
+	trace_contention_begin(sem, LCB_F_READ);
+
 	/* wait to be given the lock */
 	while (true) {
 		set_current_state(state);
@@ -289,13 +321,17 @@ __rwsem_down_read_failed_common(struct rw_semaphore *sem, int state)
 	}
 
 	__set_current_state(TASK_RUNNING);
+	trace_contention_end(sem, 0);
 	return sem;
 out_nolock:
+	if (rwsem_first_waiter(sem) == &waiter)
+		rwsem_clear_handoff(sem);
 	list_del(&waiter.list);
 	if (list_empty(&sem->wait_list))
 		atomic_long_add(-RWSEM_WAITING_BIAS, &sem->count);
 	raw_spin_unlock_irq(&sem->wait_lock);
 	__set_current_state(TASK_RUNNING);
+	trace_contention_end(sem, -EINTR);
 	return ERR_PTR(-EINTR);
 }
 
@@ -337,6 +373,7 @@ static inline bool rwsem_try_write_lock(long count, struct rw_semaphore *sem)
 	if (atomic_long_cmpxchg_acquire(&sem->count, RWSEM_WAITING_BIAS, count)
 							== RWSEM_WAITING_BIAS) {
 		rwsem_set_owner(sem);
+		rwsem_clear_handoff(sem);
 		return true;
 	}
 
@@ -355,6 +392,10 @@ static inline bool rwsem_try_write_lock_unqueued(struct rw_semaphore *sem)
 		if (!(count == 0 || count == RWSEM_WAITING_BIAS))
 			return false;
 
+		/* Leave the lock to the waiters once a handoff is requested */
+		if (count == RWSEM_WAITING_BIAS && READ_ONCE(sem->handoff))
+			return false;
+
 		old = atomic_long_cmpxchg_acquire(&sem->count, count,
 				      count + RWSEM_ACTIVE_WRITE_BIAS);
 		if (old == count) {
@@ -382,12 +423,12 @@ static inline bool rwsem_can_spin_on_owner(struct rw_semaphore *sem)
 
 	BUILD_BUG_ON(!rwsem_has_anonymous_owner(RWSEM_OWNER_UNKNOWN));
 
-	if (need_resched())
+	if (need_resched() || READ_ONCE(sem->handoff))
 		return false;
 
 	rcu_read_lock();
 	owner = READ_ONCE(sem->owner);
-	if (owner) {
+	if (owner && owner != RWSEM_READER_OWNED) {
 		ret = is_rwsem_owner_spinnable(owner) &&
 		      owner_on_cpu(owner);
 	}
@@ -395,18 +436,38 @@ static inline bool rwsem_can_spin_on_owner(struct rw_semaphore *sem)
 	return ret;
 }
 
+enum owner_state {
+	OWNER_NULL,		/* no owner, or the owner isn't set yet */
+	OWNER_WRITER,		/* a writer we can spin on owns the lock */
+	OWNER_READER,		/* readers own the lock */
+	OWNER_NONSPINNABLE,	/* anonymous writer, or stop spinning */
+};
+
+static inline enum owner_state rwsem_owner_state(struct task_struct *owner)
+{
+	if (!owner)
+		return OWNER_NULL;
+	if (owner == RWSEM_READER_OWNED)
+		return OWNER_READER;
+	if (!is_rwsem_owner_spinnable(owner))
+		return OWNER_NONSPINNABLE;
+	return OWNER_WRITER;
+}
+
 /*
- * Return true only if we can still spin on the owner field of the rwsem.
+ * Spin as long as the same running writer owns the rwsem, then return the
+ * state of the new owner.  OWNER_NONSPINNABLE means spinning should stop.
  */
-static noinline bool rwsem_spin_on_owner(struct rw_semaphore *sem)
+static noinline enum owner_state rwsem_spin_on_owner(struct rw_semaphore *sem)
 {
 	struct task_struct *owner = READ_ONCE(sem->owner);
+	enum owner_state state = rwsem_owner_state(owner);
 
-	if (!is_rwsem_owner_spinnable(owner))
-		return false;
+	if (state != OWNER_WRITER)
+		return state;
 
 	rcu_read_lock();
-	while (owner && (READ_ONCE(sem->owner) == owner)) {
+	while (READ_ONCE(sem->owner) == owner) {
 		/*
 		 * Ensure we emit the owner->on_cpu, dereference _after_
 		 * checking sem->owner still matches owner, if that fails,
@@ -421,22 +482,33 @@ static noinline bool rwsem_spin_on_owner(struct rw_semaphore *sem)
 		 */
 		if (need_resched() || !owner_on_cpu(owner)) {
 			rcu_read_unlock();
-			return false;
+			return OWNER_NONSPINNABLE;
 		}
 
 		cpu_relax();
 	}
 	rcu_read_unlock();
 
-	/*
-	 * If there is a new owner or the owner is not set, we continue
-	 * spinning.
-	 */
-	return is_rwsem_owner_spinnable(READ_ONCE(sem->owner));
+	return rwsem_owner_state(READ_ONCE(sem->owner));
+}
+
+/*
+ * Readers don't record themselves as owners, so there is no telling
+ * whether they are running.  A writer spins on a reader owned rwsem for
+ * 0.5us per active reader (plus a little slack), at most 25us.
+ */
+static inline u64 rwsem_rspin_threshold(struct rw_semaphore *sem)
+{
+	long readers = atomic_long_read(&sem->count) & RWSEM_ACTIVE_MASK;
+
+	return min_t(u64, (readers + 2) * NSEC_PER_USEC / 2,
+		     25 * NSEC_PER_USEC);
 }
 
 static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
 {
+	enum owner_state state;
+	u64 rspin_end = 0;
 	bool taken = false;
 
 	preempt_disable();
@@ -452,10 +524,11 @@ static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
 	 * Optimistically spin on the owner field and attempt to acquire the
 	 * lock whenever the owner changes. Spinning will be stopped when:
 	 *  1) the owning writer isn't running; or
-	 *  2) readers own the lock as we can't determine if they are
-	 *     actively running or not.
+	 *  2) readers have owned the lock for longer than the reader spin
+	 *     threshold, as we can't determine if they are running or not; or
+	 *  3) a starved waiter asked for the lock to be handed off to it.
 	 */
-	while (rwsem_spin_on_owner(sem)) {
+	while ((state = rwsem_spin_on_owner(sem)) != OWNER_NONSPINNABLE) {
 		/*
 		 * Try to acquire the lock
 		 */
@@ -464,13 +537,28 @@ static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
 			break;
 		}
 
+		if (READ_ONCE(sem->handoff))
+			break;
+
+		if (state == OWNER_READER) {
+			if (need_resched())
+				break;
+			if (!rspin_end)
+				rspin_end = sched_clock() +
+					    rwsem_rspin_threshold(sem);
+			else if (sched_clock() > rspin_end)
+				break;
+		} else {
+			rspin_end = 0;
+		}
+
 		/*
 		 * When there's no owner, we might have preempted between the
 		 * owner acquiring the lock and setting the owner field. If
 		 * we're an RT task that will live-lock because we won't let
 		 * the owner complete.
 		 */
-		if (!sem->owner && (need_resched() || rt_task(current)))
+		if (state == OWNER_NULL && (need_resched() || rt_task(current)))
 			break;
 
 		/*
@@ -488,11 +576,52 @@ done:
 }
 
 /*
- * Return true if the rwsem has active spinner
+ * Spin while a running writer owns the rwsem, keeping the reader bias that
+ * __down_read() added to the count.  As long as nobody is queued, the
+ * writer's __up_write() then leaves a positive count: the rwsem is read
+ * owned and this reader holds it.  Give up as soon as a waiter is queued,
+ * the bias would otherwise keep the waiters from being granted the lock.
+ */
+static bool rwsem_reader_spin(struct rw_semaphore *sem)
+{
+	enum owner_state state;
+	bool taken = false;
+
+	preempt_disable();
+
+	if (!rwsem_can_spin_on_owner(sem))
+		goto done;
+
+	while (list_empty(&sem->wait_list)) {
+		if (atomic_long_read(&sem->count) > 0) {
+			smp_acquire__after_ctrl_dep();
+			taken = true;
+			break;
+		}
+
+		state = rwsem_spin_on_owner(sem);
+		if (state == OWNER_READER || state == OWNER_NONSPINNABLE)
+			break;
+
+		/* See rwsem_optimistic_spin() */
+		if (state == OWNER_NULL && (need_resched() || rt_task(current)))
+			break;
+
+		cpu_relax();
+	}
+done:
+	preempt_enable();
+	return taken;
+}
+
+/*
+ * Return true if the rwsem has an active spinner that will take the lock.
+ * Spinners leave the lock to the waiters once a handoff is requested, so
+ * the wakeup must not be skipped then.
  */
 static inline bool rwsem_has_spinner(struct rw_semaphore *sem)
 {
-	return osq_is_locked(&sem->osq);
+	return osq_is_locked(&sem->osq) && !READ_ONCE(sem->handoff);
 }
 
 #else
@@ -501,6 +630,11 @@ static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
 	return false;
 }
 
+static bool rwsem_reader_spin(struct rw_semaphore *sem)
+{
+	return false;
+}
+
 static inline bool rwsem_has_spinner(struct rw_semaphore *sem)
 {
 	return false;
@@ -523,9 +657,13 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 	/* undo write bias from down_write operation, stop active locking */
 	count = atomic_long_sub_return(RWSEM_ACTIVE_WRITE_BIAS, &sem->count);
 
+	trace_contention_begin(sem, LCB_F_WRITE | LCB_F_SPIN);
+
 	/* do optimistic spinning and steal lock if possible */
-	if (rwsem_optimistic_spin(sem))
+	if (rwsem_optimistic_spin(sem)) {
+		trace_contention_end(sem, 0);
 		return sem;
+	}
 
 	/*
 	 * Optimistic spinning failed, proceed to the slowpath
@@ -533,6 +671,7 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 	 */
 	waiter.task = current;
 	waiter.type = RWSEM_WAITING_FOR_WRITE;
+	waiter.timeout = jiffies + RWSEM_WAIT_TIMEOUT;
 
 	raw_spin_lock_irq(&sem->wait_lock);
 
@@ -577,9 +716,19 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 
 	/* wait until we successfully acquire the lock */
 	set_current_state(state);
+	trace_contention_begin(sem, LCB_F_WRITE);
 	while (true) {
 		if (rwsem_try_write_lock(count, sem))
 			break;
+
+		/*
+		 * Spinning writers keep stealing the lock from us; make them
+		 * stop once we have waited at the head of the queue for long
+		 * enough.
+		 */
+		if (rwsem_first_waiter(sem) == &waiter &&
+		    time_after(jiffies, waiter.timeout))
+			rwsem_set_handoff(sem);
 		raw_spin_unlock_irq(&sem->wait_lock);
 
 		/* Block until there are no active lockers. */
@@ -596,12 +745,15 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 	__set_current_state(TASK_RUNNING);
 	list_del(&waiter.list);
 	raw_spin_unlock_irq(&sem->wait_lock);
+	trace_contention_end(sem, 0);
 
 	return ret;
 
 out_nolock:
 	__set_current_state(TASK_RUNNING);
 	raw_spin_lock_irq(&sem->wait_lock);
+	if (rwsem_first_waiter(sem) == &waiter)
+		rwsem_clear_handoff(sem);
 	list_del(&waiter.list);
 	if (list_empty(&sem->wait_list))
 		atomic_long_add(-RWSEM_WAITING_BIAS, &sem->count);
@@ -609,6 +761,7 @@ out_nolock:
 		__rwsem_mark_wake(sem, RWSEM_WAKE_ANY, &wake_q);
 	raw_spin_unlock_irq(&sem->wait_lock);
 	wake_up_q(&wake_q);
+	trace_contention_end(sem, -EINTR);
 
 	return ERR_PTR(-EINTR);
 }
@@ -35,8 +35,16 @@ struct rwsem_waiter {
 	struct list_head list;
 	struct task_struct *task;
 	enum rwsem_waiter_type type;
+	unsigned long timeout;
 };
 
+/*
+ * A waiter at the head of the queue that has waited for longer than this
+ * (in jiffies) sets the handoff flag, so that optimistic spinners stop
+ * stealing the lock from it.
+ */
+#define RWSEM_WAIT_TIMEOUT	DIV_ROUND_UP(HZ, 250)
+
 #ifdef CONFIG_RWSEM_SPIN_ON_OWNER
 /*
  * All writes to owner are protected by WRITE_ONCE() to make sure that
@@ -83,6 +91,22 @@ static inline bool rwsem_has_anonymous_owner(struct task_struct *owner)
 {
 	return (unsigned long)owner & RWSEM_ANONYMOUSLY_OWNED;
 }
+
+/*
+ * The handoff flag is only changed with the wait_lock held, but it is read
+ * locklessly by the optimistic spinners.
+ */
+static inline void rwsem_set_handoff(struct rw_semaphore *sem)
+{
+	if (!sem->handoff)
+		WRITE_ONCE(sem->handoff, true);
+}
+
+static inline void rwsem_clear_handoff(struct rw_semaphore *sem)
+{
+	if (sem->handoff)
+		WRITE_ONCE(sem->handoff, false);
+}
 #else
 static inline void rwsem_set_owner(struct rw_semaphore *sem)
 {
@@ -95,6 +119,14 @@ static inline void rwsem_clear_owner(struct rw_semaphore *sem)
 static inline void rwsem_set_reader_owned(struct rw_semaphore *sem)
 {
 }
+
+static inline void rwsem_set_handoff(struct rw_semaphore *sem)
+{
+}
+
+static inline void rwsem_clear_handoff(struct rw_semaphore *sem)
+{
+}
 #endif
 
 #ifdef CONFIG_RWSEM_PRIO_AWARE
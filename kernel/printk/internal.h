@@ -24,6 +24,7 @@
 
 extern raw_spinlock_t logbuf_lock;
 
+/* Store a message in the ring buffer; local interrupts must be disabled. */
 __printf(5, 0)
 int vprintk_store(int facility, int level,
 		  const char *dict, size_t dictlen,
@@ -57,14 +57,10 @@
 #include "console_cmdline.h"
 #include "braille.h"
 #include "internal.h"
+#include "printk_ringbuffer.h"
 
 #include <linux/sec_debug.h>
 
-#ifdef CONFIG_SEC_LOG_BUF
-#define _ALIGN_DOWN(addr, size)  ((addr)&(~((size)-1)))
-#define _ALIGN_UP(addr, size)    _ALIGN_DOWN(addr + size - 1, size)
-#endif
-
 int console_printk[4] = {
 	CONSOLE_LOGLEVEL_DEFAULT,	/* console_loglevel */
 	MESSAGE_LOGLEVEL_DEFAULT,	/* default_message_loglevel */
@@ -291,17 +287,12 @@ enum con_msg_format_flags {
 static int console_msg_format = MSG_FORMAT_DEFAULT;
 
 /*
- * The printk log buffer consists of a chain of concatenated variable
- * length records. Every record starts with a record header, containing
- * the overall length of the record.
- *
- * The heads to the first and last entry in the buffer, as well as the
- * sequence numbers of these entries are maintained when messages are
- * stored.
- *
- * If the heads indicate available messages, the length in the header
- * tells the start next message. A length == 0 for the next message
- * indicates a wrap-around to the beginning of the buffer.
+ * The printk log buffer is a lockless ring buffer of variable length
+ * records, see printk_ringbuffer.c. Writers on any CPU and in any context
+ * store their records concurrently; readers copy a record out and use it
+ * only if it was not overwritten meanwhile. Every record starts with a
+ * record header, containing the overall length of the record, and is
+ * identified by a sequence number.
  *
  * Every record carries the monotonic timestamp in microseconds, as well as
  * the standard userspace syslog level and syslog facility. The usual
@@ -363,6 +354,7 @@ enum log_flags {
 	LOG_NEWLINE	= 2,	/* text ended with a newline */
 	LOG_PREFIX	= 4,	/* text started with a prefix */
 	LOG_CONT	= 8,	/* text is a fragment of a continuation line */
+	LOG_MIRRORED	= 16,	/* copied to sec_log_buf by its writer */
 };
 
 struct printk_log {
@@ -412,14 +404,17 @@ static size_t inline print_process(const struct printk_log *msg, char *buf) { re
 #endif
 
 #ifdef CONFIG_SEC_LOG_BUF_NO_CONSOLE
-static void __sec_log_buf_add(const struct printk_log *msg);
+static void __sec_log_buf_add(struct printk_log *msg, u64 seq);
+static void sec_log_buf_pull_resume(void);
 #else
-static inline void __sec_log_buf_add(const struct printk_log *msg) {}
+static inline void __sec_log_buf_add(struct printk_log *msg, u64 seq) {}
+static inline void sec_log_buf_pull_resume(void) {}
 #endif
 
 /*
- * The logbuf_lock protects kmsg buffer, indices, counters.  This can be taken
- * within the scheduler's rq lock. It must be released before calling
+ * The logbuf_lock protects the readers' positions in the log: syslog_seq,
+ * clear_seq and the kmsg dumpers.  Writers do not take it.  This can be
+ * taken within the scheduler's rq lock. It must be released before calling
  * console_unlock() or anything else that might wake up a process.
  */
 DEFINE_RAW_SPINLOCK(logbuf_lock);
@@ -456,30 +451,18 @@ DEFINE_RAW_SPINLOCK(logbuf_lock);
 DECLARE_WAIT_QUEUE_HEAD(log_wait);
 /* the next printk record to read by syslog(READ) or /proc/kmsg */
 static u64 syslog_seq;
-static u32 syslog_idx;
 static size_t syslog_partial;
 
-/* index and sequence number of the first record stored in the buffer */
-static u64 log_first_seq;
-static u32 log_first_idx;
-
-/* index and sequence number of the next record to store in the buffer */
-static u64 log_next_seq;
-static u32 log_next_idx;
-
 /* the next printk record to write to the console */
 static u64 console_seq;
-static u32 console_idx;
 static u64 exclusive_console_stop_seq;
 
 /* the next printk record to read after the last 'clear' command */
 static u64 clear_seq;
-static u32 clear_idx;
 
 /* { SecProductFeature_KNOX.SEC_PRODUCT_FEATURE_KNOX_SUPPORT_MDM */
 /* the next printk record to read after the last 'clear_knox' command */
 static u64 clear_seq_knox;
-static u32 clear_idx_knox;
 
 #define SYSLOG_ACTION_READ_CLEAR_KNOX 99
 /* } SecProductFeature_KNOX.SEC_PRODUCT_FEATURE_KNOX_SUPPORT_MDM */
@@ -492,17 +475,44 @@ static u32 clear_idx_knox;
 #define LOG_LINE_MAX		(1024 - PREFIX_MAX)
 #endif
 
+/* longer dictionaries are dropped, so that records have a bounded size */
+#define LOG_DICT_MAX		256
+#define LOG_RECORD_MAX		(sizeof(struct printk_log) + LOG_LINE_MAX + \
+				 LOG_DICT_MAX)
+
 #define LOG_LEVEL(v)		((v) & 0x07)
 #define LOG_FACILITY(v)		((v) >> 3 & 0xff)
 
+/* a reader's private copy of one record, see log_read() */
+union log_snap {
+	struct printk_log	msg;
+	char			buf[LOG_RECORD_MAX];
+};
+
 /* record buffer */
-#define LOG_ALIGN __alignof__(struct printk_log)
+#define LOG_ALIGN __alignof__(unsigned long)
 #define __LOG_BUF_LEN (1 << CONFIG_LOG_BUF_SHIFT)
 #define LOG_BUF_LEN_MAX (u32)(1 << 31)
 static char __log_buf[__LOG_BUF_LEN] __aligned(LOG_ALIGN);
 static char *log_buf = __log_buf;
 static u32 log_buf_len = __LOG_BUF_LEN;
 
+/*
+ * One descriptor per 2^PRB_AVGBITS bytes of text. The record header alone
+ * is 40 or more bytes, so descriptors rarely run out before the text does.
+ */
+#define PRB_AVGBITS 6
+
+DEFINE_PRINTKRB(printk_rb_static, CONFIG_LOG_BUF_SHIFT - PRB_AVGBITS,
+		PRB_AVGBITS, &__log_buf[0]);
+
+static struct printk_ringbuffer printk_rb_dynamic;
+
+static struct printk_ringbuffer *prb = &printk_rb_static;
+
+/* Snapshot for the readers under logbuf_lock */
+static union log_snap log_snap;
+
 /* Return log buffer address */
 char *log_buf_addr_get(void)
 {
@@ -527,116 +537,38 @@ static char *log_dict(const struct printk_log *msg)
 	return (char *)msg + sizeof(struct printk_log) + msg->text_len;
 }
 
-/* get record by index; idx must point to valid msg */
-static struct printk_log *log_from_idx(u32 idx)
-{
-	struct printk_log *msg = (struct printk_log *)(log_buf + idx);
-
-	/*
-	 * A length == 0 record is the end of buffer marker. Wrap around and
-	 * read the message at the start of the buffer.
-	 */
-	if (!msg->len)
-		return (struct printk_log *)log_buf;
-	return msg;
-}
-
-/* get next record; idx must point to valid msg */
-static u32 log_next(u32 idx)
-{
-	struct printk_log *msg = (struct printk_log *)(log_buf + idx);
-
-	/* length == 0 indicates the end of the buffer; wrap */
-	/*
-	 * A length == 0 record is the end of buffer marker. Wrap around and
-	 * read the message at the start of the buffer as *this* one, and
-	 * return the one after that.
-	 */
-	if (!msg->len) {
-		msg = (struct printk_log *)log_buf;
-		return msg->len;
-	}
-	return idx + msg->len;
-}
-
 /*
- * Check whether there is enough free space for the given message.
- *
- * The same values of first_idx and next_idx mean that the buffer
- * is either empty or full.
- *
- * If the buffer is empty, we must respect the position of the indexes.
- * They cannot be reset to the beginning of the buffer.
+ * Copy the first record with a sequence number of at least @seq into @snap
+ * and set @seq to its sequence number. Records that were overwritten are
+ * skipped. Returns NULL if there is no such record yet.
  */
-static int logbuf_has_space(u32 msg_size, bool empty)
+static struct printk_log *log_read(u64 *seq, union log_snap *snap)
 {
-	u32 free;
-
-	if (log_next_idx > log_first_idx || empty)
-		free = max(log_buf_len - log_next_idx, log_first_idx);
-	else
-		free = log_first_idx - log_next_idx;
-
-	/*
-	 * We need space also for an empty header that signalizes wrapping
-	 * of the buffer.
-	 */
-	return free >= msg_size + sizeof(struct printk_log);
+	if (!prb_read_valid(prb, seq, snap, sizeof(*snap), NULL))
+		return NULL;
+	return &snap->msg;
 }
 
-static int log_make_free_space(u32 msg_size)
+/* Is there a record at or after @seq? */
+static bool log_has_next(u64 seq)
 {
-	while (log_first_seq < log_next_seq &&
-	       !logbuf_has_space(msg_size, false)) {
-		/* drop old messages until we have enough contiguous space */
-		log_first_idx = log_next(log_first_idx);
-		log_first_seq++;
-	}
-
-	if (clear_seq < log_first_seq) {
-		clear_seq = log_first_seq;
-		clear_idx = log_first_idx;
-	}
-
-    /* { SecProductFeature_KNOX.SEC_PRODUCT_FEATURE_KNOX_SUPPORT_MDM */
-    /* messages are gone, move to first available one */
-    if (clear_seq_knox < log_first_seq) {
-        clear_seq_knox = log_first_seq;
-        clear_idx_knox = log_first_idx;
-    }
-    /* } SecProductFeature_KNOX.SEC_PRODUCT_FEATURE_KNOX_SUPPORT_MDM */
-
-	/* sequence numbers are equal, so the log buffer is empty */
-	if (logbuf_has_space(msg_size, log_first_seq == log_next_seq))
-		return 0;
-
-	return -ENOMEM;
+	return prb_read_valid(prb, &seq, NULL, 0, NULL);
 }
 
-/* compute the message size including the padding bytes */
-static u32 msg_used_size(u16 text_len, u16 dict_len, u32 *pad_len)
+/* compute the message size */
+static u32 msg_used_size(u16 text_len, u16 dict_len)
 {
-	u32 size;
-
-	size = sizeof(struct printk_log) + text_len + dict_len;
-	*pad_len = (-size) & (LOG_ALIGN - 1);
-	size += *pad_len;
-#ifdef CONFIG_SEC_LOG_BUF /* 8 bytes align for 64 bit XBL ramdump */
-	size = _ALIGN_UP(size,8);
-#endif
-	return size;
+	return sizeof(struct printk_log) + text_len + dict_len;
 }
 
 /*
  * Define how much of the log buffer we could take at maximum. The value
- * must be greater than two. Note that only half of the buffer is available
- * when the index points to the middle.
+ * must be greater than two.
  */
 #define MAX_LOG_TAKE_PART 4
 static const char trunc_msg[] = "<truncated>";
 
-static u32 truncate_msg(u16 *text_len, u16 *trunc_msg_len,
-			u16 *dict_len, u32 *pad_len)
+static u32 truncate_msg(u16 *text_len, u16 *trunc_msg_len, u16 *dict_len)
 {
 	/*
 	 * The message should not take the whole buffer. Otherwise, it might
@@ -650,43 +582,36 @@ static u32 truncate_msg(u16 *text_len, u16 *trunc_msg_len,
 	/* disable the "dict" completely */
 	*dict_len = 0;
 	/* compute the size again, count also the warning message */
-	return msg_used_size(*text_len + *trunc_msg_len, 0, pad_len);
+	return msg_used_size(*text_len + *trunc_msg_len, 0);
 }
 
-/* insert record into the buffer, discard old ones, update heads */
+/* insert record into the buffer, the oldest ones are discarded as needed */
 static int log_store(int facility, int level,
 		     enum log_flags flags, u64 ts_nsec,
 		     const char *dict, u16 dict_len,
 		     const char *text, u16 text_len)
 {
+	struct prb_reserved_entry e;
 	struct printk_log *msg;
-	u32 size, pad_len;
 	u16 trunc_msg_len = 0;
+	u32 size;
+	u64 seq;
 
-	/* number of '\0' padding bytes to next message */
-	size = msg_used_size(text_len, dict_len, &pad_len);
+	/* readers copy records into fixed size buffers */
+	if (dict_len > LOG_DICT_MAX)
+		dict_len = 0;
 
-	if (log_make_free_space(size)) {
-		/* truncate the message if it is too long for empty buffer */
-		size = truncate_msg(&text_len, &trunc_msg_len,
-				    &dict_len, &pad_len);
-		/* survive when the log buffer is too small for trunc_msg */
-		if (log_make_free_space(size))
-			return 0;
-	}
+	size = msg_used_size(text_len, dict_len);
 
-	if (log_next_idx + size + sizeof(struct printk_log) > log_buf_len) {
-		/*
-		 * This message + an additional empty header does not fit
-		 * at the end of the buffer. Add an empty header with len == 0
-		 * to signify a wrap around.
-		 */
-		memset(log_buf + log_next_idx, 0, sizeof(struct printk_log));
-		log_next_idx = 0;
-	}
+	/* truncate the message if it is too long for the buffer */
+	if (size > log_buf_len / MAX_LOG_TAKE_PART)
+		size = truncate_msg(&text_len, &trunc_msg_len, &dict_len);
+
+	msg = prb_reserve(&e, prb, size, &seq);
+	if (!msg)
+		return 0;
 
 	/* fill message */
-	msg = (struct printk_log *)(log_buf + log_next_idx);
 	memcpy(log_text(msg), text, text_len);
 	msg->text_len = text_len;
 	if (trunc_msg_len) {
@@ -708,21 +633,19 @@ static int log_store(int facility, int level,
 		msg->ts_nsec = ts_nsec;
 	else
 		msg->ts_nsec = local_clock();
-	memset(log_dict(msg) + dict_len, 0, pad_len);
 	msg->len = size;
-
-	/* insert message */
-	log_next_idx += msg->len;
-	log_next_seq++;
+	text_len = msg->text_len;
 
 #ifdef CONFIG_SEC_LOG_BUF
 	save_process(msg);
 #endif
-#ifdef CONFIG_SEC_LOG_BUF_NO_CONSOLE
-	__sec_log_buf_add(msg);
-#endif
+	__sec_log_buf_add(msg, seq);
 
-	return msg->text_len;
+	/* insert message */
+	prb_commit(&e);
+	sec_log_buf_pull_resume();
+
+	return text_len;
 }
 
 int dmesg_restrict = IS_ENABLED(CONFIG_SECURITY_DMESG_RESTRICT);
@@ -837,10 +760,10 @@ static ssize_t msg_print_ext_body(char *buf, size_t size,
 /* /dev/kmsg - userspace message inject/listen interface */
 struct devkmsg_user {
 	u64 seq;
-	u32 idx;
 	struct ratelimit_state rs;
 	struct mutex lock;
 	char buf[CONSOLE_EXT_LOG_MAX];
+	union log_snap snap;
 };
 
 static ssize_t devkmsg_write(struct kiocb *iocb, struct iov_iter *from)
@@ -916,6 +839,7 @@ static ssize_t devkmsg_read(struct file *file, char __user *buf,
 	struct printk_log *msg;
 	size_t len;
 	ssize_t ret;
+	u64 seq;
 
 	if (!user)
 		return -EBADF;
@@ -924,41 +848,37 @@ static ssize_t devkmsg_read(struct file *file, char __user *buf,
 	if (ret)
 		return ret;
 
-	logbuf_lock_irq();
-	while (user->seq == log_next_seq) {
+	for (;;) {
+		seq = user->seq;
+		msg = log_read(&seq, &user->snap);
+		if (msg)
+			break;
+
 		if (file->f_flags & O_NONBLOCK) {
 			ret = -EAGAIN;
-			logbuf_unlock_irq();
 			goto out;
 		}
 
-		logbuf_unlock_irq();
 		ret = wait_event_interruptible(log_wait,
-					       user->seq != log_next_seq);
+					       log_has_next(user->seq));
 		if (ret)
 			goto out;
-		logbuf_lock_irq();
 	}
 
-	if (user->seq < log_first_seq) {
+	if (seq != user->seq) {
 		/* our last seen message is gone, return error and reset */
-		user->idx = log_first_idx;
-		user->seq = log_first_seq;
+		user->seq = seq;
 		ret = -EPIPE;
-		logbuf_unlock_irq();
 		goto out;
 	}
 
-	msg = log_from_idx(user->idx);
 	len = msg_print_ext_header(user->buf, sizeof(user->buf),
 				   msg, user->seq);
 	len += msg_print_ext_body(user->buf + len, sizeof(user->buf) - len,
 				  log_dict(msg), msg->dict_len,
 				  log_text(msg), msg->text_len);
 
-	user->idx = log_next(user->idx);
 	user->seq++;
-	logbuf_unlock_irq();
 
 	if (len > count) {
 		ret = -EINVAL;
@@ -989,8 +909,7 @@ static loff_t devkmsg_llseek(struct file *file, loff_t offset, int whence)
 	switch (whence) {
 	case SEEK_SET:
 		/* the first record */
-		user->idx = log_first_idx;
-		user->seq = log_first_seq;
+		user->seq = prb_first_valid_seq(prb);
 		break;
 	case SEEK_DATA:
 		/*
@@ -998,13 +917,11 @@ static loff_t devkmsg_llseek(struct file *file, loff_t offset, int whence)
 		 * like issued by 'dmesg -c'. Reading /dev/kmsg itself
 		 * changes no global state, and does not clear anything.
 		 */
-		user->idx = clear_idx;
 		user->seq = clear_seq;
 		break;
 	case SEEK_END:
 		/* after the last record */
-		user->idx = log_next_idx;
-		user->seq = log_next_seq;
+		user->seq = prb_next_seq(prb);
 		break;
 	default:
 		ret = -EINVAL;
@@ -1023,15 +940,13 @@ static __poll_t devkmsg_poll(struct file *file, poll_table *wait)
 
 	poll_wait(file, &log_wait, wait);
 
-	logbuf_lock_irq();
-	if (user->seq < log_next_seq) {
+	if (log_has_next(user->seq)) {
 		/* return error when data has vanished underneath us */
-		if (user->seq < log_first_seq)
+		if (user->seq < prb_first_valid_seq(prb))
 			ret = EPOLLIN|EPOLLRDNORM|EPOLLERR|EPOLLPRI;
 		else
 			ret = EPOLLIN|EPOLLRDNORM;
 	}
-	logbuf_unlock_irq();
 
 	return ret;
 }
@@ -1061,10 +976,7 @@ static int devkmsg_open(struct inode *inode, struct file *file)
 
 	mutex_init(&user->lock);
 
-	logbuf_lock_irq();
-	user->idx = log_first_idx;
-	user->seq = log_first_seq;
-	logbuf_unlock_irq();
+	user->seq = prb_first_valid_seq(prb);
 
 	file->private_data = user;
 	return 0;
@@ -1104,11 +1016,39 @@ const struct file_operations kmsg_fops = {
  */
 void log_buf_vmcoreinfo_setup(void)
 {
-	VMCOREINFO_SYMBOL(log_buf);
-	VMCOREINFO_SYMBOL(log_buf_len);
-	VMCOREINFO_SYMBOL(log_first_idx);
-	VMCOREINFO_SYMBOL(clear_idx);
-	VMCOREINFO_SYMBOL(log_next_idx);
+	VMCOREINFO_SYMBOL(prb);
+	VMCOREINFO_SYMBOL(printk_rb_static);
+	VMCOREINFO_SYMBOL(clear_seq);
+
+	/*
+	 * Export the ring buffer layout, see printk_ringbuffer.c. Each data
+	 * block holds the descriptor ID followed by a struct printk_log.
+	 */
+	VMCOREINFO_STRUCT_SIZE(printk_ringbuffer);
+	VMCOREINFO_OFFSET(printk_ringbuffer, desc_ring);
+	VMCOREINFO_OFFSET(printk_ringbuffer, text_data_ring);
+
+	VMCOREINFO_STRUCT_SIZE(prb_desc_ring);
+	VMCOREINFO_OFFSET(prb_desc_ring, count_bits);
+	VMCOREINFO_OFFSET(prb_desc_ring, descs);
+	VMCOREINFO_OFFSET(prb_desc_ring, head_id);
+	VMCOREINFO_OFFSET(prb_desc_ring, tail_id);
+
+	VMCOREINFO_STRUCT_SIZE(prb_desc);
+	VMCOREINFO_OFFSET(prb_desc, state_var);
+	VMCOREINFO_OFFSET(prb_desc, text_blk_lpos);
+	VMCOREINFO_OFFSET(prb_desc, seq);
+
+	VMCOREINFO_STRUCT_SIZE(prb_data_blk_lpos);
+	VMCOREINFO_OFFSET(prb_data_blk_lpos, begin);
+	VMCOREINFO_OFFSET(prb_data_blk_lpos, next);
+
+	VMCOREINFO_STRUCT_SIZE(prb_data_ring);
+	VMCOREINFO_OFFSET(prb_data_ring, size_bits);
+	VMCOREINFO_OFFSET(prb_data_ring, data);
+	VMCOREINFO_OFFSET(prb_data_ring, head_lpos);
+	VMCOREINFO_OFFSET(prb_data_ring, tail_lpos);
+
 	/*
 	 * Export struct printk_log size and field offsets. User space tools can
 	 * parse it and detect any changes to structure down the line.
@@ -1189,9 +1129,15 @@ static inline void log_buf_add_cpu(void) {}
 
 void __init setup_log_buf(int early)
 {
+	struct prb_reserved_entry e;
+	struct prb_desc *new_descs;
+	unsigned int new_descs_count;
+	size_t new_descs_size;
 	unsigned long flags;
 	char *new_log_buf;
 	unsigned int free;
+	void *rec;
+	u64 seq;
 
 	if (log_buf != __log_buf)
 		return;
@@ -1202,28 +1148,54 @@ void __init setup_log_buf(int early)
 	if (!new_log_buf_len)
 		return;
 
+	new_descs_count = new_log_buf_len >> PRB_AVGBITS;
+	new_descs_size = new_descs_count * sizeof(struct prb_desc);
+
 	set_memsize_kernel_type(MEMSIZE_KERNEL_LOGBUF);
 	if (early) {
 		new_log_buf =
 			memblock_virt_alloc(new_log_buf_len, LOG_ALIGN);
+		new_descs = memblock_virt_alloc(new_descs_size, LOG_ALIGN);
 	} else {
 		new_log_buf = memblock_virt_alloc_nopanic(new_log_buf_len,
 							  LOG_ALIGN);
+		new_descs = memblock_virt_alloc_nopanic(new_descs_size,
+							LOG_ALIGN);
 	}
 	set_memsize_kernel_type(MEMSIZE_KERNEL_OTHERS);
 
-	if (unlikely(!new_log_buf)) {
+	if (unlikely(!new_log_buf || !new_descs)) {
 		pr_err("log_buf_len: %lu bytes not available\n",
 			new_log_buf_len);
+		if (new_log_buf)
+			memblock_free_early(__pa(new_log_buf), new_log_buf_len);
+		if (new_descs)
+			memblock_free_early(__pa(new_descs), new_descs_size);
 		return;
 	}
 
+	prb_init(&printk_rb_dynamic, new_log_buf, ilog2(new_log_buf_len),
+		 new_descs, ilog2(new_descs_count));
+
+	/*
+	 * This is early enough that everything still runs on the boot CPU,
+	 * so no new records appear while the old ones are copied over.
+	 */
 	logbuf_lock_irqsave(flags);
+	free = __LOG_BUF_LEN;
+	for (seq = 0; log_read(&seq, &log_snap); seq++) {
+		rec = prb_reserve(&e, &printk_rb_dynamic, log_snap.msg.len,
+				  NULL);
+		if (!rec)
+			continue;
+		memcpy(rec, &log_snap, log_snap.msg.len);
+		prb_commit(&e);
+		free -= min_t(unsigned int, free, log_snap.msg.len);
+	}
 	log_buf_len = new_log_buf_len;
 	log_buf = new_log_buf;
 	new_log_buf_len = 0;
-	free = __LOG_BUF_LEN - log_next_idx;
-	memcpy(log_buf, __log_buf, __LOG_BUF_LEN);
+	prb = &printk_rb_dynamic;
 	logbuf_unlock_irqrestore(flags);
 
 	pr_info("log_buf_len: %u bytes\n", log_buf_len);
@@ -1432,25 +1404,25 @@ static int syslog_print(char __user *buf, int size)
 	while (size > 0) {
 		size_t n;
 		size_t skip;
+		u64 seq;
 
 		logbuf_lock_irq();
-		if (syslog_seq < log_first_seq) {
-			/* messages are gone, move to first one */
-			syslog_seq = log_first_seq;
-			syslog_idx = log_first_idx;
-			syslog_partial = 0;
-		}
-		if (syslog_seq == log_next_seq) {
+		seq = syslog_seq;
+		msg = log_read(&seq, &log_snap);
+		if (!msg) {
 			logbuf_unlock_irq();
 			break;
 		}
+		if (seq != syslog_seq) {
+			/* messages are gone, move to first one */
+			syslog_seq = seq;
+			syslog_partial = 0;
+		}
 
 		skip = syslog_partial;
-		msg = log_from_idx(syslog_idx);
 		n = msg_print_text(msg, true, text, LOG_LINE_MAX + PREFIX_MAX);
 		if (n - syslog_partial <= size) {
 			/* message fits into buffer, move forward */
-			syslog_idx = log_next(syslog_idx);
 			syslog_seq++;
 			n -= syslog_partial;
 			syslog_partial = 0;
@@ -1482,11 +1454,11 @@ static int syslog_print(char __user *buf, int size)
 
 static int syslog_print_all(char __user *buf, int size, bool clear, bool knox)
 {
+	struct printk_log *msg;
 	char *text;
 	int len = 0;
 	u64 next_seq;
 	u64 seq;
-	u32 idx;
 
 	text = kmalloc(LOG_LINE_MAX + PREFIX_MAX, GFP_KERNEL);
 	if (!text)
@@ -1500,53 +1472,47 @@ static int syslog_print_all(char __user *buf, int size, bool clear, bool knox)
     /* { SecProductFeature_KNOX.SEC_PRODUCT_FEATURE_KNOX_SUPPORT_MDM */
     if (!knox) {
         seq = clear_seq;
-        idx = clear_idx;
     } else { //MDM edmaudit
         seq = clear_seq_knox;
-        idx = clear_idx_knox;
     }
     /* } SecProductFeature_KNOX.SEC_PRODUCT_FEATURE_KNOX_SUPPORT_MDM */
-	while (seq < log_next_seq) {
-		struct printk_log *msg = log_from_idx(idx);
-
+	while ((msg = log_read(&seq, &log_snap))) {
 		len += msg_print_text(msg, true, NULL, 0);
-		idx = log_next(idx);
 		seq++;
 	}
 
+	/* last message fitting into this dump */
+	next_seq = seq;
+
 	/* move first record forward until length fits into the buffer */
     /* { SecProductFeature_KNOX.SEC_PRODUCT_FEATURE_KNOX_SUPPORT_MDM */
     if (!knox) {
         seq = clear_seq;
-        idx = clear_idx;
     } else { // MDM edmaudit
         seq = clear_seq_knox;
-        idx = clear_idx_knox;
     }
     /* } SecProductFeature_KNOX.SEC_PRODUCT_FEATURE_KNOX_SUPPORT_MDM */
-	while (len > size && seq < log_next_seq) {
-		struct printk_log *msg = log_from_idx(idx);
-
+	while (len > size && seq < next_seq &&
+	       (msg = log_read(&seq, &log_snap))) {
 		len -= msg_print_text(msg, true, NULL, 0);
-		idx = log_next(idx);
 		seq++;
 	}
 
-	/* last message fitting into this dump */
-	next_seq = log_next_seq;
-
 	len = 0;
 	while (len >= 0 && seq < next_seq) {
-		struct printk_log *msg = log_from_idx(idx);
 		int textlen;
 
+		/* messages that are gone are skipped */
+		msg = log_read(&seq, &log_snap);
+		if (!msg || seq >= next_seq)
+			break;
+
 		textlen = msg_print_text(msg, true, text,
 					 LOG_LINE_MAX + PREFIX_MAX);
 		if (textlen < 0) {
 			len = textlen;
 			break;
 		}
-		idx = log_next(idx);
 		seq++;
 
 		logbuf_unlock_irq();
@@ -1555,22 +1521,14 @@ static int syslog_print_all(char __user *buf, int size, bool clear, bool knox)
 		else
 			len += textlen;
 		logbuf_lock_irq();
-
-		if (seq < log_first_seq) {
-			/* messages are gone, move to next one */
-			seq = log_first_seq;
-			idx = log_first_idx;
-		}
 	}
 
 	if (clear) {
         /* { SecProductFeature_KNOX.SEC_PRODUCT_FEATURE_KNOX_SUPPORT_MDM */
         if (!knox) {
-            clear_seq = log_next_seq;
-            clear_idx = log_next_idx;
+            clear_seq = next_seq;
         } else { //MDM edmaudit
-            clear_seq_knox = log_next_seq;
-            clear_idx_knox = log_next_idx;
+            clear_seq_knox = next_seq;
         }
         /* } SecProductFeature_KNOX.SEC_PRODUCT_FEATURE_KNOX_SUPPORT_MDM */
 	}
@@ -1583,8 +1541,7 @@ static int syslog_print_all(char __user *buf, int size, bool clear, bool knox)
 static void syslog_clear(void)
 {
 	logbuf_lock_irq();
-	clear_seq = log_next_seq;
-	clear_idx = log_next_idx;
+	clear_seq = prb_next_seq(prb);
 	logbuf_unlock_irq();
 }
 
@@ -1611,7 +1568,7 @@ int do_syslog(int type, char __user *buf, int len, int source)
 		if (!access_ok(VERIFY_WRITE, buf, len))
 			return -EFAULT;
 		error = wait_event_interruptible(log_wait,
-						 syslog_seq != log_next_seq);
+						 log_has_next(syslog_seq));
 		if (error)
 			return error;
 		error = syslog_print(buf, len);
@@ -1660,10 +1617,9 @@ int do_syslog(int type, char __user *buf, int len, int source)
 	/* Number of chars in the log buffer */
 	case SYSLOG_ACTION_SIZE_UNREAD:
 		logbuf_lock_irq();
-		if (syslog_seq < log_first_seq) {
+		if (syslog_seq < prb_first_valid_seq(prb)) {
 			/* messages are gone, move to first one */
-			syslog_seq = log_first_seq;
-			syslog_idx = log_first_idx;
+			syslog_seq = prb_first_valid_seq(prb);
 			syslog_partial = 0;
 		}
 		if (source == SYSLOG_FROM_PROC) {
@@ -1672,16 +1628,14 @@ int do_syslog(int type, char __user *buf, int len, int source)
 			 * for pending data, not the size; return the count of
 			 * records, not the length.
 			 */
-			error = log_next_seq - syslog_seq;
+			if (log_has_next(syslog_seq))
+				error = prb_next_seq(prb) - syslog_seq;
 		} else {
+			struct printk_log *msg;
 			u64 seq = syslog_seq;
-			u32 idx = syslog_idx;
-
-			while (seq < log_next_seq) {
-				struct printk_log *msg = log_from_idx(idx);
 
+			while ((msg = log_read(&seq, &log_snap))) {
 				error += msg_print_text(msg, true, NULL, 0);
-				idx = log_next(idx);
 				seq++;
 			}
 			error -= syslog_partial;
@@ -1911,7 +1865,12 @@ static inline void printk_delay(void)
  * until the line is complete, or a race forces it. The line fragments
  * though, are printed immediately to the consoles to ensure everything has
  * reached the console in case of a kernel crash.
+ *
+ * The buffer is shared by all CPUs and protected by cont_lock, which is
+ * only taken while a fragment is buffered or about to be.
  */
+static DEFINE_RAW_SPINLOCK(cont_lock);
+
 static struct cont {
 	char buf[LOG_LINE_MAX];
 	size_t len;			/* length == 0 means unused buffer */
@@ -1968,7 +1927,13 @@ static bool cont_add(int facility, int level, enum log_flags flags, const char *
 	return true;
 }
 
-static size_t log_output(int facility, int level, enum log_flags lflags, const char *dict, size_t dictlen, char *text, size_t text_len)
+/*
+ * Store a line or buffer it in cont. Returns the number of characters
+ * consumed; @stored is set if a record was added to the log.
+ */
+static size_t __log_output(int facility, int level, enum log_flags lflags,
+			   const char *dict, size_t dictlen,
+			   char *text, size_t text_len, bool *stored)
 {
 	/*
 	 * If an earlier line was buffered, and we're a continuation
@@ -1976,11 +1941,14 @@ static size_t log_output(int facility, int level, enum log_flags lflags, const c
 	 */
 	if (cont.len) {
 		if (cont.owner == current && (lflags & LOG_CONT)) {
-			if (cont_add(facility, level, lflags, text, text_len))
+			if (cont_add(facility, level, lflags, text, text_len)) {
+				*stored = !cont.len;
 				return text_len;
+			}
 		}
 		/* Otherwise, make sure it's flushed */
 		cont_flush();
+		*stored = true;
 	}
 
 	/* Skip empty continuation lines that couldn't be added - they just flush */
@@ -1989,21 +1957,68 @@ static size_t log_output(int facility, int level, enum log_flags lflags, const c
 
 	/* If it doesn't end in a newline, try to buffer the current line */
 	if (!(lflags & LOG_NEWLINE)) {
-		if (cont_add(facility, level, lflags, text, text_len))
+		if (cont_add(facility, level, lflags, text, text_len)) {
+			*stored |= !cont.len;
 			return text_len;
+		}
 	}
 
 	/* Store it in the record log */
+	*stored = true;
 	return log_store(facility, level, lflags, 0, dict, dictlen, text, text_len);
 }
 
-/* Must be called under logbuf_lock. */
-int vprintk_store(int facility, int level,
-		  const char *dict, size_t dictlen,
-		  const char *fmt, va_list args)
+static size_t log_output(int facility, int level, enum log_flags lflags,
+			 const char *dict, size_t dictlen,
+			 char *text, size_t text_len, bool *stored)
+{
+	size_t ret;
+
+	*stored = false;
+
+	/* Complete lines with nothing buffered go straight to the ring. */
+	if (!READ_ONCE(cont.len) && (lflags & LOG_NEWLINE) && text_len) {
+		*stored = true;
+		return log_store(facility, level, lflags, 0, dict, dictlen,
+				 text, text_len);
+	}
+
+	/*
+	 * Never spin in NMI, or when the holder may have been stopped by a
+	 * crash: store the fragment as a record of its own instead.
+	 */
+	if (in_nmi() || oops_in_progress) {
+		if (!raw_spin_trylock(&cont_lock)) {
+			*stored = true;
+			return log_store(facility, level, lflags, 0, dict,
+					 dictlen, text, text_len);
+		}
+	} else {
+		raw_spin_lock(&cont_lock);
+	}
+
+	ret = __log_output(facility, level, lflags, dict, dictlen,
+			   text, text_len, stored);
+	raw_spin_unlock(&cont_lock);
+
+	return ret;
+}
+
+/*
+ * Per-CPU buffers to format into: interrupts are disabled while storing,
+ * so only NMI can nest. Recursion from within printk() itself goes to the
+ * printk_safe buffers.
+ */
+static DEFINE_PER_CPU(char [LOG_LINE_MAX], printk_textbuf);
+static DEFINE_PER_CPU(char [LOG_LINE_MAX], printk_nmi_textbuf);
+
+/* Must be called with interrupts disabled. */
+static int __vprintk_store(int facility, int level,
+			   const char *dict, size_t dictlen,
+			   const char *fmt, va_list args, bool *stored)
 {
-	static char textbuf[LOG_LINE_MAX];
-	char *text = textbuf;
+	char *text = in_nmi() ? this_cpu_ptr(printk_nmi_textbuf) :
+				this_cpu_ptr(printk_textbuf);
 	size_t text_len;
 	enum log_flags lflags = 0;
 
@@ -2011,7 +2026,7 @@ int vprintk_store(int facility, int level,
 	 * The printf needs to come first; we need the syslog
 	 * prefix which might be passed-in as a parameter.
 	 */
-	text_len = vscnprintf(text, sizeof(textbuf), fmt, args);
+	text_len = vscnprintf(text, LOG_LINE_MAX, fmt, args);
 
 	/* mark and strip a trailing newline */
 	if (text_len && text[text_len-1] == '\n') {
@@ -2048,7 +2063,18 @@ int vprintk_store(int facility, int level,
 		lflags |= LOG_PREFIX|LOG_NEWLINE;
 
 	return log_output(facility, level, lflags,
-			  dict, dictlen, text, text_len);
+			  dict, dictlen, text, text_len, stored);
+}
+
+/* Must be called with interrupts disabled. */
+int vprintk_store(int facility, int level,
+		  const char *dict, size_t dictlen,
+		  const char *fmt, va_list args)
+{
+	bool stored;
+
+	return __vprintk_store(facility, level, dict, dictlen, fmt, args,
+			       &stored);
 }
 
 asmlinkage int vprintk_emit(int facility, int level,
@@ -2058,7 +2084,6 @@ asmlinkage int vprintk_emit(int facility, int level,
 	int printed_len;
 	bool in_sched = false, pending_output;
 	unsigned long flags;
-	u64 curr_log_seq;
 
 	if (level == LOGLEVEL_SCHED) {
 		level = LOGLEVEL_DEFAULT;
@@ -2068,12 +2093,10 @@ asmlinkage int vprintk_emit(int facility, int level,
 	boot_delay_msec(level);
 	printk_delay();
 
-	/* This stops the holder of console_sem just where we want him */
-	logbuf_lock_irqsave(flags);
-	curr_log_seq = log_next_seq;
-	printed_len = vprintk_store(facility, level, dict, dictlen, fmt, args);
-	pending_output = (curr_log_seq != log_next_seq);
-	logbuf_unlock_irqrestore(flags);
+	printk_safe_enter_irqsave(flags);
+	printed_len = __vprintk_store(facility, level, dict, dictlen, fmt, args,
+				      &pending_output);
+	printk_safe_exit_irqrestore(flags);
 
 	/* If called from the scheduler, we can not call up(). */
 	if (!in_sched && pending_output) {
@@ -2176,18 +2199,17 @@ EXPORT_SYMBOL(printk);
 #define LOG_LINE_MAX		0
 #define PREFIX_MAX		0
 
+union log_snap {
+	struct printk_log	msg;
+};
+
 static u64 syslog_seq;
-static u32 syslog_idx;
 static u64 console_seq;
-static u32 console_idx;
 static u64 exclusive_console_stop_seq;
-static u64 log_first_seq;
-static u32 log_first_idx;
-static u64 log_next_seq;
 static char *log_text(const struct printk_log *msg) { return NULL; }
 static char *log_dict(const struct printk_log *msg) { return NULL; }
-static struct printk_log *log_from_idx(u32 idx) { return NULL; }
-static u32 log_next(u32 idx) { return 0; }
+static struct printk_log *log_read(u64 *seq, union log_snap *snap) { return NULL; }
+static bool log_has_next(u64 seq) { return false; }
 static ssize_t msg_print_ext_header(char *buf, size_t size,
 				    struct printk_log *msg,
 				    u64 seq) { return 0; }
@@ -2482,8 +2504,10 @@ void console_unlock(void)
 {
 	static char ext_text[CONSOLE_EXT_LOG_MAX];
 	static char text[LOG_LINE_MAX + PREFIX_MAX];
+	static union log_snap snap;
 	unsigned long flags;
 	bool do_cond_resched, retry;
+	u64 seq;
 
 	if (console_suspended) {
 		up_console_sem();
@@ -2522,37 +2546,40 @@ again:
 	for (;;) {
 		struct printk_log *msg;
 		size_t ext_len = 0;
+		u64 dropped = 0;
 		size_t len;
 
 		printk_safe_enter_irqsave(flags);
-		raw_spin_lock(&logbuf_lock);
-		if (console_seq < log_first_seq) {
-			len = sprintf(text,
-				      "** %llu printk messages dropped **\n",
-				      log_first_seq - console_seq);
+skip:
+		seq = console_seq;
+		msg = log_read(&seq, &snap);
+		if (!msg)
+			break;
 
+		if (seq != console_seq) {
 			/* messages are gone, move to first one */
-			console_seq = log_first_seq;
-			console_idx = log_first_idx;
-		} else {
-			len = 0;
+			dropped += seq - console_seq;
+			console_seq = seq;
 		}
-skip:
-		if (console_seq == log_next_seq)
-			break;
 
-		msg = log_from_idx(console_idx);
 		if (suppress_message_printing(msg->level)) {
 			/*
 			 * Skip record we have buffered and already printed
 			 * directly to the console when we received it, and
 			 * record that has level above the console loglevel.
 			 */
-			console_idx = log_next(console_idx);
 			console_seq++;
 			goto skip;
 		}
 
+		if (dropped) {
+			len = sprintf(text,
+				      "** %llu printk messages dropped **\n",
+				      dropped);
+		} else {
+			len = 0;
+		}
+
 		/* Output to all consoles once old messages replayed. */
 		if (unlikely(exclusive_console &&
 			     console_seq >= exclusive_console_stop_seq)) {
@@ -2572,9 +2599,7 @@ skip:
 						log_dict(msg), msg->dict_len,
 						log_text(msg), msg->text_len);
 		}
-		console_idx = log_next(console_idx);
 		console_seq++;
-		raw_spin_unlock(&logbuf_lock);
 
 		/*
 		 * While actively printing out messages, if another printk()
@@ -2601,8 +2626,7 @@ skip:
 
 	console_locked = 0;
 
-	raw_spin_unlock(&logbuf_lock);
-
+	seq = console_seq;
 	up_console_sem();
 
 	/*
@@ -2611,9 +2635,7 @@ skip:
 	 * there's a new owner and the console_unlock() from them will do the
 	 * flush, no worries.
 	 */
-	raw_spin_lock(&logbuf_lock);
-	retry = console_seq != log_next_seq;
-	raw_spin_unlock(&logbuf_lock);
+	retry = log_has_next(seq);
 	printk_safe_exit_irqrestore(flags);
 
 	if (retry && console_trylock())
@@ -2877,7 +2899,6 @@ void register_console(struct console *newcon)
 		 */
 		logbuf_lock_irqsave(flags);
 		console_seq = syslog_seq;
-		console_idx = syslog_idx;
 		/*
 		 * We're about to replay the log buffer.  Only do this to the
 		 * just-registered console to avoid excessive message spam to
@@ -3235,9 +3256,7 @@ void kmsg_dump(enum kmsg_dump_reason reason)
 
 		logbuf_lock_irqsave(flags);
 		dumper->cur_seq = clear_seq;
-		dumper->cur_idx = clear_idx;
-		dumper->next_seq = log_next_seq;
-		dumper->next_idx = log_next_idx;
+		dumper->next_seq = prb_next_seq(prb);
 		logbuf_unlock_irqrestore(flags);
 
 		/* invoke dumper which will iterate over records */
@@ -3278,20 +3297,15 @@ bool kmsg_dump_get_line_nolock(struct kmsg_dumper *dumper, bool syslog,
 	if (!dumper->active)
 		goto out;
 
-	if (dumper->cur_seq < log_first_seq) {
-		/* messages are gone, move to first available one */
-		dumper->cur_seq = log_first_seq;
-		dumper->cur_idx = log_first_idx;
-	}
+	/* messages that are gone are skipped */
+	msg = log_read(&dumper->cur_seq, &log_snap);
 
 	/* last entry */
-	if (dumper->cur_seq >= log_next_seq)
+	if (!msg)
 		goto out;
 
-	msg = log_from_idx(dumper->cur_idx);
 	l = msg_print_text(msg, syslog, line, size);
 
-	dumper->cur_idx = log_next(dumper->cur_idx);
 	dumper->cur_seq++;
 	ret = true;
 out:
@@ -3353,11 +3367,10 @@ EXPORT_SYMBOL_GPL(kmsg_dump_get_line);
 bool kmsg_dump_get_buffer(struct kmsg_dumper *dumper, bool syslog,
 			  char *buf, size_t size, size_t *len)
 {
+	struct printk_log *msg;
 	unsigned long flags;
 	u64 seq;
-	u32 idx;
 	u64 next_seq;
-	u32 next_idx;
 	size_t l = 0;
 	bool ret = false;
 
@@ -3365,55 +3378,42 @@ bool kmsg_dump_get_buffer(struct kmsg_dumper *dumper, bool syslog,
 		goto out;
 
 	logbuf_lock_irqsave(flags);
-	if (dumper->cur_seq < log_first_seq) {
-		/* messages are gone, move to first available one */
-		dumper->cur_seq = log_first_seq;
-		dumper->cur_idx = log_first_idx;
-	}
+
+	/* messages that are gone are skipped */
+	seq = dumper->cur_seq;
+	msg = log_read(&seq, &log_snap);
 
 	/* last entry */
-	if (dumper->cur_seq >= dumper->next_seq) {
+	if (!msg || seq >= dumper->next_seq) {
 		logbuf_unlock_irqrestore(flags);
 		goto out;
 	}
+	dumper->cur_seq = seq;
 
 	/* calculate length of entire buffer */
-	seq = dumper->cur_seq;
-	idx = dumper->cur_idx;
-	while (seq < dumper->next_seq) {
-		struct printk_log *msg = log_from_idx(idx);
-
+	while ((msg = log_read(&seq, &log_snap)) && seq < dumper->next_seq) {
 		l += msg_print_text(msg, true, NULL, 0);
-		idx = log_next(idx);
 		seq++;
 	}
 
 	/* move first record forward until length fits into the buffer */
 	seq = dumper->cur_seq;
-	idx = dumper->cur_idx;
-	while (l >= size && seq < dumper->next_seq) {
-		struct printk_log *msg = log_from_idx(idx);
-
+	while (l >= size && (msg = log_read(&seq, &log_snap)) &&
+	       seq < dumper->next_seq) {
 		l -= msg_print_text(msg, true, NULL, 0);
-		idx = log_next(idx);
 		seq++;
 	}
 
 	/* last message in next interation */
 	next_seq = seq;
-	next_idx = idx;
 
 	l = 0;
-	while (seq < dumper->next_seq) {
-		struct printk_log *msg = log_from_idx(idx);
-
+	while ((msg = log_read(&seq, &log_snap)) && seq < dumper->next_seq) {
 		l += msg_print_text(msg, syslog, buf + l, size - l);
-		idx = log_next(idx);
 		seq++;
 	}
 
 	dumper->next_seq = next_seq;
-	dumper->next_idx = next_idx;
 	ret = true;
 	logbuf_unlock_irqrestore(flags);
 out:
@@ -3436,9 +3436,7 @@ EXPORT_SYMBOL_GPL(kmsg_dump_get_buffer);
 void kmsg_dump_rewind_nolock(struct kmsg_dumper *dumper)
 {
 	dumper->cur_seq = clear_seq;
-	dumper->cur_idx = clear_idx;
-	dumper->next_seq = log_next_seq;
-	dumper->next_idx = log_next_idx;
+	dumper->next_seq = prb_next_seq(prb);
 }
 
 /**
@@ -3462,7 +3460,27 @@ EXPORT_SYMBOL_GPL(kmsg_dump_rewind);
 #endif
 
 #ifdef CONFIG_SEC_LOG_BUF_NO_CONSOLE
-static void __sec_log_buf_add(const struct printk_log *msg)
+/*
+ * Records are mirrored by their writers, before they are committed and
+ * possibly by several CPUs at once, but sec_log_buf_write() and the
+ * formatting buffer are not reentrant.
+ */
+static DEFINE_RAW_SPINLOCK(sec_log_buf_lock);
+
+/*
+ * Until sec_log_buf_pull_early_buffer() runs, writers only note how far
+ * the records they did not mirror go. The pull copies those records, and
+ * the ones that were still being written are copied by the commit hook,
+ * sec_log_buf_pull_resume(), so they may land out of order in the mirror.
+ * All of this is protected by sec_log_buf_lock.
+ */
+static bool sec_log_buf_pulled;
+static bool sec_log_buf_pull_pending;
+static u64 sec_log_buf_pull_seq;
+static u64 sec_log_buf_pull_end;
+static union log_snap sec_log_snap;
+
+static void sec_log_buf_add_locked(const struct printk_log *msg)
 {
 	static char tmp[PAGE_SIZE];
 	unsigned int size;
@@ -3474,31 +3492,106 @@ static void __sec_log_buf_add(const struct printk_log *msg)
 		sec_init_log_buf_write(tmp, size);
 }
 
-void __init sec_log_buf_pull_early_buffer(bool *init_done)
+static bool sec_log_buf_lock_irqsave(unsigned long *flags)
+{
+	/* Never spin in NMI or after a crash; the mirror may miss a line. */
+	if (in_nmi() || oops_in_progress)
+		return raw_spin_trylock_irqsave(&sec_log_buf_lock, *flags);
+
+	raw_spin_lock_irqsave(&sec_log_buf_lock, *flags);
+	return true;
+}
+
+static void __sec_log_buf_add(struct printk_log *msg, u64 seq)
 {
-	u32 current_idx = log_first_idx;
-	struct printk_log *msg;
 	unsigned long flags;
 
-	logbuf_lock_irqsave(flags);
+	if (!sec_log_buf_lock_irqsave(&flags))
+		return;
 
-	*init_done = true;
+	if (sec_log_buf_pulled) {
+		msg->flags |= LOG_MIRRORED;
+		sec_log_buf_add_locked(msg);
+	} else if (seq >= sec_log_buf_pull_end) {
+		sec_log_buf_pull_end = seq + 1;
+	}
 
-	while (current_idx < log_next_idx) {
-		msg = log_from_idx(current_idx);
-		__sec_log_buf_add(msg);
-		current_idx = log_next(current_idx);
+	raw_spin_unlock_irqrestore(&sec_log_buf_lock, flags);
+}
+
+/* Copy the committed records below sec_log_buf_pull_end that were not mirrored */
+static void sec_log_buf_pull_locked(void)
+{
+	struct printk_log *msg;
+	u64 seq = sec_log_buf_pull_seq;
+
+	/* Pairs with the barrier in sec_log_buf_pull_resume() */
+	WRITE_ONCE(sec_log_buf_pull_pending, true);
+	smp_mb();
+
+	while (seq < sec_log_buf_pull_end &&
+	       (msg = log_read(&seq, &sec_log_snap)) &&
+	       seq < sec_log_buf_pull_end) {
+		if (!(msg->flags & LOG_MIRRORED))
+			sec_log_buf_add_locked(msg);
+		seq++;
 	}
 
-	logbuf_unlock_irqrestore(flags);
+	/* Stopped early on a record that is not committed yet */
+	sec_log_buf_pull_seq = seq;
+	if (seq >= sec_log_buf_pull_end)
+		WRITE_ONCE(sec_log_buf_pull_pending, false);
+}
+
+/* Called after each commit, for the records the pull had to skip */
+static void sec_log_buf_pull_resume(void)
+{
+	unsigned long flags;
+
+	/*
+	 * Either the pull sees our record committed, or we see it
+	 * pending and pull it ourselves.
+	 */
+	smp_mb();
+	if (likely(!READ_ONCE(sec_log_buf_pull_pending)))
+		return;
+
+	if (!sec_log_buf_lock_irqsave(&flags))
+		return;
+	if (sec_log_buf_pull_pending)
+		sec_log_buf_pull_locked();
+	raw_spin_unlock_irqrestore(&sec_log_buf_lock, flags);
+}
+
+void __init sec_log_buf_pull_early_buffer(bool *init_done)
+{
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&sec_log_buf_lock, flags);
+	*init_done = true;
+	sec_log_buf_pulled = true;
+	sec_log_buf_pull_locked();
+	raw_spin_unlock_irqrestore(&sec_log_buf_lock, flags);
 }
 #endif
 
 #ifdef CONFIG_SEC_DEBUG_SUMMARY
 void sec_debug_summary_set_klog_info(struct sec_debug_summary_data_apss *apss)
 {
-	apss->log.first_idx_paddr = (unsigned int)__pa(&log_first_idx);
-	apss->log.next_idx_paddr = (unsigned int)__pa(&log_next_idx);
+	/*
+	 * The tail and head of the data ring: byte positions that keep
+	 * growing, the offset into log_buf is their value modulo
+	 * log_buf_len. Each data block starts with an unsigned long
+	 * descriptor ID, followed by the struct printk_log.
+	 *
+	 * This is not the layout of the old log_first_idx/log_next_idx
+	 * ring: the XBL ramdump parser has to be updated together with
+	 * this kernel, an older bootloader cannot extract the klog.
+	 */
+	apss->log.first_idx_paddr =
+		(unsigned int)__pa(&prb->text_data_ring.tail_lpos);
+	apss->log.next_idx_paddr =
+		(unsigned int)__pa(&prb->text_data_ring.head_lpos);
 	apss->log.log_paddr = (unsigned long)__pa(log_buf);
 	apss->log.size_paddr = (unsigned long)__pa(&log_buf_len);
 }
@@ -0,0 +1,794 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Lockless multi-writer ring buffer for the printk log.
+ *
+ * The ring buffer is made of two rings:
+ *
+ *  - the descriptor ring: an array of 2^n struct prb_desc, one per record.
+ *    Each descriptor holds an ID and a state packed into one word
+ *    (state_var), the position of the record's data block and the record's
+ *    sequence number.
+ *
+ *  - the data ring: a byte array of 2^m bytes holding the data blocks.  A
+ *    block starts with the ID of its descriptor, so that a writer pushing
+ *    the tail can find out whether the oldest block may be overwritten.
+ *    A block that would not fit at the end of the array is stored at its
+ *    beginning instead and the remainder of the array is left unused.
+ *
+ * Both rings are addressed by ever increasing logical positions (IDs for
+ * descriptors, lpos for data) which are reduced to an index modulo the ring
+ * size.  Writers reserve space by cmpxchg'ing the head of a ring forward;
+ * if the ring is full they first push its tail forward, which is only
+ * possible over records that are committed.  The oldest committed records
+ * are thereby recycled: their descriptor becomes reusable before their data
+ * is overwritten.
+ *
+ * A descriptor goes reserved -> committed -> reusable -> reserved...
+ * Only committed records are visible to readers.  A reader copies a record
+ * out and then checks that its descriptor is still committed with the same
+ * ID; if it is not, the copy may be torn and is discarded.  Readers never
+ * write to the ring buffer, so there is no limit on their number, and a
+ * slow reader does not hold up writers: it just loses records.
+ *
+ * A record whose writer is still between prb_reserve() and prb_commit()
+ * stops readers, and once the descriptor ring wraps onto it, also further
+ * reservations.  prb_reserve() therefore disables interrupts until
+ * prb_commit(), and writers must not sleep in between.  Writers may nest,
+ * e.g. from NMI, and may run concurrently on any number of CPUs.
+ */
+
+#include <linux/errno.h>
+#include <linux/irqflags.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/bug.h>
+#include "printk_ringbuffer.h"
+
+#define DATA_SIZE(data_ring)		_DATA_SIZE((data_ring)->size_bits)
+#define DATA_SIZE_MASK(data_ring)	(DATA_SIZE(data_ring) - 1)
+
+#define DESCS_COUNT(desc_ring)		_DESCS_COUNT((desc_ring)->count_bits)
+#define DESCS_COUNT_MASK(desc_ring)	(DESCS_COUNT(desc_ring) - 1)
+
+/* Determine the data array index from a logical position. */
+#define DATA_INDEX(data_ring, lpos)	((lpos) & DATA_SIZE_MASK(data_ring))
+
+/* Determine the desc array index from an ID or sequence number. */
+#define DESC_INDEX(desc_ring, n)	((n) & DESCS_COUNT_MASK(desc_ring))
+
+/* Determine how many times the data array has wrapped. */
+#define DATA_WRAPS(data_ring, lpos)	((lpos) >> (data_ring)->size_bits)
+
+/* Determine if a logical position refers to a data-less block. */
+#define LPOS_DATALESS(lpos)		((lpos) & 1UL)
+
+/* Get the logical position at index 0 of the current wrap. */
+#define DATA_THIS_WRAP_START_LPOS(data_ring, lpos) \
+	((lpos) & ~DATA_SIZE_MASK(data_ring))
+
+/* Get the ID for the same index of the previous wrap as the given ID. */
+#define DESC_ID_PREV_WRAP(desc_ring, id) \
+	DESC_ID((id) - DESCS_COUNT(desc_ring))
+
+/* A data block: the ID of its descriptor followed by the record data */
+struct prb_data_block {
+	unsigned long	id;
+	char		data[0];
+};
+
+static struct prb_desc *to_desc(struct prb_desc_ring *desc_ring, u64 n)
+{
+	return &desc_ring->descs[DESC_INDEX(desc_ring, n)];
+}
+
+static struct prb_data_block *to_block(struct prb_data_ring *data_ring,
+				       unsigned long begin_lpos)
+{
+	return (void *)&data_ring->data[DATA_INDEX(data_ring, begin_lpos)];
+}
+
+/* Increase the data size to account for the ID and the alignment. */
+static unsigned int to_blk_size(unsigned int size)
+{
+	struct prb_data_block *db = NULL;
+
+	size += sizeof(*db);
+	size = ALIGN(size, sizeof(db->id));
+	return size;
+}
+
+/*
+ * The largest block must still leave room for the ID of the next one, or
+ * the tail could not be pushed past it.
+ */
+static bool data_check_size(struct prb_data_ring *data_ring, unsigned int size)
+{
+	struct prb_data_block *db = NULL;
+
+	if (size == 0)
+		return false;
+
+	return to_blk_size(size) <= DATA_SIZE(data_ring) - sizeof(db->id);
+}
+
+static enum desc_state get_desc_state(unsigned long id,
+				      unsigned long state_val)
+{
+	if (id != DESC_ID(state_val))
+		return desc_miss;
+
+	return DESC_STATE(state_val);
+}
+
+/*
+ * Copy the descriptor @id to @desc_out and return its state.  The copy is
+ * only consistent if the returned state is committed or reusable.
+ */
+static enum desc_state desc_read(struct prb_desc_ring *desc_ring,
+				 unsigned long id, struct prb_desc *desc_out,
+				 u64 *seq_out)
+{
+	struct prb_desc *desc = to_desc(desc_ring, id);
+	atomic_long_t *state_var = &desc->state_var;
+	enum desc_state d_state;
+	unsigned long state_val;
+
+	state_val = atomic_long_read(state_var);
+	d_state = get_desc_state(id, state_val);
+	if (d_state == desc_miss || d_state == desc_reserved)
+		goto out;
+
+	/* Load the state before the descriptor content. */
+	smp_rmb();
+
+	if (desc_out)
+		desc_out->text_blk_lpos = desc->text_blk_lpos;
+	if (seq_out)
+		*seq_out = desc->seq;
+
+	/*
+	 * Load the descriptor content, and for readers that copied the data
+	 * before calling here again, the data, before re-checking the state.
+	 * Pairs with the full barriers in desc_reserve() and data_alloc().
+	 */
+	smp_rmb();
+
+	state_val = atomic_long_read(state_var);
+	d_state = get_desc_state(id, state_val);
+out:
+	if (desc_out)
+		atomic_long_set(&desc_out->state_var, state_val);
+	return d_state;
+}
+
+/* Take a committed descriptor out of the readers' view. */
+static void desc_make_reusable(struct prb_desc_ring *desc_ring,
+			       unsigned long id)
+{
+	unsigned long val_committed = DESC_SV(id, desc_committed);
+	unsigned long val_reusable = DESC_SV(id, desc_reusable);
+	struct prb_desc *desc = to_desc(desc_ring, id);
+
+	atomic_long_cmpxchg_relaxed(&desc->state_var, val_committed,
+				    val_reusable);
+}
+
+/*
+ * Make the descriptors of all data blocks in [lpos_begin, lpos_end)
+ * reusable.  Fails if one of them is still reserved, or if the tail moved
+ * underneath us; @lpos_out is where the walk stopped.
+ */
+static bool data_make_reusable(struct printk_ringbuffer *rb,
+			       unsigned long lpos_begin,
+			       unsigned long lpos_end,
+			       unsigned long *lpos_out)
+{
+	struct prb_data_ring *data_ring = &rb->text_data_ring;
+	struct prb_desc_ring *desc_ring = &rb->desc_ring;
+	struct prb_data_blk_lpos *blk_lpos;
+	struct prb_data_block *blk;
+	enum desc_state d_state;
+	struct prb_desc desc;
+	unsigned long id;
+
+	blk_lpos = &desc.text_blk_lpos;
+
+	/* Loop until @lpos_begin has advanced to or beyond @lpos_end. */
+	while ((lpos_end - lpos_begin) - 1 < DATA_SIZE(data_ring)) {
+		blk = to_block(data_ring, lpos_begin);
+
+		/*
+		 * The ID may be garbage if the block is being written, in
+		 * which case desc_read() reports a miss.
+		 */
+		id = READ_ONCE(blk->id);
+
+		d_state = desc_read(desc_ring, id, &desc, NULL);
+
+		switch (d_state) {
+		case desc_miss:
+		case desc_reserved:
+			return false;
+		case desc_committed:
+			if (blk_lpos->begin != lpos_begin)
+				return false;
+			desc_make_reusable(desc_ring, id);
+			break;
+		case desc_reusable:
+			if (blk_lpos->begin != lpos_begin)
+				return false;
+			break;
+		}
+
+		/* Advance @lpos_begin to the next data block. */
+		lpos_begin = blk_lpos->next;
+	}
+
+	*lpos_out = lpos_begin;
+	return true;
+}
+
+/* Advance the data ring tail to at least @lpos. */
+static bool data_push_tail(struct printk_ringbuffer *rb, unsigned long lpos)
+{
+	struct prb_data_ring *data_ring = &rb->text_data_ring;
+	unsigned long tail_lpos_new;
+	unsigned long tail_lpos;
+	unsigned long next_lpos;
+
+	/* If @lpos is from a data-less block, there is nothing to do. */
+	if (LPOS_DATALESS(lpos))
+		return true;
+
+	tail_lpos = atomic_long_read(&data_ring->tail_lpos);
+
+	/* Loop until the tail lpos is at or beyond @lpos. */
+	while ((lpos - tail_lpos) - 1 < DATA_SIZE(data_ring)) {
+		if (!data_make_reusable(rb, tail_lpos, lpos, &next_lpos)) {
+			/*
+			 * Only fail if the tail did not move meanwhile: the
+			 * blocking record may have been recycled by another
+			 * writer that pushed the tail already.
+			 */
+			smp_rmb();
+			tail_lpos_new = atomic_long_read(&data_ring->tail_lpos);
+			if (tail_lpos_new == tail_lpos)
+				return false;
+
+			tail_lpos = tail_lpos_new;
+			continue;
+		}
+
+		/*
+		 * Store the reusable states, possibly set by other CPUs,
+		 * before the new tail allows the data to be overwritten.
+		 */
+		smp_mb();
+
+		if (atomic_long_try_cmpxchg(&data_ring->tail_lpos, &tail_lpos,
+					    next_lpos))
+			break;
+	}
+
+	return true;
+}
+
+/* Advance the descriptor ring tail past @tail_id. */
+static bool desc_push_tail(struct printk_ringbuffer *rb,
+			   unsigned long tail_id)
+{
+	struct prb_desc_ring *desc_ring = &rb->desc_ring;
+	enum desc_state d_state;
+	struct prb_desc desc;
+
+	d_state = desc_read(desc_ring, tail_id, &desc, NULL);
+
+	switch (d_state) {
+	case desc_miss:
+		/*
+		 * If the ID is exactly one wrap behind, the descriptor is
+		 * being reserved by another writer and counts as reserved.
+		 */
+		if (DESC_ID(atomic_long_read(&desc.state_var)) ==
+		    DESC_ID_PREV_WRAP(desc_ring, tail_id)) {
+			return false;
+		}
+
+		/*
+		 * Otherwise another writer pushed the tail and recycled the
+		 * descriptor already, which is all we wanted.
+		 */
+		return true;
+	case desc_reserved:
+		return false;
+	case desc_committed:
+		desc_make_reusable(desc_ring, tail_id);
+		break;
+	case desc_reusable:
+		break;
+	}
+
+	/*
+	 * The data blocks must be invalidated before the descriptor can be
+	 * recycled; afterwards there is no way to tell whether they can be
+	 * trusted.
+	 */
+	if (!data_push_tail(rb, desc.text_blk_lpos.next))
+		return false;
+
+	/*
+	 * The tail must always be committed or reusable, prb_first_seq()
+	 * relies on it.  A successful read also means the next descriptor
+	 * is not beyond the head.
+	 */
+	d_state = desc_read(desc_ring, DESC_ID(tail_id + 1), &desc, NULL);
+	if (d_state == desc_committed || d_state == desc_reusable) {
+		atomic_long_cmpxchg_relaxed(&desc_ring->tail_id, tail_id,
+					    DESC_ID(tail_id + 1));
+	} else {
+		/*
+		 * Load the state before re-checking the tail: if another CPU
+		 * moved it on meanwhile, the next descriptor does not matter.
+		 */
+		smp_rmb();
+		if (atomic_long_read(&desc_ring->tail_id) == tail_id)
+			return false;
+	}
+
+	return true;
+}
+
+/* Reserve a new descriptor, invalidating the oldest if necessary. */
+static bool desc_reserve(struct printk_ringbuffer *rb, unsigned long *id_out)
+{
+	struct prb_desc_ring *desc_ring = &rb->desc_ring;
+	unsigned long prev_state_val;
+	unsigned long id_prev_wrap;
+	struct prb_desc *desc;
+	unsigned long head_id;
+	unsigned long id;
+
+	head_id = atomic_long_read(&desc_ring->head_id);
+
+	do {
+		id = DESC_ID(head_id + 1);
+		id_prev_wrap = DESC_ID_PREV_WRAP(desc_ring, id);
+
+		/* Load the head ID before the tail ID. */
+		smp_rmb();
+
+		if (id_prev_wrap == atomic_long_read(&desc_ring->tail_id)) {
+			/* Make space by advancing the tail. */
+			if (!desc_push_tail(rb, id_prev_wrap))
+				return false;
+		}
+
+		/*
+		 * The full barrier of a successful cmpxchg orders the tail
+		 * load and the data invalidation above before the new head
+		 * can be seen.
+		 */
+	} while (!atomic_long_try_cmpxchg(&desc_ring->head_id, &head_id, id));
+
+	desc = to_desc(desc_ring, id);
+
+	/*
+	 * A never used descriptor has a state of 0; any other must be the
+	 * reusable one from the previous wrap.
+	 */
+	prev_state_val = atomic_long_read(&desc->state_var);
+	if (prev_state_val &&
+	    get_desc_state(id_prev_wrap, prev_state_val) != desc_reusable) {
+		WARN_ON_ONCE(1);
+		return false;
+	}
+
+	/*
+	 * Store the new ID and state before anything else is written to the
+	 * descriptor or its data, so readers of the old record notice.
+	 */
+	if (!atomic_long_try_cmpxchg(&desc->state_var, &prev_state_val,
+				     DESC_SV(id, desc_reserved))) {
+		WARN_ON_ONCE(1);
+		return false;
+	}
+
+	*id_out = id;
+	return true;
+}
+
+/* Determine the end of a data block of @size bytes starting at @lpos. */
+static unsigned long get_next_lpos(struct prb_data_ring *data_ring,
+				   unsigned long lpos, unsigned int size)
+{
+	unsigned long begin_lpos;
+	unsigned long next_lpos;
+
+	begin_lpos = lpos;
+	next_lpos = lpos + size;
+
+	/* First check if the data block does not wrap. */
+	if (DATA_WRAPS(data_ring, begin_lpos) == DATA_WRAPS(data_ring, next_lpos))
+		return next_lpos;
+
+	/* Wrapping data blocks store their data at the beginning. */
+	return (DATA_THIS_WRAP_START_LPOS(data_ring, next_lpos) + size);
+}
+
+/*
+ * Allocate a data block of @size bytes for descriptor @id, invalidating old
+ * blocks if necessary, and return its data.  On failure the descriptor is
+ * marked as having no data.
+ */
+static char *data_alloc(struct printk_ringbuffer *rb, unsigned int size,
+			struct prb_data_blk_lpos *blk_lpos, unsigned long id)
+{
+	struct prb_data_ring *data_ring = &rb->text_data_ring;
+	struct prb_data_block *blk;
+	unsigned long begin_lpos;
+	unsigned long next_lpos;
+
+	size = to_blk_size(size);
+
+	begin_lpos = atomic_long_read(&data_ring->head_lpos);
+
+	do {
+		next_lpos = get_next_lpos(data_ring, begin_lpos, size);
+
+		if (!data_push_tail(rb, next_lpos - DATA_SIZE(data_ring))) {
+			blk_lpos->begin = FAILED_LPOS;
+			blk_lpos->next = FAILED_LPOS;
+			return NULL;
+		}
+
+		/*
+		 * The full barrier of a successful cmpxchg orders the
+		 * reusable states stored while pushing the tail before the
+		 * data is overwritten.
+		 */
+	} while (!atomic_long_try_cmpxchg(&data_ring->head_lpos, &begin_lpos,
+					  next_lpos));
+
+	blk = to_block(data_ring, begin_lpos);
+	WRITE_ONCE(blk->id, id);
+
+	if (DATA_WRAPS(data_ring, begin_lpos) != DATA_WRAPS(data_ring, next_lpos)) {
+		/* Wrapping data blocks store their data at the beginning. */
+		blk = to_block(data_ring, 0);
+
+		/* Not needed by the ring buffer, but keeps dumps readable. */
+		WRITE_ONCE(blk->id, id);
+	}
+
+	blk_lpos->begin = begin_lpos;
+	blk_lpos->next = next_lpos;
+
+	return &blk->data[0];
+}
+
+/*
+ * Return the data of a block and its size, which includes the alignment
+ * padding, or NULL if the descriptor has no data.
+ */
+static const char *get_data(struct prb_data_ring *data_ring,
+			    struct prb_data_blk_lpos *blk_lpos,
+			    unsigned int *data_size)
+{
+	struct prb_data_block *db;
+
+	/* Data-less data block description. */
+	if (LPOS_DATALESS(blk_lpos->begin) && LPOS_DATALESS(blk_lpos->next))
+		return NULL;
+
+	/* Regular data block: @begin less than @next and in same wrap. */
+	if (DATA_WRAPS(data_ring, blk_lpos->begin) == DATA_WRAPS(data_ring, blk_lpos->next) &&
+	    blk_lpos->begin < blk_lpos->next) {
+		db = to_block(data_ring, blk_lpos->begin);
+		*data_size = blk_lpos->next - blk_lpos->begin;
+
+	/* Wrapping data block: @begin is one wrap behind @next. */
+	} else if (DATA_WRAPS(data_ring, blk_lpos->begin + DATA_SIZE(data_ring)) ==
+		   DATA_WRAPS(data_ring, blk_lpos->next)) {
+		db = to_block(data_ring, 0);
+		*data_size = DATA_INDEX(data_ring, blk_lpos->next);
+
+	/* Illegal block description. */
+	} else {
+		WARN_ON_ONCE(1);
+		return NULL;
+	}
+
+	/* A valid data block is aligned and has at least an ID. */
+	if (WARN_ON_ONCE(blk_lpos->begin != ALIGN(blk_lpos->begin, sizeof(db->id))) ||
+	    WARN_ON_ONCE(blk_lpos->next != ALIGN(blk_lpos->next, sizeof(db->id))) ||
+	    WARN_ON_ONCE(*data_size < sizeof(db->id))) {
+		return NULL;
+	}
+
+	*data_size -= sizeof(db->id);
+
+	return &db->data[0];
+}
+
+/**
+ * prb_reserve() - Reserve space for a record.
+ * @e:    The entry structure to set up for prb_commit().
+ * @rb:   The ring buffer to reserve in.
+ * @size: The size of the record data, must be non-zero.
+ * @seq:  Set to the sequence number of the record, if not NULL.
+ *
+ * The oldest records are invalidated as needed to make room.  Interrupts
+ * are disabled until prb_commit().
+ *
+ * Return: A pointer to @size bytes to fill in, or NULL if no space could be
+ *         reserved.  On failure there is nothing to commit.
+ */
+void *prb_reserve(struct prb_reserved_entry *e, struct printk_ringbuffer *rb,
+		  unsigned int size, u64 *seq)
+{
+	struct prb_desc_ring *desc_ring = &rb->desc_ring;
+	struct prb_desc *d;
+	unsigned long id;
+	char *data;
+
+	if (!data_check_size(&rb->text_data_ring, size))
+		return NULL;
+
+	/*
+	 * A reserved descriptor blocks further reservations once the ring
+	 * wraps onto it, so keep the window short.
+	 */
+	local_irq_save(e->irqflags);
+
+	if (!desc_reserve(rb, &id)) {
+		atomic_long_inc(&rb->fail);
+		local_irq_restore(e->irqflags);
+		return NULL;
+	}
+
+	d = to_desc(desc_ring, id);
+
+	/*
+	 * The sequence number advances by the ring size on each reuse of a
+	 * descriptor.  Unused descriptors start out with 0 (index 0 is
+	 * preset so that its first record gets 0 too), so they take their
+	 * index instead.
+	 */
+	if (d->seq == 0 && DESC_INDEX(desc_ring, id) != 0)
+		d->seq = DESC_INDEX(desc_ring, id);
+	else
+		d->seq += DESCS_COUNT(desc_ring);
+
+	e->rb = rb;
+	e->id = id;
+
+	data = data_alloc(rb, size, &d->text_blk_lpos, id);
+	if (!data) {
+		/* Readers skip the data-less record. */
+		atomic_long_inc(&rb->fail);
+		prb_commit(e);
+		return NULL;
+	}
+
+	if (seq)
+		*seq = d->seq;
+	return data;
+}
+
+/**
+ * prb_commit() - Make a reserved record visible to readers.
+ * @e: The entry from prb_reserve().
+ *
+ * Re-enables interrupts.
+ */
+void prb_commit(struct prb_reserved_entry *e)
+{
+	struct prb_desc_ring *desc_ring = &e->rb->desc_ring;
+	struct prb_desc *d = to_desc(desc_ring, e->id);
+	unsigned long prev_state_val = DESC_SV(e->id, desc_reserved);
+
+	/* The full barrier orders the record data before the new state. */
+	if (!atomic_long_try_cmpxchg(&d->state_var, &prev_state_val,
+				     DESC_SV(e->id, desc_committed))) {
+		WARN_ON_ONCE(1);
+	}
+
+	local_irq_restore(e->irqflags);
+}
+
+/*
+ * Copy the descriptor @id and check that it is the committed record @seq.
+ *
+ * Return: 0 if it is, -ENOENT if the record exists but has no data (left),
+ *         -EINVAL if it does not exist or is not committed yet.
+ */
+static int desc_read_committed_seq(struct prb_desc_ring *desc_ring,
+				   unsigned long id, u64 seq,
+				   struct prb_desc *desc_out)
+{
+	struct prb_data_blk_lpos *blk_lpos = &desc_out->text_blk_lpos;
+	enum desc_state d_state;
+	u64 s;
+
+	d_state = desc_read(desc_ring, id, desc_out, &s);
+
+	if (d_state == desc_miss || d_state == desc_reserved || s != seq)
+		return -EINVAL;
+
+	if (d_state == desc_reusable ||
+	    (blk_lpos->begin == FAILED_LPOS && blk_lpos->next == FAILED_LPOS)) {
+		return -ENOENT;
+	}
+
+	return 0;
+}
+
+/*
+ * Copy the record @seq to @buf, truncated to @size bytes, and set @len to
+ * its full size.  With @buf NULL only check that the record is readable.
+ */
+static int prb_read(struct printk_ringbuffer *rb, u64 seq,
+		    void *buf, unsigned int size, unsigned int *len)
+{
+	struct prb_desc_ring *desc_ring = &rb->desc_ring;
+	struct prb_desc *rdesc = to_desc(desc_ring, seq);
+	unsigned int data_size;
+	struct prb_desc desc;
+	const char *data;
+	unsigned long id;
+	int err;
+
+	/* Extract the ID, used to specify the descriptor to read. */
+	id = DESC_ID(atomic_long_read(&rdesc->state_var));
+
+	err = desc_read_committed_seq(desc_ring, id, seq, &desc);
+	if (err || !buf)
+		return err;
+
+	data = get_data(&rb->text_data_ring, &desc.text_blk_lpos, &data_size);
+	if (!data)
+		return -ENOENT;
+
+	memcpy(buf, data, min(data_size, size));
+	if (len)
+		*len = data_size;
+
+	/* The copy is only valid if the record was not recycled meanwhile. */
+	return desc_read_committed_seq(desc_ring, id, seq, &desc);
+}
+
+/* The sequence number of the tail descriptor, which may have no data. */
+static u64 prb_first_seq(struct printk_ringbuffer *rb)
+{
+	struct prb_desc_ring *desc_ring = &rb->desc_ring;
+	enum desc_state d_state;
+	struct prb_desc desc;
+	unsigned long id;
+	u64 seq;
+
+	for (;;) {
+		id = atomic_long_read(&rb->desc_ring.tail_id);
+
+		/* The tail is always committed or reusable. */
+		d_state = desc_read(desc_ring, id, &desc, &seq);
+		if (d_state == desc_committed || d_state == desc_reusable)
+			break;
+
+		/* Load the state before re-loading the tail ID. */
+		smp_rmb();
+	}
+
+	return seq;
+}
+
+/**
+ * prb_read_valid() - Read the next available record.
+ * @rb:   The ring buffer to read from.
+ * @seq:  The sequence number to start at, set to that of the record read.
+ * @buf:  The buffer to copy the record to, or NULL to only check for one.
+ * @size: The size of @buf.
+ * @len:  Set to the size of the record, if not NULL.  It may be larger than
+ *        @size, and includes up to sizeof(long) - 1 bytes of padding.
+ *
+ * Records that have been overwritten, or were lost because the ring was
+ * full, are skipped.
+ *
+ * Return: false if there is no record at or after @seq yet.
+ */
+bool prb_read_valid(struct printk_ringbuffer *rb, u64 *seq,
+		    void *buf, unsigned int size, unsigned int *len)
+{
+	u64 tail_seq;
+	int err;
+
+	while ((err = prb_read(rb, *seq, buf, size, len))) {
+		tail_seq = prb_first_seq(rb);
+
+		if (*seq < tail_seq) {
+			/* Behind the tail: catch up and try again. */
+			*seq = tail_seq;
+		} else if (err == -ENOENT) {
+			/* The record exists but its data is gone: skip it. */
+			(*seq)++;
+		} else {
+			/* Not there or not committed yet. */
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * prb_first_valid_seq() - Get the sequence number of the oldest record.
+ * @rb: The ring buffer.
+ *
+ * Return: The sequence number of the oldest readable record, or 0 if there
+ *         is none.
+ */
+u64 prb_first_valid_seq(struct printk_ringbuffer *rb)
+{
+	u64 seq = 0;
+
+	if (!prb_read_valid(rb, &seq, NULL, 0, NULL))
+		return 0;
+
+	return seq;
+}
+
+/**
+ * prb_next_seq() - Get the sequence number after the last readable record.
+ * @rb: The ring buffer.
+ *
+ * This walks the whole ring, so it is meant for the slow reader paths only.
+ * Readers waiting for new records should use prb_read_valid() instead.
+ *
+ * Return: The sequence number the next record will have, unless one is
+ *         still being written, in which case it is the sequence number of
+ *         the oldest such record.
+ */
+u64 prb_next_seq(struct printk_ringbuffer *rb)
+{
+	u64 seq = 0;
+
+	while (prb_read_valid(rb, &seq, NULL, 0, NULL))
+		seq++;
+
+	return seq;
+}
+
+/**
+ * prb_init() - Initialize a ring buffer for dynamically allocated memory.
+ * @rb:       The ring buffer.
+ * @text_buf: The data ring, 2^@textbits bytes aligned to a long.
+ * @textbits: The size of @text_buf as a power of 2.
+ * @descs:    The descriptor ring, 2^@descbits entries.
+ * @descbits: The number of descriptors as a power of 2.
+ *
+ * See DEFINE_PRINTKRB() for static ring buffers.
+ */
+void prb_init(struct printk_ringbuffer *rb,
+	      char *text_buf, unsigned int textbits,
+	      struct prb_desc *descs, unsigned int descbits)
+{
+	memset(descs, 0, _DESCS_COUNT(descbits) * sizeof(descs[0]));
+
+	rb->desc_ring.count_bits = descbits;
+	rb->desc_ring.descs = descs;
+	atomic_long_set(&rb->desc_ring.head_id, DESC0_ID(descbits));
+	atomic_long_set(&rb->desc_ring.tail_id, DESC0_ID(descbits));
+
+	rb->text_data_ring.size_bits = textbits;
+	rb->text_data_ring.data = text_buf;
+	atomic_long_set(&rb->text_data_ring.head_lpos, BLK0_LPOS(textbits));
+	atomic_long_set(&rb->text_data_ring.tail_lpos, BLK0_LPOS(textbits));
+
+	atomic_long_set(&rb->fail, 0);
+
+	descs[0].seq = -(u64)_DESCS_COUNT(descbits);
+
+	atomic_long_set(&descs[_DESCS_COUNT(descbits) - 1].state_var,
+			DESC0_SV(descbits));
+	descs[_DESCS_COUNT(descbits) - 1].text_blk_lpos.begin = FAILED_LPOS;
+	descs[_DESCS_COUNT(descbits) - 1].text_blk_lpos.next = FAILED_LPOS;
+}
@@ -0,0 +1,139 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+#ifndef _KERNEL_PRINTK_RINGBUFFER_H
+#define _KERNEL_PRINTK_RINGBUFFER_H
+
+#include <linux/atomic.h>
+#include <linux/types.h>
+
+/*
+ * Lockless multi-writer ring buffer for printk records, see the comment at
+ * the top of printk_ringbuffer.c.  The records are opaque byte strings to the
+ * ring buffer; printk.c stores a complete struct printk_log in each one.
+ */
+
+/* Logical positions of a data block: [begin, next) */
+struct prb_data_blk_lpos {
+	unsigned long	begin;
+	unsigned long	next;
+};
+
+struct prb_desc {
+	atomic_long_t			state_var;	/* ID and state */
+	struct prb_data_blk_lpos	text_blk_lpos;
+	u64				seq;
+};
+
+struct prb_data_ring {
+	unsigned int	size_bits;
+	char		*data;
+	atomic_long_t	head_lpos;
+	atomic_long_t	tail_lpos;
+};
+
+struct prb_desc_ring {
+	unsigned int		count_bits;
+	struct prb_desc		*descs;
+	atomic_long_t		head_id;
+	atomic_long_t		tail_id;
+};
+
+struct printk_ringbuffer {
+	struct prb_desc_ring	desc_ring;
+	struct prb_data_ring	text_data_ring;
+	atomic_long_t		fail;		/* records lost to a full ring */
+};
+
+/* A writer's handle between prb_reserve() and prb_commit() */
+struct prb_reserved_entry {
+	struct printk_ringbuffer	*rb;
+	unsigned long			irqflags;
+	unsigned long			id;
+};
+
+/* The state of a descriptor, stored in the top bits of state_var */
+enum desc_state {
+	desc_miss	= -1,	/* ID mismatch (pseudo state) */
+	desc_reserved	= 0x0,	/* reserved, in use by a writer */
+	desc_committed	= 0x1,	/* committed, readable */
+	desc_reusable	= 0x3,	/* free, not yet used by any writer */
+};
+
+#define _DATA_SIZE(sz_bits)	(1UL << (sz_bits))
+#define _DESCS_COUNT(ct_bits)	(1U << (ct_bits))
+#define DESC_SV_BITS		(sizeof(unsigned long) * 8)
+#define DESC_FLAGS_SHIFT	(DESC_SV_BITS - 2)
+#define DESC_FLAGS_MASK		(3UL << DESC_FLAGS_SHIFT)
+#define DESC_STATE(sv)		(3UL & ((sv) >> DESC_FLAGS_SHIFT))
+#define DESC_SV(id, state)	(((unsigned long)(state) << DESC_FLAGS_SHIFT) | (id))
+#define DESC_ID_MASK		(~DESC_FLAGS_MASK)
+#define DESC_ID(sv)		((sv) & DESC_ID_MASK)
+
+/* Data block positions that carry no data; real ones are long aligned */
+#define FAILED_LPOS		0x1
+#define NO_LPOS			0x3
+
+#define FAILED_BLK_LPOS	\
+{				\
+	.begin	= FAILED_LPOS,	\
+	.next	= FAILED_LPOS,	\
+}
+
+/*
+ * The initial head and tail both point at the last descriptor, which is
+ * reusable and has no data. The IDs start so that they overflow soon after
+ * boot, to catch wrap bugs early rather than after weeks of uptime.
+ */
+#define DESC0_ID(ct_bits)	DESC_ID(-(_DESCS_COUNT(ct_bits) + 1))
+#define DESC0_SV(ct_bits)	DESC_SV(DESC0_ID(ct_bits), desc_reusable)
+#define BLK0_LPOS(sz_bits)	(-(_DATA_SIZE(sz_bits)))
+
+/*
+ * Define a ring buffer with 2^descbits descriptors and a text data ring of
+ * 2^(descbits + avgtextbits) bytes at @text_buf, which must be aligned to
+ * the size of a long.
+ */
+#define DEFINE_PRINTKRB(name, descbits, avgtextbits, text_buf)			\
+static struct prb_desc _##name##_descs[_DESCS_COUNT(descbits)] = {		\
+	/* index 0 gets seq 0 on its first use */				\
+	[0] = {									\
+		.seq		= -(u64)_DESCS_COUNT(descbits),			\
+	},									\
+	/* the initial head and tail */						\
+	[_DESCS_COUNT(descbits) - 1] = {					\
+		.state_var	= ATOMIC_LONG_INIT(DESC0_SV(descbits)),		\
+		.text_blk_lpos	= FAILED_BLK_LPOS,				\
+	},									\
+};										\
+static struct printk_ringbuffer name = {					\
+	.desc_ring = {								\
+		.count_bits	= descbits,					\
+		.descs		= &_##name##_descs[0],				\
+		.head_id	= ATOMIC_LONG_INIT(DESC0_ID(descbits)),		\
+		.tail_id	= ATOMIC_LONG_INIT(DESC0_ID(descbits)),		\
+	},									\
+	.text_data_ring = {							\
+		.size_bits	= (avgtextbits) + (descbits),			\
+		.data		= text_buf,					\
+		.head_lpos	= ATOMIC_LONG_INIT(BLK0_LPOS((avgtextbits) + (descbits))), \
+		.tail_lpos	= ATOMIC_LONG_INIT(BLK0_LPOS((avgtextbits) + (descbits))), \
+	},									\
+	.fail		= ATOMIC_LONG_INIT(0),					\
+}
+
+/* Writer interface */
+void *prb_reserve(struct prb_reserved_entry *e, struct printk_ringbuffer *rb,
+		  unsigned int size, u64 *seq);
+void prb_commit(struct prb_reserved_entry *e);
+
+void prb_init(struct printk_ringbuffer *rb,
+	      char *text_buf, unsigned int textbits,
+	      struct prb_desc *descs, unsigned int descbits);
+
+/* Reader interface */
+bool prb_read_valid(struct printk_ringbuffer *rb, u64 *seq,
+		    void *buf, unsigned int size, unsigned int *len);
+u64 prb_first_valid_seq(struct printk_ringbuffer *rb);
+u64 prb_next_seq(struct printk_ringbuffer *rb);
+
+#endif /* _KERNEL_PRINTK_RINGBUFFER_H */
@@ -32,6 +32,7 @@
 #include <linux/smp.h>
 #include <linux/rcupdate.h>
 #include <linux/interrupt.h>
+#include <linux/kernel_stat.h>
 #include <linux/sched.h>
 #include <uapi/linux/sched/types.h>
 #include <linux/atomic.h>
@@ -85,6 +86,8 @@ MODULE_AUTHOR("Paul E. McKenney <paulmck@linux.vnet.ibm.com>");
 
 torture_param(bool, gp_async, false, "Use asynchronous GP wait primitives");
 torture_param(int, gp_async_max, 1000, "Max # outstanding waits per reader");
+torture_param(int, gp_async_sleep, 0,
+	      "Sleep (ms) between asynchronous GP requests, zero to disable");
 torture_param(bool, gp_exp, false, "Use expedited GP wait primitives");
 torture_param(int, holdoff, 10, "Holdoff time before test start (s)");
 torture_param(int, nreaders, -1, "Number of RCU reader threads");
@@ -114,6 +117,8 @@ static u64 t_rcu_perf_writer_started;
 static u64 t_rcu_perf_writer_finished;
 static unsigned long b_rcu_perf_writer_started;
 static unsigned long b_rcu_perf_writer_finished;
+static unsigned long s_rcu_perf_writer_started;
+static unsigned long s_rcu_perf_writer_finished;
 static DEFINE_PER_CPU(atomic_t, n_async_inflight);
 
 static int rcu_perf_writer_state;
@@ -189,6 +194,27 @@ static struct rcu_perf_ops rcu_ops = {
 	.name		= "rcu"
 };
 
+/*
+ * Definitions for lazy rcu perf testing.  Use with gp_async=1 and
+ * gp_async_sleep to compare grace periods and RCU core invocations
+ * against perf_type=rcu for a trickle of callbacks.
+ */
+
+static struct rcu_perf_ops rcu_lazy_ops = {
+	.ptype		= RCU_FLAVOR,
+	.init		= rcu_sync_perf_init,
+	.readlock	= rcu_perf_read_lock,
+	.readunlock	= rcu_perf_read_unlock,
+	.get_gp_seq	= rcu_get_gp_seq,
+	.gp_diff	= rcu_seq_diff,
+	.exp_completed	= rcu_exp_batches_completed,
+	.async		= call_rcu_lazy,
+	.gp_barrier	= rcu_barrier,
+	.sync		= synchronize_rcu,
+	.exp_sync	= synchronize_rcu_expedited,
+	.name		= "rcu_lazy"
+};
+
 /*
  * Definitions for rcu_bh perf testing.
  */
@@ -369,6 +395,20 @@ static unsigned long rcuperf_seq_diff(unsigned long new, unsigned long old)
 	return cur_ops->gp_diff(new, old);
 }
 
+/*
+ * Count RCU core invocations on all CPUs, each of which is a wakeup
+ * of an otherwise idle CPU when the system is idle.
+ */
+static unsigned long rcu_perf_softirqs(void)
+{
+	unsigned long n = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		n += kstat_softirqs_cpu(RCU_SOFTIRQ, cpu);
+	return n;
+}
+
 /*
  * If performance tests complete, wait for shutdown to commence.
  */
@@ -451,6 +491,7 @@ rcu_perf_writer(void *arg)
 		} else {
 			b_rcu_perf_writer_started = cur_ops->get_gp_seq();
 		}
+		s_rcu_perf_writer_started = rcu_perf_softirqs();
 	}
 
 	do {
@@ -474,6 +515,9 @@ retry:
 			} else {
 				kfree(rhp); /* Because we are stopping. */
 			}
+			if (gp_async_sleep)
+				schedule_timeout_interruptible(
+					msecs_to_jiffies(gp_async_sleep));
 		} else if (gp_exp) {
 			rcu_perf_writer_state = RTWS_EXP_SYNC;
 			cur_ops->exp_sync();
@@ -508,6 +552,8 @@ retry:
 					b_rcu_perf_writer_finished =
 						cur_ops->get_gp_seq();
 				}
+				s_rcu_perf_writer_finished =
+					rcu_perf_softirqs();
 				if (shutdown) {
 					smp_mb(); /* Assign before wake. */
 					wake_up(&shutdown_wq);
@@ -592,6 +638,8 @@ rcu_perf_cleanup(void)
 			 ngps,
 			 rcuperf_seq_diff(b_rcu_perf_writer_finished,
 					  b_rcu_perf_writer_started));
+		pr_alert("%s%s rcu_softirqs: %lu\n", perf_type, PERF_FLAG,
+			 s_rcu_perf_writer_finished - s_rcu_perf_writer_started);
 		for (i = 0; i < nrealwriters; i++) {
 			if (!writer_durations)
 				break;
@@ -665,8 +713,8 @@ rcu_perf_init(void)
 	long i;
 	int firsterr = 0;
 	static struct rcu_perf_ops *perf_ops[] = {
-		&rcu_ops, &rcu_bh_ops, &srcu_ops, &srcud_ops, &sched_ops,
-		&tasks_ops,
+		&rcu_ops, &rcu_lazy_ops, &rcu_bh_ops, &srcu_ops, &srcud_ops,
+		&sched_ops, &tasks_ops,
 	};
 
 	if (!torture_init_begin(perf_type, verbose))
@@ -211,6 +211,11 @@ struct rcu_data {
 	unsigned long	n_force_qs_snap;
 					/* did other CPU force QS recently? */
 	long		blimit;		/* Upper limit on a processed batch */
+#ifdef CONFIG_RCU_LAZY
+	struct rcu_cblist lazy_cbs;	/* call_rcu_lazy() CBs held back */
+					/*  from ->cblist. */
+	struct timer_list lazy_timer;	/* Enforce finite deferral. */
+#endif /* #ifdef CONFIG_RCU_LAZY */
 
 	/* 3) dynticks interface. */
 	struct rcu_dynticks *dynticks;	/* Shared per-CPU dynticks state. */
@@ -460,6 +465,10 @@ static void rcu_prepare_kthreads(int cpu);
 static void rcu_cleanup_after_idle(void);
 static void rcu_prepare_for_idle(void);
 static void rcu_idle_count_callbacks_posted(void);
+static bool rcu_lazy_flush(struct rcu_data *rdp);
+static long rcu_lazy_n_cbs(struct rcu_data *rdp);
+static void rcu_lazy_migrate(struct rcu_data *rdp);
+static void __init rcu_boot_init_lazy_percpu_data(struct rcu_data *rdp);
 static bool rcu_preempt_has_tasks(struct rcu_node *rnp);
 static void print_cpu_stall_info_begin(void);
 static void print_cpu_stall_info(struct rcu_state *rsp, int cpu);
@@ -27,6 +27,7 @@
 #include <linux/delay.h>
 #include <linux/gfp.h>
 #include <linux/oom.h>
+#include <linux/shrinker.h>
 #include <linux/sched/debug.h>
 #include <linux/smpboot.h>
 #include <linux/sched/isolation.h>
@@ -1839,6 +1840,215 @@ static void increment_cpu_stall_ticks(void)
 		raw_cpu_inc(rsp->rda->ticks_this_gp);
 }
 
+#ifdef CONFIG_RCU_LAZY
+
+/*
+ * Batch callbacks posted by call_rcu_lazy().  Instead of being queued
+ * on ->cblist, where they would prompt a grace period of their own, they
+ * are held on a per-CPU ->lazy_cbs list until either rcu_lazy_jiffies
+ * have passed since the first of them was posted or rcu_lazy_qhimark
+ * of them have accumulated.  They are then moved to ->cblist as a batch,
+ * so that a trickle of them costs one grace period, and an otherwise
+ * idle CPU is woken at most once per rcu_lazy_jiffies rather than once
+ * per callback.  rcu_barrier(), CPU hotplug and memory pressure flush
+ * ->lazy_cbs early.  No-CBs CPUs queue lazy callbacks as usual.
+ */
+#define RCU_LAZY_DELAY (10 * HZ)	/* Roughly ten seconds. */
+
+static ulong rcu_lazy_jiffies = RCU_LAZY_DELAY;
+module_param(rcu_lazy_jiffies, ulong, 0644);
+static long rcu_lazy_qhimark = 1000;
+module_param(rcu_lazy_qhimark, long, 0644);
+
+/*
+ * Move the specified CPU's held-back lazy callbacks to its ->cblist,
+ * returning true if there were any.  The caller must have disabled
+ * interrupts and be running on the CPU owning rdp, or that CPU must
+ * be offline.
+ */
+static bool rcu_lazy_flush(struct rcu_data *rdp)
+{
+	if (!rdp->lazy_cbs.len)
+		return false;
+	rcu_segcblist_insert_count(&rdp->cblist, &rdp->lazy_cbs);
+	rcu_segcblist_insert_pend_cbs(&rdp->cblist, &rdp->lazy_cbs);
+	rcu_idle_count_callbacks_posted();
+	return true;
+}
+
+static long rcu_lazy_n_cbs(struct rcu_data *rdp)
+{
+	return READ_ONCE(rdp->lazy_cbs.len);
+}
+
+/* The deferral period expired, so hand the batch to RCU. */
+static void rcu_lazy_timer(struct timer_list *t)
+{
+	struct rcu_data *rdp = from_timer(rdp, t, lazy_timer);
+	unsigned long flags;
+
+	local_irq_save(flags);
+	/* A timer migrated off an outgoing CPU leaves it to migration. */
+	if (rdp->cpu == smp_processor_id() && rcu_lazy_flush(rdp))
+		invoke_rcu_core();
+	local_irq_restore(flags);
+}
+
+/* Flush a dead CPU's lazy callbacks so that they are migrated too. */
+static void rcu_lazy_migrate(struct rcu_data *rdp)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	rcu_lazy_flush(rdp);
+	local_irq_restore(flags);
+	del_timer(&rdp->lazy_timer);
+}
+
+/**
+ * call_rcu_lazy() - Queue an RCU callback that is in no hurry.
+ * @head: structure to be used for queueing the RCU updates.
+ * @func: actual callback function to be invoked after the grace period
+ *
+ * Like call_rcu(), but the callback may be held back for up to
+ * rcu_lazy_jiffies before a grace period is started on its behalf, so
+ * that it can share that grace period with other lazy callbacks.  This
+ * suits callbacks that only free memory, such as the freeing of inodes,
+ * where batching saves power on mostly idle systems.  rcu_barrier()
+ * waits for lazy callbacks just as it does for call_rcu() callbacks.
+ */
+void call_rcu_lazy(struct rcu_head *head, rcu_callback_t func)
+{
+	struct rcu_state *rsp = rcu_state_p;
+	unsigned long flags;
+	struct rcu_data *rdp;
+
+	if (!READ_ONCE(rcu_lazy_jiffies) ||
+	    rcu_scheduler_active == RCU_SCHEDULER_INACTIVE) {
+		call_rcu(head, func);
+		return;
+	}
+
+	/* Misaligned rcu_head! */
+	WARN_ON_ONCE((unsigned long)head & (sizeof(void *) - 1));
+
+	if (debug_rcu_head_queue(head)) {
+		WARN_ONCE(1, "call_rcu_lazy(): Double-freed CB %p->%pF()!!!\n",
+			  head, head->func);
+		WRITE_ONCE(head->func, rcu_leak_callback);
+		return;
+	}
+	head->func = func;
+	head->next = NULL;
+	local_irq_save(flags);
+	rdp = this_cpu_ptr(rsp->rda);
+
+	/* No-CBs or offline CPU: let __call_rcu() sort it out. */
+	if (unlikely(!rcu_segcblist_is_enabled(&rdp->cblist))) {
+		local_irq_restore(flags);
+		debug_rcu_head_unqueue(head);
+		call_rcu(head, func);
+		return;
+	}
+
+	if (!rdp->lazy_cbs.len)
+		mod_timer(&rdp->lazy_timer, jiffies + rcu_lazy_jiffies);
+	rcu_cblist_enqueue(&rdp->lazy_cbs, head);
+	trace_rcu_callback(rsp->name, head,
+			   rcu_segcblist_n_lazy_cbs(&rdp->cblist),
+			   rcu_segcblist_n_cbs(&rdp->cblist) +
+			   rdp->lazy_cbs.len);
+
+	if (rdp->lazy_cbs.len >= READ_ONCE(rcu_lazy_qhimark)) {
+		rcu_lazy_flush(rdp);
+		del_timer(&rdp->lazy_timer);
+		__call_rcu_core(rsp, rdp, head, flags);
+	}
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL_GPL(call_rcu_lazy);
+
+static unsigned long rcu_lazy_shrink_count(struct shrinker *shrink,
+					   struct shrink_control *sc)
+{
+	unsigned long count = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu)
+		count += rcu_lazy_n_cbs(per_cpu_ptr(rcu_state_p->rda, cpu));
+	return count ? count : SHRINK_EMPTY;
+}
+
+static void rcu_lazy_flush_cpu(void *unused)
+{
+	if (rcu_lazy_flush(this_cpu_ptr(rcu_state_p->rda)))
+		invoke_rcu_core();
+}
+
+/*
+ * Under memory pressure, stop holding back lazy callbacks.  As with
+ * rcu_oom_notify(), the memory is only freed after a grace period, so
+ * claim to have freed what was flushed and let reclaim move on.
+ */
+static unsigned long rcu_lazy_shrink_scan(struct shrinker *shrink,
+					  struct shrink_control *sc)
+{
+	unsigned long count = 0;
+	long n;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		n = rcu_lazy_n_cbs(per_cpu_ptr(rcu_state_p->rda, cpu));
+		if (!n)
+			continue;
+		smp_call_function_single(cpu, rcu_lazy_flush_cpu, NULL, 1);
+		count += n;
+		if (count >= sc->nr_to_scan)
+			break;
+	}
+	return count ? count : SHRINK_STOP;
+}
+
+static struct shrinker rcu_lazy_shrinker = {
+	.count_objects	= rcu_lazy_shrink_count,
+	.scan_objects	= rcu_lazy_shrink_scan,
+	.seeks		= DEFAULT_SEEKS,
+};
+
+static int __init rcu_register_lazy_shrinker(void)
+{
+	return register_shrinker(&rcu_lazy_shrinker);
+}
+core_initcall(rcu_register_lazy_shrinker);
+
+static void __init rcu_boot_init_lazy_percpu_data(struct rcu_data *rdp)
+{
+	rcu_cblist_init(&rdp->lazy_cbs);
+	timer_setup(&rdp->lazy_timer, rcu_lazy_timer, TIMER_PINNED);
+}
+
+#else /* #ifdef CONFIG_RCU_LAZY */
+
+static bool rcu_lazy_flush(struct rcu_data *rdp)
+{
+	return false;
+}
+
+static long rcu_lazy_n_cbs(struct rcu_data *rdp)
+{
+	return 0;
+}
+
+static void rcu_lazy_migrate(struct rcu_data *rdp)
+{
+}
+
+static void __init rcu_boot_init_lazy_percpu_data(struct rcu_data *rdp)
+{
+}
+
+#endif /* #else #ifdef CONFIG_RCU_LAZY */
+
 #ifdef CONFIG_RCU_NOCB_CPU
 
 /*
@@ -163,4 +163,26 @@ DECLARE_PER_CPU(struct hrtimer_cpu_base, hrtimer_bases);
 
 extern u64 get_next_timer_interrupt(unsigned long basej, u64 basem);
 void timer_clear_idle(void);
+
+#ifdef CONFIG_TIMER_MIGRATION
+struct tmigr_cpu_stats {
+	unsigned long	handoffs;	/* global timers handed over on idle */
+	unsigned long	wakeups;	/* idle wakeups as the last active CPU */
+	unsigned long	remote;		/* idle CPUs' timer bases expired */
+};
+
+extern u64 get_jiffies_update(unsigned long *basej);
+extern void timer_expire_remote(unsigned int cpu);
+extern u64 timer_next_global_remote(unsigned int cpu, unsigned long basej,
+				    u64 basem);
+extern u64 tmigr_cpu_deactivate(u64 nextexp);
+extern void tmigr_cpu_activate(void);
+extern bool tmigr_requires_handle_remote(void);
+extern void tmigr_handle_remote(void);
+extern void tmigr_get_cpu_stats(unsigned int cpu, struct tmigr_cpu_stats *st);
+#else
+static inline void tmigr_cpu_activate(void) { }
+static inline bool tmigr_requires_handle_remote(void) { return false; }
+static inline void tmigr_handle_remote(void) { }
+#endif
 #define TIMER_LOCK_TIGHT_LOOP_DELAY_NS	350
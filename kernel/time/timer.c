@@ -183,16 +183,25 @@ EXPORT_SYMBOL(jiffies_64);
 /*
  * The resulting wheel size. If NOHZ is configured we allocate two
  * wheels so we have a separate storage for the deferrable timers.
+ * With TIMER_MIGRATION a third wheel holds the unpinned timers, which
+ * an idle CPU hands over to the timer migration hierarchy.
  */
 #define WHEEL_SIZE	(LVL_SIZE * LVL_DEPTH)
 
-#ifdef CONFIG_NO_HZ_COMMON
+#ifdef CONFIG_TIMER_MIGRATION
+# define NR_BASES	3
+# define BASE_STD	0
+# define BASE_GLOBAL	1
+# define BASE_DEF	2
+#elif defined(CONFIG_NO_HZ_COMMON)
 # define NR_BASES	2
 # define BASE_STD	0
+# define BASE_GLOBAL	0
 # define BASE_DEF	1
 #else
 # define NR_BASES	1
 # define BASE_STD	0
+# define BASE_GLOBAL	0
 # define BASE_DEF	0
 #endif
 
@@ -204,6 +213,7 @@ struct timer_base {
 	unsigned int		cpu;
 	bool			is_idle;
 	bool			must_forward_clk;
+	bool			expiry_active;
 	DECLARE_BITMAP(pending_map, WHEEL_SIZE);
 	struct hlist_head	vectors[WHEEL_SIZE];
 } ____cacheline_aligned;
@@ -585,6 +595,15 @@ trigger_dyntick_cpu(struct timer_base *base, struct timer_list *timer)
 	if (!base->is_idle)
 		return;
 
+	/*
+	 * A global timer re-armed from its callback while the timer
+	 * migration hierarchy expires the idle CPU's timers: the new expiry
+	 * is read back after the callback, see tmigr_handle_remote().
+	 */
+	if (IS_ENABLED(CONFIG_TIMER_MIGRATION) &&
+	    !(timer->flags & TIMER_PINNED) && base->running_timer == timer)
+		return;
+
 	/* Check whether this is the new first expiring timer: */
 	if (time_after_eq(timer->expires, base->next_expiry))
 		return;
@@ -850,7 +869,10 @@ static int detach_if_pending(struct timer_list *timer, struct timer_base *base,
 
 static inline struct timer_base *get_timer_cpu_base(u32 tflags, u32 cpu)
 {
-	struct timer_base *base = per_cpu_ptr(&timer_bases[BASE_STD], cpu);
+	struct timer_base *base;
+
+	base = per_cpu_ptr(&timer_bases[tflags & TIMER_PINNED ?
+					BASE_STD : BASE_GLOBAL], cpu);
 
 	/*
 	 * If the timer is deferrable and NO_HZ_COMMON is set then we need
@@ -866,7 +888,10 @@ static inline struct timer_base *get_timer_cpu_base(u32 tflags, u32 cpu)
 
 static inline struct timer_base *get_timer_this_cpu_base(u32 tflags)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
+	struct timer_base *base;
+
+	base = this_cpu_ptr(&timer_bases[tflags & TIMER_PINNED ?
+					 BASE_STD : BASE_GLOBAL]);
 
 	/*
 	 * If the timer is deferrable and NO_HZ_COMMON is set then we need
@@ -888,7 +913,12 @@ static inline struct timer_base *get_timer_base(u32 tflags)
 static inline struct timer_base *
 get_target_base(struct timer_base *base, unsigned tflags)
 {
-#if defined(CONFIG_SMP) && defined(CONFIG_NO_HZ_COMMON)
+	/*
+	 * With TIMER_MIGRATION unpinned timers stay on the local global
+	 * base; when this CPU goes idle the hierarchy expires them.
+	 */
+#if defined(CONFIG_SMP) && defined(CONFIG_NO_HZ_COMMON) && \
+	!defined(CONFIG_TIMER_MIGRATION)
 	if (static_branch_likely(&timers_migration_enabled) &&
 	    !(tflags & TIMER_PINNED))
 		return get_timer_cpu_base(tflags, get_nohz_timer_target());
@@ -1173,6 +1203,10 @@ void add_timer_on(struct timer_list *timer, int cpu)
 
 	BUG_ON(timer_pending(timer) || !timer->function);
 
+	/* The timer must run on @cpu, keep it off the global base */
+	if (!(timer->flags & TIMER_PINNED))
+		timer->flags |= TIMER_PINNED;
+
 	new_base = get_timer_cpu_base(timer->flags, cpu);
 
 	/*
@@ -1556,6 +1590,37 @@ bool check_pending_deferrable_timers(int cpu)
 }
 #endif
 
+/*
+ * Fetch the next expiry of @base and forward its clock.  Returns the clock
+ * monotonic time of the next event, KTIME_MAX if the base is empty.
+ * Called with the base lock held.
+ */
+static u64 next_timer_forward_base(struct timer_base *base,
+				   unsigned long basej, u64 basem)
+{
+	unsigned long nextevt = __next_timer_interrupt(base);
+	bool is_max_delta = (nextevt == base->clk + NEXT_TIMER_MAX_DELTA);
+
+	base->next_expiry = nextevt;
+	/*
+	 * We have a fresh next event. Check whether we can forward the
+	 * base. We can only do that when @basej is past base->clk
+	 * otherwise we might rewind base->clk.
+	 */
+	if (time_after(basej, base->clk)) {
+		if (time_after(nextevt, basej))
+			base->clk = basej;
+		else if (time_after(nextevt, base->clk))
+			base->clk = nextevt;
+	}
+
+	if (time_before_eq(nextevt, basej))
+		return basem;
+	if (is_max_delta)
+		return KTIME_MAX;
+	return basem + (u64)(nextevt - basej) * TICK_NSEC;
+}
+
 /**
  * get_next_timer_interrupt - return the time (clock mono) of the next timer
  * @basej:	base time jiffies
@@ -1563,56 +1628,60 @@ bool check_pending_deferrable_timers(int cpu)
  *
  * Returns the tick aligned clock monotonic time of the next pending
  * timer or KTIME_MAX if no timer is pending.
+ *
+ * When the CPU is about to sleep for more than a tick and timer migration
+ * is enabled, the timers of the global base are handed over to the timer
+ * migration hierarchy; the CPU then only has to wake up for its pinned
+ * timers, or for the first global timer of all idle CPUs when it is the
+ * last active CPU.
  */
 u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
-	u64 expires = KTIME_MAX;
-	unsigned long nextevt;
-	bool is_max_delta;
+	struct timer_base *base_local = this_cpu_ptr(&timer_bases[BASE_STD]);
+	struct timer_base *base_global = this_cpu_ptr(&timer_bases[BASE_GLOBAL]);
+	u64 expires, local, global;
 
 	/*
 	 * Pretend that there is no timer pending if the cpu is offline.
 	 * Possible pending timers will be migrated later to an active cpu.
 	 */
 	if (cpu_is_offline(smp_processor_id()))
-		return expires;
+		return KTIME_MAX;
+
+	raw_spin_lock(&base_local->lock);
+	local = next_timer_forward_base(base_local, basej, basem);
+	global = local;
+	if (base_global != base_local) {
+		raw_spin_lock_nested(&base_global->lock, SINGLE_DEPTH_NESTING);
+		global = next_timer_forward_base(base_global, basej, basem);
+	}
+	expires = min(local, global);
 
-	raw_spin_lock(&base->lock);
-	nextevt = __next_timer_interrupt(base);
-	is_max_delta = (nextevt == base->clk + NEXT_TIMER_MAX_DELTA);
-	base->next_expiry = nextevt;
 	/*
-	 * We have a fresh next event. Check whether we can forward the
-	 * base. We can only do that when @basej is past base->clk
-	 * otherwise we might rewind base->clk.
+	 * If we expect to sleep more than a tick, mark the bases idle.
+	 * Also the tick is stopped so any added timer must forward the
+	 * base clk itself to keep granularity small. This idle logic is
+	 * only maintained for the BASE_STD and BASE_GLOBAL bases,
+	 * deferrable timers may still see large granularity skew (by
+	 * design).
 	 */
-	if (time_after(basej, base->clk)) {
-		if (time_after(nextevt, basej))
-			base->clk = basej;
-		else if (time_after(nextevt, base->clk))
-			base->clk = nextevt;
-	}
-
-	if (time_before_eq(nextevt, basej)) {
-		expires = basem;
-		base->is_idle = false;
+	if (expires - basem > TICK_NSEC) {
+		base_local->must_forward_clk = true;
+		base_local->is_idle = true;
+		base_global->must_forward_clk = true;
+		base_global->is_idle = true;
+#ifdef CONFIG_TIMER_MIGRATION
+		if (static_branch_likely(&timers_migration_enabled))
+			expires = min(local, tmigr_cpu_deactivate(global));
+#endif
 	} else {
-		if (!is_max_delta)
-			expires = basem + (u64)(nextevt - basej) * TICK_NSEC;
-		/*
-		 * If we expect to sleep more than a tick, mark the base idle.
-		 * Also the tick is stopped so any added timer must forward
-		 * the base clk itself to keep granularity small. This idle
-		 * logic is only maintained for the BASE_STD base, deferrable
-		 * timers may still see large granularity skew (by design).
-		 */
-		if ((expires - basem) > TICK_NSEC) {
-			base->must_forward_clk = true;
-			base->is_idle = true;
-		}
+		base_local->is_idle = false;
+		base_global->is_idle = false;
 	}
-	raw_spin_unlock(&base->lock);
+
+	if (base_global != base_local)
+		raw_spin_unlock(&base_global->lock);
+	raw_spin_unlock(&base_local->lock);
 
 	return cmp_next_hrtimer_event(basem, expires);
 }
@@ -1624,15 +1693,17 @@ u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
  */
 void timer_clear_idle(void)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
-
 	/*
 	 * We do this unlocked. The worst outcome is a remote enqueue sending
 	 * a pointless IPI, but taking the lock would just make the window for
 	 * sending the IPI a few instructions smaller for the cost of taking
 	 * the lock in the exit from idle path.
 	 */
-	base->is_idle = false;
+	__this_cpu_write(timer_bases[BASE_STD].is_idle, false);
+	__this_cpu_write(timer_bases[BASE_GLOBAL].is_idle, false);
+
+	/* Take the global timers back from the hierarchy */
+	tmigr_cpu_activate();
 }
 
 static int collect_expired_timers(struct timer_base *base,
@@ -1707,6 +1778,20 @@ static inline void __run_timers(struct timer_base *base)
 
 	raw_spin_lock_irq(&base->lock);
 
+	/*
+	 * The global base of a CPU can be expired by its owner and by the
+	 * CPU running the timer migration hierarchy at the same time. The
+	 * lock is dropped around each callback, so the first expirer has
+	 * to run the base alone or a callback could run twice at once and
+	 * base->running_timer would no longer be reliable. It expires
+	 * everything up to the current jiffies anyway.
+	 */
+	if (base->expiry_active) {
+		raw_spin_unlock_irq(&base->lock);
+		return;
+	}
+	base->expiry_active = true;
+
 	/*
 	 * timer_base::must_forward_clk must be cleared before running
 	 * timers so that any timer functions that call mod_timer() will
@@ -1732,9 +1817,48 @@ static inline void __run_timers(struct timer_base *base)
 			expire_timers(base, heads + levels);
 	}
 	base->running_timer = NULL;
+	base->expiry_active = false;
 	raw_spin_unlock_irq(&base->lock);
 }
 
+#ifdef CONFIG_TIMER_MIGRATION
+/**
+ * timer_expire_remote - expire the global timers of an idle CPU
+ * @cpu:	the idle CPU
+ *
+ * Called by the timer migration hierarchy from the softirq of the CPU
+ * which expires the global timers on behalf of idle CPUs.
+ */
+void timer_expire_remote(unsigned int cpu)
+{
+	struct timer_base *base = per_cpu_ptr(&timer_bases[BASE_GLOBAL], cpu);
+
+	if (time_after_eq(jiffies, base->clk))
+		__run_timers(base);
+}
+
+/**
+ * timer_next_global_remote - return the next global timer of an idle CPU
+ * @cpu:	the idle CPU
+ * @basej:	base time jiffies
+ * @basem:	base time clock monotonic
+ *
+ * Returns the clock monotonic time of the first timer left on the global
+ * base of @cpu or KTIME_MAX if it is empty.
+ */
+u64 timer_next_global_remote(unsigned int cpu, unsigned long basej, u64 basem)
+{
+	struct timer_base *base = per_cpu_ptr(&timer_bases[BASE_GLOBAL], cpu);
+	u64 expires;
+
+	raw_spin_lock_irq(&base->lock);
+	expires = next_timer_forward_base(base, basej, basem);
+	raw_spin_unlock_irq(&base->lock);
+
+	return expires;
+}
+#endif
+
 /*
  * This function runs timers and the timer-tq in bottom half context.
  */
@@ -1743,6 +1867,10 @@ static __latent_entropy void run_timer_softirq(struct softirq_action *h)
 	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
 
 	__run_timers(base);
+	if (IS_ENABLED(CONFIG_TIMER_MIGRATION)) {
+		__run_timers(this_cpu_ptr(&timer_bases[BASE_GLOBAL]));
+		tmigr_handle_remote();
+	}
 	if (IS_ENABLED(CONFIG_NO_HZ_COMMON)) {
 		__run_timers(this_cpu_ptr(&timer_bases[BASE_DEF]));
 	}
@@ -1765,11 +1893,17 @@ void run_local_timers(void)
 	if (time_before(jiffies, base->clk)) {
 		if (!IS_ENABLED(CONFIG_NO_HZ_COMMON))
 			return;
-		/* CPU is awake, so check the deferrable base. */
-		base++;
-		if (time_before(jiffies, base->clk))
+		/* CPU is awake, so check the global and deferrable bases. */
+		base = this_cpu_ptr(&timer_bases[BASE_GLOBAL]);
+		if (IS_ENABLED(CONFIG_TIMER_MIGRATION) &&
+		    !time_before(jiffies, base->clk))
+			goto raise;
+		base = this_cpu_ptr(&timer_bases[BASE_DEF]);
+		if (time_before(jiffies, base->clk) &&
+		    !tmigr_requires_handle_remote())
 			return;
 	}
+raise:
 	raise_softirq(TIMER_SOFTIRQ);
 }
 
@@ -190,6 +190,21 @@ static void print_cpu(struct seq_file *m, int cpu, u64 now)
 
 #undef P
 #undef P_ns
+
+#ifdef CONFIG_TIMER_MIGRATION
+# define P(x) \
+	SEQ_printf(m, "  .tmigr_%-9s: %Lu\n", #x, \
+		   (unsigned long long)(st.x))
+	{
+		struct tmigr_cpu_stats st;
+
+		tmigr_get_cpu_stats(cpu, &st);
+		P(handoffs);
+		P(wakeups);
+		P(remote);
+	}
+# undef P
+#endif
 	SEQ_printf(m, "\n");
 }
 
@@ -281,7 +296,7 @@ static void timer_list_show_tickdevices_header(struct seq_file *m)
 
 static inline void timer_list_header(struct seq_file *m, u64 now)
 {
-	SEQ_printf(m, "Timer List Version: v0.8\n");
+	SEQ_printf(m, "Timer List Version: v0.9\n");
 	SEQ_printf(m, "HRTIMER_MAX_CLOCK_BASES: %d\n", HRTIMER_MAX_CLOCK_BASES);
 	SEQ_printf(m, "now at %Ld nsecs\n", (unsigned long long)now);
 	SEQ_printf(m, "\n");
@@ -0,0 +1,443 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Timer migration hierarchy
+ *
+ * Unpinned timers are queued on the global timer base of the CPU which
+ * arms them.  While the CPU is busy it expires them itself.  When it goes
+ * idle it hands them over to the hierarchy instead of programming a
+ * wakeup for them, so idle CPUs only wake up for their pinned timers.
+ *
+ * The CPUs of a cluster form a level 0 group of at most TMIGR_CHILDREN
+ * CPUs; the groups of a level are combined the same way until a single
+ * root group is left.  Each group tracks which of its children are
+ * active and the first timer of its idle children.  One active child,
+ * the migrator, expires the timers of the idle ones from its tick: a CPU
+ * acts for a group when it is the migrator of every group on the path
+ * from its level 0 group up to that group.  When the last CPU of the
+ * whole hierarchy goes idle it programs a wakeup for the first timer of
+ * all idle CPUs.
+ *
+ * Lock order: timer base locks, then the group locks from level 0 up.
+ */
+#include <linux/cpu.h>
+#include <linux/cpuhotplug.h>
+#include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/tick.h>
+#include <linux/topology.h>
+
+#include "tick-internal.h"
+
+#define TMIGR_CHILDREN	8
+
+struct tmigr_group {
+	raw_spinlock_t		lock;
+	struct tmigr_group	*parent;
+	unsigned int		level;
+	u8			childmask;	/* bit of this group in the parent */
+	u8			num_children;
+	u8			active;		/* the active children */
+	u8			migrator;	/* the child acting for the idle ones */
+	u64			next_expiry;	/* first timer of the idle children */
+	u64			child_expiry[TMIGR_CHILDREN];
+	union {
+		unsigned int		cpu[TMIGR_CHILDREN];
+		struct tmigr_group	*group[TMIGR_CHILDREN];
+	} child;
+};
+
+struct tmigr_cpu {
+	struct tmigr_group	*group;		/* level 0 group */
+	u8			childmask;
+	bool			online;
+	bool			idle;
+	unsigned int		seq;		/* bumped on every idle entry */
+	u64			wakeup;		/* set when last active CPU */
+	struct tmigr_cpu_stats	stats;
+};
+
+static DEFINE_PER_CPU(struct tmigr_cpu, tmigr_cpu);
+static struct tmigr_group *tmigr_root;
+
+/* Recompute the first timer of the idle children, group->lock held */
+static void tmigr_update_expiry(struct tmigr_group *group)
+{
+	u64 next = KTIME_MAX;
+	unsigned int i;
+
+	for (i = 0; i < group->num_children; i++) {
+		if (!(group->active & BIT(i)))
+			next = min(next, group->child_expiry[i]);
+	}
+	WRITE_ONCE(group->next_expiry, next);
+}
+
+static u64 tmigr_idle_child(struct tmigr_group *group, u8 childmask,
+			    u64 expiry);
+
+/*
+ * A child of @group went idle or, already idle, has a new first timer
+ * @expiry.  Returns the first timer of the hierarchy if no CPU is left
+ * active to expire it, KTIME_MAX otherwise.  Called with group->lock held.
+ */
+static u64 __tmigr_idle_child(struct tmigr_group *group, u8 childmask,
+			      u64 expiry)
+{
+	group->child_expiry[__ffs(childmask)] = expiry;
+	group->active &= ~childmask;
+	if (group->migrator == childmask) {
+		WRITE_ONCE(group->migrator,
+			   group->active ? BIT(__ffs(group->active)) : 0);
+	}
+	tmigr_update_expiry(group);
+
+	if (group->active)
+		return KTIME_MAX;
+	if (!group->parent)
+		return group->next_expiry;
+	return tmigr_idle_child(group->parent, group->childmask,
+				group->next_expiry);
+}
+
+static u64 tmigr_idle_child(struct tmigr_group *group, u8 childmask,
+			    u64 expiry)
+{
+	u64 ret;
+
+	raw_spin_lock_nested(&group->lock, group->level);
+	ret = __tmigr_idle_child(group, childmask, expiry);
+	raw_spin_unlock(&group->lock);
+
+	return ret;
+}
+
+/* A child of @group became active. Called with group->lock held. */
+static void __tmigr_active_child(struct tmigr_group *group, u8 childmask)
+{
+	struct tmigr_group *parent = group->parent;
+
+	if (!group->active && parent) {
+		raw_spin_lock_nested(&parent->lock, parent->level);
+		__tmigr_active_child(parent, group->childmask);
+		raw_spin_unlock(&parent->lock);
+	}
+
+	group->active |= childmask;
+	if (!group->migrator)
+		WRITE_ONCE(group->migrator, childmask);
+	tmigr_update_expiry(group);
+}
+
+/**
+ * tmigr_cpu_deactivate - hand the global timers of this CPU over
+ * @nextexp:	first timer of the global base, KTIME_MAX if none
+ *
+ * Called with interrupts disabled and the timer base locks held, when the
+ * CPU is about to sleep for more than a tick.  Returns the time this CPU
+ * has to wake up for the global timers: KTIME_MAX unless it was the last
+ * active CPU of the hierarchy.
+ */
+u64 tmigr_cpu_deactivate(u64 nextexp)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	u64 ret;
+
+	if (!tmc->online)
+		return nextexp;
+
+	raw_spin_lock(&tmc->group->lock);
+	if (!tmc->idle) {
+		WRITE_ONCE(tmc->idle, true);
+		tmc->seq++;
+		tmc->stats.handoffs++;
+	}
+	ret = __tmigr_idle_child(tmc->group, tmc->childmask, nextexp);
+	WRITE_ONCE(tmc->wakeup, ret);
+	raw_spin_unlock(&tmc->group->lock);
+
+	return ret;
+}
+
+/**
+ * tmigr_cpu_activate - take the global timers of this CPU back
+ *
+ * Called with interrupts disabled when the CPU leaves idle or keeps its
+ * tick running.
+ */
+void tmigr_cpu_activate(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+
+	if (!tmc->online || !tmc->idle)
+		return;
+
+	raw_spin_lock(&tmc->group->lock);
+	WRITE_ONCE(tmc->idle, false);
+	__tmigr_active_child(tmc->group, tmc->childmask);
+	raw_spin_unlock(&tmc->group->lock);
+}
+
+/**
+ * tmigr_requires_handle_remote - check for expired timers of idle CPUs
+ *
+ * Called from the tick. Returns true if this CPU has to expire global
+ * timers of idle CPUs in its timer softirq.
+ */
+bool tmigr_requires_handle_remote(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	struct tmigr_group *group = tmc->group;
+	u8 childmask = tmc->childmask;
+	unsigned long basej;
+	u64 now;
+
+	if (!tmc->online)
+		return false;
+
+	if (tmc->idle) {
+		now = get_jiffies_update(&basej);
+		return READ_ONCE(tmc->wakeup) <= now;
+	}
+
+	/* Cheap check first: the common case is not being the migrator */
+	if (READ_ONCE(group->migrator) != childmask)
+		return false;
+
+	now = get_jiffies_update(&basej);
+	for (; group; childmask = group->childmask, group = group->parent) {
+		if (READ_ONCE(group->migrator) != childmask)
+			break;
+		if (READ_ONCE(group->next_expiry) <= now)
+			return true;
+	}
+	return false;
+}
+
+/* Update an idle CPU's first global timer after expiring its base */
+static void tmigr_update_remote(struct tmigr_cpu *tmc, unsigned int seq,
+				u64 expiry)
+{
+	raw_spin_lock_irq(&tmc->group->lock);
+	/* Skip if the CPU has been active since, its own update is newer */
+	if (tmc->idle && tmc->seq == seq)
+		__tmigr_idle_child(tmc->group, tmc->childmask, expiry);
+	raw_spin_unlock_irq(&tmc->group->lock);
+}
+
+static void tmigr_expire_cpu(unsigned int cpu)
+{
+	struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+	unsigned long basej;
+	unsigned int seq;
+	bool idle;
+	u64 now;
+
+	raw_spin_lock_irq(&tmc->group->lock);
+	idle = tmc->idle;
+	seq = tmc->seq;
+	raw_spin_unlock_irq(&tmc->group->lock);
+	if (!idle)
+		return;
+
+	timer_expire_remote(cpu);
+	this_cpu_inc(tmigr_cpu.stats.remote);
+
+	now = get_jiffies_update(&basej);
+	tmigr_update_remote(tmc, seq, timer_next_global_remote(cpu, basej, now));
+}
+
+/* Expire the timers of the idle children of @group which are due */
+static void tmigr_expire_idle(struct tmigr_group *group, u64 now)
+{
+	unsigned long due = 0;
+	unsigned int i;
+
+	raw_spin_lock_irq(&group->lock);
+	if (group->next_expiry <= now) {
+		for (i = 0; i < group->num_children; i++) {
+			if (!(group->active & BIT(i)) &&
+			    group->child_expiry[i] <= now)
+				due |= BIT(i);
+		}
+	}
+	raw_spin_unlock_irq(&group->lock);
+
+	for_each_set_bit(i, &due, TMIGR_CHILDREN) {
+		if (group->level)
+			tmigr_expire_idle(group->child.group[i], now);
+		else
+			tmigr_expire_cpu(group->child.cpu[i]);
+	}
+}
+
+/**
+ * tmigr_handle_remote - expire the global timers of idle CPUs
+ *
+ * Called from the timer softirq.
+ */
+void tmigr_handle_remote(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	struct tmigr_group *group;
+	unsigned long basej;
+	u8 childmask;
+	u64 now;
+
+	if (!tmc->online)
+		return;
+
+	now = get_jiffies_update(&basej);
+
+	/* Woken up as the last active CPU of the hierarchy */
+	if (READ_ONCE(tmc->idle)) {
+		if (READ_ONCE(tmc->wakeup) > now)
+			return;
+		tmc->stats.wakeups++;
+		tmigr_expire_idle(tmigr_root, now);
+		return;
+	}
+
+	for (group = tmc->group, childmask = tmc->childmask; group;
+	     childmask = group->childmask, group = group->parent) {
+		if (READ_ONCE(group->migrator) != childmask)
+			break;
+		tmigr_expire_idle(group, now);
+	}
+}
+
+void tmigr_get_cpu_stats(unsigned int cpu, struct tmigr_cpu_stats *st)
+{
+	*st = per_cpu(tmigr_cpu, cpu).stats;
+}
+
+static int tmigr_cpu_online(unsigned int cpu)
+{
+	struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+
+	/* A busy nohz_full CPU does not tick, it cannot act as migrator */
+	if (tick_nohz_full_cpu(cpu))
+		return 0;
+
+	raw_spin_lock_irq(&tmc->group->lock);
+	tmc->online = true;
+	WRITE_ONCE(tmc->idle, false);
+	__tmigr_active_child(tmc->group, tmc->childmask);
+	raw_spin_unlock_irq(&tmc->group->lock);
+	return 0;
+}
+
+static int tmigr_cpu_offline(unsigned int cpu)
+{
+	struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+
+	if (!tmc->online)
+		return 0;
+
+	/* The pending timers are moved to a live CPU by timers_dead_cpu() */
+	raw_spin_lock_irq(&tmc->group->lock);
+	tmc->online = false;
+	WRITE_ONCE(tmc->idle, false);
+	__tmigr_idle_child(tmc->group, tmc->childmask, KTIME_MAX);
+	raw_spin_unlock_irq(&tmc->group->lock);
+	return 0;
+}
+
+static struct tmigr_group * __init tmigr_new_group(unsigned int level)
+{
+	struct tmigr_group *group;
+	unsigned int i;
+
+	group = kzalloc(sizeof(*group), GFP_KERNEL);
+	if (!group)
+		return NULL;
+
+	raw_spin_lock_init(&group->lock);
+	group->level = level;
+	group->next_expiry = KTIME_MAX;
+	for (i = 0; i < TMIGR_CHILDREN; i++)
+		group->child_expiry[i] = KTIME_MAX;
+	return group;
+}
+
+static int __init tmigr_build(void)
+{
+	struct tmigr_group **groups, *group;
+	unsigned int cpu, i, n = 0, level = 0;
+	int ret = -ENOMEM;
+
+	groups = kcalloc(nr_cpu_ids, sizeof(*groups), GFP_KERNEL);
+	if (!groups)
+		return -ENOMEM;
+
+	/* Level 0: the CPUs of a cluster */
+	for_each_possible_cpu(cpu) {
+		struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+		int cluster = topology_physical_package_id(cpu);
+
+		group = NULL;
+		for (i = 0; i < n; i++) {
+			unsigned int first = groups[i]->child.cpu[0];
+
+			if (groups[i]->num_children < TMIGR_CHILDREN &&
+			    topology_physical_package_id(first) == cluster) {
+				group = groups[i];
+				break;
+			}
+		}
+		if (!group) {
+			group = tmigr_new_group(0);
+			if (!group)
+				goto out;
+			groups[n++] = group;
+		}
+		tmc->group = group;
+		tmc->childmask = BIT(group->num_children);
+		group->child.cpu[group->num_children++] = cpu;
+	}
+
+	/* Upper levels: consecutive groups, until a single root is left */
+	while (n > 1) {
+		unsigned int parents = 0;
+
+		level++;
+		for (i = 0; i < n; i++) {
+			struct tmigr_group *child = groups[i];
+
+			if (!(i % TMIGR_CHILDREN)) {
+				group = tmigr_new_group(level);
+				if (!group)
+					goto out;
+				groups[parents++] = group;
+			}
+			child->parent = group;
+			child->childmask = BIT(group->num_children);
+			group->child.group[group->num_children++] = child;
+		}
+		n = parents;
+	}
+
+	tmigr_root = groups[0];
+	pr_info("Timer migration: %u hierarchy levels\n", level + 1);
+	ret = 0;
+out:
+	kfree(groups);
+	return ret;
+}
+
+static int __init tmigr_init(void)
+{
+	int ret;
+
+	/* Leave every CPU alone with its timers if this fails */
+	ret = tmigr_build();
+	if (ret)
+		return ret;
+
+	ret = cpuhp_setup_state(CPUHP_AP_ONLINE_DYN, "timers/migration:online",
+				tmigr_cpu_online, tmigr_cpu_offline);
+	return ret < 0 ? ret : 0;
+}
+early_initcall(tmigr_init);
@@ -51,6 +51,9 @@
 #include <linux/nmi.h>
 #include <linux/bug.h>
 #include <linux/delay.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/sched/clock.h>
 
 #include "workqueue_internal.h"
 
@@ -147,6 +150,46 @@ enum {
 
 /* struct worker is defined in workqueue_internal.h */
 
+#ifdef CONFIG_WQ_STATS
+#define WQ_STATS_HIST		16	/* log2(usecs) execution time buckets */
+
+/* Per-pwq work item statistics, see wq_stats_queue() and friends */
+struct wq_stats {
+	u64			queued;
+	u64			executed;
+	u64			latency_cnt;	/* executions with a latency */
+	u64			latency_ns;	/* total queue latency */
+	u64			latency_max_ns;
+	u64			exec_hist[WQ_STATS_HIST];
+};
+
+/* Per-pool concurrency management statistics */
+struct wq_pool_stats {
+	u64			cm_wakeups;	/* idle workers woken on sleep */
+	u64			cpu_intensive;	/* CPU intensive work items run */
+	u64			workers_created;
+	u64			maydays;	/* rescuer distress calls */
+};
+
+static DEFINE_STATIC_KEY_FALSE(wq_stats_key);
+/* local_clock() when the statistics were last turned on */
+static u64 wq_stats_enabled_at;
+
+static inline bool wq_stats_enabled(void)
+{
+	return static_branch_unlikely(&wq_stats_key);
+}
+
+#define wq_pool_stats_inc(pool, name)					\
+do {									\
+	if (wq_stats_enabled())						\
+		(pool)->stats.name++;					\
+} while (0)
+#else
+static inline bool wq_stats_enabled(void) { return false; }
+#define wq_pool_stats_inc(pool, name)	do { } while (0)
+#endif
+
 struct worker_pool {
 	spinlock_t		lock;		/* the pool lock */
 	int			cpu;		/* I: the associated cpu */
@@ -186,6 +229,10 @@ struct worker_pool {
 	 */
 	atomic_t		nr_running ____cacheline_aligned_in_smp;
 
+#ifdef CONFIG_WQ_STATS
+	struct wq_pool_stats	stats;		/* L: except cm_wakeups, X */
+#endif
+
 	/*
 	 * Destruction of pool is sched-RCU protected to allow dereferences
 	 * from get_work_pool().
@@ -212,6 +259,9 @@ struct pool_workqueue {
 	struct list_head	delayed_works;	/* L: delayed works */
 	struct list_head	pwqs_node;	/* WR: node on wq->pwqs */
 	struct list_head	mayday_node;	/* MD: node on wq->maydays */
+#ifdef CONFIG_WQ_STATS
+	struct wq_stats		stats;		/* L: work item statistics */
+#endif
 
 	/*
 	 * Release of unbound pwq is punted to system_wq.  See put_pwq()
@@ -910,6 +960,8 @@ struct task_struct *wq_worker_sleeping(struct task_struct *task)
 	if (atomic_dec_and_test(&pool->nr_running) &&
 	    !list_empty(&pool->worklist))
 		to_wakeup = first_idle_worker(pool);
+	if (to_wakeup)
+		wq_pool_stats_inc(pool, cm_wakeups);
 	return to_wakeup ? to_wakeup->task : NULL;
 }
 
@@ -1317,6 +1369,124 @@ fail:
 	return -EAGAIN;
 }
 
+#ifdef CONFIG_WQ_STATS
+/*
+ * Queue latency and execution time statistics.  The counters live in the
+ * pwq and the pool and are only updated under pool->lock; the cost when
+ * disabled is a static branch, wq_stats_key.  Enabled through
+ * "workqueue.stats".
+ */
+static void wq_stats_queue(struct pool_workqueue *pwq,
+			   struct work_struct *work)
+{
+	pwq->stats.queued++;
+	work->queued_at = local_clock();
+}
+
+/* @work is about to run; returns the start time for wq_stats_done() */
+static u64 wq_stats_start(struct pool_workqueue *pwq,
+			  struct work_struct *work)
+{
+	u64 now = local_clock();
+
+	/*
+	 * queued_at is only written while the statistics are on.  A stamp
+	 * from before they were last turned on belongs to an earlier
+	 * queueing, this one happened while they were off.
+	 */
+	if (work->queued_at &&
+	    work->queued_at >= READ_ONCE(wq_stats_enabled_at)) {
+		u64 lat = now > work->queued_at ? now - work->queued_at : 0;
+
+		pwq->stats.latency_cnt++;
+		pwq->stats.latency_ns += lat;
+		if (lat > pwq->stats.latency_max_ns)
+			pwq->stats.latency_max_ns = lat;
+	}
+	work->queued_at = 0;
+	return now;
+}
+
+static void wq_stats_done(struct pool_workqueue *pwq, u64 start)
+{
+	u64 us = div_u64(local_clock() - start, NSEC_PER_USEC);
+	unsigned int b = us ? min_t(unsigned int, ilog2(us) + 1,
+				    WQ_STATS_HIST - 1) : 0;
+
+	pwq->stats.executed++;
+	pwq->stats.exec_hist[b]++;
+}
+
+/* Sum the statistics of all pwqs of @wq */
+static void wq_stats_collect(struct workqueue_struct *wq, struct wq_stats *sum)
+{
+	struct pool_workqueue *pwq;
+	unsigned int b;
+
+	memset(sum, 0, sizeof(*sum));
+
+	rcu_read_lock_sched();
+	for_each_pwq(pwq, wq) {
+		spin_lock_irq(&pwq->pool->lock);
+		sum->queued += pwq->stats.queued;
+		sum->executed += pwq->stats.executed;
+		sum->latency_cnt += pwq->stats.latency_cnt;
+		sum->latency_ns += pwq->stats.latency_ns;
+		sum->latency_max_ns = max(sum->latency_max_ns,
+					  pwq->stats.latency_max_ns);
+		for (b = 0; b < WQ_STATS_HIST; b++)
+			sum->exec_hist[b] += pwq->stats.exec_hist[b];
+		spin_unlock_irq(&pwq->pool->lock);
+	}
+	rcu_read_unlock_sched();
+}
+
+static u64 wq_stats_latency_avg_us(const struct wq_stats *st)
+{
+	if (!st->latency_cnt)
+		return 0;
+	return div64_u64(st->latency_ns, st->latency_cnt * NSEC_PER_USEC);
+}
+
+static int wq_stats_param_set(const char *val, const struct kernel_param *kp)
+{
+	bool enable;
+	int ret;
+
+	ret = kstrtobool(val, &enable);
+	if (ret)
+		return ret;
+
+	if (enable) {
+		/* Before any work item can be stamped under the new key */
+		if (!wq_stats_enabled())
+			WRITE_ONCE(wq_stats_enabled_at, local_clock());
+		static_branch_enable(&wq_stats_key);
+	} else {
+		static_branch_disable(&wq_stats_key);
+	}
+	return 0;
+}
+
+static int wq_stats_param_get(char *buffer, const struct kernel_param *kp)
+{
+	return sprintf(buffer, "%c\n", wq_stats_enabled() ? 'Y' : 'N');
+}
+
+static const struct kernel_param_ops wq_stats_ops = {
+	.set	= wq_stats_param_set,
+	.get	= wq_stats_param_get,
+};
+
+module_param_cb(stats, &wq_stats_ops, NULL, 0644);
+#else
+static inline void wq_stats_queue(struct pool_workqueue *pwq,
+				  struct work_struct *work) { }
+static inline u64 wq_stats_start(struct pool_workqueue *pwq,
+				 struct work_struct *work) { return 0; }
+static inline void wq_stats_done(struct pool_workqueue *pwq, u64 start) { }
+#endif
+
 /**
  * insert_work - insert a work into a pool
  * @pwq: pwq @work belongs to
@@ -1487,6 +1657,9 @@ retry:
 	pwq->nr_in_flight[pwq->work_color]++;
 	work_flags = work_color_to_flags(pwq->work_color);
 
+	if (wq_stats_enabled())
+		wq_stats_queue(pwq, work);
+
 	if (likely(pwq->nr_active < pwq->max_active)) {
 		trace_workqueue_activate_work(work);
 		pwq->nr_active++;
@@ -1864,6 +2037,7 @@ static struct worker *create_worker(struct worker_pool *pool)
 	/* start the newly created worker */
 	spin_lock_irq(&pool->lock);
 	worker->pool->nr_workers++;
+	wq_pool_stats_inc(pool, workers_created);
 	worker_enter_idle(worker);
 	wake_up_process(worker->task);
 	spin_unlock_irq(&pool->lock);
@@ -1972,6 +2146,7 @@ static void pool_mayday_timeout(struct timer_list *t)
 		 */
 		list_for_each_entry(work, &pool->worklist, entry)
 			send_mayday(work);
+		wq_pool_stats_inc(pool, maydays);
 	}
 
 	spin_unlock(&wq_mayday_lock);
@@ -2092,6 +2267,7 @@ __acquires(&pool->lock)
 	bool cpu_intensive = pwq->wq->flags & WQ_CPU_INTENSIVE;
 	int work_color;
 	struct worker *collision;
+	u64 stats_start = 0;
 #ifdef CONFIG_LOCKDEP
 	/*
 	 * It is permissible to free the struct work_struct from
@@ -2136,14 +2312,19 @@ __acquires(&pool->lock)
 
 	list_del_init(&work->entry);
 
+	if (wq_stats_enabled())
+		stats_start = wq_stats_start(pwq, work);
+
 	/*
 	 * CPU intensive works don't participate in concurrency management.
 	 * They're the scheduler's responsibility.  This takes @worker out
 	 * of concurrency management and the next code block will chain
 	 * execution of the pending work items.
 	 */
-	if (unlikely(cpu_intensive))
+	if (unlikely(cpu_intensive)) {
 		worker_set_flags(worker, WORKER_CPU_INTENSIVE);
+		wq_pool_stats_inc(pool, cpu_intensive);
+	}
 
 	/*
 	 * Wake up another worker if necessary.  The condition is always
@@ -2223,6 +2404,9 @@ __acquires(&pool->lock)
 
 	spin_lock_irq(&pool->lock);
 
+	if (stats_start)
+		wq_stats_done(pwq, stats_start);
+
 	/* clear cpu intensive status */
 	if (unlikely(cpu_intensive))
 		worker_clr_flags(worker, WORKER_CPU_INTENSIVE);
@@ -5195,6 +5379,7 @@ int workqueue_set_unbound_cpumask(cpumask_var_t cpumask)
  *
  *  per_cpu	RO bool	: whether the workqueue is per-cpu or unbound
  *  max_active	RW int	: maximum number of in-flight work items
+ *  stats	RO	: work item statistics (CONFIG_WQ_STATS)
  *
  * Unbound workqueues have the following extra attributes.
  *
@@ -5247,9 +5432,39 @@ static ssize_t max_active_store(struct device *dev,
 }
 static DEVICE_ATTR_RW(max_active);
 
+#ifdef CONFIG_WQ_STATS
+static ssize_t stats_show(struct device *dev, struct device_attribute *attr,
+			  char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	struct wq_stats st;
+	ssize_t written;
+	unsigned int b;
+
+	wq_stats_collect(wq, &st);
+
+	written = scnprintf(buf, PAGE_SIZE,
+			    "queued %llu\nexecuted %llu\n"
+			    "latency_avg_us %llu\nlatency_max_us %llu\n"
+			    "exec_us_hist",
+			    st.queued, st.executed,
+			    wq_stats_latency_avg_us(&st),
+			    div_u64(st.latency_max_ns, NSEC_PER_USEC));
+	for (b = 0; b < WQ_STATS_HIST; b++)
+		written += scnprintf(buf + written, PAGE_SIZE - written,
+				     " %llu", st.exec_hist[b]);
+	written += scnprintf(buf + written, PAGE_SIZE - written, "\n");
+	return written;
+}
+static DEVICE_ATTR_RO(stats);
+#endif
+
 static struct attribute *wq_sysfs_attrs[] = {
 	&dev_attr_per_cpu.attr,
 	&dev_attr_max_active.attr,
+#ifdef CONFIG_WQ_STATS
+	&dev_attr_stats.attr,
+#endif
 	NULL,
 };
 ATTRIBUTE_GROUPS(wq_sysfs);
@@ -5703,6 +5918,100 @@ static inline void wq_watchdog_init(void) { }
 
 #endif	/* CONFIG_WQ_WATCHDOG */
 
+#if defined(CONFIG_WQ_STATS) && defined(CONFIG_DEBUG_FS)
+/*
+ * debugfs view of the statistics: "workqueue/stats" has a line per
+ * workqueue which queued anything, including those without WQ_SYSFS,
+ * "workqueue/pools" the concurrency management counters of each pool.
+ * The execution time histogram buckets are [0, 1us), [1us, 2us),
+ * [2us, 4us) ... the last one is open.
+ */
+static int wq_stats_debugfs_show(struct seq_file *m, void *v)
+{
+	struct workqueue_struct *wq;
+	struct wq_stats st;
+	unsigned int b;
+
+	seq_puts(m, "# workqueue queued executed latency_avg_us latency_max_us exec_us_hist\n");
+
+	mutex_lock(&wq_pool_mutex);
+	list_for_each_entry(wq, &workqueues, list) {
+		wq_stats_collect(wq, &st);
+		if (!st.queued && !st.executed)
+			continue;
+
+		seq_printf(m, "%-24s %llu %llu %llu %llu", wq->name,
+			   st.queued, st.executed,
+			   wq_stats_latency_avg_us(&st),
+			   div_u64(st.latency_max_ns, NSEC_PER_USEC));
+		for (b = 0; b < WQ_STATS_HIST; b++)
+			seq_printf(m, " %llu", st.exec_hist[b]);
+		seq_putc(m, '\n');
+	}
+	mutex_unlock(&wq_pool_mutex);
+	return 0;
+}
+
+static int wq_stats_debugfs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wq_stats_debugfs_show, NULL);
+}
+
+static const struct file_operations wq_stats_debugfs_fops = {
+	.open		= wq_stats_debugfs_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int wq_pools_debugfs_show(struct seq_file *m, void *v)
+{
+	struct worker_pool *pool;
+	int pi;
+
+	seq_puts(m, "# pool cpu nice workers idle cm_wakeups cpu_intensive workers_created maydays\n");
+
+	mutex_lock(&wq_pool_mutex);
+	for_each_pool(pool, pi) {
+		spin_lock_irq(&pool->lock);
+		seq_printf(m, "%4d %3d %4d %3d %3d %llu %llu %llu %llu\n",
+			   pool->id, pool->cpu, pool->attrs->nice,
+			   pool->nr_workers, pool->nr_idle,
+			   pool->stats.cm_wakeups, pool->stats.cpu_intensive,
+			   pool->stats.workers_created, pool->stats.maydays);
+		spin_unlock_irq(&pool->lock);
+	}
+	mutex_unlock(&wq_pool_mutex);
+	return 0;
+}
+
+static int wq_pools_debugfs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wq_pools_debugfs_show, NULL);
+}
+
+static const struct file_operations wq_pools_debugfs_fops = {
+	.open		= wq_pools_debugfs_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init wq_stats_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("workqueue", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	debugfs_create_file("stats", 0444, dir, NULL, &wq_stats_debugfs_fops);
+	debugfs_create_file("pools", 0444, dir, NULL, &wq_pools_debugfs_fops);
+	return 0;
+}
+late_initcall(wq_stats_debugfs_init);
+#endif	/* CONFIG_WQ_STATS && CONFIG_DEBUG_FS */
+
 static void __init wq_numa_init(void)
 {
 	cpumask_var_t *tbl;
@@ -23,6 +23,9 @@
 #else
 #include <linux/module.h>
 #include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
 #if !RAID6_USE_EMPTY_ZERO_PAGE
 /* In .bss so it's zeroed */
 const char raid6_empty_zero_page[PAGE_SIZE] __attribute__((aligned(256)));
@@ -91,6 +94,8 @@ const struct raid6_calls * const raid6_algos[] = {
 	&raid6_neonx2,
 	&raid6_neonx4,
 	&raid6_neonx8,
+	&raid6_neonx4b,
+	&raid6_neonx8b,
 #endif
 	NULL
 };
@@ -150,6 +155,25 @@ static inline const struct raid6_recov_calls *raid6_choose_recov(void)
 	return best;
 }
 
+/* Number of gen_syndrome() calls on a PAGE_SIZE stripe in the timing window */
+static unsigned long raid6_gen_perf(const struct raid6_calls *algo,
+				    int disks, void **dptrs)
+{
+	unsigned long perf = 0, j0, j1;
+
+	preempt_disable();
+	j0 = jiffies;
+	while ((j1 = jiffies) == j0)
+		cpu_relax();
+	while (time_before(jiffies, j1 + (1<<RAID6_TIME_JIFFIES_LG2))) {
+		algo->gen_syndrome(disks, PAGE_SIZE, dptrs);
+		perf++;
+	}
+	preempt_enable();
+
+	return perf;
+}
+
 static inline const struct raid6_calls *raid6_choose_gen(
 	void *(*const dptrs)[(65536/PAGE_SIZE)+2], const int disks)
 {
@@ -163,18 +187,7 @@ static inline const struct raid6_calls *raid6_choose_gen(
 			if ((*algo)->valid && !(*algo)->valid())
 				continue;
 
-			perf = 0;
-
-			preempt_disable();
-			j0 = jiffies;
-			while ((j1 = jiffies) == j0)
-				cpu_relax();
-			while (time_before(jiffies,
-					    j1 + (1<<RAID6_TIME_JIFFIES_LG2))) {
-				(*algo)->gen_syndrome(disks, PAGE_SIZE, *dptrs);
-				perf++;
-			}
-			preempt_enable();
+			perf = raid6_gen_perf(*algo, disks, *dptrs);
 
 			if (perf > bestgenperf) {
 				bestgenperf = perf;
@@ -261,6 +274,85 @@ int __init raid6_select_algo(void)
 	return gen_best && rec_best ? 0 : -EINVAL;
 }
 
+#ifdef __KERNEL__
+/*
+ * raid6_select_algo() times the algorithms on a stripe of 16 data pages
+ * only.  The best unroll width, and whether the cache blocked variants pay
+ * off, depends on the number of disks, so raid456 asks for the algorithms
+ * to be timed again at the width of each array it sets up.  The winner is
+ * cached per width and used through raid6_call_for().
+ */
+const struct raid6_calls *raid6_width_call[RAID6_MAX_TUNED_DISKS + 1];
+EXPORT_SYMBOL_GPL(raid6_width_call);
+
+static DEFINE_MUTEX(raid6_width_mutex);
+
+void raid6_select_algo_disks(int disks)
+{
+	const int gfmul_pages = 65536 / PAGE_SIZE;
+	const struct raid6_calls *const *algo;
+	const struct raid6_calls *best = NULL;
+	unsigned long perf, bestperf = 0;
+	struct page **pages;
+	void **dptrs;
+	int i;
+
+	if (disks < 4 || disks > RAID6_MAX_TUNED_DISKS)
+		return;
+
+	mutex_lock(&raid6_width_mutex);
+	if (raid6_width_call[disks])
+		goto out;
+
+	pages = kcalloc(disks, sizeof(*pages), GFP_KERNEL);
+	dptrs = kcalloc(disks, sizeof(*dptrs), GFP_KERNEL);
+	if (!pages || !dptrs)
+		goto out_free;
+
+	for (i = 0; i < disks; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i])
+			goto out_free;
+		dptrs[i] = page_address(pages[i]);
+		if (i < disks - 2)
+			memcpy(dptrs[i], (const char *)raid6_gfmul +
+			       PAGE_SIZE * (i % gfmul_pages), PAGE_SIZE);
+	}
+
+	for (algo = raid6_algos; *algo; algo++) {
+		if ((*algo)->valid && !(*algo)->valid())
+			continue;
+		/* raid456 enables read-modify-write based on raid6_call */
+		if (raid6_call.xor_syndrome && !(*algo)->xor_syndrome)
+			continue;
+
+		perf = raid6_gen_perf(*algo, disks, dptrs);
+		if (perf > bestperf) {
+			bestperf = perf;
+			best = *algo;
+		}
+	}
+
+	if (best) {
+		pr_info("raid6: using algorithm %s for %d disks, gen() %llu MB/s\n",
+			best->name, disks,
+			((u64)bestperf * (disks - 2) * PAGE_SIZE * HZ) >>
+				(20 + RAID6_TIME_JIFFIES_LG2));
+		WRITE_ONCE(raid6_width_call[disks], best);
+	}
+
+out_free:
+	for (i = 0; pages && i < disks; i++)
+		if (pages[i])
+			__free_page(pages[i]);
+	kfree(dptrs);
+	kfree(pages);
+out:
+	mutex_unlock(&raid6_width_mutex);
+}
+EXPORT_SYMBOL_GPL(raid6_select_algo_disks);
+#endif
+
 static void raid6_exit(void)
 {
 	do { } while (0);
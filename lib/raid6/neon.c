@@ -59,6 +59,30 @@
 		0							\
 	}
 
+/*
+ * The cache blocked gen_syndrome() variants share xor_syndrome() with the
+ * plain variant of the same unroll width, so they must be instantiated
+ * after it.
+ */
+#define RAID6_NEON_BLOCKED_WRAPPER(_n)					\
+	static void raid6_neon ## _n ## b_gen_syndrome(int disks,	\
+					size_t bytes, void **ptrs)	\
+	{								\
+		void raid6_neon ## _n ## _gen_syndrome_blocked_real(int, \
+						unsigned long, void**);	\
+		kernel_neon_begin();					\
+		raid6_neon ## _n ## _gen_syndrome_blocked_real(disks,	\
+					(unsigned long)bytes, ptrs);	\
+		kernel_neon_end();					\
+	}								\
+	struct raid6_calls const raid6_neonx ## _n ## b = {		\
+		raid6_neon ## _n ## b_gen_syndrome,			\
+		raid6_neon ## _n ## _xor_syndrome,			\
+		raid6_have_neon,					\
+		"neonx" #_n "b",					\
+		0							\
+	}
+
 static int raid6_have_neon(void)
 {
 	return cpu_has_neon();
@@ -68,3 +92,5 @@ RAID6_NEON_WRAPPER(1);
 RAID6_NEON_WRAPPER(2);
 RAID6_NEON_WRAPPER(4);
 RAID6_NEON_WRAPPER(8);
+RAID6_NEON_BLOCKED_WRAPPER(4);
+RAID6_NEON_BLOCKED_WRAPPER(8);
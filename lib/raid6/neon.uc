@@ -84,6 +84,63 @@ void raid6_neon$#_gen_syndrome_real(int disks, unsigned long bytes, void **ptrs)
 	}
 }
 
+/*
+ * Cache blocked variant for wide stripes: the data disks are processed in
+ * groups of RAID6_NEON_GROUP, and the partial P/Q of each RAID6_NEON_BLOCK
+ * bytes is carried from one group to the next through the (cache hot) P/Q
+ * pages.  This bounds the number of concurrent load streams, which the
+ * hardware prefetchers can only track so many of.
+ */
+#define RAID6_NEON_GROUP	8
+#define RAID6_NEON_BLOCK	1024
+
+void raid6_neon$#_gen_syndrome_blocked_real(int disks, unsigned long bytes,
+					    void **ptrs)
+{
+	uint8_t **dptr = (uint8_t **)ptrs;
+	uint8_t *p, *q;
+	unsigned long b, d, end;
+	int z, z0, zs, ze;
+
+	register unative_t wd$$, wq$$, wp$$, w1$$, w2$$;
+	const unative_t x1d = NBYTES(0x1d);
+
+	z0 = disks - 3;		/* Highest data disk */
+	p = dptr[z0+1];		/* XOR parity */
+	q = dptr[z0+2];		/* RS syndrome */
+
+	for ( b = 0 ; b < bytes ; b += RAID6_NEON_BLOCK ) {
+		end = bytes - b > RAID6_NEON_BLOCK ? b + RAID6_NEON_BLOCK : bytes;
+
+		for ( zs = z0 ; zs >= 0 ; zs = ze - 1 ) {
+			ze = zs >= RAID6_NEON_GROUP ? zs - RAID6_NEON_GROUP + 1 : 0;
+
+			for ( d = b ; d < end ; d += NSIZE*$# ) {
+				if ( zs == z0 ) {
+					wq$$ = wp$$ = vld1q_u8(&dptr[z0][d+$$*NSIZE]);
+					z = z0 - 1;
+				} else {
+					wp$$ = vld1q_u8(&p[d+$$*NSIZE]);
+					wq$$ = vld1q_u8(&q[d+$$*NSIZE]);
+					z = zs;
+				}
+				for ( ; z >= ze ; z-- ) {
+					wd$$ = vld1q_u8(&dptr[z][d+$$*NSIZE]);
+					wp$$ = veorq_u8(wp$$, wd$$);
+					w2$$ = MASK(wq$$);
+					w1$$ = SHLBYTE(wq$$);
+
+					w2$$ = vandq_u8(w2$$, x1d);
+					w1$$ = veorq_u8(w1$$, w2$$);
+					wq$$ = veorq_u8(w1$$, wd$$);
+				}
+				vst1q_u8(&p[d+NSIZE*$$], wp$$);
+				vst1q_u8(&q[d+NSIZE*$$], wq$$);
+			}
+		}
+	}
+}
+
 void raid6_neon$#_xor_syndrome_real(int disks, int start, int stop,
 				    unsigned long bytes, void **ptrs)
 {
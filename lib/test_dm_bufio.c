@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Concurrent cache hit benchmark for dm-bufio.
+ *
+ * A working set of blocks is read into the cache, then an increasing number
+ * of threads look up random blocks from it with dm_bufio_read() and release
+ * them again.  Every lookup is a cache hit, so this measures the cost of the
+ * lookup and release paths and how they scale with the number of readers.
+ *
+ *	modprobe test_dm_bufio dev=/dev/sdX threads=8
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/blkdev.h>
+#include <linux/completion.h>
+#include <linux/dm-bufio.h>
+#include <linux/err.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+
+static char *dev;
+module_param(dev, charp, 0);
+MODULE_PARM_DESC(dev, "Block device to read from (required)");
+
+static unsigned int bufio_block_size = 4096;
+module_param_named(block_size, bufio_block_size, uint, 0);
+MODULE_PARM_DESC(block_size, "dm-bufio block size (default: 4096)");
+
+static unsigned int blocks = 1024;
+module_param(blocks, uint, 0);
+MODULE_PARM_DESC(blocks, "Number of blocks in the working set (default: 1024)");
+
+static unsigned int ops = 1000000;
+module_param(ops, uint, 0);
+MODULE_PARM_DESC(ops, "Lookups per thread (default: 1000000)");
+
+static unsigned int threads;
+module_param(threads, uint, 0);
+MODULE_PARM_DESC(threads, "Maximum number of reader threads (default: online CPUs)");
+
+struct reader {
+	struct task_struct *task;
+	struct dm_bufio_client *c;
+	struct completion *start;
+	u64 ns;
+	int err;
+};
+
+static int reader_fn(void *data)
+{
+	struct reader *r = data;
+	struct dm_buffer *b;
+	unsigned int i;
+	ktime_t t;
+	void *p;
+
+	wait_for_completion(r->start);
+
+	t = ktime_get();
+	for (i = 0; i < ops; i++) {
+		p = dm_bufio_read(r->c, prandom_u32_max(blocks), &b);
+		if (IS_ERR(p)) {
+			r->err = PTR_ERR(p);
+			break;
+		}
+		dm_bufio_release(b);
+		if (!(i & 1023))
+			cond_resched();
+	}
+	r->ns = ktime_to_ns(ktime_sub(ktime_get(), t));
+
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		schedule();
+	}
+	return r->err;
+}
+
+static int run_readers(struct dm_bufio_client *c, struct reader *readers,
+		       unsigned int nr)
+{
+	DECLARE_COMPLETION_ONSTACK(start);
+	u64 total = 0, max_ns = 0;
+	unsigned int i, started;
+	int err = 0;
+
+	for (started = 0; started < nr; started++) {
+		struct reader *r = &readers[started];
+
+		r->c = c;
+		r->start = &start;
+		r->ns = 0;
+		r->err = 0;
+		r->task = kthread_run(reader_fn, r, "dm_bufio_rd/%u", started);
+		if (IS_ERR(r->task)) {
+			err = PTR_ERR(r->task);
+			break;
+		}
+	}
+
+	complete_all(&start);
+
+	for (i = 0; i < started; i++) {
+		int r = kthread_stop(readers[i].task);
+
+		if (r && !err)
+			err = r;
+		total += ops;
+		max_ns = max(max_ns, readers[i].ns);
+	}
+
+	if (err)
+		return err;
+
+	pr_info("%3u threads: %8llu ns/lookup per thread, %8llu lookups/s total\n",
+		nr, div64_u64(max_ns, ops),
+		div64_u64(total * NSEC_PER_SEC, max_ns ? : 1));
+	return 0;
+}
+
+static int __init test_dm_bufio_init(void)
+{
+	struct block_device *bdev;
+	struct dm_bufio_client *c;
+	struct reader *readers;
+	struct dm_buffer *b;
+	unsigned int i, nr;
+	void *p;
+	int err;
+
+	if (!dev) {
+		pr_err("dev= parameter is required\n");
+		return -EINVAL;
+	}
+	if (!blocks || !ops)
+		return -EINVAL;
+	if (!threads)
+		threads = num_online_cpus();
+
+	bdev = blkdev_get_by_path(dev, FMODE_READ, NULL);
+	if (IS_ERR(bdev))
+		return PTR_ERR(bdev);
+
+	c = dm_bufio_client_create(bdev, bufio_block_size, 1, 0, NULL, NULL);
+	if (IS_ERR(c)) {
+		err = PTR_ERR(c);
+		goto out_put;
+	}
+
+	readers = kcalloc(threads, sizeof(*readers), GFP_KERNEL);
+	if (!readers) {
+		err = -ENOMEM;
+		goto out_client;
+	}
+
+	for (i = 0; i < blocks; i++) {
+		p = dm_bufio_read(c, i, &b);
+		if (IS_ERR(p)) {
+			err = PTR_ERR(p);
+			pr_err("reading block %u failed: %d\n", i, err);
+			goto out_free;
+		}
+		dm_bufio_release(b);
+	}
+
+	pr_info("%u blocks of %u bytes, %u lookups per thread\n",
+		blocks, bufio_block_size, ops);
+
+	for (nr = 1; ; nr = min(nr * 2, threads)) {
+		err = run_readers(c, readers, nr);
+		if (err || nr == threads)
+			break;
+	}
+	if (err)
+		pr_err("benchmark failed: %d\n", err);
+
+out_free:
+	kfree(readers);
+out_client:
+	dm_bufio_client_destroy(c);
+out_put:
+	blkdev_put(bdev, FMODE_READ);
+	return err;
+}
+
+static void __exit test_dm_bufio_exit(void)
+{
+}
+
+module_init(test_dm_bufio_init);
+module_exit(test_dm_bufio_exit);
+
+MODULE_DESCRIPTION("dm-bufio concurrent lookup benchmark");
+MODULE_LICENSE("GPL v2");
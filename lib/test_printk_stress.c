@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Concurrent printk() writer benchmark.
+ *
+ * An increasing number of threads log lines as fast as they can, the way a
+ * driver dumping its state does.  With the default loglevel the lines only
+ * go to the log buffer, not to the consoles, so this measures the cost of
+ * storing a record, how it scales with the number of writers, and the worst
+ * case time a single printk() keeps its caller busy.
+ *
+ *	modprobe test_printk_stress threads=8 lines=100000
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/completion.h>
+#include <linux/err.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/printk.h>
+#include <linux/slab.h>
+
+static unsigned int lines = 100000;
+module_param(lines, uint, 0);
+MODULE_PARM_DESC(lines, "Lines logged per thread (default: 100000)");
+
+static unsigned int len = 64;
+module_param(len, uint, 0);
+MODULE_PARM_DESC(len, "Payload bytes per line (default: 64)");
+
+static int level = LOGLEVEL_DEBUG;
+module_param(level, int, 0);
+MODULE_PARM_DESC(level, "Loglevel of the lines (default: 7, not printed on the consoles)");
+
+static unsigned int threads;
+module_param(threads, uint, 0);
+MODULE_PARM_DESC(threads, "Maximum number of writer threads (default: online CPUs)");
+
+struct writer {
+	struct task_struct *task;
+	struct completion *start;
+	unsigned int id;
+	u64 ns;
+	u64 max_ns;
+};
+
+static int writer_fn(void *data)
+{
+	struct writer *w = data;
+	ktime_t t, t0;
+	unsigned int i;
+	u64 ns;
+
+	wait_for_completion(w->start);
+
+	t = ktime_get();
+	for (i = 0; i < lines; i++) {
+		t0 = ktime_get();
+		printk_emit(0, level, NULL, 0, "stress %u/%u %.*s\n",
+			    w->id, i, len,
+			    "0123456789abcdef0123456789abcdef"
+			    "0123456789abcdef0123456789abcdef"
+			    "0123456789abcdef0123456789abcdef"
+			    "0123456789abcdef0123456789abcdef");
+		ns = ktime_to_ns(ktime_sub(ktime_get(), t0));
+		w->max_ns = max(w->max_ns, ns);
+		if (!(i & 1023))
+			cond_resched();
+	}
+	w->ns = ktime_to_ns(ktime_sub(ktime_get(), t));
+
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		schedule();
+	}
+	return 0;
+}
+
+static int run_writers(struct writer *writers, unsigned int nr)
+{
+	DECLARE_COMPLETION_ONSTACK(start);
+	u64 total = 0, max_ns = 0, worst_ns = 0;
+	unsigned int i, started;
+	int err = 0;
+
+	for (started = 0; started < nr; started++) {
+		struct writer *w = &writers[started];
+
+		w->start = &start;
+		w->id = started;
+		w->ns = 0;
+		w->max_ns = 0;
+		w->task = kthread_run(writer_fn, w, "printk_stress/%u", started);
+		if (IS_ERR(w->task)) {
+			err = PTR_ERR(w->task);
+			break;
+		}
+	}
+
+	complete_all(&start);
+
+	for (i = 0; i < started; i++) {
+		kthread_stop(writers[i].task);
+		total += lines;
+		max_ns = max(max_ns, writers[i].ns);
+		worst_ns = max(worst_ns, writers[i].max_ns);
+	}
+
+	if (err)
+		return err;
+
+	pr_info("%3u threads: %8llu ns/printk per thread, %8llu printk/s total, %8llu ns worst\n",
+		nr, div64_u64(max_ns, lines),
+		div64_u64(total * NSEC_PER_SEC, max_ns ? : 1), worst_ns);
+	return 0;
+}
+
+static int __init test_printk_stress_init(void)
+{
+	struct writer *writers;
+	unsigned int nr;
+	int err;
+
+	if (!lines)
+		return -EINVAL;
+	if (!threads)
+		threads = num_online_cpus();
+	len = min(len, 128U);
+
+	writers = kcalloc(threads, sizeof(*writers), GFP_KERNEL);
+	if (!writers)
+		return -ENOMEM;
+
+	pr_info("%u lines of %u bytes per thread at loglevel %d\n",
+		lines, len, level);
+
+	for (nr = 1; ; nr = min(nr * 2, threads)) {
+		err = run_writers(writers, nr);
+		if (err || nr == threads)
+			break;
+	}
+	if (err)
+		pr_err("benchmark failed: %d\n", err);
+
+	kfree(writers);
+	return err;
+}
+
+static void __exit test_printk_stress_exit(void)
+{
+}
+
+module_init(test_printk_stress_init);
+module_exit(test_printk_stress_exit);
+
+MODULE_DESCRIPTION("Concurrent printk() writer benchmark");
+MODULE_LICENSE("GPL v2");
@@ -2620,6 +2620,7 @@ int tcp_disconnect(struct sock *sk, int flags)
 	tp->bytes_retrans = 0;
 	tp->dsack_dups = 0;
 	tp->reord_seen = 0;
+	tp->tcp_wstamp_ns = 0;
 
 	/* Clean up fastopen related fields */
 	tcp_free_fastopen_req(tp);
@@ -831,6 +831,191 @@ static void tcp_tasklet_func(unsigned long data)
 	}
 }
 
+/*
+ * Internal pacing follows the earliest departure time model: every data
+ * packet sent pushes tp->tcp_wstamp_ns by its length at the pacing rate,
+ * and the socket may not send again before that time.
+ *
+ * Throttled sockets wait on a per cpu timing wheel rather than on a
+ * timer of their own, so that with many paced flows the sockets due in
+ * the same slot are released by a single timer interrupt. Slots are
+ * TCP_PACING_SLOT_NS wide; departure times further away than the wheel
+ * horizon simply stay queued for another lap.
+ *
+ * TSQ_PACED in sk_tsq_flags says whether the socket is on a wheel. The
+ * owner sets it when queueing, the wheel clears it under its lock once
+ * the node is unlinked, so a wheel on another cpu never races with the
+ * owner over tp->pacing_node.
+ */
+#define TCP_PACING_SLOT_SHIFT	14	/* 16.384 usec slots */
+#define TCP_PACING_WHEEL_BITS	11	/* ~33 ms horizon */
+#define TCP_PACING_WHEEL_SLOTS	(1U << TCP_PACING_WHEEL_BITS)
+#define TCP_PACING_WHEEL_MASK	(TCP_PACING_WHEEL_SLOTS - 1)
+
+struct tcp_pacing_wheel {
+	spinlock_t		lock;
+	struct hrtimer		timer;
+	u64			clk;	/* next slot to run */
+	u64			next;	/* slot the timer is armed for */
+	unsigned int		count;	/* sockets on the wheel */
+	DECLARE_BITMAP(pending, TCP_PACING_WHEEL_SLOTS);
+	struct hlist_head	slots[TCP_PACING_WHEEL_SLOTS];
+};
+static DEFINE_PER_CPU(struct tcp_pacing_wheel, tcp_pacing_wheel);
+
+static u64 tcp_pacing_slot(u64 ns)
+{
+	return ns >> TCP_PACING_SLOT_SHIFT;
+}
+
+static void tcp_pacing_unlink(struct tcp_pacing_wheel *w, struct tcp_sock *tp)
+{
+	unsigned int idx = tp->pacing_slot & TCP_PACING_WHEEL_MASK;
+
+	hlist_del_init(&tp->pacing_node);
+	if (hlist_empty(&w->slots[idx]))
+		__clear_bit(idx, w->pending);
+	w->count--;
+
+	/* The node may be reused once this is seen clear */
+	smp_mb__before_atomic();
+	clear_bit(TSQ_PACED, &((struct sock *)tp)->sk_tsq_flags);
+}
+
+/* Arm the wheel timer for the first non empty slot. Called with w->lock held */
+static void tcp_pacing_wheel_program(struct tcp_pacing_wheel *w)
+{
+	unsigned int start, idx;
+	u64 next;
+
+	if (!w->count)
+		return;
+
+	start = w->clk & TCP_PACING_WHEEL_MASK;
+	idx = find_next_bit(w->pending, TCP_PACING_WHEEL_SLOTS, start);
+	if (idx >= TCP_PACING_WHEEL_SLOTS)
+		idx = find_first_bit(w->pending, TCP_PACING_WHEEL_SLOTS) +
+		      TCP_PACING_WHEEL_SLOTS;
+	next = w->clk + idx - start;
+
+	if (hrtimer_is_queued(&w->timer) && w->next == next)
+		return;
+	w->next = next;
+	hrtimer_start(&w->timer, ns_to_ktime(next << TCP_PACING_SLOT_SHIFT),
+		      HRTIMER_MODE_ABS_PINNED_SOFT);
+}
+
+/* Detach one socket due at or before @now_slot, advancing the wheel clock
+ * as slots are emptied. Called with w->lock held.
+ */
+static struct tcp_sock *tcp_pacing_wheel_pop(struct tcp_pacing_wheel *w,
+					     u64 now_slot)
+{
+	struct tcp_sock *tp;
+
+	/* After a long stall one lap visits every slot */
+	if (now_slot - w->clk > TCP_PACING_WHEEL_MASK)
+		w->clk = now_slot - TCP_PACING_WHEEL_MASK;
+
+	while (w->count && w->clk <= now_slot) {
+		unsigned int idx = w->clk & TCP_PACING_WHEEL_MASK;
+
+		if (test_bit(idx, w->pending)) {
+			hlist_for_each_entry(tp, &w->slots[idx], pacing_node) {
+				if (tp->pacing_slot <= now_slot) {
+					tcp_pacing_unlink(w, tp);
+					return tp;
+				}
+			}
+		}
+		w->clk++;
+	}
+	return NULL;
+}
+
+/* Note: Called under soft irq.
+ * We can call TCP stack right away, unless socket is owned by user.
+ */
+static enum hrtimer_restart tcp_pacing_wheel_run(struct hrtimer *timer)
+{
+	struct tcp_pacing_wheel *w = container_of(timer, struct tcp_pacing_wheel,
+						  timer);
+	u64 now_slot = tcp_pacing_slot(ktime_get_ns());
+	struct tcp_sock *tp;
+
+	spin_lock(&w->lock);
+	while ((tp = tcp_pacing_wheel_pop(w, now_slot)) != NULL) {
+		struct sock *sk = (struct sock *)tp;
+
+		spin_unlock(&w->lock);
+		tcp_tsq_handler(sk);
+		sock_put(sk);
+		spin_lock(&w->lock);
+	}
+	tcp_pacing_wheel_program(w);
+	spin_unlock(&w->lock);
+
+	return HRTIMER_NORESTART;
+}
+
+/* Queue a throttled socket on this cpu's wheel until tp->tcp_wstamp_ns.
+ * Caller owns the socket.
+ */
+static void tcp_pacing_arm(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct tcp_pacing_wheel *w;
+	u64 slot;
+
+	if (test_and_set_bit(TSQ_PACED, &sk->sk_tsq_flags))
+		return;
+
+	slot = tcp_pacing_slot(tp->tcp_wstamp_ns);
+
+	local_bh_disable();
+	w = this_cpu_ptr(&tcp_pacing_wheel);
+	spin_lock(&w->lock);
+	if (!w->count)
+		w->clk = tcp_pacing_slot(ktime_get_ns());
+	tp->pacing_slot = slot;
+	tp->pacing_cpu = smp_processor_id();
+	hlist_add_head(&tp->pacing_node,
+		       &w->slots[slot & TCP_PACING_WHEEL_MASK]);
+	__set_bit(slot & TCP_PACING_WHEEL_MASK, w->pending);
+	w->count++;
+	sock_hold(sk);
+	if (!hrtimer_is_queued(&w->timer) || slot < w->next) {
+		w->next = slot;
+		hrtimer_start(&w->timer,
+			      ns_to_ktime(slot << TCP_PACING_SLOT_SHIFT),
+			      HRTIMER_MODE_ABS_PINNED_SOFT);
+	}
+	spin_unlock(&w->lock);
+	local_bh_enable();
+}
+
+void tcp_pacing_cancel(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct tcp_pacing_wheel *w;
+	bool queued;
+
+	if (!test_bit(TSQ_PACED, &sk->sk_tsq_flags))
+		return;
+
+	/* pacing_cpu is only written by the owner, which we are */
+	w = per_cpu_ptr(&tcp_pacing_wheel, tp->pacing_cpu);
+	spin_lock_bh(&w->lock);
+	queued = test_bit(TSQ_PACED, &sk->sk_tsq_flags);
+	if (queued)
+		tcp_pacing_unlink(w, tp);
+	spin_unlock_bh(&w->lock);
+
+	if (queued)
+		__sock_put(sk);
+}
+EXPORT_SYMBOL(tcp_pacing_cancel);
+
 #define TCP_DEFERRED_ALL (TCPF_TSQ_DEFERRED |		\
 			  TCPF_WRITE_TIMER_DEFERRED |	\
 			  TCPF_DELACK_TIMER_DEFERRED |	\
@@ -896,6 +1081,15 @@ void __init tcp_tasklet_init(void)
 			     tcp_tasklet_func,
 			     (unsigned long)tsq);
 	}
+
+	for_each_possible_cpu(i) {
+		struct tcp_pacing_wheel *w = &per_cpu(tcp_pacing_wheel, i);
+
+		spin_lock_init(&w->lock);
+		hrtimer_init(&w->timer, CLOCK_MONOTONIC,
+			     HRTIMER_MODE_ABS_PINNED_SOFT);
+		w->timer.function = tcp_pacing_wheel_run;
+	}
 }
 
 /*
@@ -950,23 +1144,15 @@ out:
 	sk_free(sk);
 }
 
-/* Note: Called under soft irq.
- * We can call TCP stack right away, unless socket is owned by user.
+/* Advance the earliest departure time past this data packet. Sending
+ * late, because of the wheel granularity or scheduling delays, earns a
+ * credit of up to half the packet time so that the flow catches up
+ * with its pacing rate.
  */
-enum hrtimer_restart tcp_pace_kick(struct hrtimer *timer)
+static void tcp_update_wstamp(struct sock *sk, const struct sk_buff *skb)
 {
-	struct tcp_sock *tp = container_of(timer, struct tcp_sock, pacing_timer);
-	struct sock *sk = (struct sock *)tp;
-
-	tcp_tsq_handler(sk);
-	sock_put(sk);
-
-	return HRTIMER_NORESTART;
-}
-
-static void tcp_internal_pacing(struct sock *sk, const struct sk_buff *skb)
-{
-	u64 len_ns;
+	struct tcp_sock *tp = tcp_sk(sk);
+	u64 now, len_ns, credit = 0;
 	u32 rate;
 
 	if (!tcp_needs_internal_pacing(sk))
@@ -975,12 +1161,15 @@ static void tcp_internal_pacing(struct sock *sk, const struct sk_buff *skb)
 	if (!rate || rate == ~0U)
 		return;
 
+	now = ktime_get_ns();
+	if (tp->tcp_wstamp_ns < now) {
+		credit = now - tp->tcp_wstamp_ns;
+		tp->tcp_wstamp_ns = now;
+	}
+
 	len_ns = (u64)skb->len * NSEC_PER_SEC;
 	do_div(len_ns, rate);
-	hrtimer_start(&tcp_sk(sk)->pacing_timer,
-		      ktime_add_ns(ktime_get(), len_ns),
-		      HRTIMER_MODE_ABS_PINNED_SOFT);
-	sock_hold(sk);
+	tp->tcp_wstamp_ns += len_ns - min_t(u64, len_ns / 2, credit);
 }
 
 static void tcp_update_skb_after_send(struct tcp_sock *tp, struct sk_buff *skb)
@@ -1124,7 +1313,7 @@ static int __tcp_transmit_skb(struct sock *sk, struct sk_buff *skb,
 		tcp_event_data_sent(tp, sk);
 		tp->data_segs_out += tcp_skb_pcount(skb);
 		tp->bytes_sent += skb->len - tcp_header_size;
-		tcp_internal_pacing(sk, skb);
+		tcp_update_wstamp(sk, skb);
 	}
 
 	if (after(tcb->end_seq, tp->snd_nxt) || tcb->seq == tcb->end_seq)
@@ -2190,10 +2379,21 @@ static int tcp_mtu_probe(struct sock *sk)
 	return -1;
 }
 
-static bool tcp_pacing_check(const struct sock *sk)
+/* Returns true if the socket has to wait for its departure time, in
+ * which case it is queued on the pacing wheel.
+ */
+static bool tcp_pacing_check(struct sock *sk)
 {
-	return tcp_needs_internal_pacing(sk) &&
-	       hrtimer_is_queued(&tcp_sk(sk)->pacing_timer);
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	if (!tcp_needs_internal_pacing(sk))
+		return false;
+	if (tcp_pacing_slot(tp->tcp_wstamp_ns) <=
+	    tcp_pacing_slot(ktime_get_ns()))
+		return false;
+
+	tcp_pacing_arm(sk);
+	return true;
 }
 
 /* TCP Small Queues :
@@ -749,6 +749,58 @@ static void esp6_destroy(struct xfrm_state *x)
 	crypto_free_aead(aead);
 }
 
+/* With net.core.xfrm_pcrypt set, ask for the pcrypt version of the
+ * AEAD, which spreads the requests of an SA over all CPUs and completes
+ * them in submission order. Fall back to the plain algorithm if pcrypt is
+ * not available.
+ *
+ * Once instantiated, pcrypt is registered under the same name as the
+ * algorithm it wraps at a higher priority, and stays so. Without
+ * xfrm_pcrypt, look through it and allocate the wrapped implementation by
+ * its driver name, so the sysctl keeps deciding for the states created
+ * afterwards.
+ */
+static struct crypto_aead *esp_alloc_aead(struct xfrm_state *x,
+					  const char *name)
+{
+	static const char pcrypt_prefix[] = "pcrypt(";
+	const size_t prefix_len = sizeof(pcrypt_prefix) - 1;
+	char alg_name[CRYPTO_MAX_ALG_NAME];
+	struct crypto_aead *aead, *plain;
+	const char *driver;
+	size_t len;
+
+	if (xs_net(x)->xfrm.sysctl_pcrypt &&
+	    snprintf(alg_name, CRYPTO_MAX_ALG_NAME, "pcrypt(%s)",
+		     name) < CRYPTO_MAX_ALG_NAME) {
+		aead = crypto_alloc_aead(alg_name, 0, 0);
+		if (!IS_ERR(aead))
+			return aead;
+	}
+
+	aead = crypto_alloc_aead(name, 0, 0);
+	if (IS_ERR(aead) || xs_net(x)->xfrm.sysctl_pcrypt)
+		return aead;
+
+	driver = crypto_tfm_alg_driver_name(crypto_aead_tfm(aead));
+	len = strlen(driver);
+	if (len <= prefix_len + 1 ||
+	    strncmp(driver, pcrypt_prefix, prefix_len) ||
+	    driver[len - 1] != ')')
+		return aead;
+
+	len -= prefix_len + 1;
+	memcpy(alg_name, driver + prefix_len, len);
+	alg_name[len] = '\0';
+
+	plain = crypto_alloc_aead(alg_name, 0, 0);
+	if (IS_ERR(plain))
+		return aead;
+
+	crypto_free_aead(aead);
+	return plain;
+}
+
 static int esp_init_aead(struct xfrm_state *x)
 {
 	char aead_name[CRYPTO_MAX_ALG_NAME];
@@ -760,7 +812,7 @@ static int esp_init_aead(struct xfrm_state *x)
 		     x->geniv, x->aead->alg_name) >= CRYPTO_MAX_ALG_NAME)
 		goto error;
 
-	aead = crypto_alloc_aead(aead_name, 0, 0);
+	aead = esp_alloc_aead(x, aead_name);
 	err = PTR_ERR(aead);
 	if (IS_ERR(aead))
 		goto error;
@@ -815,7 +867,7 @@ static int esp_init_authenc(struct xfrm_state *x)
 			goto error;
 	}
 
-	aead = crypto_alloc_aead(authenc_name, 0, 0);
+	aead = esp_alloc_aead(x, authenc_name);
 	err = PTR_ERR(aead);
 	if (IS_ERR(aead))
 		goto error;
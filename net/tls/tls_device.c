@@ -719,6 +719,11 @@ int tls_set_device_offload(struct sock *sk, struct tls_context *ctx)
 	}
 
 	crypto_info = &ctx->crypto_send.info;
+	if (crypto_info->version != TLS_1_2_VERSION) {
+		rc = -EOPNOTSUPP;
+		goto free_offload_ctx;
+	}
+
 	switch (crypto_info->cipher_type) {
 	case TLS_CIPHER_AES_GCM_128:
 		nonce_size = TLS_CIPHER_AES_GCM_128_IV_SIZE;
@@ -738,6 +743,8 @@ int tls_set_device_offload(struct sock *sk, struct tls_context *ctx)
 	ctx->tx.tag_size = tag_size;
 	ctx->tx.overhead_size = ctx->tx.prepend_size + ctx->tx.tag_size;
 	ctx->tx.iv_size = iv_size;
+	ctx->tx.salt_size = TLS_CIPHER_AES_GCM_128_SALT_SIZE;
+	ctx->tx.aad_size = TLS_AAD_SPACE_SIZE;
 	ctx->tx.iv = kmalloc(iv_size + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
 			     GFP_KERNEL);
 	if (!ctx->tx.iv) {
@@ -853,6 +860,10 @@ int tls_set_device_offload_rx(struct sock *sk, struct tls_context *ctx)
 	struct net_device *netdev;
 	int rc = 0;
 
+	if (ctx->crypto_recv.info.version != TLS_1_2_VERSION ||
+	    ctx->crypto_recv.info.cipher_type != TLS_CIPHER_AES_GCM_128)
+		return -EOPNOTSUPP;
+
 	/* We support starting offload on multiple sockets
 	 * concurrently, so we only need a read lock here.
 	 * This lock must precede get_netdev_for_sock to prevent races between
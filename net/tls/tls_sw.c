@@ -41,28 +41,116 @@
 #include <net/strparser.h>
 #include <net/tls.h>
 
-#define MAX_IV_SIZE	TLS_CIPHER_AES_GCM_128_IV_SIZE
+/* Largest salt + IV of the supported ciphers */
+#define MAX_IV_SIZE	TLS_CIPHER_CHACHA20_POLY1305_IV_SIZE
+
+static void tls_decrypt_done(struct crypto_async_request *req, int err)
+{
+	struct aead_request *aead_req = (struct aead_request *)req;
+	struct scatterlist *sgout = aead_req->dst;
+	struct tls_sw_context_rx *ctx;
+	struct tls_context *tls_ctx;
+	struct scatterlist *sg;
+	struct sk_buff *skb;
+	unsigned int pages;
+
+	/* Backlogged request has just been started */
+	if (err == -EINPROGRESS)
+		return;
+
+	skb = (struct sk_buff *)req->data;
+	tls_ctx = tls_get_ctx(skb->sk);
+	ctx = tls_sw_ctx_rx(tls_ctx);
+
+	/* Propagate if there was an err */
+	if (err) {
+		ctx->async_wait.err = err;
+		tls_err_abort(skb->sk, err);
+	}
+
+	/* skb->sk only carried the socket through the crypto callback */
+	skb->sk = NULL;
+	kfree_skb(skb);
+
+	/* Release the user pages; the first S/G entry points to the AAD */
+	for_each_sg(sg_next(sgout), sg, UINT_MAX, pages) {
+		if (!sg || !sg_page(sg))
+			break;
+		put_page(sg_page(sg));
+	}
+
+	kfree(aead_req);
+
+	/* The reader holds a bias on decrypt_pending while it has records
+	 * in flight, so ctx cannot be touched once this drops the count.
+	 */
+	if (atomic_dec_and_test(&ctx->decrypt_pending))
+		complete(&ctx->async_wait.completion);
+}
+
+/* Wait for all records submitted for async decryption. Dropping the
+ * reader's bias on decrypt_pending decides, together with the callbacks,
+ * who sees the count reach zero; only that one completes.
+ */
+static int tls_decrypt_async_wait(struct tls_sw_context_rx *ctx)
+{
+	if (!atomic_dec_and_test(&ctx->decrypt_pending))
+		crypto_wait_req(-EINPROGRESS, &ctx->async_wait);
+	atomic_inc(&ctx->decrypt_pending);
+
+	return ctx->async_wait.err;
+}
 
 static int tls_do_decryption(struct sock *sk,
+			     struct sk_buff *skb,
 			     struct scatterlist *sgin,
 			     struct scatterlist *sgout,
 			     char *iv_recv,
 			     size_t data_len,
-			     struct aead_request *aead_req)
+			     struct aead_request *aead_req,
+			     bool async)
 {
 	struct tls_context *tls_ctx = tls_get_ctx(sk);
 	struct tls_sw_context_rx *ctx = tls_sw_ctx_rx(tls_ctx);
 	int ret;
 
 	aead_request_set_tfm(aead_req, ctx->aead_recv);
-	aead_request_set_ad(aead_req, TLS_AAD_SPACE_SIZE);
+	aead_request_set_ad(aead_req, tls_ctx->rx.aad_size);
 	aead_request_set_crypt(aead_req, sgin, sgout,
 			       data_len + tls_ctx->rx.tag_size,
 			       (u8 *)iv_recv);
-	aead_request_set_callback(aead_req, CRYPTO_TFM_REQ_MAY_BACKLOG,
-				  crypto_req_done, &ctx->async_wait);
 
-	ret = crypto_wait_req(crypto_aead_decrypt(aead_req), &ctx->async_wait);
+	if (async) {
+		/* Using skb->sk to push sk through to crypto async callback
+		 * handler. This allows propagating errors up to the socket
+		 * if needed. It _must_ be cleared in the async handler
+		 * before kfree_skb is called.
+		 */
+		skb->sk = sk;
+		aead_request_set_callback(aead_req,
+					  CRYPTO_TFM_REQ_MAY_BACKLOG,
+					  tls_decrypt_done, skb);
+		atomic_inc(&ctx->decrypt_pending);
+	} else {
+		aead_request_set_callback(aead_req,
+					  CRYPTO_TFM_REQ_MAY_BACKLOG,
+					  crypto_req_done, &ctx->async_wait);
+	}
+
+	ret = crypto_aead_decrypt(aead_req);
+	if (ret == -EINPROGRESS || ret == -EBUSY) {
+		if (async)
+			return -EINPROGRESS;
+
+		ret = crypto_wait_req(ret, &ctx->async_wait);
+	}
+
+	if (async) {
+		/* Completed inline, the callback will not run */
+		atomic_dec(&ctx->decrypt_pending);
+		skb->sk = NULL;
+	}
+
 	return ret;
 }
 
@@ -142,7 +230,7 @@ static int alloc_plaintext_sg(struct sock *sk, int len)
 			 tls_ctx->pending_open_record_frags);
 
 	if (rc == -ENOSPC)
-		ctx->sg_plaintext_num_elem = ARRAY_SIZE(ctx->sg_plaintext_data);
+		ctx->sg_plaintext_num_elem = MAX_SKB_FRAGS;
 
 	return rc;
 }
@@ -175,7 +263,7 @@ static void tls_free_both_sg(struct sock *sk)
 static int tls_do_encryption(struct tls_context *tls_ctx,
 			     struct tls_sw_context_tx *ctx,
 			     struct aead_request *aead_req,
-			     size_t data_len)
+			     size_t data_len, char *iv)
 {
 	int rc;
 
@@ -183,9 +271,9 @@ static int tls_do_encryption(struct tls_context *tls_ctx,
 	ctx->sg_encrypted_data[0].length -= tls_ctx->tx.prepend_size;
 
 	aead_request_set_tfm(aead_req, ctx->aead_send);
-	aead_request_set_ad(aead_req, TLS_AAD_SPACE_SIZE);
+	aead_request_set_ad(aead_req, tls_ctx->tx.aad_size);
 	aead_request_set_crypt(aead_req, ctx->sg_aead_in, ctx->sg_aead_out,
-			       data_len, tls_ctx->tx.iv);
+			       data_len, iv);
 
 	aead_request_set_callback(aead_req, CRYPTO_TFM_REQ_MAY_BACKLOG,
 				  crypto_req_done, &ctx->async_wait);
@@ -203,6 +291,8 @@ static int tls_push_record(struct sock *sk, int flags,
 {
 	struct tls_context *tls_ctx = tls_get_ctx(sk);
 	struct tls_sw_context_tx *ctx = tls_sw_ctx_tx(tls_ctx);
+	int num_elem = ctx->sg_plaintext_num_elem;
+	char iv[MAX_IV_SIZE], *nonce = tls_ctx->tx.iv;
 	struct aead_request *req;
 	int rc;
 
@@ -210,12 +300,29 @@ static int tls_push_record(struct sock *sk, int flags,
 	if (!req)
 		return -ENOMEM;
 
-	sg_mark_end(ctx->sg_plaintext_data + ctx->sg_plaintext_num_elem - 1);
+	sg_mark_end(ctx->sg_plaintext_data + num_elem - 1);
 	sg_mark_end(ctx->sg_encrypted_data + ctx->sg_encrypted_num_elem - 1);
 
-	tls_make_aad(ctx->aad_space, ctx->sg_plaintext_size,
-		     tls_ctx->tx.rec_seq, tls_ctx->tx.rec_seq_size,
-		     record_type);
+	if (tls_ctx->tx.tail_size) {
+		/* TLS 1.3 encrypts the record type after the payload */
+		ctx->content_type = record_type;
+		sg_unmark_end(&ctx->sg_plaintext_data[num_elem - 1]);
+		sg_set_buf(&ctx->sg_plaintext_data[num_elem],
+			   &ctx->content_type, tls_ctx->tx.tail_size);
+		sg_mark_end(&ctx->sg_plaintext_data[num_elem]);
+
+		tls13_make_aad(ctx->aad_space, ctx->sg_plaintext_size +
+			       tls_ctx->tx.tail_size + tls_ctx->tx.tag_size);
+	} else {
+		tls_make_aad(ctx->aad_space, ctx->sg_plaintext_size,
+			     tls_ctx->tx.rec_seq, tls_ctx->tx.rec_seq_size,
+			     record_type);
+	}
+
+	if (!tls_nonce_size(&tls_ctx->tx)) {
+		tls_xor_iv_with_seq(&tls_ctx->tx, iv);
+		nonce = iv;
+	}
 
 	tls_fill_prepend(tls_ctx,
 			 page_address(sg_page(&ctx->sg_encrypted_data[0])) +
@@ -225,7 +332,9 @@ static int tls_push_record(struct sock *sk, int flags,
 	tls_ctx->pending_open_record_frags = 0;
 	set_bit(TLS_PENDING_CLOSED_RECORD, &tls_ctx->flags);
 
-	rc = tls_do_encryption(tls_ctx, ctx, req, ctx->sg_plaintext_size);
+	rc = tls_do_encryption(tls_ctx, ctx, req,
+			       ctx->sg_plaintext_size + tls_ctx->tx.tail_size,
+			       nonce);
 	if (rc < 0) {
 		/* If we are called from write_space and
 		 * we fail, we need to set this SOCK_NOSPACE
@@ -418,7 +527,7 @@ alloc_encrypted:
 				try_to_copy, &ctx->sg_plaintext_num_elem,
 				&ctx->sg_plaintext_size,
 				ctx->sg_plaintext_data,
-				ARRAY_SIZE(ctx->sg_plaintext_data),
+				MAX_SKB_FRAGS,
 				true);
 			if (ret)
 				goto fallback_to_reg_send;
@@ -579,8 +688,7 @@ alloc_payload:
 		tls_ctx->pending_open_record_frags = ctx->sg_plaintext_num_elem;
 
 		if (full_record || eor ||
-		    ctx->sg_plaintext_num_elem ==
-		    ARRAY_SIZE(ctx->sg_plaintext_data)) {
+		    ctx->sg_plaintext_num_elem == MAX_SKB_FRAGS) {
 push_record:
 			ret = tls_push_record(sk, flags, record_type);
 			if (ret) {
@@ -663,12 +771,16 @@ static struct sk_buff *tls_wait_data(struct sock *sk, int flags,
  * out_iov or out_sg must be non-NULL. In case both out_iov and out_sg are
  * NULL, then the decryption happens inside skb buffers itself, i.e.
  * zero-copy gets disabled and 'zc' is updated.
+ *
+ * With 'async' set and zero-copy into out_iov in use, the request may be
+ * left in flight, in which case -EINPROGRESS is returned and the skb
+ * reference passes to the completion handler.
  */
 
 static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 			    struct iov_iter *out_iov,
 			    struct scatterlist *out_sg,
-			    int *chunk, bool *zc)
+			    int *chunk, bool *zc, bool async)
 {
 	struct tls_context *tls_ctx = tls_get_ctx(sk);
 	struct tls_sw_context_rx *ctx = tls_sw_ctx_rx(tls_ctx);
@@ -679,7 +791,8 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 	u8 *aad, *iv, *mem = NULL;
 	struct scatterlist *sgin = NULL;
 	struct scatterlist *sgout = NULL;
-	const int data_len = rxm->full_len - tls_ctx->rx.overhead_size;
+	const int data_len = rxm->full_len - tls_ctx->rx.prepend_size -
+			     tls_ctx->rx.tag_size;
 
 	if (*zc && (out_iov || out_sg)) {
 		if (out_iov)
@@ -721,23 +834,29 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 	iv = aad + TLS_AAD_SPACE_SIZE;
 
 	/* Prepare IV */
-	err = skb_copy_bits(skb, rxm->offset + TLS_HEADER_SIZE,
-			    iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
-			    tls_ctx->rx.iv_size);
-	if (err < 0) {
-		kfree(mem);
-		return err;
+	if (tls_nonce_size(&tls_ctx->rx)) {
+		err = skb_copy_bits(skb, rxm->offset + TLS_HEADER_SIZE,
+				    iv + tls_ctx->rx.salt_size,
+				    tls_ctx->rx.iv_size);
+		if (err < 0) {
+			kfree(mem);
+			return err;
+		}
+		memcpy(iv, tls_ctx->rx.iv, tls_ctx->rx.salt_size);
+	} else {
+		tls_xor_iv_with_seq(&tls_ctx->rx, iv);
 	}
-	memcpy(iv, tls_ctx->rx.iv, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
 
 	/* Prepare AAD */
-	tls_make_aad(aad, rxm->full_len - tls_ctx->rx.overhead_size,
-		     tls_ctx->rx.rec_seq, tls_ctx->rx.rec_seq_size,
-		     ctx->control);
+	if (tls_ctx->crypto_recv.info.version == TLS_1_3_VERSION)
+		tls13_make_aad(aad, data_len + tls_ctx->rx.tag_size);
+	else
+		tls_make_aad(aad, data_len, tls_ctx->rx.rec_seq,
+			     tls_ctx->rx.rec_seq_size, ctx->control);
 
 	/* Prepare sgin */
 	sg_init_table(sgin, n_sgin);
-	sg_set_buf(&sgin[0], aad, TLS_AAD_SPACE_SIZE);
+	sg_set_buf(&sgin[0], aad, tls_ctx->rx.aad_size);
 	err = skb_to_sgvec(skb, &sgin[1],
 			   rxm->offset + tls_ctx->rx.prepend_size,
 			   rxm->full_len - tls_ctx->rx.prepend_size);
@@ -749,7 +868,7 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 	if (n_sgout) {
 		if (out_iov) {
 			sg_init_table(sgout, n_sgout);
-			sg_set_buf(&sgout[0], aad, TLS_AAD_SPACE_SIZE);
+			sg_set_buf(&sgout[0], aad, tls_ctx->rx.aad_size);
 
 			*chunk = 0;
 			err = zerocopy_from_iter(sk, out_iov, data_len, &pages,
@@ -768,10 +887,14 @@ fallback_to_reg_recv:
 		pages = 0;
 		*chunk = 0;
 		*zc = false;
+		async = false;
 	}
 
 	/* Prepare and submit AEAD request */
-	err = tls_do_decryption(sk, sgin, sgout, iv, data_len, aead_req);
+	err = tls_do_decryption(sk, skb, sgin, sgout, iv, data_len, aead_req,
+				async);
+	if (err == -EINPROGRESS)
+		return err;
 
 	/* Release the pages in case iov was mapped to pages */
 	for (; pages > 0; pages--)
@@ -781,12 +904,41 @@ fallback_to_reg_recv:
 	return err;
 }
 
+/* TLS 1.3 records end with the real record type followed by optional
+ * zero padding. Sets the record type and returns the padding length.
+ */
+static int tls13_padding_length(struct tls_context *tls_ctx,
+				struct tls_sw_context_rx *ctx,
+				struct sk_buff *skb)
+{
+	struct strp_msg *rxm = strp_msg(skb);
+	int end = rxm->full_len - tls_ctx->rx.tag_size;
+	int pos = end;
+	u8 content_type;
+	int err;
+
+	while (--pos >= tls_ctx->rx.prepend_size) {
+		err = skb_copy_bits(skb, rxm->offset + pos, &content_type, 1);
+		if (err < 0)
+			return err;
+
+		if (content_type) {
+			ctx->control = content_type;
+			return end - pos - 1;
+		}
+	}
+
+	return -EBADMSG;
+}
+
 static int decrypt_skb_update(struct sock *sk, struct sk_buff *skb,
-			      struct iov_iter *dest, int *chunk, bool *zc)
+			      struct iov_iter *dest, int *chunk, bool *zc,
+			      bool async)
 {
 	struct tls_context *tls_ctx = tls_get_ctx(sk);
 	struct tls_sw_context_rx *ctx = tls_sw_ctx_rx(tls_ctx);
 	struct strp_msg *rxm = strp_msg(skb);
+	int padding = 0;
 	int err = 0;
 
 #ifdef CONFIG_TLS_DEVICE
@@ -795,15 +947,25 @@ static int decrypt_skb_update(struct sock *sk, struct sk_buff *skb,
 		return err;
 #endif
 	if (!ctx->decrypted) {
-		err = decrypt_internal(sk, skb, dest, NULL, chunk, zc);
-		if (err < 0)
+		err = decrypt_internal(sk, skb, dest, NULL, chunk, zc, async);
+		if (err < 0) {
+			/* The skb now belongs to the pending request */
+			if (err == -EINPROGRESS)
+				tls_advance_record_sn(sk, &tls_ctx->rx);
 			return err;
+		}
 	} else {
 		*zc = false;
 	}
 
+	if (tls_ctx->rx.tail_size) {
+		padding = tls13_padding_length(tls_ctx, ctx, skb);
+		if (padding < 0)
+			return padding;
+	}
+
 	rxm->offset += tls_ctx->rx.prepend_size;
-	rxm->full_len -= tls_ctx->rx.overhead_size;
+	rxm->full_len -= tls_ctx->rx.overhead_size + padding;
 	tls_advance_record_sn(sk, &tls_ctx->rx);
 	ctx->decrypted = true;
 	ctx->saved_data_ready(sk);
@@ -817,7 +979,7 @@ int decrypt_skb(struct sock *sk, struct sk_buff *skb,
 	bool zc = true;
 	int chunk;
 
-	return decrypt_internal(sk, skb, NULL, sgout, &chunk, &zc);
+	return decrypt_internal(sk, skb, NULL, sgout, &chunk, &zc, false);
 }
 
 static bool tls_sw_advance_skb(struct sock *sk, struct sk_buff *skb,
@@ -825,18 +987,22 @@ static bool tls_sw_advance_skb(struct sock *sk, struct sk_buff *skb,
 {
 	struct tls_context *tls_ctx = tls_get_ctx(sk);
 	struct tls_sw_context_rx *ctx = tls_sw_ctx_rx(tls_ctx);
-	struct strp_msg *rxm = strp_msg(skb);
+	struct strp_msg *rxm;
 
-	if (len < rxm->full_len) {
-		rxm->offset += len;
-		rxm->full_len -= len;
+	/* A NULL skb was handed over to an async decryption request */
+	if (skb) {
+		rxm = strp_msg(skb);
+		if (len < rxm->full_len) {
+			rxm->offset += len;
+			rxm->full_len -= len;
 
-		return false;
+			return false;
+		}
+		kfree_skb(skb);
 	}
 
 	/* Finished with message */
 	ctx->recv_pkt = NULL;
-	kfree_skb(skb);
 	__strp_unpause(&ctx->strp);
 
 	return true;
@@ -857,6 +1023,7 @@ int tls_sw_recvmsg(struct sock *sk,
 	ssize_t copied = 0;
 	bool cmsg = false;
 	int target, err = 0;
+	int num_async = 0;
 	long timeo;
 	bool is_kvec = msg->msg_iter.type & ITER_KVEC;
 
@@ -870,6 +1037,7 @@ int tls_sw_recvmsg(struct sock *sk,
 	target = sock_rcvlowat(sk, flags & MSG_WAITALL, len);
 	timeo = sock_rcvtimeo(sk, flags & MSG_DONTWAIT);
 	do {
+		bool async = false;
 		bool zc = false;
 		int chunk = 0;
 
@@ -878,6 +1046,48 @@ int tls_sw_recvmsg(struct sock *sk,
 			goto recv_end;
 
 		rxm = strp_msg(skb);
+
+		/* Decrypt first: the TLS 1.3 record type is only known once
+		 * the record has been decrypted. Only data records, whose
+		 * length is known up front, are decrypted into the user
+		 * buffer. With an asynchronous cipher those are left in
+		 * flight, so the following records can be submitted before
+		 * this one completes.
+		 */
+		if (!ctx->decrypted) {
+			int to_copy = rxm->full_len - tls_ctx->rx.overhead_size;
+
+			if (!is_kvec && to_copy <= len &&
+			    ctx->control == TLS_RECORD_TYPE_DATA &&
+			    !tls_ctx->rx.tail_size &&
+			    likely(!(flags & MSG_PEEK))) {
+				zc = true;
+				async = ctx->async_capable &&
+					(!cmsg || control == ctx->control);
+			}
+
+			err = decrypt_skb_update(sk, skb, &msg->msg_iter,
+						 &chunk, &zc, async);
+			if (err == -EINPROGRESS) {
+				if (!cmsg) {
+					put_cmsg(msg, SOL_TLS,
+						 TLS_GET_RECORD_TYPE,
+						 sizeof(ctx->control),
+						 &ctx->control);
+					cmsg = true;
+					control = ctx->control;
+				}
+				num_async++;
+				goto pick_next_record;
+			}
+			if (err < 0) {
+				tls_err_abort(sk, EBADMSG);
+				goto recv_end;
+			}
+			async = false;
+			ctx->decrypted = true;
+		}
+
 		if (!cmsg) {
 			int cerr;
 
@@ -895,22 +1105,6 @@ int tls_sw_recvmsg(struct sock *sk,
 			goto recv_end;
 		}
 
-		if (!ctx->decrypted) {
-			int to_copy = rxm->full_len - tls_ctx->rx.overhead_size;
-
-			if (!is_kvec && to_copy <= len &&
-			    likely(!(flags & MSG_PEEK)))
-				zc = true;
-
-			err = decrypt_skb_update(sk, skb, &msg->msg_iter,
-						 &chunk, &zc);
-			if (err < 0) {
-				tls_err_abort(sk, EBADMSG);
-				goto recv_end;
-			}
-			ctx->decrypted = true;
-		}
-
 		if (!zc) {
 			chunk = min_t(unsigned int, rxm->full_len, len);
 			err = skb_copy_datagram_msg(skb, rxm->offset, msg,
@@ -919,11 +1113,16 @@ int tls_sw_recvmsg(struct sock *sk,
 				goto recv_end;
 		}
 
+pick_next_record:
 		copied += chunk;
 		len -= chunk;
 		if (likely(!(flags & MSG_PEEK))) {
 			u8 control = ctx->control;
 
+			/* For async, drop current skb reference */
+			if (async)
+				skb = NULL;
+
 			if (tls_sw_advance_skb(sk, skb, chunk)) {
 				/* Return full control message to
 				 * userspace before trying to parse
@@ -948,6 +1147,18 @@ int tls_sw_recvmsg(struct sock *sk,
 	} while (len);
 
 recv_end:
+	if (num_async) {
+		/* Wait for all previously submitted records to be decrypted */
+		int ret = tls_decrypt_async_wait(ctx);
+
+		if (ret) {
+			/* one of the async decryptions failed */
+			tls_err_abort(sk, EBADMSG);
+			copied = 0;
+			err = ret;
+		}
+	}
+
 	release_sock(sk);
 	return copied ? : err;
 }
@@ -975,14 +1186,8 @@ ssize_t tls_sw_splice_read(struct socket *sock,  loff_t *ppos,
 	if (!skb)
 		goto splice_read_end;
 
-	/* splice does not support reading control messages */
-	if (ctx->control != TLS_RECORD_TYPE_DATA) {
-		err = -ENOTSUPP;
-		goto splice_read_end;
-	}
-
 	if (!ctx->decrypted) {
-		err = decrypt_skb_update(sk, skb, NULL, &chunk, &zc);
+		err = decrypt_skb_update(sk, skb, NULL, &chunk, &zc, false);
 
 		if (err < 0) {
 			tls_err_abort(sk, EBADMSG);
@@ -990,6 +1195,12 @@ ssize_t tls_sw_splice_read(struct socket *sock,  loff_t *ppos,
 		}
 		ctx->decrypted = true;
 	}
+
+	/* splice does not support reading control messages */
+	if (ctx->control != TLS_RECORD_TYPE_DATA) {
+		err = -ENOTSUPP;
+		goto splice_read_end;
+	}
 	rxm = strp_msg(skb);
 
 	chunk = min_t(unsigned int, rxm->full_len, len);
@@ -1032,6 +1243,7 @@ static int tls_read_size(struct strparser *strp, struct sk_buff *skb)
 	struct strp_msg *rxm = strp_msg(skb);
 	size_t cipher_overhead;
 	size_t data_len = 0;
+	u16 version;
 	int ret;
 
 	/* Verify that we have a full TLS header, or wait for more data */
@@ -1054,9 +1266,10 @@ static int tls_read_size(struct strparser *strp, struct sk_buff *skb)
 
 	data_len = ((header[4] & 0xFF) | (header[3] << 8));
 
-	cipher_overhead = tls_ctx->rx.tag_size + tls_ctx->rx.iv_size;
+	cipher_overhead = tls_ctx->rx.tag_size + tls_nonce_size(&tls_ctx->rx);
 
-	if (data_len > TLS_MAX_PAYLOAD_SIZE + cipher_overhead) {
+	if (data_len > TLS_MAX_PAYLOAD_SIZE + cipher_overhead +
+		       tls_ctx->rx.tail_size) {
 		ret = -EMSGSIZE;
 		goto read_failure;
 	}
@@ -1065,8 +1278,13 @@ static int tls_read_size(struct strparser *strp, struct sk_buff *skb)
 		goto read_failure;
 	}
 
-	if (header[1] != TLS_VERSION_MINOR(tls_ctx->crypto_recv.info.version) ||
-	    header[2] != TLS_VERSION_MAJOR(tls_ctx->crypto_recv.info.version)) {
+	/* TLS 1.3 records carry the legacy TLS 1.2 version */
+	version = tls_ctx->crypto_recv.info.version;
+	if (version == TLS_1_3_VERSION)
+		version = TLS_1_2_VERSION;
+
+	if (header[1] != TLS_VERSION_MINOR(version) ||
+	    header[2] != TLS_VERSION_MAJOR(version)) {
 		ret = -EINVAL;
 		goto read_failure;
 	}
@@ -1149,15 +1367,15 @@ void tls_sw_free_resources_rx(struct sock *sk)
 
 int tls_set_sw_offload(struct sock *sk, struct tls_context *ctx, int tx)
 {
-	struct tls_crypto_info *crypto_info;
-	struct tls12_crypto_info_aes_gcm_128 *gcm_128_info;
+	u16 nonce_size, tag_size, iv_size, rec_seq_size, key_size, salt_size;
 	struct tls_sw_context_tx *sw_ctx_tx = NULL;
 	struct tls_sw_context_rx *sw_ctx_rx = NULL;
+	struct tls_crypto_info *crypto_info;
+	char *iv, *rec_seq, *key, *salt;
 	struct cipher_context *cctx;
 	struct crypto_aead **aead;
 	struct strp_callbacks cb;
-	u16 nonce_size, tag_size, iv_size, rec_seq_size;
-	char *iv, *rec_seq;
+	const char *cipher_name;
 	int rc = 0;
 
 	if (!ctx) {
@@ -1198,6 +1416,7 @@ int tls_set_sw_offload(struct sock *sk, struct tls_context *ctx, int tx)
 		aead = &sw_ctx_tx->aead_send;
 	} else {
 		crypto_init_wait(&sw_ctx_rx->async_wait);
+		atomic_set(&sw_ctx_rx->decrypt_pending, 1);
 		crypto_info = &ctx->crypto_recv.info;
 		cctx = &ctx->rx;
 		aead = &sw_ctx_rx->aead_recv;
@@ -1205,15 +1424,58 @@ int tls_set_sw_offload(struct sock *sk, struct tls_context *ctx, int tx)
 
 	switch (crypto_info->cipher_type) {
 	case TLS_CIPHER_AES_GCM_128: {
+		struct tls12_crypto_info_aes_gcm_128 *gcm_128_info;
+
+		gcm_128_info =
+			(struct tls12_crypto_info_aes_gcm_128 *)crypto_info;
 		nonce_size = TLS_CIPHER_AES_GCM_128_IV_SIZE;
 		tag_size = TLS_CIPHER_AES_GCM_128_TAG_SIZE;
 		iv_size = TLS_CIPHER_AES_GCM_128_IV_SIZE;
-		iv = ((struct tls12_crypto_info_aes_gcm_128 *)crypto_info)->iv;
+		iv = gcm_128_info->iv;
 		rec_seq_size = TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE;
-		rec_seq =
-		 ((struct tls12_crypto_info_aes_gcm_128 *)crypto_info)->rec_seq;
-		gcm_128_info =
-			(struct tls12_crypto_info_aes_gcm_128 *)crypto_info;
+		rec_seq = gcm_128_info->rec_seq;
+		key_size = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+		key = gcm_128_info->key;
+		salt_size = TLS_CIPHER_AES_GCM_128_SALT_SIZE;
+		salt = gcm_128_info->salt;
+		cipher_name = "gcm(aes)";
+		break;
+	}
+	case TLS_CIPHER_AES_GCM_256: {
+		struct tls12_crypto_info_aes_gcm_256 *gcm_256_info;
+
+		gcm_256_info =
+			(struct tls12_crypto_info_aes_gcm_256 *)crypto_info;
+		nonce_size = TLS_CIPHER_AES_GCM_256_IV_SIZE;
+		tag_size = TLS_CIPHER_AES_GCM_256_TAG_SIZE;
+		iv_size = TLS_CIPHER_AES_GCM_256_IV_SIZE;
+		iv = gcm_256_info->iv;
+		rec_seq_size = TLS_CIPHER_AES_GCM_256_REC_SEQ_SIZE;
+		rec_seq = gcm_256_info->rec_seq;
+		key_size = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+		key = gcm_256_info->key;
+		salt_size = TLS_CIPHER_AES_GCM_256_SALT_SIZE;
+		salt = gcm_256_info->salt;
+		cipher_name = "gcm(aes)";
+		break;
+	}
+	case TLS_CIPHER_CHACHA20_POLY1305: {
+		struct tls12_crypto_info_chacha20_poly1305 *chacha_info;
+
+		chacha_info =
+			(struct tls12_crypto_info_chacha20_poly1305 *)crypto_info;
+		/* RFC 7905: the nonce is always implicit */
+		nonce_size = 0;
+		tag_size = TLS_CIPHER_CHACHA20_POLY1305_TAG_SIZE;
+		iv_size = TLS_CIPHER_CHACHA20_POLY1305_IV_SIZE;
+		iv = chacha_info->iv;
+		rec_seq_size = TLS_CIPHER_CHACHA20_POLY1305_REC_SEQ_SIZE;
+		rec_seq = chacha_info->rec_seq;
+		key_size = TLS_CIPHER_CHACHA20_POLY1305_KEY_SIZE;
+		key = chacha_info->key;
+		salt_size = TLS_CIPHER_CHACHA20_POLY1305_SALT_SIZE;
+		salt = chacha_info->salt;
+		cipher_name = "rfc7539(chacha20,poly1305)";
 		break;
 	}
 	default:
@@ -1222,23 +1484,36 @@ int tls_set_sw_offload(struct sock *sk, struct tls_context *ctx, int tx)
 	}
 
 	/* Sanity-check the IV size for stack allocations. */
-	if (iv_size > MAX_IV_SIZE || nonce_size > MAX_IV_SIZE) {
+	if (iv_size + salt_size > MAX_IV_SIZE || nonce_size > MAX_IV_SIZE) {
 		rc = -EINVAL;
 		goto free_priv;
 	}
 
+	if (crypto_info->version == TLS_1_3_VERSION) {
+		/* RFC 8446: implicit nonce, header as AAD and the record
+		 * type encrypted after the payload
+		 */
+		nonce_size = 0;
+		cctx->aad_size = TLS_1_3_AAD_SPACE_SIZE;
+		cctx->tail_size = TLS_1_3_TAIL_SIZE;
+	} else {
+		cctx->aad_size = TLS_AAD_SPACE_SIZE;
+		cctx->tail_size = 0;
+	}
+
 	cctx->prepend_size = TLS_HEADER_SIZE + nonce_size;
 	cctx->tag_size = tag_size;
-	cctx->overhead_size = cctx->prepend_size + cctx->tag_size;
+	cctx->overhead_size = cctx->prepend_size + cctx->tag_size +
+			      cctx->tail_size;
 	cctx->iv_size = iv_size;
-	cctx->iv = kmalloc(iv_size + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
-			   GFP_KERNEL);
+	cctx->salt_size = salt_size;
+	cctx->iv = kmalloc(iv_size + salt_size, GFP_KERNEL);
 	if (!cctx->iv) {
 		rc = -ENOMEM;
 		goto free_priv;
 	}
-	memcpy(cctx->iv, gcm_128_info->salt, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
-	memcpy(cctx->iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE, iv, iv_size);
+	memcpy(cctx->iv, salt, salt_size);
+	memcpy(cctx->iv + salt_size, iv, iv_size);
 	cctx->rec_seq_size = rec_seq_size;
 	cctx->rec_seq = kmemdup(rec_seq, rec_seq_size, GFP_KERNEL);
 	if (!cctx->rec_seq) {
@@ -1254,20 +1529,20 @@ int tls_set_sw_offload(struct sock *sk, struct tls_context *ctx, int tx)
 
 		sg_init_table(sw_ctx_tx->sg_aead_in, 2);
 		sg_set_buf(&sw_ctx_tx->sg_aead_in[0], sw_ctx_tx->aad_space,
-			   sizeof(sw_ctx_tx->aad_space));
+			   cctx->aad_size);
 		sg_unmark_end(&sw_ctx_tx->sg_aead_in[1]);
 		sg_chain(sw_ctx_tx->sg_aead_in, 2,
 			 sw_ctx_tx->sg_plaintext_data);
 		sg_init_table(sw_ctx_tx->sg_aead_out, 2);
 		sg_set_buf(&sw_ctx_tx->sg_aead_out[0], sw_ctx_tx->aad_space,
-			   sizeof(sw_ctx_tx->aad_space));
+			   cctx->aad_size);
 		sg_unmark_end(&sw_ctx_tx->sg_aead_out[1]);
 		sg_chain(sw_ctx_tx->sg_aead_out, 2,
 			 sw_ctx_tx->sg_encrypted_data);
 	}
 
 	if (!*aead) {
-		*aead = crypto_alloc_aead("gcm(aes)", 0, 0);
+		*aead = crypto_alloc_aead(cipher_name, 0, 0);
 		if (IS_ERR(*aead)) {
 			rc = PTR_ERR(*aead);
 			*aead = NULL;
@@ -1277,8 +1552,7 @@ int tls_set_sw_offload(struct sock *sk, struct tls_context *ctx, int tx)
 
 	ctx->push_pending_record = tls_sw_push_pending_record;
 
-	rc = crypto_aead_setkey(*aead, gcm_128_info->key,
-				TLS_CIPHER_AES_GCM_128_KEY_SIZE);
+	rc = crypto_aead_setkey(*aead, key, key_size);
 	if (rc)
 		goto free_aead;
 
@@ -1287,6 +1561,14 @@ int tls_set_sw_offload(struct sock *sk, struct tls_context *ctx, int tx)
 		goto free_aead;
 
 	if (sw_ctx_rx) {
+		struct crypto_tfm *tfm = crypto_aead_tfm(sw_ctx_rx->aead_recv);
+
+		/* Records can only be decrypted in parallel by a cipher
+		 * implementation that completes asynchronously.
+		 */
+		sw_ctx_rx->async_capable =
+			tfm->__crt_alg->cra_flags & CRYPTO_ALG_ASYNC;
+
 		/* Set up strparser */
 		memset(&cb, 0, sizeof(cb));
 		cb.rcv_msg = tls_queue;
@@ -493,6 +493,7 @@ static void unix_sock_destructor(struct sock *sk)
 	struct unix_sock *u = unix_sk(sk);
 
 	skb_queue_purge(&sk->sk_receive_queue);
+	skb_queue_purge(&u->recycle);
 
 	WARN_ON(refcount_read(&sk->sk_wmem_alloc));
 	WARN_ON(!sk_unhashed(sk));
@@ -629,6 +630,8 @@ static int unix_listen(struct socket *sock, int backlog)
 	sk->sk_state		= TCP_LISTEN;
 	/* set credentials so connect can copy them */
 	init_peercred(sk);
+	/* embryos may be passed sockets before they are accepted */
+	unix_gc_track(sk);
 	err = 0;
 
 out_unlock:
@@ -781,6 +784,7 @@ static struct sock *unix_create1(struct net *net, struct socket *sock, int kern)
 	mutex_init(&u->bindlock); /* single task binding lock */
 	init_waitqueue_head(&u->peer_wait);
 	init_waitqueue_func_entry(&u->peer_wake, unix_dgram_peer_wake_relay);
+	skb_queue_head_init(&u->recycle);
 	unix_insert_socket(unix_sockets_unbound(sk), sk);
 out:
 	if (sk == NULL)
@@ -1626,6 +1630,74 @@ static bool unix_skb_scm_eq(struct sk_buff *skb,
 	       unix_secdata_eq(scm, skb);
 }
 
+/* A receiving socket keeps up to this many consumed skbs for its peers to
+ * send the next messages in, each with a head of at most this size.
+ */
+#define UNIX_RECYCLE_QLEN	8
+#define UNIX_RECYCLE_SIZE	SKB_WITH_OVERHEAD(PAGE_SIZE << 1)
+
+/* Called by the reader of sk instead of consume_skb() once skb is off the
+ * receive queue. An skb nobody else holds and whose head was kmalloc'ed
+ * by sock_alloc_send_pskb() is stripped of its owner, creds and page
+ * fragments and put in the recycle cache of sk, still the size it was
+ * allocated with.
+ */
+static void unix_skb_recycle(struct sock *sk, struct sk_buff *skb)
+{
+	struct skb_shared_info *shinfo = skb_shinfo(skb);
+	int i;
+
+	if (skb_queue_len(&unix_sk(sk)->recycle) >= UNIX_RECYCLE_QLEN ||
+	    refcount_read(&skb->users) != 1 || skb_cloned(skb) ||
+	    skb->head_frag || skb->pfmemalloc ||
+	    skb->fclone != SKB_FCLONE_UNAVAILABLE ||
+	    skb_has_frag_list(skb) || skb_zcopy(skb) || UNIXCB(skb).fp ||
+	    skb_end_offset(skb) > UNIX_RECYCLE_SIZE) {
+		consume_skb(skb);
+		return;
+	}
+
+	/* unix_destruct_scm() drops the pid and uncharges the sender */
+	skb_orphan(skb);
+	for (i = 0; i < shinfo->nr_frags; i++)
+		__skb_frag_unref(&shinfo->frags[i]);
+
+	memset(skb, 0, offsetof(struct sk_buff, tail));
+	memset(shinfo, 0, offsetof(struct skb_shared_info, dataref));
+	skb->data = skb->head;
+	skb_reset_tail_pointer(skb);
+	skb->truesize = SKB_TRUESIZE(skb_end_offset(skb));
+
+	skb_queue_head(&unix_sk(sk)->recycle, skb);
+}
+
+/* Take an skb with room for len bytes of linear data from the recycle
+ * cache of other and charge it to sk, as sock_alloc_send_pskb() would
+ * have. Returns NULL if there is none or sk has to wait for send buffer
+ * space, which is then left to sock_alloc_send_pskb().
+ */
+static struct sk_buff *unix_skb_get_recycled(struct sock *sk,
+					     struct sock *other, size_t len)
+{
+	struct sk_buff *skb;
+
+	if (sk->sk_err || (sk->sk_shutdown & SEND_SHUTDOWN) ||
+	    refcount_read(&sk->sk_wmem_alloc) >= sk->sk_sndbuf)
+		return NULL;
+
+	skb = skb_dequeue(&unix_sk(other)->recycle);
+	if (!skb)
+		return NULL;
+
+	if (skb_tailroom(skb) < len) {
+		skb_queue_head(&unix_sk(other)->recycle, skb);
+		return NULL;
+	}
+
+	skb_set_owner_w(skb, sk);
+	return skb;
+}
+
 /*
  *	Send AF_UNIX data.
  */
@@ -1647,11 +1719,12 @@ static int unix_dgram_sendmsg(struct socket *sock, struct msghdr *msg,
 	int data_len = 0;
 	int sk_locked;
 
-	wait_for_unix_gc();
 	err = scm_send(sock, msg, &scm, false);
 	if (err < 0)
 		return err;
 
+	wait_for_unix_gc(scm.fp);
+
 	err = -EOPNOTSUPP;
 	if (msg->msg_flags&MSG_OOB)
 		goto out;
@@ -1686,9 +1759,16 @@ static int unix_dgram_sendmsg(struct socket *sock, struct msghdr *msg,
 		BUILD_BUG_ON(SKB_MAX_ALLOC < PAGE_SIZE);
 	}
 
-	skb = sock_alloc_send_pskb(sk, len - data_len, data_len,
-				   msg->msg_flags & MSG_DONTWAIT, &err,
-				   PAGE_ALLOC_COSTLY_ORDER);
+	/* A connected sender gets its message into an skb the peer has
+	 * already read from, if it kept one. It is still one skb per message.
+	 */
+	skb = NULL;
+	if (other && !data_len)
+		skb = unix_skb_get_recycled(sk, other, len);
+	if (!skb)
+		skb = sock_alloc_send_pskb(sk, len - data_len, data_len,
+					   msg->msg_flags & MSG_DONTWAIT, &err,
+					   PAGE_ALLOC_COSTLY_ORDER);
 	if (skb == NULL)
 		goto out;
 
@@ -1811,6 +1891,8 @@ restart_locked:
 	if (sock_flag(other, SOCK_RCVTSTAMP))
 		__net_timestamp(skb);
 	maybe_add_creds(skb, sock, other);
+	if (UNIXCB(skb).fp)
+		unix_gc_track_receiver(other, UNIXCB(skb).fp);
 	skb_queue_tail(&other->sk_receive_queue, skb);
 	unix_state_unlock(other);
 	other->sk_data_ready(other);
@@ -1836,6 +1918,118 @@ out:
  */
 #define UNIX_SKB_FRAGS_SZ (PAGE_SIZE << get_order(32768))
 
+/* Writes up to this size without fds take the small message path */
+#define UNIX_STREAM_SMALL_MAX	4096
+
+/* Copy a small write into a page fragment and append it to the tail skb
+ * of the receive queue when that still belongs to us, the same way
+ * unix_stream_sendpage() extends it. A burst of small writes the reader
+ * has not caught up with then costs neither an skb nor a kmalloc'ed data
+ * area each. Only when the tail can't be extended does the fragment get
+ * an skb of its own, taken from the peer's recycle cache if it has one.
+ *
+ * Returns 0 without touching msg if the regular path should be used.
+ */
+static int unix_stream_sendmsg_small(struct socket *sock, struct sock *other,
+				     struct msghdr *msg, size_t len,
+				     struct scm_cookie *scm)
+{
+	struct sock *sk = sock->sk;
+	struct page_frag *pfrag = sk_page_frag(sk);
+	struct sk_buff *skb;
+	struct page *page;
+	int offset, err;
+
+	if (!skb_page_frag_refill(len, pfrag, sk->sk_allocation))
+		return 0;
+
+	page = pfrag->page;
+	offset = pfrag->offset;
+	if (copy_page_from_iter(page, offset, len, &msg->msg_iter) != len)
+		return -EFAULT;
+
+	/* The fragment is ours now, whichever skb it ends up in */
+	get_page(page);
+	pfrag->offset += len;
+
+	/* Don't wait for a reader, it is busy draining the queue anyway */
+	if (!mutex_trylock(&unix_sk(other)->iolock))
+		goto alloc_skb;
+
+	unix_state_lock(other);
+
+	if (sock_flag(other, SOCK_DEAD) ||
+	    (other->sk_shutdown & RCV_SHUTDOWN)) {
+		unix_state_unlock(other);
+		mutex_unlock(&unix_sk(other)->iolock);
+		put_page(page);
+		return -EPIPE;
+	}
+
+	skb = skb_peek_tail(&other->sk_receive_queue);
+	if (!skb || skb->sk != sk || UNIXCB(skb).fp ||
+	    !unix_skb_scm_eq(skb, scm) ||
+	    skb->len + len > UNIX_SKB_FRAGS_SZ ||
+	    refcount_read(&sk->sk_wmem_alloc) + len > sk->sk_sndbuf ||
+	    skb_append_pagefrags(skb, page, offset, len)) {
+		unix_state_unlock(other);
+		mutex_unlock(&unix_sk(other)->iolock);
+		goto alloc_skb;
+	}
+
+	/* skb_append_pagefrags() took its own reference if it needed one */
+	put_page(page);
+
+	skb->len += len;
+	skb->data_len += len;
+	skb->truesize += len;
+	refcount_add(len, &sk->sk_wmem_alloc);
+
+	unix_state_unlock(other);
+	mutex_unlock(&unix_sk(other)->iolock);
+	other->sk_data_ready(other);
+	return len;
+
+alloc_skb:
+	skb = unix_skb_get_recycled(sk, other, 0);
+	if (!skb)
+		skb = sock_alloc_send_pskb(sk, 0, 0,
+					   msg->msg_flags & MSG_DONTWAIT,
+					   &err, 0);
+	if (!skb) {
+		put_page(page);
+		return err;
+	}
+
+	err = unix_scm_to_skb(scm, skb, false);
+	if (err < 0) {
+		put_page(page);
+		kfree_skb(skb);
+		return err;
+	}
+
+	skb_fill_page_desc(skb, 0, page, offset, len);
+	skb->len = len;
+	skb->data_len = len;
+	skb->truesize += len;
+	refcount_add(len, &sk->sk_wmem_alloc);
+
+	unix_state_lock(other);
+
+	if (sock_flag(other, SOCK_DEAD) ||
+	    (other->sk_shutdown & RCV_SHUTDOWN)) {
+		unix_state_unlock(other);
+		kfree_skb(skb);
+		return -EPIPE;
+	}
+
+	maybe_add_creds(skb, sock, other);
+	skb_queue_tail(&other->sk_receive_queue, skb);
+	unix_state_unlock(other);
+	other->sk_data_ready(other);
+	return len;
+}
+
 static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 			       size_t len)
 {
@@ -1848,11 +2042,12 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 	bool fds_sent = false;
 	int data_len;
 
-	wait_for_unix_gc();
 	err = scm_send(sock, msg, &scm, false);
 	if (err < 0)
 		return err;
 
+	wait_for_unix_gc(scm.fp);
+
 	err = -EOPNOTSUPP;
 	if (msg->msg_flags&MSG_OOB)
 		goto out_err;
@@ -1870,6 +2065,15 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 	if (sk->sk_shutdown & SEND_SHUTDOWN)
 		goto pipe_err;
 
+	if (len && len <= UNIX_STREAM_SMALL_MAX && !scm.fp) {
+		err = unix_stream_sendmsg_small(sock, other, msg, len, &scm);
+		if (err == -EPIPE)
+			goto pipe_err;
+		if (err < 0)
+			goto out_err;
+		sent = err;
+	}
+
 	while (sent < len) {
 		size = len - sent;
 
@@ -1913,6 +2117,8 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 			goto pipe_err_free;
 
 		maybe_add_creds(skb, sock, other);
+		if (UNIXCB(skb).fp)
+			unix_gc_track_receiver(other, UNIXCB(skb).fp);
 		skb_queue_tail(&other->sk_receive_queue, skb);
 		unix_state_unlock(other);
 		other->sk_data_ready(other);
@@ -2188,7 +2394,10 @@ static int unix_dgram_recvmsg(struct socket *sock, struct msghdr *msg,
 	scm_recv(sock, msg, &scm, flags);
 
 out_free:
-	skb_free_datagram(sk, skb);
+	if (flags & MSG_PEEK)
+		skb_free_datagram(sk, skb);
+	else
+		unix_skb_recycle(sk, skb);
 	mutex_unlock(&u->iolock);
 out:
 	return err;
@@ -2414,7 +2623,7 @@ unlock:
 				break;
 
 			skb_unlink(skb, &sk->sk_receive_queue);
-			consume_skb(skb);
+			unix_skb_recycle(sk, skb);
 
 			if (scm.fp)
 				break;
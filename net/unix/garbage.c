@@ -79,7 +79,7 @@
 #include <linux/file.h>
 #include <linux/proc_fs.h>
 #include <linux/mutex.h>
-#include <linux/wait.h>
+#include <linux/workqueue.h>
 
 #include <net/sock.h>
 #include <net/af_unix.h>
@@ -88,10 +88,12 @@
 
 /* Internal data structures and random procedures: */
 
+/* Only in-flight sockets which may hold references to other sockets are
+ * kept on gc_inflight_list, see unix_gc_track().
+ */
 static LIST_HEAD(gc_inflight_list);
 static LIST_HEAD(gc_candidates);
 static DEFINE_SPINLOCK(unix_gc_lock);
-static DECLARE_WAIT_QUEUE_HEAD(unix_gc_wait);
 
 unsigned int unix_tot_inflight;
 
@@ -125,11 +127,10 @@ void unix_inflight(struct user_struct *user, struct file *fp)
 	if (s) {
 		struct unix_sock *u = unix_sk(s);
 
-		if (atomic_long_inc_return(&u->inflight) == 1) {
+		if (atomic_long_inc_return(&u->inflight) == 1 &&
+		    test_bit(UNIX_GC_TRACKED, &u->gc_flags)) {
 			BUG_ON(!list_empty(&u->link));
 			list_add_tail(&u->link, &gc_inflight_list);
-		} else {
-			BUG_ON(list_empty(&u->link));
 		}
 		unix_tot_inflight++;
 	}
@@ -147,7 +148,6 @@ void unix_notinflight(struct user_struct *user, struct file *fp)
 		struct unix_sock *u = unix_sk(s);
 
 		BUG_ON(!atomic_long_read(&u->inflight));
-		BUG_ON(list_empty(&u->link));
 
 		if (atomic_long_dec_and_test(&u->inflight))
 			list_del_init(&u->link);
@@ -157,6 +157,43 @@ void unix_notinflight(struct user_struct *user, struct file *fp)
 	spin_unlock(&unix_gc_lock);
 }
 
+/* A socket can only be part of a cycle if it holds references to other
+ * AF_UNIX sockets: either it had some queued to it with SCM_RIGHTS, or
+ * it is listening and its embryos may have. Such sockets are marked
+ * once and only those are ever considered by the collector, so the
+ * many sockets which are passed around but never receive sockets
+ * themselves cost it nothing.
+ */
+void unix_gc_track(struct sock *sk)
+{
+	struct unix_sock *u = unix_sk(sk);
+
+	if (test_bit(UNIX_GC_TRACKED, &u->gc_flags))
+		return;
+
+	spin_lock(&unix_gc_lock);
+	__set_bit(UNIX_GC_TRACKED, &u->gc_flags);
+	if (atomic_long_read(&u->inflight) && list_empty(&u->link))
+		list_add_tail(&u->link, &gc_inflight_list);
+	spin_unlock(&unix_gc_lock);
+}
+
+/* Called before an skb carrying fpl is queued to sk */
+void unix_gc_track_receiver(struct sock *sk, struct scm_fp_list *fpl)
+{
+	int i;
+
+	if (test_bit(UNIX_GC_TRACKED, &unix_sk(sk)->gc_flags))
+		return;
+
+	for (i = 0; i < fpl->count; i++) {
+		if (unix_get_socket(fpl->fp[i])) {
+			unix_gc_track(sk);
+			return;
+		}
+	}
+}
+
 static void scan_inflight(struct sock *x, void (*func)(struct unix_sock *),
 			  struct sk_buff_head *hitlist)
 {
@@ -255,20 +292,11 @@ static void inc_inflight_move_tail(struct unix_sock *u)
 }
 
 static bool gc_in_progress;
-#define UNIX_INFLIGHT_TRIGGER_GC 16000
-
-void wait_for_unix_gc(void)
-{
-	/* If number of inflight sockets is insane,
-	 * force a garbage collect right now.
-	 */
-	if (unix_tot_inflight > UNIX_INFLIGHT_TRIGGER_GC && !gc_in_progress)
-		unix_gc();
-	wait_event(unix_gc_wait, gc_in_progress == false);
-}
 
-/* The external entry point: unix_gc() */
-void unix_gc(void)
+/* The collector runs from a work item, so neither the sender which
+ * triggered it nor the task closing a socket pays for the scan.
+ */
+static void __unix_gc(struct work_struct *work)
 {
 	struct unix_sock *u;
 	struct unix_sock *next;
@@ -278,11 +306,6 @@ void unix_gc(void)
 
 	spin_lock(&unix_gc_lock);
 
-	/* Avoid a recursive GC. */
-	if (gc_in_progress)
-		goto out;
-
-	gc_in_progress = true;
 	/* First, select candidates for garbage collection.  Only
 	 * in-flight sockets are considered, and from those only ones
 	 * which don't have any external reference.
@@ -368,9 +391,41 @@ void unix_gc(void)
 
 	/* All candidates should have been detached by now. */
 	BUG_ON(!list_empty(&gc_candidates));
-	gc_in_progress = false;
-	wake_up(&unix_gc_wait);
 
- out:
+	/* Paired with READ_ONCE() in wait_for_unix_gc(). */
+	WRITE_ONCE(gc_in_progress, false);
+
 	spin_unlock(&unix_gc_lock);
 }
+
+static DECLARE_WORK(unix_gc_work, __unix_gc);
+
+/* The external entry point: unix_gc() */
+void unix_gc(void)
+{
+	WRITE_ONCE(gc_in_progress, true);
+	queue_work(system_unbound_wq, &unix_gc_work);
+}
+
+#define UNIX_INFLIGHT_TRIGGER_GC 16000
+#define UNIX_INFLIGHT_SANE_USER (SCM_MAX_FD * 8)
+
+void wait_for_unix_gc(struct scm_fp_list *fpl)
+{
+	/* If number of inflight sockets is insane,
+	 * kick the garbage collector.
+	 */
+	if (READ_ONCE(unix_tot_inflight) > UNIX_INFLIGHT_TRIGGER_GC &&
+	    !READ_ONCE(gc_in_progress))
+		unix_gc();
+
+	/* Only a user with an unreasonable number of fds in flight is
+	 * made to wait for the collector; everybody else, including
+	 * senders without SCM_RIGHTS, carries on.
+	 */
+	if (!fpl || READ_ONCE(fpl->user->unix_inflight) < UNIX_INFLIGHT_SANE_USER)
+		return;
+
+	if (READ_ONCE(gc_in_progress))
+		flush_work(&unix_gc_work);
+}
@@ -65,6 +65,15 @@ int xdp_umem_assign_dev(struct xdp_umem *umem, struct net_device *dev,
 	if (force_zc && force_copy)
 		return -EINVAL;
 
+	if (flags & XDP_USE_NEED_WAKEUP) {
+		umem->flags |= XDP_UMEM_USES_NEED_WAKEUP;
+		/* Tx needs to be explicitly woken up the first time. Copy
+		 * mode, and drivers that do not manage the flag, leave it
+		 * set so that user space always kicks Tx with sendto().
+		 */
+		xsk_set_tx_need_wakeup(umem);
+	}
+
 	if (force_copy)
 		return 0;
 
@@ -303,6 +312,8 @@ static int xdp_umem_reg(struct xdp_umem *umem, struct xdp_umem_reg *mr)
 	umem->user = NULL;
 	INIT_LIST_HEAD(&umem->xsk_list);
 	spin_lock_init(&umem->xsk_list_lock);
+	spin_lock_init(&umem->fq_lock);
+	spin_lock_init(&umem->cq_lock);
 
 	refcount_set(&umem->users, 1);
 
@@ -30,6 +30,20 @@
 
 #define TX_BATCH_SIZE 16
 
+/* XDP_MMAP_OFFSETS layout before the ring flags were added */
+struct xdp_ring_offset_v1 {
+	__u64 producer;
+	__u64 consumer;
+	__u64 desc;
+};
+
+struct xdp_mmap_offsets_v1 {
+	struct xdp_ring_offset_v1 rx;
+	struct xdp_ring_offset_v1 tx;
+	struct xdp_ring_offset_v1 fr;
+	struct xdp_ring_offset_v1 cr;
+};
+
 static struct xdp_sock *xdp_sk(struct sock *sk)
 {
 	return (struct xdp_sock *)sk;
@@ -53,6 +67,62 @@ void xsk_umem_discard_addr(struct xdp_umem *umem)
 }
 EXPORT_SYMBOL(xsk_umem_discard_addr);
 
+void xsk_set_rx_need_wakeup(struct xdp_umem *umem)
+{
+	if (umem->need_wakeup & XDP_WAKEUP_RX)
+		return;
+
+	umem->fq->ring->flags |= XDP_RING_NEED_WAKEUP;
+	umem->need_wakeup |= XDP_WAKEUP_RX;
+}
+EXPORT_SYMBOL(xsk_set_rx_need_wakeup);
+
+void xsk_set_tx_need_wakeup(struct xdp_umem *umem)
+{
+	struct xdp_sock *xs;
+
+	if (umem->need_wakeup & XDP_WAKEUP_TX)
+		return;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(xs, &umem->xsk_list, list) {
+		if (xs->tx)
+			xs->tx->ring->flags |= XDP_RING_NEED_WAKEUP;
+	}
+	rcu_read_unlock();
+
+	umem->need_wakeup |= XDP_WAKEUP_TX;
+}
+EXPORT_SYMBOL(xsk_set_tx_need_wakeup);
+
+void xsk_clear_rx_need_wakeup(struct xdp_umem *umem)
+{
+	if (!(umem->need_wakeup & XDP_WAKEUP_RX))
+		return;
+
+	umem->fq->ring->flags &= ~XDP_RING_NEED_WAKEUP;
+	umem->need_wakeup &= ~XDP_WAKEUP_RX;
+}
+EXPORT_SYMBOL(xsk_clear_rx_need_wakeup);
+
+void xsk_clear_tx_need_wakeup(struct xdp_umem *umem)
+{
+	struct xdp_sock *xs;
+
+	if (!(umem->need_wakeup & XDP_WAKEUP_TX))
+		return;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(xs, &umem->xsk_list, list) {
+		if (xs->tx)
+			xs->tx->ring->flags &= ~XDP_RING_NEED_WAKEUP;
+	}
+	rcu_read_unlock();
+
+	umem->need_wakeup &= ~XDP_WAKEUP_TX;
+}
+EXPORT_SYMBOL(xsk_clear_tx_need_wakeup);
+
 static int __xsk_rcv(struct xdp_sock *xs, struct xdp_buff *xdp, u32 len)
 {
 	void *buffer;
@@ -112,6 +182,7 @@ void xsk_flush(struct xdp_sock *xs)
 int xsk_generic_rcv(struct xdp_sock *xs, struct xdp_buff *xdp)
 {
 	u32 len = xdp->data_end - xdp->data;
+	struct xdp_umem *umem = xs->umem;
 	void *buffer;
 	u64 addr;
 	int err;
@@ -119,24 +190,34 @@ int xsk_generic_rcv(struct xdp_sock *xs, struct xdp_buff *xdp)
 	if (xs->dev != xdp->rxq->dev || xs->queue_id != xdp->rxq->queue_index)
 		return -EINVAL;
 
-	if (!xskq_peek_addr(xs->umem->fq, &addr) ||
-	    len > xs->umem->chunk_size_nohr) {
-		xs->rx_dropped++;
-		return -ENOSPC;
+	/* Generic XDP can run on several CPUs for the same queue, e.g.
+	 * for veth, and the fill queue is shared with every socket bound
+	 * to the umem.
+	 */
+	spin_lock_bh(&umem->fq_lock);
+
+	if (!xskq_peek_addr(umem->fq, &addr) ||
+	    len > umem->chunk_size_nohr) {
+		err = -ENOSPC;
+		goto out_drop;
 	}
 
-	addr += xs->umem->headroom;
+	addr += umem->headroom;
 
-	buffer = xdp_umem_get_data(xs->umem, addr);
+	buffer = xdp_umem_get_data(umem, addr);
 	memcpy(buffer, xdp->data, len);
 	err = xskq_produce_batch_desc(xs->rx, addr, len);
-	if (!err) {
-		xskq_discard_addr(xs->umem->fq);
-		xsk_flush(xs);
-		return 0;
-	}
+	if (err)
+		goto out_drop;
+
+	xskq_discard_addr(umem->fq);
+	xsk_flush(xs);
+	spin_unlock_bh(&umem->fq_lock);
+	return 0;
 
+out_drop:
 	xs->rx_dropped++;
+	spin_unlock_bh(&umem->fq_lock);
 	return err;
 }
 
@@ -196,21 +277,67 @@ static int xsk_zc_xmit(struct sock *sk)
 static void xsk_destruct_skb(struct sk_buff *skb)
 {
 	u64 addr = (u64)(long)skb_shinfo(skb)->destructor_arg;
-	struct xdp_sock *xs = xdp_sk(skb->sk);
+	struct xdp_umem *umem = xdp_sk(skb->sk)->umem;
 	unsigned long flags;
 
-	spin_lock_irqsave(&xs->tx_completion_lock, flags);
-	WARN_ON_ONCE(xskq_produce_addr(xs->umem->cq, addr));
-	spin_unlock_irqrestore(&xs->tx_completion_lock, flags);
+	spin_lock_irqsave(&umem->cq_lock, flags);
+	xskq_produce_reserved_addr(umem->cq, addr);
+	if (!umem->cq_batches)
+		xskq_produce_flush_addr(umem->cq);
+	spin_unlock_irqrestore(&umem->cq_lock, flags);
 
 	sock_wfree(skb);
 }
 
-static int xsk_generic_xmit(struct sock *sk, struct msghdr *m,
-			    size_t total_len)
+static bool xsk_cq_reserve(struct xdp_umem *umem)
+{
+	unsigned long flags;
+	int err;
+
+	spin_lock_irqsave(&umem->cq_lock, flags);
+	err = xskq_reserve_addr(umem->cq);
+	spin_unlock_irqrestore(&umem->cq_lock, flags);
+
+	return !err;
+}
+
+static void xsk_cq_cancel(struct xdp_umem *umem)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&umem->cq_lock, flags);
+	xskq_cancel_addr(umem->cq);
+	spin_unlock_irqrestore(&umem->cq_lock, flags);
+}
+
+/* Devices such as veth complete the skb from within dev_direct_xmit(),
+ * so batch the completion queue producer update and the write space
+ * wakeup over the whole sendmsg() call instead of doing them per frame.
+ */
+static void xsk_cq_batch_start(struct xdp_umem *umem)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&umem->cq_lock, flags);
+	umem->cq_batches++;
+	spin_unlock_irqrestore(&umem->cq_lock, flags);
+}
+
+static void xsk_cq_batch_end(struct xdp_umem *umem)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&umem->cq_lock, flags);
+	if (!--umem->cq_batches)
+		xskq_produce_flush_addr(umem->cq);
+	spin_unlock_irqrestore(&umem->cq_lock, flags);
+}
+
+static int xsk_generic_xmit(struct sock *sk)
 {
 	u32 max_batch = TX_BATCH_SIZE;
 	struct xdp_sock *xs = xdp_sk(sk);
+	struct xdp_umem *umem = xs->umem;
 	bool sent_frame = false;
 	struct xdp_desc desc;
 	struct sk_buff *skb;
@@ -218,6 +345,11 @@ static int xsk_generic_xmit(struct sock *sk, struct msghdr *m,
 
 	mutex_lock(&xs->mutex);
 
+	if (xs->queue_id >= xs->dev->real_num_tx_queues)
+		goto out_unlock;
+
+	xsk_cq_batch_start(umem);
+
 	while (xskq_peek_desc(xs->tx, &desc)) {
 		char *buffer;
 		u64 addr;
@@ -228,25 +360,24 @@ static int xsk_generic_xmit(struct sock *sk, struct msghdr *m,
 			goto out;
 		}
 
-		if (xskq_reserve_addr(xs->umem->cq))
-			goto out;
-
-		if (xs->queue_id >= xs->dev->real_num_tx_queues)
+		if (!xsk_cq_reserve(umem))
 			goto out;
 
 		len = desc.len;
 		skb = sock_alloc_send_skb(sk, len, 1, &err);
 		if (unlikely(!skb)) {
+			xsk_cq_cancel(umem);
 			err = -EAGAIN;
 			goto out;
 		}
 
 		skb_put(skb, len);
 		addr = desc.addr;
-		buffer = xdp_umem_get_data(xs->umem, addr);
+		buffer = xdp_umem_get_data(umem, addr);
 		err = skb_store_bits(skb, 0, buffer, len);
 		if (unlikely(err)) {
 			kfree_skb(skb);
+			xsk_cq_cancel(umem);
 			goto out;
 		}
 
@@ -269,13 +400,27 @@ static int xsk_generic_xmit(struct sock *sk, struct msghdr *m,
 	}
 
 out:
+	xsk_cq_batch_end(umem);
 	if (sent_frame)
 		sk->sk_write_space(sk);
 
+out_unlock:
 	mutex_unlock(&xs->mutex);
 	return err;
 }
 
+static int __xsk_sendmsg(struct sock *sk)
+{
+	struct xdp_sock *xs = xdp_sk(sk);
+
+	if (unlikely(!(xs->dev->flags & IFF_UP)))
+		return -ENETDOWN;
+	if (unlikely(!xs->tx))
+		return -ENOBUFS;
+
+	return (xs->zc) ? xsk_zc_xmit(sk) : xsk_generic_xmit(sk);
+}
+
 static int xsk_sendmsg(struct socket *sock, struct msghdr *m, size_t total_len)
 {
 	bool need_wait = !(m->msg_flags & MSG_DONTWAIT);
@@ -284,14 +429,10 @@ static int xsk_sendmsg(struct socket *sock, struct msghdr *m, size_t total_len)
 
 	if (unlikely(!xs->dev))
 		return -ENXIO;
-	if (unlikely(!(xs->dev->flags & IFF_UP)))
-		return -ENETDOWN;
-	if (unlikely(!xs->tx))
-		return -ENOBUFS;
 	if (need_wait)
 		return -EOPNOTSUPP;
 
-	return (xs->zc) ? xsk_zc_xmit(sk) : xsk_generic_xmit(sk, m, total_len);
+	return __xsk_sendmsg(sk);
 }
 
 static unsigned int xsk_poll(struct file *file, struct socket *sock,
@@ -301,6 +442,16 @@ static unsigned int xsk_poll(struct file *file, struct socket *sock,
 	struct sock *sk = sock->sk;
 	struct xdp_sock *xs = xdp_sk(sk);
 
+	/* With need_wakeup, poll() is the wakeup call for Rx and Tx, so it
+	 * has to drive Tx in copy mode too.
+	 */
+	if (xs->dev && xs->umem->need_wakeup) {
+		if (xs->zc)
+			xsk_zc_xmit(sk);
+		else if (xs->tx && (xs->dev->flags & IFF_UP))
+			xsk_generic_xmit(sk);
+	}
+
 	if (xs->rx && !xskq_empty_desc(xs->rx))
 		mask |= POLLIN | POLLRDNORM;
 	if (xs->tx && !xskq_full_desc(xs->tx))
@@ -421,12 +572,18 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 	}
 
 	flags = sxdp->sxdp_flags;
+	if (flags & ~(XDP_SHARED_UMEM | XDP_COPY | XDP_ZEROCOPY |
+		      XDP_USE_NEED_WAKEUP)) {
+		err = -EINVAL;
+		goto out_unlock;
+	}
 
 	if (flags & XDP_SHARED_UMEM) {
 		struct xdp_sock *umem_xs;
 		struct socket *sock;
 
-		if ((flags & XDP_COPY) || (flags & XDP_ZEROCOPY)) {
+		if ((flags & XDP_COPY) || (flags & XDP_ZEROCOPY) ||
+		    (flags & XDP_USE_NEED_WAKEUP)) {
 			/* Cannot specify flags for shared sockets. */
 			err = -EINVAL;
 			goto out_unlock;
@@ -477,6 +634,9 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 	xs->queue_id = qid;
 	xskq_set_umem(xs->rx, &xs->umem->props);
 	xskq_set_umem(xs->tx, &xs->umem->props);
+	/* A socket joining a shared umem inherits its Tx wakeup state */
+	if (xs->tx && (xs->umem->need_wakeup & XDP_WAKEUP_TX))
+		xs->tx->ring->flags |= XDP_RING_NEED_WAKEUP;
 	xdp_add_sk_umem(xs->umem, xs);
 
 out_unlock:
@@ -569,6 +729,14 @@ static int xsk_setsockopt(struct socket *sock, int level, int optname,
 	return -ENOPROTOOPT;
 }
 
+static void xsk_offset_to_v1(struct xdp_ring_offset_v1 *off_v1,
+			     struct xdp_ring_offset *off)
+{
+	off_v1->producer = off->producer;
+	off_v1->consumer = off->consumer;
+	off_v1->desc = off->desc;
+}
+
 static int xsk_getsockopt(struct socket *sock, int level, int optname,
 			  char __user *optval, int __user *optlen)
 {
@@ -609,26 +777,46 @@ static int xsk_getsockopt(struct socket *sock, int level, int optname,
 	{
 		struct xdp_mmap_offsets off;
 
-		if (len < sizeof(off))
+		/* Binaries built before the flags field was added pass the
+		 * shorter struct and get the layout they know about.
+		 */
+		if (len < sizeof(struct xdp_mmap_offsets_v1))
 			return -EINVAL;
 
 		off.rx.producer = offsetof(struct xdp_rxtx_ring, ptrs.producer);
 		off.rx.consumer = offsetof(struct xdp_rxtx_ring, ptrs.consumer);
 		off.rx.desc	= offsetof(struct xdp_rxtx_ring, desc);
+		off.rx.flags	= offsetof(struct xdp_rxtx_ring, ptrs.flags);
 		off.tx.producer = offsetof(struct xdp_rxtx_ring, ptrs.producer);
 		off.tx.consumer = offsetof(struct xdp_rxtx_ring, ptrs.consumer);
 		off.tx.desc	= offsetof(struct xdp_rxtx_ring, desc);
+		off.tx.flags	= offsetof(struct xdp_rxtx_ring, ptrs.flags);
 
 		off.fr.producer = offsetof(struct xdp_umem_ring, ptrs.producer);
 		off.fr.consumer = offsetof(struct xdp_umem_ring, ptrs.consumer);
 		off.fr.desc	= offsetof(struct xdp_umem_ring, desc);
+		off.fr.flags	= offsetof(struct xdp_umem_ring, ptrs.flags);
 		off.cr.producer = offsetof(struct xdp_umem_ring, ptrs.producer);
 		off.cr.consumer = offsetof(struct xdp_umem_ring, ptrs.consumer);
 		off.cr.desc	= offsetof(struct xdp_umem_ring, desc);
-
-		len = sizeof(off);
-		if (copy_to_user(optval, &off, len))
-			return -EFAULT;
+		off.cr.flags	= offsetof(struct xdp_umem_ring, ptrs.flags);
+
+		if (len >= sizeof(off)) {
+			len = sizeof(off);
+			if (copy_to_user(optval, &off, len))
+				return -EFAULT;
+		} else {
+			struct xdp_mmap_offsets_v1 off_v1;
+
+			xsk_offset_to_v1(&off_v1.rx, &off.rx);
+			xsk_offset_to_v1(&off_v1.tx, &off.tx);
+			xsk_offset_to_v1(&off_v1.fr, &off.fr);
+			xsk_offset_to_v1(&off_v1.cr, &off.cr);
+
+			len = sizeof(off_v1);
+			if (copy_to_user(optval, &off_v1, len))
+				return -EFAULT;
+		}
 		if (put_user(len, optlen))
 			return -EFAULT;
 
@@ -751,7 +939,6 @@ static int xsk_create(struct net *net, struct socket *sock, int protocol,
 
 	xs = xdp_sk(sk);
 	mutex_init(&xs->mutex);
-	spin_lock_init(&xs->tx_completion_lock);
 
 	local_bh_disable();
 	sock_prot_inuse_add(net, &xsk_proto, 1);
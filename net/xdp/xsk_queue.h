@@ -16,6 +16,7 @@
 struct xdp_ring {
 	u32 producer ____cacheline_aligned_in_smp;
 	u32 consumer ____cacheline_aligned_in_smp;
+	u32 flags;
 };
 
 /* Used for the RX and TX queues for packets */
@@ -120,22 +121,6 @@ static inline void xskq_discard_addr(struct xsk_queue *q)
 	q->cons_tail++;
 }
 
-static inline int xskq_produce_addr(struct xsk_queue *q, u64 addr)
-{
-	struct xdp_umem_ring *ring = (struct xdp_umem_ring *)q->ring;
-
-	if (xskq_nb_free(q, q->prod_tail, 1) == 0)
-		return -ENOSPC;
-
-	ring->desc[q->prod_tail++ & q->ring_mask] = addr;
-
-	/* Order producer and data */
-	smp_wmb();
-
-	WRITE_ONCE(q->ring->producer, q->prod_tail);
-	return 0;
-}
-
 static inline int xskq_produce_addr_lazy(struct xsk_queue *q, u64 addr)
 {
 	struct xdp_umem_ring *ring = (struct xdp_umem_ring *)q->ring;
@@ -166,6 +151,29 @@ static inline int xskq_reserve_addr(struct xsk_queue *q)
 	return 0;
 }
 
+static inline void xskq_cancel_addr(struct xsk_queue *q)
+{
+	q->prod_head--;
+}
+
+/* Fill the oldest slot taken with xskq_reserve_addr(). The entry is not
+ * visible to user space until xskq_produce_flush_addr().
+ */
+static inline void xskq_produce_reserved_addr(struct xsk_queue *q, u64 addr)
+{
+	struct xdp_umem_ring *ring = (struct xdp_umem_ring *)q->ring;
+
+	ring->desc[q->prod_tail++ & q->ring_mask] = addr;
+}
+
+static inline void xskq_produce_flush_addr(struct xsk_queue *q)
+{
+	/* Order producer and data */
+	smp_wmb();
+
+	WRITE_ONCE(q->ring->producer, q->prod_tail);
+}
+
 /* Rx/Tx queue */
 
 static inline bool xskq_is_valid_desc(struct xsk_queue *q, struct xdp_desc *d)
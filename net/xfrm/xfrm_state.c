@@ -25,6 +25,8 @@
 #include <linux/slab.h>
 #include <linux/interrupt.h>
 #include <linux/kernel.h>
+#include <linux/hash.h>
+#include <linux/percpu.h>
 
 #include "xfrm_hash.h"
 
@@ -52,6 +54,32 @@ static inline bool xfrm_state_hold_rcu(struct xfrm_state __rcu *x)
 	return refcount_inc_not_zero(&x->refcnt);
 }
 
+/* Input SA cache: a small direct mapped table per CPU, indexed by SPI,
+ * that lets the receive path skip the byspi hash walk. Entries hold no
+ * reference. Every change to the byspi table bumps input_cache_genid,
+ * and an entry is only trusted if it was filled under the current
+ * genid, which means its state is still hashed and therefore alive.
+ */
+#define XFRM_INPUT_CACHE_BITS	4
+
+struct xfrm_input_cache_entry {
+	struct xfrm_state	*x;
+	unsigned int		genid;
+	u32			mark;	/* of the lookup that filled it */
+};
+
+struct xfrm_input_cache {
+	struct xfrm_input_cache_entry entries[1 << XFRM_INPUT_CACHE_BITS];
+};
+
+/* net->xfrm.xfrm_state_lock is held */
+static void xfrm_input_cache_invalidate(struct net *net)
+{
+	/* Make the byspi update visible before the new genid */
+	smp_mb__before_atomic();
+	atomic_inc(&net->xfrm.input_cache_genid);
+}
+
 static inline unsigned int xfrm_dst_hash(struct net *net,
 					 const xfrm_address_t *daddr,
 					 const xfrm_address_t *saddr,
@@ -627,8 +655,10 @@ int __xfrm_state_delete(struct xfrm_state *x)
 		list_del(&x->km.all);
 		hlist_del_rcu(&x->bydst);
 		hlist_del_rcu(&x->bysrc);
-		if (x->id.spi)
+		if (x->id.spi) {
 			hlist_del_rcu(&x->byspi);
+			xfrm_input_cache_invalidate(net);
+		}
 		net->xfrm.state_num--;
 		spin_unlock(&net->xfrm.xfrm_state_lock);
 
@@ -1047,6 +1077,7 @@ found:
 			if (x->id.spi) {
 				h = xfrm_spi_hash(net, &x->id.daddr, x->id.spi, x->id.proto, encap_family);
 				hlist_add_head_rcu(&x->byspi, net->xfrm.state_byspi + h);
+				xfrm_input_cache_invalidate(net);
 			}
 			x->lft.hard_add_expires_seconds = net->xfrm.sysctl_acq_expires;
 			tasklet_hrtimer_start(&x->mtimer, ktime_set(net->xfrm.sysctl_acq_expires, 0), HRTIMER_MODE_REL);
@@ -1159,6 +1190,7 @@ static void __xfrm_state_insert(struct xfrm_state *x)
 				  x->props.family);
 
 		hlist_add_head_rcu(&x->byspi, net->xfrm.state_byspi + h);
+		xfrm_input_cache_invalidate(net);
 	}
 
 	tasklet_hrtimer_start(&x->mtimer, ktime_set(1, 0), HRTIMER_MODE_REL);
@@ -1639,6 +1671,50 @@ xfrm_state_lookup(struct net *net, u32 mark, const xfrm_address_t *daddr, __be32
 }
 EXPORT_SYMBOL(xfrm_state_lookup);
 
+/* xfrm_state_lookup() for the receive path, going through the per-CPU
+ * input cache first.
+ */
+struct xfrm_state *
+xfrm_input_state_lookup(struct net *net, u32 mark, const xfrm_address_t *daddr,
+			__be32 spi, u8 proto, unsigned short family)
+{
+	struct xfrm_input_cache_entry *e;
+	struct xfrm_state *x;
+	unsigned int genid;
+
+	local_bh_disable();
+	rcu_read_lock();
+
+	genid = atomic_read(&net->xfrm.input_cache_genid);
+	/* Pairs with xfrm_input_cache_invalidate() */
+	smp_rmb();
+
+	e = &this_cpu_ptr(net->xfrm.input_cache)->entries[
+		hash_32((__force u32)spi, XFRM_INPUT_CACHE_BITS)];
+
+	x = e->x;
+	if (x && e->genid == genid &&
+	    x->id.spi == spi && x->id.proto == proto &&
+	    x->props.family == family &&
+	    xfrm_addr_equal(&x->id.daddr, daddr, family) &&
+	    e->mark == mark &&
+	    xfrm_state_hold_rcu(x))
+		goto out;
+
+	x = __xfrm_state_lookup(net, mark, daddr, spi, proto, family);
+	if (x) {
+		e->x = x;
+		e->genid = genid;
+		e->mark = mark;
+	}
+
+out:
+	rcu_read_unlock();
+	local_bh_enable();
+	return x;
+}
+EXPORT_SYMBOL(xfrm_input_state_lookup);
+
 struct xfrm_state *
 xfrm_state_lookup_byaddr(struct net *net, u32 mark,
 			 const xfrm_address_t *daddr, const xfrm_address_t *saddr,
@@ -1828,6 +1904,7 @@ int xfrm_alloc_spi(struct xfrm_state *x, u32 low, u32 high)
 		spin_lock_bh(&net->xfrm.xfrm_state_lock);
 		h = xfrm_spi_hash(net, &x->id.daddr, x->id.spi, x->id.proto, x->props.family);
 		hlist_add_head_rcu(&x->byspi, net->xfrm.state_byspi + h);
+		xfrm_input_cache_invalidate(net);
 		spin_unlock_bh(&net->xfrm.xfrm_state_lock);
 
 		err = 0;
@@ -2364,11 +2441,18 @@ int __net_init xfrm_state_init(struct net *net)
 		goto out_byspi;
 	net->xfrm.state_hmask = ((sz / sizeof(struct hlist_head)) - 1);
 
+	net->xfrm.input_cache = alloc_percpu(struct xfrm_input_cache);
+	if (!net->xfrm.input_cache)
+		goto out_input_cache;
+	atomic_set(&net->xfrm.input_cache_genid, 0);
+
 	net->xfrm.state_num = 0;
 	INIT_WORK(&net->xfrm.state_hash_work, xfrm_hash_resize);
 	spin_lock_init(&net->xfrm.xfrm_state_lock);
 	return 0;
 
+out_input_cache:
+	xfrm_hash_free(net->xfrm.state_byspi, sz);
 out_byspi:
 	xfrm_hash_free(net->xfrm.state_bysrc, sz);
 out_bysrc:
@@ -2394,6 +2478,7 @@ void xfrm_state_fini(struct net *net)
 	xfrm_hash_free(net->xfrm.state_bysrc, sz);
 	WARN_ON(!hlist_empty(net->xfrm.state_bydst));
 	xfrm_hash_free(net->xfrm.state_bydst, sz);
+	free_percpu(net->xfrm.input_cache);
 }
 
 // [ SEC_SELINUX_PORTING_COMMON - remove AUDIT_MAC_IPSEC_EVENT audit log, it conflict with security notification
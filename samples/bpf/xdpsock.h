@@ -5,7 +5,4 @@
 /* Power-of-2 number of sockets */
 #define MAX_SOCKS 4
 
-/* Round-robin receive */
-#define RR_LB 0
-
 #endif /* XDPSOCK_H_ */
@@ -12,11 +12,19 @@ struct bpf_map_def SEC("maps") qidconf_map = {
 	.max_entries	= 1,
 };
 
+/* Number of sockets to round-robin over, a power of 2 */
+struct bpf_map_def SEC("maps") num_socks_map = {
+	.type		= BPF_MAP_TYPE_ARRAY,
+	.key_size	= sizeof(int),
+	.value_size	= sizeof(int),
+	.max_entries	= 1,
+};
+
 struct bpf_map_def SEC("maps") xsks_map = {
 	.type = BPF_MAP_TYPE_XSKMAP,
 	.key_size = sizeof(int),
 	.value_size = sizeof(int),
-	.max_entries = 4,
+	.max_entries = MAX_SOCKS,
 };
 
 struct bpf_map_def SEC("maps") rr_map = {
@@ -29,7 +37,7 @@ struct bpf_map_def SEC("maps") rr_map = {
 SEC("xdp_sock")
 int xdp_sock_prog(struct xdp_md *ctx)
 {
-	int *qidconf, key = 0, idx;
+	int *qidconf, *num_socks, key = 0, idx;
 	unsigned int *rr;
 
 	qidconf = bpf_map_lookup_elem(&qidconf_map, &key);
@@ -39,16 +47,17 @@ int xdp_sock_prog(struct xdp_md *ctx)
 	if (*qidconf != ctx->rx_queue_index)
 		return XDP_PASS;
 
-#if RR_LB /* NB! RR_LB is configured in xdpsock.h */
+	num_socks = bpf_map_lookup_elem(&num_socks_map, &key);
+	if (!num_socks)
+		return XDP_ABORTED;
+
+	/* Round-robin over the sockets sharing the umem */
 	rr = bpf_map_lookup_elem(&rr_map, &key);
 	if (!rr)
 		return XDP_ABORTED;
 
-	*rr = (*rr + 1) & (MAX_SOCKS - 1);
+	*rr = (*rr + 1) & (*num_socks - 1);
 	idx = *rr;
-#else
-	idx = 0;
-#endif
 
 	return bpf_redirect_map(&xsks_map, idx, 0);
 }
@@ -76,6 +76,8 @@ static int opt_poll;
 static int opt_shared_packet_buffer;
 static int opt_interval = 1;
 static u32 opt_xdp_bind_flags;
+static int opt_need_wakeup = 1;
+static int opt_num_xsks = 1;
 
 struct xdp_umem_uqueue {
 	u32 cached_prod;
@@ -84,6 +86,7 @@ struct xdp_umem_uqueue {
 	u32 size;
 	u32 *producer;
 	u32 *consumer;
+	u32 *flags;
 	u64 *ring;
 	void *map;
 };
@@ -102,6 +105,7 @@ struct xdp_uqueue {
 	u32 size;
 	u32 *producer;
 	u32 *consumer;
+	u32 *flags;
 	struct xdp_desc *ring;
 	void *map;
 };
@@ -274,6 +278,11 @@ static inline size_t umem_complete_from_kernel(struct xdp_umem_uqueue *cq,
 	return entries;
 }
 
+static inline bool needs_wakeup(u32 *flags)
+{
+	return *flags & XDP_RING_NEED_WAKEUP;
+}
+
 static inline void *xq_get_data(struct xdpsock *xsk, u64 addr)
 {
 	return &xsk->umem->frames[addr];
@@ -432,6 +441,9 @@ static struct xdp_umem *xdp_umem_configure(int sfd)
 	optlen = sizeof(off);
 	lassert(getsockopt(sfd, SOL_XDP, XDP_MMAP_OFFSETS, &off,
 			   &optlen) == 0);
+	/* Older kernels have no ring flags */
+	if (optlen < sizeof(off))
+		opt_need_wakeup = 0;
 
 	umem->fq.map = mmap(0, off.fr.desc +
 			    FQ_NUM_DESCS * sizeof(u64),
@@ -444,6 +456,7 @@ static struct xdp_umem *xdp_umem_configure(int sfd)
 	umem->fq.size = FQ_NUM_DESCS;
 	umem->fq.producer = umem->fq.map + off.fr.producer;
 	umem->fq.consumer = umem->fq.map + off.fr.consumer;
+	umem->fq.flags = umem->fq.map + off.fr.flags;
 	umem->fq.ring = umem->fq.map + off.fr.desc;
 	umem->fq.cached_cons = FQ_NUM_DESCS;
 
@@ -458,6 +471,7 @@ static struct xdp_umem *xdp_umem_configure(int sfd)
 	umem->cq.size = CQ_NUM_DESCS;
 	umem->cq.producer = umem->cq.map + off.cr.producer;
 	umem->cq.consumer = umem->cq.map + off.cr.consumer;
+	umem->cq.flags = umem->cq.map + off.cr.flags;
 	umem->cq.ring = umem->cq.map + off.cr.desc;
 
 	umem->frames = bufs;
@@ -535,12 +549,14 @@ static struct xdpsock *xsk_configure(struct xdp_umem *umem)
 	xsk->rx.size = NUM_DESCS;
 	xsk->rx.producer = xsk->rx.map + off.rx.producer;
 	xsk->rx.consumer = xsk->rx.map + off.rx.consumer;
+	xsk->rx.flags = xsk->rx.map + off.rx.flags;
 	xsk->rx.ring = xsk->rx.map + off.rx.desc;
 
 	xsk->tx.mask = NUM_DESCS - 1;
 	xsk->tx.size = NUM_DESCS;
 	xsk->tx.producer = xsk->tx.map + off.tx.producer;
 	xsk->tx.consumer = xsk->tx.map + off.tx.consumer;
+	xsk->tx.flags = xsk->tx.map + off.tx.flags;
 	xsk->tx.ring = xsk->tx.map + off.tx.desc;
 	xsk->tx.cached_cons = NUM_DESCS;
 
@@ -553,6 +569,8 @@ static struct xdpsock *xsk_configure(struct xdp_umem *umem)
 		sxdp.sxdp_shared_umem_fd = umem->fd;
 	} else {
 		sxdp.sxdp_flags = opt_xdp_bind_flags;
+		if (opt_need_wakeup)
+			sxdp.sxdp_flags |= XDP_USE_NEED_WAKEUP;
 	}
 
 	lassert(bind(sfd, (struct sockaddr *)&sxdp, sizeof(sxdp)) == 0);
@@ -582,6 +600,9 @@ static void print_benchmark(bool running)
 	if (opt_poll)
 		printf("poll() ");
 
+	if (opt_need_wakeup)
+		printf("need_wakeup ");
+
 	if (running) {
 		printf("running...");
 		fflush(stdout);
@@ -649,6 +670,8 @@ static struct option long_options[] = {
 	{"xdp-skb", no_argument, 0, 'S'},
 	{"xdp-native", no_argument, 0, 'N'},
 	{"interval", required_argument, 0, 'n'},
+	{"no-need-wakeup", no_argument, 0, 'm'},
+	{"sockets", required_argument, 0, 'M'},
 	{0, 0, 0, 0}
 };
 
@@ -667,6 +690,8 @@ static void usage(const char *prog)
 		"  -S, --xdp-skb=n	Use XDP skb-mod\n"
 		"  -N, --xdp-native=n	Enfore XDP native mode\n"
 		"  -n, --interval=n	Specify statistics update interval (default 1 sec).\n"
+		"  -m, --no-need-wakeup	Turn off use of driver need wakeup flag.\n"
+		"  -M, --sockets=n	Number of sockets sharing one umem, rxdrop only (default 1).\n"
 		"\n";
 	fprintf(stderr, str, prog);
 	exit(EXIT_FAILURE);
@@ -679,7 +704,7 @@ static void parse_command_line(int argc, char **argv)
 	opterr = 0;
 
 	for (;;) {
-		c = getopt_long(argc, argv, "rtli:q:psSNn:", long_options,
+		c = getopt_long(argc, argv, "rtli:q:psSNn:mM:", long_options,
 				&option_index);
 		if (c == -1)
 			break;
@@ -716,11 +741,28 @@ static void parse_command_line(int argc, char **argv)
 		case 'n':
 			opt_interval = atoi(optarg);
 			break;
+		case 'm':
+			opt_need_wakeup = 0;
+			break;
+		case 'M':
+			opt_num_xsks = atoi(optarg);
+			break;
 		default:
 			usage(basename(argv[0]));
 		}
 	}
 
+	if (opt_num_xsks < 1 || opt_num_xsks > MAX_SOCKS ||
+	    (opt_num_xsks & (opt_num_xsks - 1))) {
+		fprintf(stderr, "ERROR: sockets must be a power of 2 up to %d\n",
+			MAX_SOCKS);
+		usage(basename(argv[0]));
+	}
+	if (opt_num_xsks > 1 && opt_bench != BENCH_RXDROP) {
+		fprintf(stderr, "ERROR: multiple sockets need rxdrop\n");
+		usage(basename(argv[0]));
+	}
+
 	opt_ifindex = if_nametoindex(opt_if);
 	if (!opt_ifindex) {
 		fprintf(stderr, "ERROR: interface \"%s\" does not exist\n",
@@ -748,7 +790,8 @@ static inline void complete_tx_l2fwd(struct xdpsock *xsk)
 	if (!xsk->outstanding_tx)
 		return;
 
-	kick_tx(xsk->sfd);
+	if (!opt_need_wakeup || needs_wakeup(xsk->tx.flags))
+		kick_tx(xsk->sfd);
 	ndescs = (xsk->outstanding_tx > BATCH_SIZE) ? BATCH_SIZE :
 		 xsk->outstanding_tx;
 
@@ -769,7 +812,8 @@ static inline void complete_tx_only(struct xdpsock *xsk)
 	if (!xsk->outstanding_tx)
 		return;
 
-	kick_tx(xsk->sfd);
+	if (!opt_need_wakeup || needs_wakeup(xsk->tx.flags))
+		kick_tx(xsk->sfd);
 
 	rcvd = umem_complete_from_kernel(&xsk->umem->cq, descs, BATCH_SIZE);
 	if (rcvd > 0) {
@@ -778,14 +822,17 @@ static inline void complete_tx_only(struct xdpsock *xsk)
 	}
 }
 
-static void rx_drop(struct xdpsock *xsk)
+static void rx_drop(struct xdpsock *xsk, struct pollfd *fds)
 {
 	struct xdp_desc descs[BATCH_SIZE];
 	unsigned int rcvd, i;
 
 	rcvd = xq_deq(&xsk->rx, descs, BATCH_SIZE);
-	if (!rcvd)
+	if (!rcvd) {
+		if (opt_need_wakeup && needs_wakeup(xsk->umem->fq.flags))
+			poll(fds, num_socks, 1000);
 		return;
+	}
 
 	for (i = 0; i < rcvd; i++) {
 		char *pkt = xq_get_data(xsk, descs[i].addr);
@@ -801,7 +848,7 @@ static void rx_drop(struct xdpsock *xsk)
 static void rx_drop_all(void)
 {
 	struct pollfd fds[MAX_SOCKS + 1];
-	int i, ret, timeout, nfds = 1;
+	int i, ret, timeout, nfds = num_socks;
 
 	memset(fds, 0, sizeof(fds));
 
@@ -819,7 +866,7 @@ static void rx_drop_all(void)
 		}
 
 		for (i = 0; i < num_socks; i++)
-			rx_drop(xsks[i]);
+			rx_drop(xsks[i], fds);
 	}
 }
 
@@ -859,6 +906,8 @@ static void tx_only(struct xdpsock *xsk)
 
 static void l2fwd(struct xdpsock *xsk)
 {
+	struct pollfd fds[1] = { { .fd = xsk->sfd, .events = POLLIN } };
+
 	for (;;) {
 		struct xdp_desc descs[BATCH_SIZE];
 		unsigned int rcvd, i;
@@ -870,6 +919,9 @@ static void l2fwd(struct xdpsock *xsk)
 			rcvd = xq_deq(&xsk->rx, descs, BATCH_SIZE);
 			if (rcvd > 0)
 				break;
+
+			if (opt_need_wakeup && needs_wakeup(xsk->umem->fq.flags))
+				poll(fds, 1, 1000);
 		}
 
 		for (i = 0; i < rcvd; i++) {
@@ -894,7 +946,7 @@ int main(int argc, char **argv)
 	struct bpf_prog_load_attr prog_load_attr = {
 		.prog_type	= BPF_PROG_TYPE_XDP,
 	};
-	int prog_fd, qidconf_map, xsks_map;
+	int prog_fd, qidconf_map, num_socks_map, xsks_map;
 	struct bpf_object *obj;
 	char xdp_filename[256];
 	struct bpf_map *map;
@@ -928,6 +980,14 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
+	map = bpf_object__find_map_by_name(obj, "num_socks_map");
+	num_socks_map = bpf_map__fd(map);
+	if (num_socks_map < 0) {
+		fprintf(stderr, "ERROR: no num_socks map found: %s\n",
+			strerror(num_socks_map));
+		exit(EXIT_FAILURE);
+	}
+
 	map = bpf_object__find_map_by_name(obj, "xsks_map");
 	xsks_map = bpf_map__fd(map);
 	if (xsks_map < 0) {
@@ -947,13 +1007,17 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
+	ret = bpf_map_update_elem(num_socks_map, &key, &opt_num_xsks, 0);
+	if (ret) {
+		fprintf(stderr, "ERROR: bpf_map_update_elem num_socks\n");
+		exit(EXIT_FAILURE);
+	}
+
 	/* Create sockets... */
 	xsks[num_socks++] = xsk_configure(NULL);
 
-#if RR_LB
-	for (i = 0; i < MAX_SOCKS - 1; i++)
+	for (i = 1; i < opt_num_xsks; i++)
 		xsks[num_socks++] = xsk_configure(xsks[0]->umem);
-#endif
 
 	/* ...and insert them into the map. */
 	for (i = 0; i < num_socks; i++) {
@@ -15,9 +15,12 @@
 #include <string.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include <sys/wait.h>
 #include <sys/socket.h>
+#include <sys/mman.h>
+#include <poll.h>
 #include <netinet/in.h>
 #include <linux/bpf.h>
 
@@ -1412,6 +1415,280 @@ static void test_reuseport_array(void)
 	close(map_fd);
 }
 
+static bool map_type_percpu(enum bpf_map_type type)
+{
+	return type == BPF_MAP_TYPE_PERCPU_HASH ||
+	       type == BPF_MAP_TYPE_LRU_PERCPU_HASH ||
+	       type == BPF_MAP_TYPE_PERCPU_ARRAY;
+}
+
+static bool map_type_hash(enum bpf_map_type type)
+{
+	return type != BPF_MAP_TYPE_ARRAY && type != BPF_MAP_TYPE_PERCPU_ARRAY;
+}
+
+/* keys[] are 0..n-1 in some order and each value (on each CPU) is key + 1 */
+static void map_batch_verify(int *visited, __u32 n, int *keys, __u64 *values,
+			     int nr_vals)
+{
+	int i, j;
+
+	memset(visited, 0, n * sizeof(*visited));
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < nr_vals; j++)
+			CHECK(values[i * nr_vals + j] != keys[i] + 1,
+			      "key/value checking",
+			      "error: i %d j %d key %d value %llu\n", i, j,
+			      keys[i], values[i * nr_vals + j]);
+		CHECK(keys[i] < 0 || keys[i] >= n || visited[keys[i]],
+		      "visited checking", "error: key %d\n", keys[i]);
+		visited[keys[i]] = 1;
+	}
+}
+
+static void map_batch_fill(int fd, __u32 n, int *keys, __u64 *values,
+			   int nr_vals)
+{
+	__u32 count = n;
+	int i, j, err;
+
+	for (i = 0; i < n; i++) {
+		keys[i] = i;
+		for (j = 0; j < nr_vals; j++)
+			values[i * nr_vals + j] = i + 1;
+	}
+
+	err = bpf_map_update_batch(fd, keys, values, &count, 0, 0);
+	CHECK(err || count != n, "bpf_map_update_batch()",
+	      "error: %s count %u\n", strerror(errno), count);
+}
+
+/* Walk the whole map @step elements at a time, optionally deleting */
+static __u32 map_batch_dump(int fd, __u32 n, __u32 step, int *keys,
+			    __u64 *values, int nr_vals, bool del)
+{
+	__u32 batch, count, total = 0;
+	void *in_batch = NULL;
+	int err;
+
+	while (true) {
+		count = step;
+		if (del)
+			err = bpf_map_lookup_and_delete_batch(fd, in_batch,
+							      &batch,
+							      keys + total,
+							      values + total * nr_vals,
+							      &count, 0, 0);
+		else
+			err = bpf_map_lookup_batch(fd, in_batch, &batch,
+						   keys + total,
+						   values + total * nr_vals,
+						   &count, 0, 0);
+		if (err && errno == ENOSPC) {
+			/* a whole hash bucket did not fit, retry larger */
+			CHECK(count, "lookup batch", "ENOSPC count %u\n",
+			      count);
+			step *= 2;
+			continue;
+		}
+		CHECK(err && errno != ENOENT, "lookup batch",
+		      "error: %s\n", strerror(errno));
+		total += count;
+		CHECK(total > n, "lookup batch", "error: total %u\n", total);
+		if (err)
+			break;
+		in_batch = &batch;
+	}
+	return total;
+}
+
+static void test_map_batch_type(enum bpf_map_type type, __u32 n, __u32 flags)
+{
+	int nr_vals = map_type_percpu(type) ? bpf_num_possible_cpus() : 1;
+	__u64 *values;
+	int *keys, *visited;
+	__u32 count, step, max_entries;
+	int fd, key, err;
+
+	/* leave the LRU maps room so that they do not evict while filled */
+	max_entries = type == BPF_MAP_TYPE_LRU_HASH ||
+		      type == BPF_MAP_TYPE_LRU_PERCPU_HASH ? 2 * n : n;
+	fd = bpf_create_map(type, sizeof(int), sizeof(__u64), max_entries,
+			    flags);
+	CHECK(fd < 0, "bpf_create_map()", "type %d error: %s\n", type,
+	      strerror(errno));
+
+	keys = malloc(n * sizeof(*keys));
+	values = malloc(n * nr_vals * sizeof(*values));
+	visited = malloc(n * sizeof(*visited));
+	CHECK(!keys || !values || !visited, "malloc()", "error: %s\n",
+	      strerror(errno));
+
+	/* a zero count is a no-op, unknown flags are rejected */
+	count = 0;
+	err = bpf_map_lookup_batch(fd, NULL, &key, keys, values, &count, 0, 0);
+	CHECK(err || count, "zero count", "error: %s\n", strerror(errno));
+	count = 1;
+	err = bpf_map_lookup_batch(fd, NULL, &key, keys, values, &count, 0, 1);
+	CHECK(!err || errno != EINVAL, "flags", "error: %s\n", strerror(errno));
+
+	map_batch_fill(fd, n, keys, values, nr_vals);
+
+	for (step = 1; step <= n; step = step * 7 + 3) {
+		memset(values, 0, n * nr_vals * sizeof(*values));
+		count = map_batch_dump(fd, n, step, keys, values, nr_vals,
+				       false);
+		CHECK(count != n, "lookup batch", "step %u count %u\n",
+		      step, count);
+		map_batch_verify(visited, n, keys, values, nr_vals);
+	}
+
+	if (!map_type_hash(type)) {
+		/* array elements cannot be deleted */
+		count = n;
+		err = bpf_map_delete_batch(fd, keys, &count, 0, 0);
+		CHECK(!err || errno != EOPNOTSUPP, "delete batch array",
+		      "error: %s\n", strerror(errno));
+		goto out;
+	}
+
+	/* lookup and delete empties the map */
+	count = map_batch_dump(fd, n, n / 3 + 1, keys, values, nr_vals, true);
+	CHECK(count != n, "lookup and delete batch", "count %u\n", count);
+	map_batch_verify(visited, n, keys, values, nr_vals);
+	CHECK(bpf_map_get_next_key(fd, NULL, &key) != -1 || errno != ENOENT,
+	      "map empty", "error: %s\n", strerror(errno));
+
+	/* delete stops at the first missing key and reports how far it got */
+	map_batch_fill(fd, n, keys, values, nr_vals);
+	count = n;
+	err = bpf_map_delete_batch(fd, keys, &count, 0, 0);
+	CHECK(err || count != n, "delete batch", "error: %s count %u\n",
+	      strerror(errno), count);
+	count = n;
+	err = bpf_map_delete_batch(fd, keys, &count, 0, 0);
+	CHECK(!err || errno != ENOENT || count != 0, "delete batch missing",
+	      "error: %s count %u\n", strerror(errno), count);
+
+out:
+	free(visited);
+	free(values);
+	free(keys);
+	close(fd);
+}
+
+static double time_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* Dump a large hash table element by element and in batches */
+static void test_map_batch_perf(void)
+{
+	const __u32 n = 100000;
+	double t, t_elem, t_batch;
+	int *keys, key, next_key, fd;
+	__u64 *values, value;
+	__u32 count;
+
+	fd = bpf_create_map(BPF_MAP_TYPE_HASH, sizeof(int), sizeof(__u64), n,
+			    map_flags);
+	CHECK(fd < 0, "bpf_create_map()", "error: %s\n", strerror(errno));
+
+	keys = malloc(n * sizeof(*keys));
+	values = malloc(n * sizeof(*values));
+	CHECK(!keys || !values, "malloc()", "error: %s\n", strerror(errno));
+
+	map_batch_fill(fd, n, keys, values, 1);
+
+	t = time_ms();
+	count = 0;
+	if (!bpf_map_get_next_key(fd, NULL, &key)) {
+		do {
+			assert(bpf_map_lookup_elem(fd, &key, &value) == 0);
+			count++;
+		} while (!bpf_map_get_next_key(fd, &key, &next_key) &&
+			 (key = next_key, true));
+	}
+	t_elem = time_ms() - t;
+	CHECK(count != n, "per element dump", "count %u\n", count);
+
+	t = time_ms();
+	count = map_batch_dump(fd, n, 4096, keys, values, 1, false);
+	t_batch = time_ms() - t;
+	CHECK(count != n, "batch dump", "count %u\n", count);
+
+	printf("Dumped %u hash elements: per element %.1f ms, batched %.1f ms\n",
+	       n, t_elem, t_batch);
+
+	free(values);
+	free(keys);
+	close(fd);
+}
+
+static void test_map_batch(void)
+{
+	test_map_batch_type(BPF_MAP_TYPE_HASH, 1000, map_flags);
+	test_map_batch_type(BPF_MAP_TYPE_PERCPU_HASH, 1000, map_flags);
+	test_map_batch_type(BPF_MAP_TYPE_LRU_HASH, 1000, 0);
+	test_map_batch_type(BPF_MAP_TYPE_LRU_PERCPU_HASH, 1000, 0);
+	test_map_batch_type(BPF_MAP_TYPE_ARRAY, 1000, 0);
+	test_map_batch_type(BPF_MAP_TYPE_PERCPU_ARRAY, 1000, 0);
+
+	test_map_batch_perf();
+}
+
+static void test_ringbuf(void)
+{
+	long page_size = sysconf(_SC_PAGE_SIZE);
+	struct pollfd pfd;
+	void *cons, *prod;
+	int fd, key = 0;
+
+	/* the size must be a power of 2 multiple of the page size */
+	fd = bpf_create_map(BPF_MAP_TYPE_RINGBUF, 0, 0, 3 * page_size, 0);
+	assert(fd < 0 && errno == EINVAL);
+	fd = bpf_create_map(BPF_MAP_TYPE_RINGBUF, 4, 0, 4 * page_size, 0);
+	assert(fd < 0 && errno == EINVAL);
+
+	fd = bpf_create_map(BPF_MAP_TYPE_RINGBUF, 0, 0, 4 * page_size, 0);
+	if (fd < 0) {
+		printf("Failed to create ringbuf '%s'!\n", strerror(errno));
+		exit(1);
+	}
+
+	/* only the consumer position page may be mapped writable */
+	cons = mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	assert(cons != MAP_FAILED);
+	assert(mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+		    page_size) == MAP_FAILED && errno == EPERM);
+
+	/* producer position page and the data pages, mapped twice */
+	prod = mmap(NULL, page_size + 8 * page_size, PROT_READ, MAP_SHARED,
+		    fd, page_size);
+	assert(prod != MAP_FAILED);
+	assert(mprotect(prod, page_size, PROT_READ | PROT_WRITE) == -1);
+
+	assert(*(unsigned long *)cons == 0);
+	assert(*(unsigned long *)prod == 0);
+
+	/* nothing produced yet */
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	assert(poll(&pfd, 1, 0) == 0);
+
+	/* no elements to look up or update from user space */
+	assert(bpf_map_lookup_elem(fd, &key, &key) == -1 && errno == ENOENT);
+	assert(bpf_map_update_elem(fd, &key, &key, BPF_ANY) == -1);
+
+	munmap(prod, page_size + 8 * page_size);
+	munmap(cons, page_size);
+	close(fd);
+}
+
 static void run_all_tests(void)
 {
 	test_hashmap(0, NULL);
@@ -1434,6 +1711,10 @@ static void run_all_tests(void)
 	test_map_wronly();
 
 	test_reuseport_array();
+
+	test_ringbuf();
+
+	test_map_batch();
 }
 
 int main(void)
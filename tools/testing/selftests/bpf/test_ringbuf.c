@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <assert.h>
+#include <bpf/bpf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/filter.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "bpf_rlimit.h"
+#include "cgroup_helpers.h"
+
+char bpf_log_buf[BPF_LOG_BUF_SIZE];
+
+#define TEST_CGROUP "/test-bpf-ringbuf/"
+
+#define RINGBUF_PAGES	4
+
+struct dev_rec {
+	__u32 major;
+	__u32 minor;
+};
+
+int main(int argc, char **argv)
+{
+	/* Emit a record with the device numbers of every access, allow it */
+	struct bpf_insn prog[] = {
+		BPF_LDX_MEM(BPF_W, BPF_REG_2, BPF_REG_1,
+			    offsetof(struct bpf_cgroup_dev_ctx, major)),
+		BPF_LDX_MEM(BPF_W, BPF_REG_3, BPF_REG_1,
+			    offsetof(struct bpf_cgroup_dev_ctx, minor)),
+		BPF_STX_MEM(BPF_W, BPF_REG_10, BPF_REG_2, -8),
+		BPF_STX_MEM(BPF_W, BPF_REG_10, BPF_REG_3, -4),
+		BPF_LD_MAP_FD(BPF_REG_1, 0), /* map fd */
+		BPF_MOV64_REG(BPF_REG_2, BPF_REG_10),
+		BPF_ALU64_IMM(BPF_ADD, BPF_REG_2, -8),
+		BPF_MOV64_IMM(BPF_REG_3, sizeof(struct dev_rec)),
+		BPF_MOV64_IMM(BPF_REG_4, 0),
+		BPF_RAW_INSN(BPF_JMP | BPF_CALL, 0, 0, 0,
+			     BPF_FUNC_ringbuf_output),
+		BPF_MOV64_IMM(BPF_REG_0, 1),
+		BPF_EXIT_INSN(),
+	};
+	size_t insns_cnt = sizeof(prog) / sizeof(struct bpf_insn);
+	long page_size = sysconf(_SC_PAGE_SIZE);
+	unsigned long mask = RINGBUF_PAGES * page_size - 1;
+	unsigned long cons_pos, prod_pos;
+	int error = EXIT_FAILURE;
+	int map_fd, prog_fd, cgroup_fd, fd;
+	void *cons, *prod, *data;
+	struct pollfd pfd;
+	bool found = false;
+
+	map_fd = bpf_create_map(BPF_MAP_TYPE_RINGBUF, 0, 0,
+				RINGBUF_PAGES * page_size, 0);
+	if (map_fd < 0) {
+		printf("Failed to create map: %s\n", strerror(errno));
+		goto out;
+	}
+
+	cons = mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		    map_fd, 0);
+	prod = mmap(NULL, page_size + 2 * RINGBUF_PAGES * page_size,
+		    PROT_READ, MAP_SHARED, map_fd, page_size);
+	if (cons == MAP_FAILED || prod == MAP_FAILED) {
+		printf("Failed to mmap ringbuf: %s\n", strerror(errno));
+		goto out;
+	}
+	data = prod + page_size;
+
+	prog[4].imm = map_fd;
+	prog_fd = bpf_load_program(BPF_PROG_TYPE_CGROUP_DEVICE,
+				   prog, insns_cnt, "GPL", 0,
+				   bpf_log_buf, BPF_LOG_BUF_SIZE);
+	if (prog_fd < 0) {
+		printf("Failed to load bpf program: %s\n", bpf_log_buf);
+		goto out;
+	}
+
+	if (setup_cgroup_environment()) {
+		printf("Failed to setup cgroup environment\n");
+		goto err;
+	}
+
+	/* Create a cgroup, get fd, and join it */
+	cgroup_fd = create_and_get_cgroup(TEST_CGROUP);
+	if (!cgroup_fd) {
+		printf("Failed to create test cgroup\n");
+		goto err;
+	}
+
+	if (join_cgroup(TEST_CGROUP)) {
+		printf("Failed to join cgroup\n");
+		goto err;
+	}
+
+	/* Attach the bpf program */
+	if (bpf_prog_attach(prog_fd, cgroup_fd, BPF_CGROUP_DEVICE, 0)) {
+		printf("Failed to attach bpf program\n");
+		goto err;
+	}
+
+	/* Nothing produced yet */
+	pfd.fd = map_fd;
+	pfd.events = POLLIN;
+	assert(poll(&pfd, 1, 0) == 0);
+
+	/* Opening /dev/zero (1:5) runs the program */
+	fd = open("/dev/zero", O_RDONLY);
+	assert(fd >= 0);
+	close(fd);
+
+	assert(poll(&pfd, 1, 1000) == 1 && (pfd.revents & POLLIN));
+
+	cons_pos = *(volatile unsigned long *)cons;
+	prod_pos = *(volatile unsigned long *)prod;
+	assert(cons_pos == 0 && prod_pos > 0);
+
+	while (cons_pos < prod_pos) {
+		__u32 len = *(volatile __u32 *)(data + (cons_pos & mask));
+		struct dev_rec *rec;
+
+		assert(!(len & BPF_RINGBUF_BUSY_BIT));
+		assert(len == sizeof(*rec));
+
+		rec = data + (cons_pos & mask) + BPF_RINGBUF_HDR_SZ;
+		if (rec->major == 1 && rec->minor == 5)
+			found = true;
+
+		cons_pos += BPF_RINGBUF_HDR_SZ + ((len + 7) & ~7U);
+	}
+	assert(cons_pos == prod_pos);
+
+	if (!found) {
+		printf("No record for /dev/zero in the ring buffer\n");
+		goto err;
+	}
+
+	/* Consume everything, the ring is empty again */
+	*(volatile unsigned long *)cons = cons_pos;
+	assert(poll(&pfd, 1, 0) == 0);
+
+	error = 0;
+	printf("test_ringbuf:PASS\n");
+
+err:
+	cleanup_cgroup_environment();
+
+out:
+	return error;
+}
@@ -0,0 +1,194 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/******************************************************************************
+ *
+ * DESCRIPTION
+ *      Test FUTEX_WAIT_MULTIPLE: the index of the woken futex is returned,
+ *      the per-futex bitsets select the wakes that count, a mismatched
+ *      value on any futex gives -EWOULDBLOCK, the timeout expires with
+ *      -ETIMEDOUT and bad arguments are rejected.
+ *
+ *****************************************************************************/
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libgen.h>
+#include "futextest.h"
+#include "logging.h"
+
+#define TEST_NAME "futex-wait-multiple"
+#define NR_FUTEXES 8
+#define timeout_ns 100000
+#define WAKE_WAIT_US 10000
+
+static futex_t futexes[NR_FUTEXES];
+static struct futex_wait_block fwb[NR_FUTEXES];
+static int wake_index;
+static u_int32_t wake_bitset;
+static volatile int waiting;
+
+void usage(char *prog)
+{
+	printf("Usage: %s\n", prog);
+	printf("  -c	Use color\n");
+	printf("  -h	Display this help message\n");
+	printf("  -v L	Verbosity level: %d=QUIET %d=CRITICAL %d=INFO\n",
+	       VQUIET, VCRITICAL, VINFO);
+}
+
+static void init_blocks(u_int32_t bitset)
+{
+	int i;
+
+	for (i = 0; i < NR_FUTEXES; i++) {
+		futexes[i] = FUTEX_INITIALIZER;
+		fwb[i].uaddr = (unsigned long)&futexes[i];
+		fwb[i].val = FUTEX_INITIALIZER;
+		fwb[i].bitset = bitset;
+	}
+}
+
+void *waker(void *arg)
+{
+	int woken;
+
+	/* Retry until the waiter is queued on the futex, or gave up. */
+	do {
+		usleep(WAKE_WAIT_US);
+		woken = futex_wake_bitset(&futexes[wake_index], 1,
+					  wake_bitset, FUTEX_PRIVATE_FLAG);
+	} while (woken == 0 && waiting);
+
+	return NULL;
+}
+
+/*
+ * Wait with @bitset on every futex while futex @index is woken with
+ * @wake. If the bitsets don't intersect the wait must time out instead.
+ */
+static int test_wake(int index, u_int32_t bitset, u_int32_t wake)
+{
+	struct timespec to = {.tv_sec = 5, .tv_nsec = 0};
+	int expect = (bitset & wake) ? index : -1;
+	pthread_t thr;
+	int res;
+
+	init_blocks(bitset);
+	wake_index = index;
+	wake_bitset = wake;
+	waiting = 1;
+	if (expect < 0) {
+		to.tv_sec = 0;
+		to.tv_nsec = 200000000;
+	}
+	if (pthread_create(&thr, NULL, waker, NULL)) {
+		error("pthread_create failed\n", errno);
+		return RET_ERROR;
+	}
+
+	info("Waiting on %d futexes with bitset 0x%x, waking %d with 0x%x\n",
+	     NR_FUTEXES, bitset, index, wake);
+	res = futex_wait_multiple(fwb, NR_FUTEXES, &to, FUTEX_PRIVATE_FLAG);
+	waiting = 0;
+	pthread_join(thr, NULL);
+
+	if (expect < 0 && res == -1 && errno == ETIMEDOUT)
+		return RET_PASS;
+	if (res != expect) {
+		fail("futex_wait_multiple returned %d (%s), expected %d\n",
+		     res, res < 0 ? strerror(errno) : "", expect);
+		return RET_FAIL;
+	}
+	return RET_PASS;
+}
+
+static int test_error(const char *what, struct futex_wait_block *blocks,
+		      int count, int opflags, int err)
+{
+	struct timespec to = {.tv_sec = 0, .tv_nsec = timeout_ns};
+	int res;
+
+	info("Calling futex_wait_multiple with %s\n", what);
+	res = futex_wait_multiple(blocks, count, &to, opflags);
+	if (res != -1 || errno != err) {
+		fail("futex_wait_multiple with %s returned %d %s, expected %s\n",
+		     what, res, res < 0 ? strerror(errno) : "", strerror(err));
+		return RET_FAIL;
+	}
+	return RET_PASS;
+}
+
+int main(int argc, char *argv[])
+{
+	int ret = RET_PASS;
+	int c, res;
+
+	while ((c = getopt(argc, argv, "cht:v:")) != -1) {
+		switch (c) {
+		case 'c':
+			log_color(1);
+			break;
+		case 'h':
+			usage(basename(argv[0]));
+			exit(0);
+		case 'v':
+			log_verbosity(atoi(optarg));
+			break;
+		default:
+			usage(basename(argv[0]));
+			exit(1);
+		}
+	}
+
+	ksft_print_header();
+	ksft_print_msg("%s: Test FUTEX_WAIT_MULTIPLE\n", basename(argv[0]));
+
+	/* ~0, as the wait multiple users pass it, is woken by any wake */
+	res = test_wake(0, FUTEX_BITSET_MATCH_ANY, FUTEX_BITSET_MATCH_ANY);
+	ret = res ? res : ret;
+	res = test_wake(NR_FUTEXES - 1, FUTEX_BITSET_MATCH_ANY, 0x4);
+	ret = res ? res : ret;
+	res = test_wake(1, 0x3, 0x2);
+	ret = res ? res : ret;
+	res = test_wake(1, 0x1, 0x2);
+	ret = res ? res : ret;
+
+	init_blocks(FUTEX_BITSET_MATCH_ANY);
+	res = test_error("all values matching", fwb, NR_FUTEXES,
+			 FUTEX_PRIVATE_FLAG, ETIMEDOUT);
+	ret = res ? res : ret;
+
+	/* Shared futexes, without FUTEX_PRIVATE_FLAG in the op */
+	res = test_error("shared futexes", fwb, NR_FUTEXES, 0, ETIMEDOUT);
+	ret = res ? res : ret;
+
+	fwb[NR_FUTEXES / 2].val = futexes[NR_FUTEXES / 2] + 1;
+	res = test_error("one value mismatched", fwb, NR_FUTEXES,
+			 FUTEX_PRIVATE_FLAG, EWOULDBLOCK);
+	ret = res ? res : ret;
+
+	init_blocks(FUTEX_BITSET_MATCH_ANY);
+	res = test_error("zero futexes", fwb, 0, FUTEX_PRIVATE_FLAG, EINVAL);
+	ret = res ? res : ret;
+	res = test_error("too many futexes", fwb, FUTEX_MULTIPLE_MAX_COUNT + 1,
+			 FUTEX_PRIVATE_FLAG, EINVAL);
+	ret = res ? res : ret;
+
+	fwb[0].bitset = 0;
+	res = test_error("a zero bitset", fwb, NR_FUTEXES,
+			 FUTEX_PRIVATE_FLAG, EINVAL);
+	ret = res ? res : ret;
+
+	init_blocks(FUTEX_BITSET_MATCH_ANY);
+	fwb[1].uaddr = 0;
+	res = test_error("a NULL futex", fwb, NR_FUTEXES, FUTEX_PRIVATE_FLAG,
+			 EFAULT);
+	ret = res ? res : ret;
+
+	print_result(TEST_NAME, ret);
+	return ret;
+}
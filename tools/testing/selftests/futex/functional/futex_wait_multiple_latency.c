@@ -0,0 +1,269 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/******************************************************************************
+ *
+ * DESCRIPTION
+ *      Measure the wakeup latency of a thread blocked on N objects with
+ *      FUTEX_WAIT_MULTIPLE, and with the poll() on N eventfds emulation that
+ *      userspace has to use without it.  One thread waits, the other signals
+ *      a random object and waits for the acknowledgement; the round trip
+ *      time is reported for both.
+ *
+ *****************************************************************************/
+
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libgen.h>
+#include <sys/eventfd.h>
+#include "futextest.h"
+#include "logging.h"
+
+#define TEST_NAME "futex-wait-multiple-latency"
+
+static int nr_objects = 16;
+static int iterations = 10000;
+
+static futex_t futexes[FUTEX_MULTIPLE_MAX_COUNT];
+static int eventfds[FUTEX_MULTIPLE_MAX_COUNT];
+static futex_t ack;
+static int ack_fd;
+static int failed;
+
+void usage(char *prog)
+{
+	printf("Usage: %s\n", prog);
+	printf("  -c	Use color\n");
+	printf("  -h	Display this help message\n");
+	printf("  -i N	Number of wakeups (default: 10000)\n");
+	printf("  -n N	Number of objects waited on (default: 16, max: %d)\n",
+	       FUTEX_MULTIPLE_MAX_COUNT);
+	printf("  -v L	Verbosity level: %d=QUIET %d=CRITICAL %d=INFO\n",
+	       VQUIET, VCRITICAL, VINFO);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Each futex counts the wakeups sent to it; the waiter consumes them. */
+void *futex_waiter(void *arg)
+{
+	struct futex_wait_block fwb[FUTEX_MULTIPLE_MAX_COUNT];
+	int i, n, res;
+
+	for (i = 0; i < nr_objects; i++) {
+		fwb[i].uaddr = (unsigned long)&futexes[i];
+		fwb[i].val = 0;
+		fwb[i].bitset = FUTEX_BITSET_MATCH_ANY;
+	}
+
+	for (n = 0; n < iterations; ) {
+		for (i = 0; i < nr_objects; i++)
+			fwb[i].val = futexes[i];
+
+		res = futex_wait_multiple(fwb, nr_objects, NULL,
+					  FUTEX_PRIVATE_FLAG);
+		if (res < 0 && errno != EWOULDBLOCK && errno != EINTR) {
+			error("futex_wait_multiple failed\n", errno);
+			failed = 1;
+			/* Release the waker from its last round trip. */
+			futex_inc(&ack);
+			futex_wake(&ack, 1, FUTEX_PRIVATE_FLAG);
+			break;
+		}
+
+		/* Acknowledge every futex that changed, woken or not. */
+		for (i = 0; i < nr_objects; i++) {
+			if (fwb[i].val == futexes[i])
+				continue;
+			n++;
+			futex_inc(&ack);
+			futex_wake(&ack, 1, FUTEX_PRIVATE_FLAG);
+		}
+	}
+	return NULL;
+}
+
+static uint64_t bench_futex(void)
+{
+	uint64_t t0, t = 0;
+	pthread_t thr;
+	futex_t seen;
+	int n;
+
+	ack = 0;
+	if (pthread_create(&thr, NULL, futex_waiter, NULL)) {
+		error("pthread_create failed\n", errno);
+		failed = 1;
+		return 0;
+	}
+
+	for (n = 0; n < iterations && !failed; n++) {
+		int i = rand() % nr_objects;
+
+		seen = ack;
+		t0 = now_ns();
+		futex_inc(&futexes[i]);
+		futex_wake(&futexes[i], 1, FUTEX_PRIVATE_FLAG);
+		while (ack == seen)
+			futex_wait(&ack, seen, NULL, FUTEX_PRIVATE_FLAG);
+		t += now_ns() - t0;
+	}
+
+	pthread_join(thr, NULL);
+	return t;
+}
+
+void *poll_waiter(void *arg)
+{
+	struct pollfd pfd[FUTEX_MULTIPLE_MAX_COUNT];
+	uint64_t v;
+	int i, n;
+
+	for (i = 0; i < nr_objects; i++) {
+		pfd[i].fd = eventfds[i];
+		pfd[i].events = POLLIN;
+	}
+
+	for (n = 0; n < iterations; ) {
+		if (poll(pfd, nr_objects, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			error("poll failed\n", errno);
+			failed = 1;
+			break;
+		}
+
+		for (i = 0; i < nr_objects; i++) {
+			if (!(pfd[i].revents & POLLIN))
+				continue;
+			if (read(eventfds[i], &v, sizeof(v)) != sizeof(v))
+				continue;
+			n += v;
+			while (v--) {
+				uint64_t one = 1;
+
+				if (write(ack_fd, &one, sizeof(one)) < 0)
+					failed = 1;
+			}
+		}
+	}
+	return NULL;
+}
+
+static uint64_t bench_poll(void)
+{
+	uint64_t t0, t = 0, one = 1, v;
+	pthread_t thr;
+	int n;
+
+	if (pthread_create(&thr, NULL, poll_waiter, NULL)) {
+		error("pthread_create failed\n", errno);
+		failed = 1;
+		return 0;
+	}
+
+	for (n = 0; n < iterations && !failed; n++) {
+		int i = rand() % nr_objects;
+
+		t0 = now_ns();
+		if (write(eventfds[i], &one, sizeof(one)) != sizeof(one) ||
+		    read(ack_fd, &v, sizeof(v)) != sizeof(v)) {
+			error("eventfd failed\n", errno);
+			failed = 1;
+			break;
+		}
+		t += now_ns() - t0;
+	}
+
+	pthread_join(thr, NULL);
+	return t;
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t futex_ns, poll_ns;
+	int ret = RET_PASS;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "chi:n:v:")) != -1) {
+		switch (c) {
+		case 'c':
+			log_color(1);
+			break;
+		case 'h':
+			usage(basename(argv[0]));
+			exit(0);
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		case 'n':
+			nr_objects = atoi(optarg);
+			break;
+		case 'v':
+			log_verbosity(atoi(optarg));
+			break;
+		default:
+			usage(basename(argv[0]));
+			exit(1);
+		}
+	}
+
+	if (nr_objects < 1 || nr_objects > FUTEX_MULTIPLE_MAX_COUNT ||
+	    iterations < 1) {
+		usage(basename(argv[0]));
+		exit(1);
+	}
+
+	ksft_print_header();
+	ksft_print_msg("%s: Wakeup latency of FUTEX_WAIT_MULTIPLE and poll()\n",
+		       basename(argv[0]));
+	ksft_print_msg("\tArguments: objects=%d iterations=%d\n",
+		       nr_objects, iterations);
+
+	futex_ns = bench_futex();
+	if (failed) {
+		ret = RET_FAIL;
+		goto out;
+	}
+
+	for (i = 0; i < nr_objects; i++) {
+		eventfds[i] = eventfd(0, 0);
+		if (eventfds[i] < 0) {
+			error("eventfd failed\n", errno);
+			ret = RET_ERROR;
+			goto out;
+		}
+	}
+	ack_fd = eventfd(0, EFD_SEMAPHORE);
+	if (ack_fd < 0) {
+		error("eventfd failed\n", errno);
+		ret = RET_ERROR;
+		goto out;
+	}
+
+	poll_ns = bench_poll();
+	if (failed) {
+		ret = RET_FAIL;
+		goto out;
+	}
+
+	ksft_print_msg("\tfutex_wait_multiple: %8llu ns per wakeup\n",
+		       (unsigned long long)(futex_ns / iterations));
+	ksft_print_msg("\tpoll on eventfds:    %8llu ns per wakeup\n",
+		       (unsigned long long)(poll_ns / iterations));
+
+out:
+	print_result(TEST_NAME, ret);
+	return ret;
+}
@@ -0,0 +1,141 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# ESP tunnel between two network namespaces over veth. Reports the UDP
+# packet rate through the tunnel, measured with udpgso_bench_{tx,rx},
+# and the ping latency over it. Both are measured with the AEAD in its
+# plain form and through pcrypt (net.core.xfrm_pcrypt). /proc/crypto is
+# checked to confirm which of the two the states actually use.
+#
+# Usage: ipsec_bench.sh [seconds per run]
+
+# Kselftest framework requirement - SKIP code is 4.
+ksft_skip=4
+
+duration=${1:-5}
+
+NS_A="ns-$(mktemp -u XXXXXX)"
+NS_B="ns-$(mktemp -u XXXXXX)"
+ns_a="ip netns exec ${NS_A}"
+ns_b="ip netns exec ${NS_B}"
+
+veth_a_addr="192.168.1.1"
+veth_b_addr="192.168.1.2"
+key="0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f"
+esp_aead="seqiv(rfc4106(gcm(aes)))"
+
+cleanup() {
+	local -r jobs="$(jobs -p)"
+
+	if [[ "${jobs}" != "" ]]; then
+		kill ${jobs} 2>/dev/null
+		wait 2>/dev/null
+	fi
+	ip netns del ${NS_A} 2>/dev/null
+	ip netns del ${NS_B} 2>/dev/null
+}
+trap cleanup EXIT
+
+setup_xfrm() {
+	local -r ns="${1}"
+
+	${ns} ip xfrm state add src ${veth_a_addr} dst ${veth_b_addr} spi 0x1000 proto esp aead "rfc4106(gcm(aes))" ${key} 128 mode tunnel || return 1
+	${ns} ip xfrm state add src ${veth_b_addr} dst ${veth_a_addr} spi 0x1001 proto esp aead "rfc4106(gcm(aes))" ${key} 128 mode tunnel || return 1
+}
+
+setup_policy() {
+	local -r ns="${1}"
+	local -r src="${2}"
+	local -r dst="${3}"
+
+	${ns} ip xfrm policy add src ${src} dst ${dst} dir out tmpl src ${src} dst ${dst} proto esp mode tunnel || return 1
+	${ns} ip xfrm policy add src ${dst} dst ${src} dir in tmpl src ${dst} dst ${src} proto esp mode tunnel || return 1
+}
+
+setup() {
+	local -r pcrypt="${1}"
+
+	ip netns add ${NS_A} || return 1
+	ip netns add ${NS_B} || return 1
+
+	${ns_a} ip link add veth_a type veth peer name veth_b || return 1
+	${ns_a} ip link set veth_b netns ${NS_B}
+	${ns_a} ip addr add ${veth_a_addr}/24 dev veth_a
+	${ns_b} ip addr add ${veth_b_addr}/24 dev veth_b
+	${ns_a} ip link set veth_a up
+	${ns_b} ip link set veth_b up
+
+	${ns_a} sysctl -q -w net.core.xfrm_pcrypt=${pcrypt} || return 1
+	${ns_b} sysctl -q -w net.core.xfrm_pcrypt=${pcrypt} || return 1
+
+	setup_xfrm "${ns_a}" || return 1
+	setup_xfrm "${ns_b}" || return 1
+	setup_policy "${ns_a}" ${veth_a_addr} ${veth_b_addr} || return 1
+	setup_policy "${ns_b}" ${veth_b_addr} ${veth_a_addr} || return 1
+}
+
+# Number of transforms allocated through a pcrypt instance of the ESP
+# AEAD. The instance itself holds one reference on its registration.
+pcrypt_users() {
+	awk -F' *: ' -v alg="${esp_aead}" '
+		$1 == "name" { name = $2 }
+		$1 == "driver" { driver = $2 }
+		$1 == "refcnt" && name == alg && driver ~ /^pcrypt\(/ {
+			users += $2 - 1
+		}
+		END { print users + 0 }' /proc/crypto
+}
+
+run_one() {
+	local -r pcrypt="${1}"
+	local -r rx_log="$(mktemp)"
+	local rx_pid users
+
+	if ! setup ${pcrypt}; then
+		echo "SKIP: could not set up the ESP tunnel"
+		rm -f ${rx_log}
+		exit ${ksft_skip}
+	fi
+
+	users=$(pcrypt_users)
+	if [ ${pcrypt} -eq 0 ] && [ ${users} -ne 0 ]; then
+		echo "FAIL: xfrm_pcrypt=0 but ${users} transforms use pcrypt"
+		rm -f ${rx_log}
+		exit 1
+	fi
+	if [ ${pcrypt} -ne 0 ] && [ ${users} -eq 0 ]; then
+		echo "SKIP: xfrm_pcrypt=1 but pcrypt is not in use"
+		rm -f ${rx_log}
+		cleanup
+		return
+	fi
+
+	${ns_b} ./udpgso_bench_rx 2> ${rx_log} &
+	rx_pid=$!
+	sleep 0.2
+
+	${ns_a} ./udpgso_bench_tx -4 -D ${veth_b_addr} -l ${duration} -s 1400
+
+	kill ${rx_pid}
+	wait ${rx_pid} 2>/dev/null
+
+	echo "xfrm_pcrypt=${pcrypt} (${users} pcrypt transforms)"
+	awk '/udp rx:/ { pps += $5; n++ }
+	     END { if (n) printf("  esp udp rx: %d pps\n", pps / n);
+		   else print "  esp udp rx: no packets" }' ${rx_log}
+	rm -f ${rx_log}
+
+	${ns_a} ping -q -c 1000 -i 0.001 ${veth_b_addr} | \
+		awk -F'[/ ]' '/^rtt/ { printf("  esp ping rtt us: min %d avg %d max %d\n",
+					   $7 * 1000, $8 * 1000, $9 * 1000) }'
+
+	cleanup
+}
+
+if [ "$(id -u)" -ne 0 ]; then
+	echo "SKIP: need root privileges"
+	exit ${ksft_skip}
+fi
+
+run_one 0
+run_one 1
@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Many paced TCP flows: the sender opens a number of connections, caps
+ * each of them with SO_MAX_PACING_RATE and keeps them busy, so that the
+ * stack paces them internally. The receiver drains all connections.
+ * Reports the aggregate goodput on the sender.
+ *
+ * Usage: tcp_pacing_bench -r [-p port]
+ *        tcp_pacing_bench -D addr [-p port] [-n flows] [-R Mbit/s per flow]
+ *                         [-C congestion control] [-t seconds]
+ */
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <error.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef SO_MAX_PACING_RATE
+#define SO_MAX_PACING_RATE	47
+#endif
+
+#define MAX_FLOWS	4096
+#define BUF_LEN		(64 * 1024)
+
+static bool cfg_rx;
+static const char *cfg_addr;
+static const char *cfg_cc;
+static int cfg_port = 8000;
+static int cfg_flows = 100;
+static int cfg_rate_mbit = 10;
+static int cfg_duration = 5;
+
+static char buf[BUF_LEN];
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void do_rx(void)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(cfg_port),
+		.sin_addr.s_addr = htonl(INADDR_ANY),
+	};
+	struct epoll_event ev, events[64];
+	int fd, efd, one = 1, i, n;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		error(1, errno, "socket");
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(fd, (void *)&addr, sizeof(addr)))
+		error(1, errno, "bind");
+	if (listen(fd, MAX_FLOWS))
+		error(1, errno, "listen");
+
+	efd = epoll_create1(0);
+	if (efd < 0)
+		error(1, errno, "epoll_create");
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	if (epoll_ctl(efd, EPOLL_CTL_ADD, fd, &ev))
+		error(1, errno, "epoll_ctl");
+
+	for (;;) {
+		n = epoll_wait(efd, events, 64, -1);
+		if (n < 0)
+			error(1, errno, "epoll_wait");
+
+		for (i = 0; i < n; i++) {
+			int cfd = events[i].data.fd;
+			int ret;
+
+			if (cfd == fd) {
+				cfd = accept4(fd, NULL, NULL, SOCK_NONBLOCK);
+				if (cfd < 0)
+					error(1, errno, "accept");
+				ev.events = EPOLLIN;
+				ev.data.fd = cfd;
+				if (epoll_ctl(efd, EPOLL_CTL_ADD, cfd, &ev))
+					error(1, errno, "epoll_ctl");
+				continue;
+			}
+
+			while ((ret = read(cfd, buf, sizeof(buf))) > 0)
+				;
+			if (!ret || errno != EAGAIN)
+				close(cfd);
+		}
+	}
+}
+
+static void do_tx(void)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(cfg_port),
+	};
+	unsigned int rate = cfg_rate_mbit * 1000000U / 8;
+	struct epoll_event ev, events[64];
+	unsigned long long bytes = 0;
+	double start, end;
+	int efd, i, n;
+
+	if (inet_pton(AF_INET, cfg_addr, &addr.sin_addr) != 1)
+		error(1, 0, "bad address %s", cfg_addr);
+
+	efd = epoll_create1(0);
+	if (efd < 0)
+		error(1, errno, "epoll_create");
+
+	for (i = 0; i < cfg_flows; i++) {
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+		if (fd < 0)
+			error(1, errno, "socket");
+		if (cfg_cc && setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION,
+					 cfg_cc, strlen(cfg_cc)))
+			error(1, errno, "TCP_CONGESTION %s", cfg_cc);
+		if (rate && setsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE,
+				       &rate, sizeof(rate)))
+			error(1, errno, "SO_MAX_PACING_RATE");
+		if (connect(fd, (void *)&addr, sizeof(addr)))
+			error(1, errno, "connect");
+		fcntl(fd, F_SETFL, O_NONBLOCK);
+
+		ev.events = EPOLLOUT;
+		ev.data.fd = fd;
+		if (epoll_ctl(efd, EPOLL_CTL_ADD, fd, &ev))
+			error(1, errno, "epoll_ctl");
+	}
+
+	start = now();
+	end = start + cfg_duration;
+	while (now() < end) {
+		n = epoll_wait(efd, events, 64, 100);
+		if (n < 0)
+			error(1, errno, "epoll_wait");
+
+		for (i = 0; i < n; i++) {
+			int ret = write(events[i].data.fd, buf, sizeof(buf));
+
+			if (ret < 0 && errno != EAGAIN)
+				error(1, errno, "write");
+			if (ret > 0)
+				bytes += ret;
+		}
+	}
+	end = now();
+
+	printf("tcp tx: %d flows %8.3f Gbit/s\n", cfg_flows,
+	       bytes * 8 / (end - start) / 1e9);
+}
+
+static void parse_opts(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "rD:p:n:R:C:t:")) != -1) {
+		switch (c) {
+		case 'r':
+			cfg_rx = true;
+			break;
+		case 'D':
+			cfg_addr = optarg;
+			break;
+		case 'p':
+			cfg_port = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			cfg_flows = strtoul(optarg, NULL, 0);
+			break;
+		case 'R':
+			cfg_rate_mbit = strtoul(optarg, NULL, 0);
+			break;
+		case 'C':
+			cfg_cc = optarg;
+			break;
+		case 't':
+			cfg_duration = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			error(1, 0, "usage: %s -r | -D addr [-n flows] [-R Mbit/s] [-C cc] [-t seconds]",
+			      argv[0]);
+		}
+	}
+
+	if (!cfg_rx && !cfg_addr)
+		error(1, 0, "either -r or -D addr is required");
+	if (cfg_flows < 1 || cfg_flows > MAX_FLOWS)
+		error(1, 0, "flows must be 1..%d", MAX_FLOWS);
+}
+
+int main(int argc, char **argv)
+{
+	parse_opts(argc, argv);
+
+	if (cfg_rx)
+		do_rx();
+	else
+		do_tx();
+
+	return 0;
+}
@@ -0,0 +1,89 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Many internally paced TCP flows between two network namespaces over
+# veth. Reports the goodput, the local timer interrupt rate and the CPU
+# time spent per Gbit/s while the flows run.
+#
+# Usage: tcp_pacing_bench.sh [flows] [Mbit/s per flow] [congestion control]
+
+# Kselftest framework requirement - SKIP code is 4.
+ksft_skip=4
+
+flows=${1:-200}
+rate=${2:-10}
+cc=${3:-bbr}
+duration=5
+
+NS_A="ns-$(mktemp -u XXXXXX)"
+NS_B="ns-$(mktemp -u XXXXXX)"
+ns_a="ip netns exec ${NS_A}"
+ns_b="ip netns exec ${NS_B}"
+
+veth_a_addr="192.168.1.1"
+veth_b_addr="192.168.1.2"
+
+cleanup() {
+	local -r jobs="$(jobs -p)"
+
+	if [[ "${jobs}" != "" ]]; then
+		kill ${jobs} 2>/dev/null
+		wait 2>/dev/null
+	fi
+	ip netns del ${NS_A} 2>/dev/null
+	ip netns del ${NS_B} 2>/dev/null
+}
+trap cleanup EXIT
+
+setup() {
+	ip netns add ${NS_A} || return 1
+	ip netns add ${NS_B} || return 1
+
+	${ns_a} ip link add veth_a type veth peer name veth_b || return 1
+	${ns_a} ip link set veth_b netns ${NS_B}
+	${ns_a} ip addr add ${veth_a_addr}/24 dev veth_a
+	${ns_b} ip addr add ${veth_b_addr}/24 dev veth_b
+	${ns_a} ip link set veth_a up
+	${ns_b} ip link set veth_b up
+}
+
+# Local timer interrupts summed over all cpus: LOC on x86, the arch
+# timer on arm64.
+timer_irqs() {
+	awk '/^ *LOC:|arch_timer/ { for (i = 2; i <= NF && $i ~ /^[0-9]+$/; i++)
+					     n += $i }
+	     END { print n + 0 }' /proc/interrupts
+}
+
+# Busy jiffies summed over all cpus
+busy_ticks() {
+	awk '/^cpu / { print $2 + $3 + $4 + $7 + $8 }' /proc/stat
+}
+
+if [ "$(id -u)" -ne 0 ]; then
+	echo "SKIP: need root privileges"
+	exit ${ksft_skip}
+fi
+
+if ! setup; then
+	echo "SKIP: could not set up veth pair"
+	exit ${ksft_skip}
+fi
+
+${ns_b} ./tcp_pacing_bench -r &
+sleep 0.2
+
+irqs=$(timer_irqs)
+ticks=$(busy_ticks)
+out="$(${ns_a} ./tcp_pacing_bench -D ${veth_b_addr} -n ${flows} -R ${rate} \
+	-C ${cc} -t ${duration})" || exit 1
+irqs=$(( $(timer_irqs) - irqs ))
+ticks=$(( $(busy_ticks) - ticks ))
+
+echo "${out}"
+echo "${out}" | awk -v irqs=${irqs} -v ticks=${ticks} -v hz=$(getconf CLK_TCK) \
+		       -v t=${duration} '/tcp tx:/ {
+	printf("  timer irqs: %d/s\n", irqs / t);
+	if ($5 > 0)
+		printf("  cpu: %.3f cpu-seconds/s per Gbit/s\n", ticks / hz / t / $5);
+}'
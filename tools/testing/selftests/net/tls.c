@@ -9,8 +9,10 @@
 #include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <linux/if_alg.h>
 #include <linux/tls.h>
 #include <linux/tcp.h>
 #include <linux/socket.h>
@@ -19,12 +21,322 @@
 #include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 
 #include "../kselftest_harness.h"
 
 #define TLS_PAYLOAD_MAX_LEN 16384
 #define SOL_TLS 282
 
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#endif
+
+#ifndef SOL_ALG
+#define SOL_ALG 279
+#endif
+
+#define TLS_HDR_LEN 5
+#define TLS_TAG_LEN 16
+#define TLS_NONCE_LEN 12
+#define TLS_RECORD_TYPE_DATA 0x17
+
+struct tls_crypto_info_keys {
+	union {
+		struct tls_crypto_info info;
+		struct tls12_crypto_info_aes_gcm_128 aes128;
+		struct tls12_crypto_info_aes_gcm_256 aes256;
+		struct tls12_crypto_info_chacha20_poly1305 chacha20;
+	};
+	size_t len;
+	/* The same key material in the layout used by AF_ALG */
+	unsigned char *key;
+	int key_len;
+	unsigned char *salt;
+	int salt_len;
+	unsigned char nonce[TLS_NONCE_LEN];
+};
+
+static const struct tls_cipher {
+	const char *name;
+	uint16_t cipher_type;
+	const char *alg;
+} tls_ciphers[] = {
+	{ "aes-gcm-128", TLS_CIPHER_AES_GCM_128, "gcm(aes)" },
+	{ "aes-gcm-256", TLS_CIPHER_AES_GCM_256, "gcm(aes)" },
+	{ "chacha20-poly1305", TLS_CIPHER_CHACHA20_POLY1305,
+	  "rfc7539(chacha20,poly1305)" },
+};
+
+static void tls_crypto_info_init(uint16_t tls_version, uint16_t cipher_type,
+				 struct tls_crypto_info_keys *keys)
+{
+	unsigned char *iv;
+	int iv_len;
+
+	memset(keys, 0, sizeof(*keys));
+
+	switch (cipher_type) {
+	case TLS_CIPHER_AES_GCM_128:
+		keys->len = sizeof(keys->aes128);
+		keys->key = keys->aes128.key;
+		keys->key_len = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+		keys->salt = keys->aes128.salt;
+		keys->salt_len = TLS_CIPHER_AES_GCM_128_SALT_SIZE;
+		iv = keys->aes128.iv;
+		iv_len = TLS_CIPHER_AES_GCM_128_IV_SIZE;
+		break;
+	case TLS_CIPHER_AES_GCM_256:
+		keys->len = sizeof(keys->aes256);
+		keys->key = keys->aes256.key;
+		keys->key_len = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+		keys->salt = keys->aes256.salt;
+		keys->salt_len = TLS_CIPHER_AES_GCM_256_SALT_SIZE;
+		iv = keys->aes256.iv;
+		iv_len = TLS_CIPHER_AES_GCM_256_IV_SIZE;
+		break;
+	case TLS_CIPHER_CHACHA20_POLY1305:
+		keys->len = sizeof(keys->chacha20);
+		keys->key = keys->chacha20.key;
+		keys->key_len = TLS_CIPHER_CHACHA20_POLY1305_KEY_SIZE;
+		keys->salt = keys->chacha20.salt;
+		keys->salt_len = TLS_CIPHER_CHACHA20_POLY1305_SALT_SIZE;
+		iv = keys->chacha20.iv;
+		iv_len = TLS_CIPHER_CHACHA20_POLY1305_IV_SIZE;
+		break;
+	default:
+		return;
+	}
+
+	keys->info.version = tls_version;
+	keys->info.cipher_type = cipher_type;
+
+	memset(keys->key, 0x11, keys->key_len);
+	memset(keys->salt, 0x22, keys->salt_len);
+	memset(iv, 0x33, iv_len);
+
+	memcpy(keys->nonce, keys->salt, keys->salt_len);
+	memcpy(keys->nonce + keys->salt_len, iv, iv_len);
+}
+
+/* Connect a TCP socket pair over loopback. When keys is set, fd gets the
+ * TLS TX state and cfd the TLS RX state. Returns -1 if kTLS is unavailable.
+ */
+static int tls_pair(int *fd, int *cfd, struct tls_crypto_info_keys *keys)
+{
+	struct sockaddr_in addr;
+	socklen_t len;
+	int sfd;
+
+	len = sizeof(addr);
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+
+	*fd = socket(AF_INET, SOCK_STREAM, 0);
+	sfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (*fd < 0 || sfd < 0)
+		return -1;
+
+	if (bind(sfd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    listen(sfd, 10) ||
+	    getsockname(sfd, (struct sockaddr *)&addr, &len) ||
+	    connect(*fd, (struct sockaddr *)&addr, sizeof(addr)))
+		return -1;
+
+	*cfd = accept(sfd, (struct sockaddr *)&addr, &len);
+	close(sfd);
+	if (*cfd < 0)
+		return -1;
+
+	if (!keys)
+		return 0;
+
+	if (setsockopt(*fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) ||
+	    setsockopt(*fd, SOL_TLS, TLS_TX, keys, keys->len) ||
+	    setsockopt(*cfd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) ||
+	    setsockopt(*cfd, SOL_TLS, TLS_RX, keys, keys->len)) {
+		close(*fd);
+		close(*cfd);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* User space TLS 1.3 record protection on top of AF_ALG */
+struct tls_us_ctx {
+	int tfm, op;
+	unsigned char nonce[TLS_NONCE_LEN];
+	uint64_t seq;
+};
+
+static int tls_us_init(struct tls_us_ctx *us, const char *alg,
+		       struct tls_crypto_info_keys *keys)
+{
+	struct sockaddr_alg sa = {
+		.salg_family = AF_ALG,
+		.salg_type = "aead",
+	};
+
+	strcpy((char *)sa.salg_name, alg);
+	memcpy(us->nonce, keys->nonce, TLS_NONCE_LEN);
+	us->seq = 0;
+
+	us->tfm = socket(AF_ALG, SOCK_SEQPACKET, 0);
+	if (us->tfm < 0)
+		return -1;
+
+	if (bind(us->tfm, (struct sockaddr *)&sa, sizeof(sa)) ||
+	    setsockopt(us->tfm, SOL_ALG, ALG_SET_KEY, keys->key,
+		       keys->key_len) ||
+	    setsockopt(us->tfm, SOL_ALG, ALG_SET_AEAD_AUTHSIZE, NULL,
+		       TLS_TAG_LEN)) {
+		close(us->tfm);
+		return -1;
+	}
+
+	us->op = accept(us->tfm, NULL, 0);
+	if (us->op < 0) {
+		close(us->tfm);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void tls_us_close(struct tls_us_ctx *us)
+{
+	close(us->op);
+	close(us->tfm);
+}
+
+/* Runs one AEAD operation over hdr || in. The output, written to out,
+ * starts with a copy of the record header.
+ */
+static int tls_us_crypt(struct tls_us_ctx *us, int op, unsigned char *hdr,
+			void *in, int in_len, void *out, int out_len)
+{
+	char cbuf[CMSG_SPACE(sizeof(__u32)) +
+		  CMSG_SPACE(sizeof(struct af_alg_iv) + TLS_NONCE_LEN) +
+		  CMSG_SPACE(sizeof(__u32))] = {};
+	struct iovec iov[2] = {
+		{ .iov_base = hdr, .iov_len = TLS_HDR_LEN },
+		{ .iov_base = in, .iov_len = in_len },
+	};
+	struct msghdr msg = {
+		.msg_control = cbuf,
+		.msg_controllen = sizeof(cbuf),
+		.msg_iov = iov,
+		.msg_iovlen = 2,
+	};
+	struct af_alg_iv *alg_iv;
+	struct cmsghdr *cmsg;
+	int i;
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_ALG;
+	cmsg->cmsg_type = ALG_SET_OP;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(__u32));
+	*(__u32 *)CMSG_DATA(cmsg) = op;
+
+	cmsg = CMSG_NXTHDR(&msg, cmsg);
+	cmsg->cmsg_level = SOL_ALG;
+	cmsg->cmsg_type = ALG_SET_IV;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(*alg_iv) + TLS_NONCE_LEN);
+	alg_iv = (struct af_alg_iv *)CMSG_DATA(cmsg);
+	alg_iv->ivlen = TLS_NONCE_LEN;
+	memcpy(alg_iv->iv, us->nonce, TLS_NONCE_LEN);
+	for (i = 0; i < 8; i++)
+		alg_iv->iv[TLS_NONCE_LEN - 1 - i] ^= us->seq >> (8 * i);
+
+	cmsg = CMSG_NXTHDR(&msg, cmsg);
+	cmsg->cmsg_level = SOL_ALG;
+	cmsg->cmsg_type = ALG_SET_AEAD_ASSOCLEN;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(__u32));
+	*(__u32 *)CMSG_DATA(cmsg) = TLS_HDR_LEN;
+
+	if (sendmsg(us->op, &msg, 0) != TLS_HDR_LEN + in_len)
+		return -1;
+
+	us->seq++;
+	return read(us->op, out, out_len);
+}
+
+/* Builds a TLS 1.3 record of the given type with pad bytes of zero padding
+ * into rec. Returns the record length.
+ */
+static int tls_us_seal(struct tls_us_ctx *us, unsigned char type,
+		       const void *data, int len, int pad, unsigned char *rec,
+		       unsigned char *scratch)
+{
+	int inner_len = len + 1 + pad;
+	int rec_len = inner_len + TLS_TAG_LEN;
+
+	rec[0] = TLS_RECORD_TYPE_DATA;
+	rec[1] = 0x3;
+	rec[2] = 0x3;
+	rec[3] = rec_len >> 8;
+	rec[4] = rec_len & 0xff;
+
+	memcpy(scratch, data, len);
+	scratch[len] = type;
+	memset(scratch + len + 1, 0, pad);
+
+	if (tls_us_crypt(us, ALG_OP_ENCRYPT, rec, scratch, inner_len, rec,
+			 TLS_HDR_LEN + rec_len) != TLS_HDR_LEN + rec_len)
+		return -1;
+
+	return TLS_HDR_LEN + rec_len;
+}
+
+static int recv_all(int fd, void *buf, int len)
+{
+	int got = 0, ret;
+
+	while (got < len) {
+		ret = recv(fd, (char *)buf + got, len - got, 0);
+		if (ret <= 0)
+			return -1;
+		got += ret;
+	}
+
+	return got;
+}
+
+/* Reads one TLS 1.3 record from fd and decrypts it into data. Returns the
+ * payload length and sets *type to the inner record type.
+ */
+static int tls_us_open(struct tls_us_ctx *us, int fd, unsigned char *type,
+		       unsigned char *rec, unsigned char *data)
+{
+	int rec_len, len;
+
+	if (recv_all(fd, rec, TLS_HDR_LEN) != TLS_HDR_LEN)
+		return -1;
+
+	rec_len = (rec[3] << 8) | rec[4];
+	if (rec_len < TLS_TAG_LEN + 1 ||
+	    recv_all(fd, rec + TLS_HDR_LEN, rec_len) != rec_len)
+		return -1;
+
+	len = tls_us_crypt(us, ALG_OP_DECRYPT, rec, rec + TLS_HDR_LEN,
+			   rec_len, data, rec_len - TLS_TAG_LEN + TLS_HDR_LEN);
+	if (len != rec_len - TLS_TAG_LEN + TLS_HDR_LEN)
+		return -1;
+
+	/* Skip the header copy and strip the padding */
+	len -= TLS_HDR_LEN;
+	memmove(data, data + TLS_HDR_LEN, len);
+	while (len > 0 && !data[len - 1])
+		len--;
+	if (!len)
+		return -1;
+
+	*type = data[--len];
+	return len;
+}
+
 FIXTURE(tls)
 {
 	int fd, cfd;
@@ -139,6 +451,31 @@ TEST_F(tls, recv_max)
 	EXPECT_EQ(memcmp(buf, recv_mem, send_len), 0);
 }
 
+TEST_F(tls, recv_many_records)
+{
+	unsigned int send_len = TLS_PAYLOAD_MAX_LEN * 8;
+	char *recv_mem = malloc(send_len);
+	char *buf = malloc(send_len);
+	int i;
+
+	ASSERT_NE(recv_mem, NULL);
+	ASSERT_NE(buf, NULL);
+	for (i = 0; i < send_len; i++)
+		buf[i] = i / TLS_PAYLOAD_MAX_LEN + i;
+
+	/* Several records queued at once are decrypted and returned in
+	 * sequence by a single recv.
+	 */
+	for (i = 0; i < 8; i++)
+		EXPECT_EQ(send(self->fd, buf + i * TLS_PAYLOAD_MAX_LEN,
+			       TLS_PAYLOAD_MAX_LEN, 0), TLS_PAYLOAD_MAX_LEN);
+	EXPECT_EQ(recv(self->cfd, recv_mem, send_len, MSG_WAITALL), send_len);
+	EXPECT_EQ(memcmp(buf, recv_mem, send_len), 0);
+
+	free(recv_mem);
+	free(buf);
+}
+
 TEST_F(tls, recv_small)
 {
 	char const *test_str = "test_read";
@@ -738,4 +1075,353 @@ TEST_F(tls, control_msg)
 	EXPECT_EQ(memcmp(buf, test_str, send_len), 0);
 }
 
+TEST(ciphers)
+{
+	uint16_t versions[] = { TLS_1_2_VERSION, TLS_1_3_VERSION };
+	struct tls_crypto_info_keys keys, tx;
+	char cbuf[CMSG_SPACE(sizeof(char))];
+	char *buf, *rbuf;
+	int i, j, fd, cfd;
+
+	buf = malloc(TLS_PAYLOAD_MAX_LEN * 2);
+	rbuf = malloc(TLS_PAYLOAD_MAX_LEN * 2);
+	ASSERT_NE(buf, NULL);
+	ASSERT_NE(rbuf, NULL);
+	for (i = 0; i < TLS_PAYLOAD_MAX_LEN * 2; i++)
+		buf[i] = rand();
+
+	for (i = 0; i < ARRAY_SIZE(versions); i++) {
+		for (j = 0; j < ARRAY_SIZE(tls_ciphers); j++) {
+			struct cmsghdr *cmsg;
+			struct msghdr msg;
+			struct iovec vec;
+			socklen_t optlen;
+
+			tls_crypto_info_init(versions[i],
+					     tls_ciphers[j].cipher_type, &keys);
+			if (tls_pair(&fd, &cfd, &keys)) {
+				printf("%s v%x: kTLS unavailable, skipping\n",
+				       tls_ciphers[j].name, versions[i]);
+				continue;
+			}
+
+			/* Small and full sized records */
+			EXPECT_EQ(send(fd, buf, 10, 0), 10);
+			EXPECT_EQ(recv(cfd, rbuf, 10, MSG_WAITALL), 10);
+			EXPECT_EQ(memcmp(buf, rbuf, 10), 0);
+
+			EXPECT_EQ(send(fd, buf, TLS_PAYLOAD_MAX_LEN * 2, 0),
+				  TLS_PAYLOAD_MAX_LEN * 2);
+			EXPECT_EQ(recv(cfd, rbuf, TLS_PAYLOAD_MAX_LEN * 2,
+				       MSG_WAITALL), TLS_PAYLOAD_MAX_LEN * 2);
+			EXPECT_EQ(memcmp(buf, rbuf, TLS_PAYLOAD_MAX_LEN * 2),
+				  0);
+
+			/* Non-data record types round trip */
+			vec.iov_base = buf;
+			vec.iov_len = 10;
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_iov = &vec;
+			msg.msg_iovlen = 1;
+			msg.msg_control = cbuf;
+			msg.msg_controllen = sizeof(cbuf);
+			cmsg = CMSG_FIRSTHDR(&msg);
+			cmsg->cmsg_level = SOL_TLS;
+			cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(char));
+			*CMSG_DATA(cmsg) = 100;
+			msg.msg_controllen = cmsg->cmsg_len;
+			EXPECT_EQ(sendmsg(fd, &msg, 0), 10);
+
+			vec.iov_base = rbuf;
+			msg.msg_controllen = sizeof(cbuf);
+			EXPECT_EQ(recvmsg(cfd, &msg, 0), 10);
+			cmsg = CMSG_FIRSTHDR(&msg);
+			EXPECT_NE(cmsg, NULL);
+			EXPECT_EQ(cmsg->cmsg_type, TLS_GET_RECORD_TYPE);
+			EXPECT_EQ(*(unsigned char *)CMSG_DATA(cmsg), 100);
+			EXPECT_EQ(memcmp(buf, rbuf, 10), 0);
+
+			/* The key material reads back unchanged. The IV and
+			 * record sequence have moved on with the records sent.
+			 */
+			optlen = keys.len;
+			memset(&tx, 0, sizeof(tx));
+			EXPECT_EQ(getsockopt(fd, SOL_TLS, TLS_TX, &tx,
+					     &optlen), 0);
+			EXPECT_EQ(optlen, keys.len);
+			EXPECT_EQ(tx.info.version, keys.info.version);
+			EXPECT_EQ(tx.info.cipher_type, keys.info.cipher_type);
+			EXPECT_EQ(memcmp((char *)&tx +
+					 (keys.key - (unsigned char *)&keys),
+					 keys.key, keys.key_len), 0);
+			EXPECT_EQ(memcmp((char *)&tx +
+					 (keys.salt - (unsigned char *)&keys),
+					 keys.salt, keys.salt_len), 0);
+
+			close(fd);
+			close(cfd);
+		}
+	}
+
+	free(buf);
+	free(rbuf);
+}
+
+TEST(tls13_bad_crypto_info)
+{
+	struct tls_crypto_info_keys keys;
+	int fd, cfd;
+
+	tls_crypto_info_init(TLS_1_3_VERSION, TLS_CIPHER_AES_GCM_128, &keys);
+	if (tls_pair(&fd, &cfd, NULL))
+		return;
+
+	if (setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")))
+		goto out;
+
+	/* A TLS 1.3 key with a TLS 1.2 size is rejected */
+	keys.info.version = TLS_1_3_VERSION;
+	EXPECT_EQ(setsockopt(fd, SOL_TLS, TLS_TX, &keys, keys.len - 1), -1);
+	keys.info.version = 0x0305;
+	EXPECT_EQ(setsockopt(fd, SOL_TLS, TLS_TX, &keys, keys.len), -1);
+	EXPECT_EQ(errno, EINVAL);
+out:
+	close(fd);
+	close(cfd);
+}
+
+/* Put cryptd in front of gcm(aes). The instance registers under the same
+ * name at a higher priority, so kTLS sockets set up afterwards decrypt
+ * asynchronously and several records are in flight in one recvmsg().
+ */
+TEST(async_decrypt)
+{
+	struct sockaddr_alg sa = {
+		.salg_family = AF_ALG,
+		.salg_type = "aead",
+		.salg_name = "cryptd(gcm(aes))",
+	};
+	int len = TLS_PAYLOAD_MAX_LEN * 8;
+	struct tls_crypto_info_keys keys;
+	char *buf, *rbuf;
+	int i, tfm, fd, cfd;
+
+	tfm = socket(AF_ALG, SOCK_SEQPACKET, 0);
+	if (tfm < 0 || bind(tfm, (struct sockaddr *)&sa, sizeof(sa))) {
+		printf("cryptd unavailable, skipping\n");
+		if (tfm >= 0)
+			close(tfm);
+		return;
+	}
+
+	buf = malloc(len);
+	rbuf = malloc(len);
+	ASSERT_NE(buf, NULL);
+	ASSERT_NE(rbuf, NULL);
+	for (i = 0; i < len; i++)
+		buf[i] = rand();
+
+	tls_crypto_info_init(TLS_1_2_VERSION, TLS_CIPHER_AES_GCM_128, &keys);
+	if (tls_pair(&fd, &cfd, &keys)) {
+		printf("kTLS unavailable, skipping\n");
+		goto out;
+	}
+
+	/* More than one batch, so the reader's count is re-armed in between */
+	for (i = 0; i < 4; i++) {
+		memset(rbuf, 0, len);
+		EXPECT_EQ(send(fd, buf, len, 0), len);
+		EXPECT_EQ(recv(cfd, rbuf, len, MSG_WAITALL), len);
+		EXPECT_EQ(memcmp(buf, rbuf, len), 0);
+	}
+
+	/* A batch cut short by a short read */
+	EXPECT_EQ(send(fd, buf, len, 0), len);
+	EXPECT_EQ(recv(cfd, rbuf, TLS_PAYLOAD_MAX_LEN * 3, MSG_WAITALL),
+		  TLS_PAYLOAD_MAX_LEN * 3);
+	EXPECT_EQ(recv(cfd, rbuf + TLS_PAYLOAD_MAX_LEN * 3,
+		       len - TLS_PAYLOAD_MAX_LEN * 3, MSG_WAITALL),
+		  len - TLS_PAYLOAD_MAX_LEN * 3);
+	EXPECT_EQ(memcmp(buf, rbuf, len), 0);
+
+	close(fd);
+	close(cfd);
+out:
+	free(buf);
+	free(rbuf);
+	close(tfm);
+}
+
+/* Check kTLS against an independent TLS 1.3 record implementation built on
+ * AF_ALG, in both directions.
+ */
+TEST(tls13_interop)
+{
+	unsigned char rec[TLS_PAYLOAD_MAX_LEN + 256];
+	unsigned char data[TLS_PAYLOAD_MAX_LEN + 256];
+	unsigned char scratch[TLS_PAYLOAD_MAX_LEN + 256];
+	char const *test_str = "tls13_interop";
+	int len = strlen(test_str) + 1;
+	struct tls_crypto_info_keys keys;
+	struct tls_us_ctx us;
+	unsigned char type;
+	int i, fd, cfd, ret;
+
+	for (i = 0; i < ARRAY_SIZE(tls_ciphers); i++) {
+		tls_crypto_info_init(TLS_1_3_VERSION,
+				     tls_ciphers[i].cipher_type, &keys);
+
+		if (tls_us_init(&us, tls_ciphers[i].alg, &keys)) {
+			printf("%s: AF_ALG unavailable, skipping\n",
+			       tls_ciphers[i].name);
+			continue;
+		}
+
+		/* kTLS TX to user space RX */
+		ASSERT_EQ(tls_pair(&fd, &cfd, NULL), 0);
+		if (setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) ||
+		    setsockopt(fd, SOL_TLS, TLS_TX, &keys, keys.len)) {
+			printf("%s: kTLS unavailable, skipping\n",
+			       tls_ciphers[i].name);
+			goto next;
+		}
+
+		EXPECT_EQ(send(fd, test_str, len, 0), len);
+		ret = tls_us_open(&us, cfd, &type, rec, data);
+		EXPECT_EQ(ret, len);
+		EXPECT_EQ(type, TLS_RECORD_TYPE_DATA);
+		EXPECT_EQ(memcmp(data, test_str, len), 0);
+		close(fd);
+		close(cfd);
+
+		/* User space TX, with record padding, to kTLS RX */
+		tls_us_close(&us);
+		ASSERT_EQ(tls_us_init(&us, tls_ciphers[i].alg, &keys), 0);
+		ASSERT_EQ(tls_pair(&fd, &cfd, NULL), 0);
+		ASSERT_EQ(setsockopt(cfd, IPPROTO_TCP, TCP_ULP, "tls",
+				     sizeof("tls")), 0);
+		ASSERT_EQ(setsockopt(cfd, SOL_TLS, TLS_RX, &keys, keys.len), 0);
+
+		ret = tls_us_seal(&us, TLS_RECORD_TYPE_DATA, test_str, len, 3,
+				  rec, scratch);
+		ASSERT_GT(ret, 0);
+		EXPECT_EQ(send(fd, rec, ret, 0), ret);
+		memset(data, 0, sizeof(data));
+		EXPECT_EQ(recv(cfd, data, sizeof(data), 0), len);
+		EXPECT_EQ(memcmp(data, test_str, len), 0);
+next:
+		close(fd);
+		close(cfd);
+		tls_us_close(&us);
+	}
+}
+
+#define TLS_BENCH_BYTES (32 << 20)
+#define TLS_BENCH_CHUNK TLS_PAYLOAD_MAX_LEN
+
+static double tls_bench_elapsed(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) +
+	       (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Transfers TLS_BENCH_BYTES over loopback TLS 1.3, framed and encrypted
+ * either by kTLS or in user space via AF_ALG. Returns MB/s or a negative
+ * value if the mode is not available.
+ */
+static double tls_bench(const struct tls_cipher *cipher, bool ktls)
+{
+	static unsigned char rec[TLS_BENCH_CHUNK + 256];
+	static unsigned char data[TLS_BENCH_CHUNK + 256];
+	static unsigned char scratch[TLS_BENCH_CHUNK + 256];
+	struct tls_crypto_info_keys keys;
+	struct timespec start;
+	struct tls_us_ctx us;
+	unsigned char type;
+	long done = 0;
+	int fd, cfd, ret, status;
+	double secs;
+	pid_t pid;
+
+	tls_crypto_info_init(TLS_1_3_VERSION, cipher->cipher_type, &keys);
+	if (tls_pair(&fd, &cfd, ktls ? &keys : NULL))
+		return -1;
+
+	memset(data, 0xa5, sizeof(data));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	pid = fork();
+	if (pid < 0)
+		return -1;
+
+	if (!pid) {
+		close(fd);
+		if (!ktls && tls_us_init(&us, cipher->alg, &keys))
+			exit(1);
+		while (done < TLS_BENCH_BYTES) {
+			if (ktls)
+				ret = recv(cfd, data, TLS_BENCH_CHUNK, 0);
+			else
+				ret = tls_us_open(&us, cfd, &type, rec, data);
+			if (ret <= 0)
+				exit(1);
+			done += ret;
+		}
+		exit(0);
+	}
+
+	close(cfd);
+	if (!ktls && tls_us_init(&us, cipher->alg, &keys)) {
+		close(fd);
+		waitpid(pid, &status, 0);
+		return -1;
+	}
+
+	while (done < TLS_BENCH_BYTES) {
+		if (ktls) {
+			ret = send(fd, data, TLS_BENCH_CHUNK, 0);
+		} else {
+			ret = tls_us_seal(&us, TLS_RECORD_TYPE_DATA, data,
+					  TLS_BENCH_CHUNK, 0, rec, scratch);
+			if (ret > 0 && send(fd, rec, ret, 0) == ret)
+				ret = TLS_BENCH_CHUNK;
+			else
+				ret = -1;
+		}
+		if (ret <= 0)
+			break;
+		done += ret;
+	}
+
+	if (!ktls)
+		tls_us_close(&us);
+	close(fd);
+	waitpid(pid, &status, 0);
+	secs = tls_bench_elapsed(&start);
+
+	if (done < TLS_BENCH_BYTES || !WIFEXITED(status) ||
+	    WEXITSTATUS(status))
+		return -1;
+
+	return TLS_BENCH_BYTES / secs / (1 << 20);
+}
+
+TEST(tls13_throughput)
+{
+	double ktls, user;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tls_ciphers); i++) {
+		ktls = tls_bench(&tls_ciphers[i], true);
+		user = tls_bench(&tls_ciphers[i], false);
+
+		printf("TLS 1.3 %-18s kTLS: %8.1f MB/s  user space: %8.1f MB/s\n",
+		       tls_ciphers[i].name, ktls, user);
+	}
+}
+
 TEST_HARNESS_MAIN
@@ -0,0 +1,473 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Throughput of a user space VPN style tun device user, in both
+ * directions.
+ *
+ * Ingress: UDP packets are written to tun and delivered to a local UDP
+ * socket, either one write() per packet, in TUNSENDMMSG batches, or as
+ * UDP segmentation offload (USO) super-packets.
+ *
+ * Egress: a local UDP socket sends to the tun subnet and the packets are
+ * taken off tun, one read() per packet or in TUNRECVMMSG batches. With
+ * UDP_SEGMENT on the sender, the USO super-packets must come out of tun
+ * whole, described by the virtio_net_hdr.
+ *
+ * Needs CAP_NET_ADMIN.
+ *
+ * Usage: tun_uso_bench [-t seconds per mode] [-s segment size]
+ */
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <error.h>
+#include <fcntl.h>
+#include <linux/if_tun.h>
+#include <linux/virtio_net.h>
+#include <net/if.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TUN_ADDR	"10.211.0.1"
+#define PEER_ADDR	"10.211.0.2"
+#define DST_PORT	9000
+#define SRC_PORT	9001
+
+#define HDR_LEN		(sizeof(struct iphdr) + sizeof(struct udphdr))
+#define MAX_SEGS	44
+#define BATCH		64
+#define MAX_PKT		(sizeof(struct virtio_net_hdr) + HDR_LEN + 65507)
+
+#ifndef SOL_UDP
+#define SOL_UDP		17
+#endif
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT	103
+#endif
+
+static int cfg_duration = 2;
+static int cfg_seg_size = 1200;
+
+static volatile bool stop, tx_stop;
+static unsigned long rx_bytes, rx_dgrams;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t csum_add(uint32_t sum, const void *data, int len)
+{
+	const uint16_t *p = data;
+
+	while (len > 1) {
+		sum += *p++;
+		len -= 2;
+	}
+	if (len)
+		sum += *(const uint8_t *)p;
+	return sum;
+}
+
+static uint16_t csum_fold(uint32_t sum)
+{
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return sum;
+}
+
+/* Build vnet header + IPv4 + UDP header + payload for nsegs segments
+ * into buf. Returns the total length.
+ */
+static int build_packet(char *buf, int nsegs)
+{
+	struct virtio_net_hdr *vh = (void *)buf;
+	struct iphdr *iph = (void *)(vh + 1);
+	struct udphdr *uh = (void *)(iph + 1);
+	int payload = nsegs * cfg_seg_size;
+	uint32_t sum;
+
+	memset(vh, 0, sizeof(*vh));
+	memset(iph, 0, sizeof(*iph));
+
+	iph->version = 4;
+	iph->ihl = 5;
+	iph->ttl = 64;
+	iph->protocol = IPPROTO_UDP;
+	iph->tot_len = htons(HDR_LEN + payload);
+	iph->saddr = inet_addr(PEER_ADDR);
+	iph->daddr = inet_addr(TUN_ADDR);
+	iph->check = ~csum_fold(csum_add(0, iph, sizeof(*iph)));
+
+	uh->source = htons(SRC_PORT);
+	uh->dest = htons(DST_PORT);
+	uh->len = htons(sizeof(*uh) + payload);
+	memset(uh + 1, 'a', payload);
+
+	if (nsegs > 1) {
+		/* The pseudo header sum only, segmentation completes it */
+		sum = csum_add(0, &iph->saddr, 8);
+		sum += htons(IPPROTO_UDP) + uh->len;
+		uh->check = csum_fold(sum);
+
+		vh->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+		vh->gso_type = VIRTIO_NET_HDR_GSO_UDP_L4;
+		vh->gso_size = cfg_seg_size;
+		vh->hdr_len = HDR_LEN;
+		vh->csum_start = sizeof(*iph);
+		vh->csum_offset = offsetof(struct udphdr, check);
+	} else {
+		/* No checksum, which is valid for UDP over IPv4 */
+		uh->check = 0;
+	}
+
+	return sizeof(*vh) + HDR_LEN + payload;
+}
+
+static int tun_open(char *ifname)
+{
+	unsigned int offload = TUN_F_CSUM | TUN_F_USO4 | TUN_F_USO6;
+	struct sockaddr_in *sin;
+	struct ifreq ifr;
+	int fd, sock;
+
+	fd = open("/dev/net/tun", O_RDWR);
+	if (fd < 0)
+		error(1, errno, "open /dev/net/tun");
+
+	memset(&ifr, 0, sizeof(ifr));
+	ifr.ifr_flags = IFF_TUN | IFF_NO_PI | IFF_VNET_HDR;
+	strcpy(ifr.ifr_name, "tunuso%d");
+	if (ioctl(fd, TUNSETIFF, &ifr))
+		error(1, errno, "TUNSETIFF");
+	strcpy(ifname, ifr.ifr_name);
+
+	if (ioctl(fd, TUNSETOFFLOAD, offload))
+		error(1, errno, "TUNSETOFFLOAD USO");
+
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sock < 0)
+		error(1, errno, "socket");
+
+	sin = (struct sockaddr_in *)&ifr.ifr_addr;
+	sin->sin_family = AF_INET;
+	sin->sin_addr.s_addr = inet_addr(TUN_ADDR);
+	if (ioctl(sock, SIOCSIFADDR, &ifr))
+		error(1, errno, "SIOCSIFADDR");
+
+	sin->sin_addr.s_addr = inet_addr("255.255.255.0");
+	if (ioctl(sock, SIOCSIFNETMASK, &ifr))
+		error(1, errno, "SIOCSIFNETMASK");
+
+	if (ioctl(sock, SIOCGIFFLAGS, &ifr))
+		error(1, errno, "SIOCGIFFLAGS");
+	ifr.ifr_flags |= IFF_UP | IFF_RUNNING;
+	if (ioctl(sock, SIOCSIFFLAGS, &ifr))
+		error(1, errno, "SIOCSIFFLAGS");
+
+	close(sock);
+	return fd;
+}
+
+static void *do_rx(void *arg)
+{
+	struct timeval tv = { .tv_usec = 100000 };
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(DST_PORT),
+	};
+	int rcvbuf = 1 << 24;
+	char buf[65536];
+	int fd, ret;
+
+	addr.sin_addr.s_addr = inet_addr(TUN_ADDR);
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		error(1, errno, "socket");
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf));
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	if (bind(fd, (void *)&addr, sizeof(addr)))
+		error(1, errno, "bind");
+
+	*(int *)arg = 1;
+	while (!stop) {
+		ret = recv(fd, buf, sizeof(buf), 0);
+		if (ret < 0) {
+			if (errno == EAGAIN)
+				continue;
+			error(1, errno, "recv");
+		}
+		__atomic_add_fetch(&rx_bytes, ret, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&rx_dgrams, 1, __ATOMIC_RELAXED);
+	}
+
+	close(fd);
+	return NULL;
+}
+
+/* Send to the tun subnet until told to stop, with UDP_SEGMENT when
+ * arg is non-zero.
+ */
+static void *do_tx(void *arg)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(DST_PORT),
+	};
+	static char buf[65507];
+	int sndbuf = 1 << 24;
+	int fd, gso, len;
+
+	gso = *(int *)arg;
+	len = gso ? MAX_SEGS * cfg_seg_size : cfg_seg_size;
+	memset(buf, 'a', len);
+	addr.sin_addr.s_addr = inet_addr(PEER_ADDR);
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		error(1, errno, "socket");
+	setsockopt(fd, SOL_SOCKET, SO_SNDBUFFORCE, &sndbuf, sizeof(sndbuf));
+	if (gso && setsockopt(fd, SOL_UDP, UDP_SEGMENT, &cfg_seg_size,
+			      sizeof(cfg_seg_size)))
+		error(1, errno, "UDP_SEGMENT");
+	if (connect(fd, (void *)&addr, sizeof(addr)))
+		error(1, errno, "connect");
+
+	while (!tx_stop) {
+		if (send(fd, buf, len, 0) < 0 &&
+		    errno != ENOBUFS && errno != EAGAIN)
+			error(1, errno, "send");
+	}
+
+	close(fd);
+	return NULL;
+}
+
+/* Account one packet read from tun, vnet header included. Returns true
+ * if it was a USO super-packet.
+ */
+static bool account_egress(const char *buf, int len, unsigned long *bytes,
+			   unsigned long *dgrams)
+{
+	const struct virtio_net_hdr *vh = (const void *)buf;
+	int payload = len - (int)(sizeof(*vh) + HDR_LEN);
+
+	if (payload < 0)
+		return false;
+
+	*bytes += payload;
+	if (vh->gso_type != VIRTIO_NET_HDR_GSO_UDP_L4) {
+		*dgrams += 1;
+		return false;
+	}
+
+	if (vh->gso_size != cfg_seg_size || vh->hdr_len != HDR_LEN ||
+	    !(vh->flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) ||
+	    vh->csum_start != sizeof(struct iphdr) ||
+	    vh->csum_offset != offsetof(struct udphdr, check))
+		error(1, 0, "bad USO virtio_net_hdr: gso_size %u hdr_len %u flags 0x%x csum %u+%u",
+		      vh->gso_size, vh->hdr_len, vh->flags, vh->csum_start,
+		      vh->csum_offset);
+
+	*dgrams += (payload + cfg_seg_size - 1) / cfg_seg_size;
+	return true;
+}
+
+enum mode {
+	MODE_WRITE, MODE_MMSG, MODE_USO,
+	MODE_READ, MODE_RECVMMSG, MODE_USO_EGRESS,
+};
+static const char * const mode_name[] = {
+	"write", "TUNSENDMMSG", "USO",
+	"read", "TUNRECVMMSG", "USO egress",
+};
+
+static void run_egress(int fd, enum mode mode)
+{
+	static char bufs[BATCH][MAX_PKT];
+	struct tun_packet pkts[BATCH] = {};
+	struct tun_mmsg mmsg = {
+		.packets = (uintptr_t)pkts,
+		.count = BATCH,
+	};
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	unsigned long bytes = 0, dgrams = 0, uso = 0;
+	int i, ret, gso = mode == MODE_USO_EGRESS;
+	double start, end;
+	pthread_t tx;
+
+	/* Drop anything left from earlier modes */
+	while (read(fd, bufs[0], MAX_PKT) > 0)
+		;
+
+	tx_stop = false;
+	if (pthread_create(&tx, NULL, do_tx, &gso))
+		error(1, errno, "pthread_create");
+
+	start = now();
+	end = start + cfg_duration;
+	while (now() < end) {
+		if (mode == MODE_READ) {
+			ret = read(fd, bufs[0], MAX_PKT);
+			if (ret > 0)
+				uso += account_egress(bufs[0], ret, &bytes,
+						      &dgrams);
+		} else {
+			for (i = 0; i < BATCH; i++) {
+				pkts[i].buf = (uintptr_t)bufs[i];
+				pkts[i].len = MAX_PKT;
+			}
+			ret = ioctl(fd, TUNRECVMMSG, &mmsg);
+			for (i = 0; i < ret; i++)
+				uso += account_egress(bufs[i], pkts[i].len,
+						      &bytes, &dgrams);
+		}
+
+		if (ret < 0) {
+			if (errno != EAGAIN)
+				error(1, errno, "%s", mode_name[mode]);
+			poll(&pfd, 1, 100);
+		}
+	}
+	end = now();
+
+	tx_stop = true;
+	pthread_join(tx, NULL);
+
+	if (gso && !uso)
+		error(1, 0, "no USO super-packets came out of tun");
+
+	printf("%-12s %10.0f datagrams/s %8.2f Gbit/s", mode_name[mode],
+	       dgrams / (end - start), bytes * 8 / (end - start) / 1e9);
+	if (gso)
+		printf(" %10.0f super-packets/s", uso / (end - start));
+	printf("\n");
+}
+
+static void run(int fd, enum mode mode)
+{
+	static char bufs[BATCH][MAX_PKT];
+	struct tun_packet pkts[BATCH] = {};
+	struct tun_mmsg mmsg = {
+		.packets = (uintptr_t)pkts,
+		.count = BATCH,
+	};
+	unsigned long bytes, dgrams;
+	double start, end;
+	int i, len;
+
+	len = build_packet(bufs[0], mode == MODE_USO ? MAX_SEGS : 1);
+	for (i = 1; i < BATCH; i++)
+		memcpy(bufs[i], bufs[0], len);
+
+	__atomic_store_n(&rx_bytes, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&rx_dgrams, 0, __ATOMIC_RELAXED);
+
+	start = now();
+	end = start + cfg_duration;
+	while (now() < end) {
+		switch (mode) {
+		case MODE_WRITE:
+		case MODE_USO:
+			for (i = 0; i < BATCH; i++)
+				if (write(fd, bufs[i], len) != len &&
+				    errno != ENOBUFS)
+					error(1, errno, "write");
+			break;
+		case MODE_MMSG:
+			for (i = 0; i < BATCH; i++) {
+				pkts[i].buf = (uintptr_t)bufs[i];
+				pkts[i].len = len;
+			}
+			if (ioctl(fd, TUNSENDMMSG, &mmsg) < 0)
+				error(1, errno, "TUNSENDMMSG");
+			break;
+		default:
+			error(1, 0, "%s is not an ingress mode",
+			      mode_name[mode]);
+		}
+	}
+
+	/* Let the receiver drain */
+	usleep(200000);
+	end = now();
+
+	bytes = __atomic_load_n(&rx_bytes, __ATOMIC_RELAXED);
+	dgrams = __atomic_load_n(&rx_dgrams, __ATOMIC_RELAXED);
+	printf("%-12s %10.0f datagrams/s %8.2f Gbit/s\n", mode_name[mode],
+	       dgrams / (end - start), bytes * 8 / (end - start) / 1e9);
+}
+
+static void parse_opts(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "t:s:")) != -1) {
+		switch (c) {
+		case 't':
+			cfg_duration = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			cfg_seg_size = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			error(1, 0, "usage: %s [-t seconds] [-s segment size]",
+			      argv[0]);
+		}
+	}
+
+	if (cfg_seg_size < 1 || HDR_LEN + MAX_SEGS * cfg_seg_size > 65535)
+		error(1, 0, "segment size out of range");
+}
+
+int main(int argc, char **argv)
+{
+	char ifname[IFNAMSIZ];
+	volatile int ready = 0;
+	pthread_t rx;
+	int fd;
+
+	parse_opts(argc, argv);
+
+	fd = tun_open(ifname);
+
+	if (pthread_create(&rx, NULL, do_rx, (void *)&ready))
+		error(1, errno, "pthread_create");
+	while (!ready)
+		usleep(1000);
+
+	printf("%s, %d byte segments\n", ifname, cfg_seg_size);
+	run(fd, MODE_WRITE);
+	run(fd, MODE_MMSG);
+	run(fd, MODE_USO);
+
+	/* The egress modes poll for packets rather than block in a read */
+	if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK))
+		error(1, errno, "fcntl O_NONBLOCK");
+
+	run_egress(fd, MODE_READ);
+	run_egress(fd, MODE_RECVMMSG);
+	run_egress(fd, MODE_USO_EGRESS);
+
+	stop = true;
+	pthread_join(rx, NULL);
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,257 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Measure SCM_RIGHTS sendmsg latency on AF_UNIX sockets while another
+ * process keeps the garbage collector busy by creating and dropping
+ * reference cycles of in-flight sockets. When run as root that process
+ * drops to an unprivileged user, so its in-flight fds are not accounted
+ * to the measured sender.
+ *
+ * Usage: unix_gc_stress [-t seconds] [-g gc threads] [-f fds per message]
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <error.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_GC_THREADS	64
+#define MAX_FDS		16
+#define MAX_SAMPLES	(1 << 22)
+
+static int cfg_duration = 5;
+static int cfg_gc_threads = 4;
+static int cfg_nr_fds = 4;
+
+static volatile bool stop;
+
+static unsigned long long *samples;
+static unsigned long nr_samples;
+static unsigned long cycles_created;
+
+#define NOBODY_UID	65534
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int send_fds(int fd, int *fds, int nr)
+{
+	char cbuf[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+	struct msghdr msg = {};
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	char c = 0;
+
+	iov.iov_base = &c;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = CMSG_SPACE(sizeof(int) * nr);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nr);
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * nr);
+
+	return sendmsg(fd, &msg, 0);
+}
+
+static int recv_fds(int fd, int *fds, int nr)
+{
+	char cbuf[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+	struct msghdr msg = {};
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	char c;
+	int ret;
+
+	iov.iov_base = &c;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+
+	ret = recvmsg(fd, &msg, 0);
+	if (ret < 0)
+		return ret;
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS ||
+	    cmsg->cmsg_len != CMSG_LEN(sizeof(int) * nr))
+		return -1;
+
+	memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * nr);
+	return 0;
+}
+
+/* Send each end of a socketpair over the other one and close both:
+ * the pair is then only reachable from its own receive queues and
+ * has to be reclaimed by the garbage collector.
+ */
+static void *gc_thread(void *arg)
+{
+	unsigned long n = 0;
+	int sv[2];
+
+	while (!stop) {
+		if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sv))
+			error(1, errno, "socketpair");
+
+		if (send_fds(sv[0], &sv[0], 1) < 0 ||
+		    send_fds(sv[1], &sv[1], 1) < 0) {
+			/* Over RLIMIT_NOFILE in flight, let the GC catch up */
+			if (errno != ETOOMANYREFS)
+				error(1, errno, "sendmsg cycle");
+			usleep(100);
+		} else {
+			n++;
+		}
+
+		close(sv[0]);
+		close(sv[1]);
+	}
+
+	__sync_fetch_and_add(&cycles_created, n);
+	return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static unsigned long long percentile(double p)
+{
+	unsigned long idx = (nr_samples - 1) * p;
+
+	return samples[idx];
+}
+
+static void parse_opts(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "t:g:f:")) != -1) {
+		switch (c) {
+		case 't':
+			cfg_duration = strtoul(optarg, NULL, 0);
+			break;
+		case 'g':
+			cfg_gc_threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			cfg_nr_fds = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			error(1, 0, "usage: %s [-t seconds] [-g threads] [-f fds]",
+			      argv[0]);
+		}
+	}
+
+	if (cfg_gc_threads > MAX_GC_THREADS)
+		error(1, 0, "at most %d gc threads", MAX_GC_THREADS);
+	if (cfg_nr_fds < 1 || cfg_nr_fds > MAX_FDS)
+		error(1, 0, "fds per message must be 1..%d", MAX_FDS);
+}
+
+static void run_gc_load(void)
+{
+	pthread_t threads[MAX_GC_THREADS];
+	int i;
+
+	if (!getuid() && setuid(NOBODY_UID))
+		error(1, errno, "setuid");
+
+	for (i = 0; i < cfg_gc_threads; i++)
+		if (pthread_create(&threads[i], NULL, gc_thread, NULL))
+			error(1, errno, "pthread_create");
+
+	sleep(cfg_duration);
+	stop = true;
+	for (i = 0; i < cfg_gc_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	printf("gc threads %d, cycles %lu\n", cfg_gc_threads, cycles_created);
+	exit(0);
+}
+
+int main(int argc, char **argv)
+{
+	int fds[MAX_FDS], rfds[MAX_FDS];
+	unsigned long long start, end, t;
+	int sv[2], status;
+	pid_t pid;
+	int i, j;
+
+	parse_opts(argc, argv);
+
+	samples = calloc(MAX_SAMPLES, sizeof(*samples));
+	if (!samples)
+		error(1, errno, "calloc");
+
+	/* The fds passed on the measured path are sockets themselves, as
+	 * they are for the HALs this models.
+	 */
+	for (i = 0; i < cfg_nr_fds; i++) {
+		fds[i] = socket(AF_UNIX, SOCK_DGRAM, 0);
+		if (fds[i] < 0)
+			error(1, errno, "socket");
+	}
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv))
+		error(1, errno, "socketpair");
+
+	pid = fork();
+	if (pid < 0)
+		error(1, errno, "fork");
+	if (!pid)
+		run_gc_load();
+
+	end = now_ns() + cfg_duration * 1000000000ULL;
+	while ((t = now_ns()) < end && nr_samples < MAX_SAMPLES) {
+		start = t;
+		if (send_fds(sv[0], fds, cfg_nr_fds) < 0)
+			error(1, errno, "sendmsg");
+		samples[nr_samples++] = now_ns() - start;
+
+		if (recv_fds(sv[1], rfds, cfg_nr_fds))
+			error(1, errno, "recvmsg");
+		for (j = 0; j < cfg_nr_fds; j++)
+			close(rfds[j]);
+	}
+
+	if (waitpid(pid, &status, 0) != pid ||
+	    !WIFEXITED(status) || WEXITSTATUS(status))
+		error(1, 0, "gc load failed");
+
+	if (!nr_samples)
+		error(1, 0, "no samples");
+
+	qsort(samples, nr_samples, sizeof(*samples), cmp_u64);
+
+	printf("sendmsg calls %lu\n", nr_samples);
+	printf("sendmsg latency (us): p50 %.1f p99 %.1f p99.9 %.1f p99.99 %.1f max %.1f\n",
+	       percentile(0.5) / 1000.0, percentile(0.99) / 1000.0,
+	       percentile(0.999) / 1000.0, percentile(0.9999) / 1000.0,
+	       samples[nr_samples - 1] / 1000.0);
+
+	return 0;
+}
@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Messages per second over an AF_UNIX socketpair for small message sizes,
+ * the pattern of logging, input and display sockets. Without -s all three
+ * socket types are run. For dgram and seqpacket the receiver also checks
+ * that every read returns exactly one message, the next one in sequence.
+ *
+ * Usage: unix_msg_bench [-t seconds per size] [-s stream|dgram|seqpacket]
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <error.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static const int sizes[] = { 64, 128, 256, 512, 1024, 2048, 4096 };
+
+static const struct {
+	const char *name;
+	int type;
+} types[] = {
+	{ "stream",	SOCK_STREAM },
+	{ "dgram",	SOCK_DGRAM },
+	{ "seqpacket",	SOCK_SEQPACKET },
+};
+
+static int cfg_duration = 2;
+static const char *cfg_type;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Drain the socket until the sender is done. Stream sockets may hand back
+ * several messages per read, so those are not checked.
+ */
+static void do_rx(int fd, int type, int size)
+{
+	unsigned long seq = 0, got;
+	char buf[65536];
+	int ret;
+
+	for (;;) {
+		ret = recv(fd, buf, sizeof(buf), 0);
+		if (ret <= 0)
+			break;
+		if (type == SOCK_STREAM)
+			continue;
+
+		if (ret != size)
+			error(1, 0, "message %lu: %d bytes, expected %d",
+			      seq, ret, size);
+		memcpy(&got, buf, sizeof(got));
+		if (got != seq || buf[size - 1] != 'a')
+			error(1, 0, "message %lu: got message %lu", seq, got);
+		seq++;
+	}
+
+	if (ret < 0)
+		error(1, errno, "recv");
+	exit(0);
+}
+
+static double run_size(int type, int size)
+{
+	unsigned long msgs = 0;
+	double start, end;
+	int sv[2], status;
+	char *buf;
+	pid_t pid;
+
+	if (socketpair(AF_UNIX, type, 0, sv))
+		error(1, errno, "socketpair");
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		error(1, errno, "fork");
+	if (!pid) {
+		close(sv[0]);
+		do_rx(sv[1], type, size);
+	}
+	close(sv[1]);
+
+	buf = malloc(size);
+	if (!buf)
+		error(1, errno, "malloc");
+	memset(buf, 'a', size);
+
+	start = now();
+	end = start + cfg_duration;
+	do {
+		int i;
+
+		/* Check the clock every so often only */
+		for (i = 0; i < 1024; i++) {
+			unsigned long seq = msgs + i;
+
+			memcpy(buf, &seq, sizeof(seq));
+			if (send(sv[0], buf, size, 0) != size)
+				error(1, errno, "send");
+		}
+		msgs += i;
+	} while (now() < end);
+	end = now();
+
+	/* A datagram receiver sees no end of file, send it an empty message */
+	if (type != SOCK_STREAM && send(sv[0], buf, 0, 0))
+		error(1, errno, "send");
+	close(sv[0]);
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+	    WEXITSTATUS(status))
+		error(1, 0, "receiver failed");
+
+	free(buf);
+	return msgs / (end - start);
+}
+
+static void parse_opts(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "t:s:")) != -1) {
+		switch (c) {
+		case 't':
+			cfg_duration = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			cfg_type = optarg;
+			break;
+		default:
+			error(1, 0, "usage: %s [-t seconds] [-s stream|dgram|seqpacket]",
+			      argv[0]);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	bool found = false;
+	int i, j;
+
+	parse_opts(argc, argv);
+	signal(SIGPIPE, SIG_IGN);
+
+	for (i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+		if (cfg_type && strcmp(cfg_type, types[i].name))
+			continue;
+		found = true;
+
+		for (j = 0; j < sizeof(sizes) / sizeof(sizes[0]); j++)
+			printf("%-9s %5d bytes: %12.0f msgs/s\n",
+			       types[i].name, sizes[j],
+			       run_size(types[i].type, sizes[j]));
+	}
+
+	if (!found)
+		error(1, 0, "unknown socket type %s", cfg_type);
+
+	return 0;
+}
@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Check the byte stream of an AF_UNIX stream socketpair when small writes,
+ * which may be appended to the skb at the tail of the receive queue, are
+ * interleaved with partial reads and MSG_PEEK.
+ *
+ * The first pass runs writer and reader in one process in a random but
+ * reproducible order. The second runs them in two processes so writes race
+ * with a reader that holds the queue.
+ *
+ * Usage: unix_stream_small [-n iterations] [-s seed]
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <error.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define MAX_CHUNK	8192
+
+static int cfg_iterations = 100000;
+static unsigned int cfg_seed = 1;
+
+/* Byte at offset off of the stream, not periodic at any write size */
+static unsigned char pattern(unsigned long off)
+{
+	return off * 7 + (off >> 8) * 13 + (off >> 16);
+}
+
+static void fill(unsigned char *buf, unsigned long off, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = pattern(off + i);
+}
+
+static void check(const unsigned char *buf, unsigned long off, int len,
+		  const char *what)
+{
+	int i;
+
+	for (i = 0; i < len; i++) {
+		if (buf[i] != pattern(off + i))
+			error(1, 0, "%s: bad byte at stream offset %lu: 0x%x, expected 0x%x",
+			      what, off + i, buf[i], pattern(off + i));
+	}
+}
+
+/* Mostly sizes that take the small message path, some that don't */
+static int chunk_len(void)
+{
+	if (rand() % 8)
+		return 1 + rand() % 4096;
+	return 1 + rand() % MAX_CHUNK;
+}
+
+static void do_interleaved(void)
+{
+	unsigned char buf[MAX_CHUNK];
+	unsigned long wr = 0, rd = 0;
+	int sv[2], i, len, ret;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv))
+		error(1, errno, "socketpair");
+
+	srand(cfg_seed);
+	for (i = 0; i < cfg_iterations; i++) {
+		len = chunk_len();
+
+		switch (rand() % 3) {
+		case 0:
+			fill(buf, wr, len);
+			ret = send(sv[0], buf, len, MSG_DONTWAIT);
+			if (ret < 0 && errno != EAGAIN)
+				error(1, errno, "send");
+			if (ret > 0)
+				wr += ret;
+			break;
+		case 1:
+			ret = recv(sv[1], buf, len, MSG_DONTWAIT | MSG_PEEK);
+			if (ret < 0 && errno != EAGAIN)
+				error(1, errno, "recv peek");
+			if (ret > 0)
+				check(buf, rd, ret, "peek");
+			break;
+		case 2:
+			ret = recv(sv[1], buf, len, MSG_DONTWAIT);
+			if (ret < 0 && errno != EAGAIN)
+				error(1, errno, "recv");
+			if (ret > 0) {
+				check(buf, rd, ret, "recv");
+				rd += ret;
+			}
+			break;
+		}
+	}
+
+	/* Whatever is still queued must follow on as well */
+	while (rd < wr) {
+		ret = recv(sv[1], buf, sizeof(buf), MSG_DONTWAIT);
+		if (ret <= 0)
+			error(1, errno, "recv drain: %lu bytes missing", wr - rd);
+		check(buf, rd, ret, "drain");
+		rd += ret;
+	}
+
+	if (recv(sv[1], buf, 1, MSG_DONTWAIT) != -1 || errno != EAGAIN)
+		error(1, 0, "data past the end of the stream");
+
+	close(sv[0]);
+	close(sv[1]);
+	printf("interleaved: %lu bytes ok\n", rd);
+}
+
+static void do_writer(int fd, unsigned long total)
+{
+	unsigned char buf[MAX_CHUNK];
+	unsigned long wr = 0;
+	int len, ret;
+
+	srand(cfg_seed + 1);
+	while (wr < total) {
+		len = chunk_len();
+		if (len > total - wr)
+			len = total - wr;
+		fill(buf, wr, len);
+		ret = send(fd, buf, len, 0);
+		if (ret < 0)
+			error(1, errno, "send");
+		wr += ret;
+	}
+
+	close(fd);
+	exit(0);
+}
+
+static void do_concurrent(void)
+{
+	unsigned long total = (unsigned long)cfg_iterations * 2048;
+	unsigned char buf[MAX_CHUNK];
+	unsigned long rd = 0;
+	int sv[2], status, ret;
+	pid_t pid;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv))
+		error(1, errno, "socketpair");
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		error(1, errno, "fork");
+	if (!pid) {
+		close(sv[1]);
+		do_writer(sv[0], total);
+	}
+	close(sv[0]);
+
+	srand(cfg_seed + 2);
+	for (;;) {
+		if (!(rand() % 4)) {
+			ret = recv(sv[1], buf, chunk_len(), MSG_PEEK);
+			if (ret < 0)
+				error(1, errno, "recv peek");
+			check(buf, rd, ret, "peek");
+		}
+
+		ret = recv(sv[1], buf, chunk_len(), 0);
+		if (ret < 0)
+			error(1, errno, "recv");
+		if (!ret)
+			break;
+		check(buf, rd, ret, "recv");
+		rd += ret;
+	}
+
+	if (waitpid(pid, &status, 0) != pid ||
+	    !WIFEXITED(status) || WEXITSTATUS(status))
+		error(1, 0, "writer failed");
+
+	if (rd != total)
+		error(1, 0, "read %lu bytes, expected %lu", rd, total);
+
+	close(sv[1]);
+	printf("concurrent: %lu bytes ok\n", rd);
+}
+
+static void parse_opts(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "n:s:")) != -1) {
+		switch (c) {
+		case 'n':
+			cfg_iterations = strtol(optarg, NULL, 0);
+			break;
+		case 's':
+			cfg_seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			error(1, 0, "usage: %s [-n iterations] [-s seed]",
+			      argv[0]);
+		}
+	}
+
+	if (cfg_iterations <= 0)
+		error(1, 0, "iterations must be positive");
+}
+
+int main(int argc, char **argv)
+{
+	parse_opts(argc, argv);
+
+	do_interleaved();
+	do_concurrent();
+
+	return 0;
+}